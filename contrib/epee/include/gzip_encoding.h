@@ -27,9 +27,17 @@
 #ifndef _GZIP_ENCODING_H_
 #define _GZIP_ENCODING_H_
 #include "net/http_client_base.h"
-#include "zlib/zlib.h"
+#include <zlib.h>
 //#include "http.h"
 
+#ifndef GZIP_DECODE_CHUNK_SIZE
+#define GZIP_DECODE_CHUNK_SIZE (64 * 1024)
+#endif
+
+#ifndef GZIP_MAX_INFLATED_SIZE
+#define GZIP_MAX_INFLATED_SIZE (100 * 1024 * 1024) // about the biggest levin packet we accept
+#endif
+
 namespace epee
 {
 namespace net_utils
@@ -42,24 +50,28 @@ class content_encoding_gzip : public i_sub_handler
 		*  Function content_encoding_gzip : Constructor
 		*
 		*/
-	inline content_encoding_gzip(i_target_handler *powner_filter, bool is_deflate_mode = false) : m_powner_filter(powner_filter),
+	inline content_encoding_gzip(i_target_handler *powner_filter, bool is_deflate_mode = false, size_t max_inflated_size = GZIP_MAX_INFLATED_SIZE) : m_powner_filter(powner_filter),
 																								  m_is_stream_ended(false),
 																								  m_is_deflate_mode(is_deflate_mode),
-																								  m_is_first_update_in(true)
+																								  m_is_first_update_in(true),
+																								  m_inflated_size(0),
+																								  m_max_inflated_size(max_inflated_size)
 	{
 		memset(&m_zstream_in, 0, sizeof(m_zstream_in));
 		memset(&m_zstream_out, 0, sizeof(m_zstream_out));
-		int ret = 0;
+		int ret_in = 0, ret_out = 0;
 		if(is_deflate_mode)
 		{
-			ret = inflateInit(&m_zstream_in);
-			ret = deflateInit(&m_zstream_out, Z_DEFAULT_COMPRESSION);
+			ret_in = inflateInit(&m_zstream_in);
+			ret_out = deflateInit(&m_zstream_out, Z_DEFAULT_COMPRESSION);
 		}
 		else
 		{
-			ret = inflateInit2(&m_zstream_in, 0x1F);
-			ret = deflateInit2(&m_zstream_out, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 0x1F, 8, Z_DEFAULT_STRATEGY);
+			ret_in = inflateInit2(&m_zstream_in, 0x1F);
+			ret_out = deflateInit2(&m_zstream_out, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 0x1F, 8, Z_DEFAULT_STRATEGY);
 		}
+		if(ret_in != Z_OK || ret_out != Z_OK)
+			GULPS_LOG_ERROR("content_encoding_gzip: failed to init zlib streams, err = ", ret_in, "/", ret_out);
 	}
 	/*! \brief
 		*  Function content_encoding_gzip : Destructor
@@ -87,22 +99,19 @@ class content_encoding_gzip : public i_sub_handler
 		piece_of_transfer.clear();
 
 		std::string decode_summary_buff;
+		std::string current_decode_buff(GZIP_DECODE_CHUNK_SIZE, 'X');
 
-		size_t ungzip_size = m_pre_decode.size() * 0x30;
-		std::string current_decode_buff(ungzip_size, 'X');
-
-		//Here the cycle is introduced where we unpack the buffer, the cycle is required
-		//because of the case where if after unpacking the data will exceed the awaited size, we will not halt with error
-		bool continue_unpacking = true;
+		//Here the cycle is introduced where we unpack the buffer chunk by chunk, the cycle is required
+		//because the unpacked data may not fit into one chunk, in which case zlib keeps the rest for the next call
 		bool first_step = true;
-		while(m_pre_decode.size() && continue_unpacking)
+		while(!m_is_stream_ended)
 		{
 
 			//fill buffers
 			m_zstream_in.next_in = (Bytef *)m_pre_decode.data();
 			m_zstream_in.avail_in = (uInt)m_pre_decode.size();
-			m_zstream_in.next_out = (Bytef *)current_decode_buff.data();
-			m_zstream_in.avail_out = (uInt)ungzip_size;
+			m_zstream_in.next_out = (Bytef *)&current_decode_buff[0];
+			m_zstream_in.avail_out = (uInt)current_decode_buff.size();
 
 			int flag = Z_SYNC_FLUSH;
 			int ret = inflate(&m_zstream_in, flag);
@@ -145,32 +154,26 @@ class content_encoding_gzip : public i_sub_handler
 			//leave only unpacked part in the output buffer to start with it the next time
 			m_pre_decode.erase(0, m_pre_decode.size() - m_zstream_in.avail_in);
 			//if decoder gave nothing to return, then everything is ahead, now simply break
-			if(ungzip_size == m_zstream_in.avail_out)
+			const size_t unpacked = current_decode_buff.size() - m_zstream_in.avail_out;
+			if(!unpacked)
 				break;
 
-			//decode_buff currently stores data parts that were unpacked, fix this size
-			current_decode_buff.resize(ungzip_size - m_zstream_in.avail_out);
-			if(decode_summary_buff.size())
-				decode_summary_buff += current_decode_buff;
-			else
-				current_decode_buff.swap(decode_summary_buff);
+			//a few kilobytes on the wire can unpack to gigabytes, don't take more than the caller can hold
+			m_inflated_size += unpacked;
+			GULPS_CHECK_AND_ASSERT_MES(m_inflated_size <= m_max_inflated_size, false, "content_encoding_gzip::update_in() Inflated data exceeds the limit of ", m_max_inflated_size, " bytes");
 
-			current_decode_buff.resize(ungzip_size);
+			decode_summary_buff.append(current_decode_buff.data(), unpacked);
 			first_step = false;
 		}
 
 		//Process these data if required
-		bool res = true;
-
-		res = m_powner_filter->handle_target_data(decode_summary_buff);
-
-		return true;
+		return m_powner_filter->handle_target_data(decode_summary_buff);
 	}
 	/*! \brief
 		*  Function stop : Entry point for stop signal and flushing cached data buffer.
 		*
 		*/
-	inline virtual void stop(std::string &OUT collect_remains)
+	inline virtual void stop(std::string &collect_remains)
 	{
 	}
 
@@ -208,6 +211,11 @@ class content_encoding_gzip : public i_sub_handler
 		*	Marks that it is a first data packet 
 		*/
 	bool m_is_first_update_in;
+	/*! \brief
+		*	Bytes unpacked so far and the most we accept before giving up on the stream
+		*/
+	size_t m_inflated_size;
+	size_t m_max_inflated_size;
 };
 }
 }
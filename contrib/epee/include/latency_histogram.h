@@ -0,0 +1,163 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <vector>
+
+namespace epee
+{
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+// Lock-free latency histogram with HDR-style log-linear buckets. Values
+// below 2^sub_bits get one bucket each, every power of two above that is
+// split into 2^sub_bits equal buckets, so any recorded value is known to
+// within 1/2^sub_bits of itself. Recording is a handful of relaxed atomic
+// adds, so the histogram can sit on hot paths and be read concurrently.
+//
+// Units are up to the caller; the RPC metrics record microseconds.
+class latency_histogram
+{
+  public:
+	static constexpr unsigned sub_bits = 3;
+	static constexpr uint64_t sub_count = uint64_t(1) << sub_bits;
+	// Largest power of two tracked, values above it are clamped into the last bucket
+	static constexpr unsigned max_exp = 36;
+	static constexpr size_t bucket_count = (max_exp - sub_bits + 2) * sub_count;
+	static constexpr uint64_t max_trackable = (uint64_t(1) << (max_exp + 1)) - 1;
+
+	struct snapshot
+	{
+		std::vector<uint64_t> buckets;
+		uint64_t count = 0;
+		uint64_t sum = 0;
+		uint64_t max = 0;
+
+		// Smallest value v such that at least q (0..1) of the samples are <= v,
+		// reported as the top of the bucket it falls in and never above max.
+		uint64_t percentile(double q) const
+		{
+			if(count == 0)
+				return 0;
+			uint64_t total = 0;
+			for(uint64_t b : buckets)
+				total += b;
+			uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * total + 0.5));
+			uint64_t seen = 0;
+			for(size_t i = 0; i < buckets.size(); ++i)
+			{
+				seen += buckets[i];
+				if(seen >= rank)
+					return std::min(bucket_upper_bound(i) - 1, max);
+			}
+			return max;
+		}
+
+		// Number of samples known to be < bound, i.e. in buckets lying entirely below it
+		uint64_t count_below(uint64_t bound) const
+		{
+			uint64_t n = 0;
+			for(size_t i = 0; i < buckets.size() && bucket_upper_bound(i) <= bound; ++i)
+				n += buckets[i];
+			return n;
+		}
+	};
+
+	latency_histogram() : m_count(0), m_sum(0), m_max(0)
+	{
+		for(auto &b : m_buckets)
+			b.store(0, std::memory_order_relaxed);
+	}
+
+	latency_histogram(const latency_histogram &) = delete;
+	latency_histogram &operator=(const latency_histogram &) = delete;
+
+	static size_t bucket_index(uint64_t v)
+	{
+		if(v > max_trackable)
+			v = max_trackable;
+		if(v < sub_count)
+			return static_cast<size_t>(v);
+		unsigned e = 63 - __builtin_clzll(v);
+		return (e - sub_bits + 1) * sub_count + static_cast<size_t>((v >> (e - sub_bits)) - sub_count);
+	}
+
+	// Exclusive upper bound of the values that land in bucket idx
+	static uint64_t bucket_upper_bound(size_t idx)
+	{
+		if(idx < sub_count)
+			return idx + 1;
+		unsigned e = static_cast<unsigned>(idx / sub_count) + sub_bits - 1;
+		uint64_t s = idx % sub_count;
+		return (sub_count + s + 1) << (e - sub_bits);
+	}
+
+	static uint64_t micros_since(const std::chrono::steady_clock::time_point &start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void record(uint64_t v)
+	{
+		m_buckets[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(v, std::memory_order_relaxed);
+		uint64_t cur = m_max.load(std::memory_order_relaxed);
+		while(v > cur && !m_max.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+			;
+	}
+
+	uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+	uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+	// Readers racing with writers may see a count slightly off from the
+	// bucket total, which is fine for monitoring purposes.
+	snapshot get_snapshot() const
+	{
+		snapshot s;
+		s.buckets.resize(bucket_count);
+		for(size_t i = 0; i < bucket_count; ++i)
+			s.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+		s.count = m_count.load(std::memory_order_relaxed);
+		s.sum = m_sum.load(std::memory_order_relaxed);
+		s.max = m_max.load(std::memory_order_relaxed);
+		return s;
+	}
+
+  private:
+	std::array<std::atomic<uint64_t>, bucket_count> m_buckets;
+	std::atomic<uint64_t> m_count;
+	std::atomic<uint64_t> m_sum;
+	std::atomic<uint64_t> m_max;
+};
+}
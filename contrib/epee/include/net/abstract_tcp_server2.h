@@ -71,6 +71,19 @@ struct i_connection_filter
 	virtual ~i_connection_filter() {}
 };
 
+/// Bytes still to come for the packet the protocol handler is reading, for handlers that can tell
+template <class t_protocol_handler>
+auto get_recv_size_hint(const t_protocol_handler &handler, int) -> decltype(handler.get_recv_size_hint())
+{
+	return handler.get_recv_size_hint();
+}
+
+template <class t_protocol_handler>
+size_t get_recv_size_hint(const t_protocol_handler &handler, long)
+{
+	return 0;
+}
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
@@ -112,8 +125,9 @@ class connection
 
   private:
 	//----------------- i_service_endpoint ---------------------
-	virtual bool do_send(const void *ptr, size_t cb);		///< (see do_send from i_service_endpoint)
-	virtual bool do_send_chunk(const void *ptr, size_t cb); ///< will send (or queue) a part of data
+	virtual bool do_send(const void *ptr, size_t cb);				 ///< (see do_send from i_service_endpoint)
+	virtual bool do_send_shared(const shared_buffer &buf);			 ///< (see do_send_shared from i_service_endpoint)
+	bool do_send_chunk(const shared_buffer &buf, size_t offset, size_t cb); ///< will send (or queue) a part of data
 	virtual bool close();
 	virtual bool call_run_once_service_io();
 	virtual bool request_callback();
@@ -135,7 +149,11 @@ class connection
 	boost::posix_time::milliseconds get_default_time() const;
 	boost::posix_time::milliseconds get_timeout_from_bytes_read(size_t bytes) const;
 
-	/// Buffer for incoming data.
+	/// Pick the buffer for the next read from what the last one and the protocol handler tell us
+	void adapt_recv_buffer(size_t bytes_transferred);
+	boost::asio::mutable_buffers_1 get_recv_buffer();
+
+	/// Buffer for incoming data, m_recv_buffer takes over for big packets
 	boost::array<char, 8192> buffer_;
 	//boost::array<char, 1024> buffer_;
 
@@ -148,7 +166,7 @@ class connection
 	//typename t_protocol_handler::config_type m_dummy_config;
 	std::list<boost::shared_ptr<connection<t_protocol_handler>>> m_self_refs; // add_ref/release support
 	critical_section m_self_refs_lock;
-	critical_section m_chunking_lock; // held while we add small chunks of the big do_send() to small do_send_chunk()
+	critical_section m_chunking_lock; // held while we add small chunks of the big do_send_shared() to small do_send_chunk()
 
 	t_connection_type m_connection_type;
 
@@ -167,7 +167,7 @@ bool connection<t_protocol_handler>::start(bool is_income, bool is_multithreaded
 
 	reset_timer(get_default_time(), false);
 
-	socket_.async_read_some(boost::asio::buffer(buffer_),
+	socket_.async_read_some(get_recv_buffer(),
 							strand_.wrap(
 								boost::bind(&connection<t_protocol_handler>::handle_read, self,
 											boost::asio::placeholders::error,
@@ -322,7 +322,7 @@ void connection<t_protocol_handler>::handle_read(const boost::system::error_code
 		logger_handle_net_read(bytes_transferred);
 		context.m_last_recv = time(NULL);
 		context.m_recv_cnt += bytes_transferred;
-		bool recv_res = m_protocol_handler.handle_recv(buffer_.data(), bytes_transferred);
+		bool recv_res = m_protocol_handler.handle_recv(boost::asio::buffer_cast<const char *>(get_recv_buffer()), bytes_transferred);
 		if(!recv_res)
 		{
 			//GULPS_INFO("[sock " << socket_.native_handle() << "] protocol_want_close");
@@ -340,7 +340,8 @@ void connection<t_protocol_handler>::handle_read(const boost::system::error_code
 		else
 		{
 			reset_timer(get_timeout_from_bytes_read(bytes_transferred), false);
-			socket_.async_read_some(boost::asio::buffer(buffer_),
+			adapt_recv_buffer(bytes_transferred);
+			socket_.async_read_some(get_recv_buffer(),
 									strand_.wrap(
 										boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
 													boost::asio::placeholders::error,
@@ -365,6 +366,25 @@ void connection<t_protocol_handler>::handle_read(const boost::system::error_code
 }
 //---------------------------------------------------------------------------------
 template <class t_protocol_handler>
+void connection<t_protocol_handler>::adapt_recv_buffer(size_t bytes_transferred)
+{
+	// only grow on data that actually arrived, the size a peer announces costs it nothing
+	const size_t read_size = m_recv_buffer.empty() ? buffer_.size() : m_recv_buffer.size();
+	if(bytes_transferred == read_size)
+		grow_recv_buffer(read_size * 2); // the socket had more than we could take
+	else if(bytes_transferred < buffer_.size() && get_recv_size_hint(m_protocol_handler, 0) <= buffer_.size())
+		release_recv_buffer(); // back to small messages
+}
+//---------------------------------------------------------------------------------
+template <class t_protocol_handler>
+boost::asio::mutable_buffers_1 connection<t_protocol_handler>::get_recv_buffer()
+{
+	if(m_recv_buffer.empty())
+		return boost::asio::buffer(buffer_);
+	return boost::asio::buffer(m_recv_buffer);
+}
+//---------------------------------------------------------------------------------
+template <class t_protocol_handler>
 bool connection<t_protocol_handler>::call_run_once_service_io()
 {
 	GULPS_TRY_ENTRY();
@@ -393,6 +413,15 @@ bool connection<t_protocol_handler>::call_run_once_service_io()
 //---------------------------------------------------------------------------------
 template <class t_protocol_handler>
 bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
+{
+	GULPS_TRY_ENTRY();
+	// the only copy of the data, the send queue keeps references to it from here on
+	return do_send_shared(make_shared_buffer(std::string((const char *)ptr, cb)));
+	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+}
+//---------------------------------------------------------------------------------
+template <class t_protocol_handler>
+bool connection<t_protocol_handler>::do_send_shared(const shared_buffer &buf)
 {
 	GULPS_TRY_ENTRY();
 
@@ -402,8 +431,8 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 		return false;
 	if(m_was_shutdown)
 		return false;
-	// TODO avoid copy
 
+	const size_t cb = buf->size();
 	const double factor = 32;			 // TODO config
 	typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
 	const t_safe chunksize_good = (t_safe)(1024 * std::max(1.0, factor));
@@ -418,7 +447,7 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 		{																					// LOCK: chunking
 			epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical ***
 
-			GULPSF_LOG_L1("do_send() will SPLIT into small chunks, from packet={} B for ptr={}", cb , ptr);
+			GULPSF_LOG_L1("do_send() will SPLIT into small chunks, from packet={} B for ptr={}", cb , (const void *)buf->data());
 			t_safe all = cb; // all bytes to send
 			t_safe pos = 0;  // current sending position
 			// 01234567890
@@ -426,8 +455,7 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 			//     ^^^^    (pos=4, len=4)     ;   pos:=pos+len, pos=8
 			//         ^^^ (pos=8, len=4)    ;
 
-			// const size_t bufsize = chunksize_good; // TODO safecast
-			// char* buf = new char[ bufsize ];
+			// chunks are slices of the same shared buffer, nothing is copied here
 
 			bool all_ok = true;
 			while(pos < all)
@@ -442,29 +470,22 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 				GULPS_CHECK_AND_ASSERT_MES(len > 0, false, "len not strictly positive");										// (redundant)
 				GULPS_CHECK_AND_ASSERT_MES(len_unsigned < std::numeric_limits<size_t>::max(), false, "Invalid len_unsigned"); // yeap we want strong < then max size, to be sure
 
-				void *chunk_start = ((char *)ptr) + pos;
-				GULPSF_LOG_L1("chunk_start={} ptr={} pos={}", chunk_start , ptr , pos);
-				GULPS_CHECK_AND_ASSERT_MES(chunk_start >= ptr, false, "Pointer wraparound"); // not wrapped around address?
-				//std::memcpy( (void*)buf, chunk_start, len);
-
 				GULPSF_LOG_L1("part of {}: pos={} len={}", lenall , pos , len);
 
-				bool ok = do_send_chunk(chunk_start, len); // <====== ***
+				bool ok = do_send_chunk(buf, pos, len); // <====== ***
 
 				all_ok = all_ok && ok;
 				if(!all_ok)
 				{
-					GULPSF_LOG_L1("do_send() DONE ***FAILED*** from packet={} B for ptr={}", cb , ptr);
+					GULPSF_LOG_L1("do_send() DONE ***FAILED*** from packet={} B for ptr={}", cb , (const void *)buf->data());
 					GULPSF_LOG_L1("do_send() SEND was aborted in middle of big package - this is mostly harmless (e.g. peer closed connection) but if it causes trouble tell us at https://github.com/ryo-currency/ryo. {}", cb);
 					return false; // partial failure in sending
 				}
 				pos = pos + len;
 				GULPS_CHECK_AND_ASSERT_MES(pos > 0, false, "pos <= 0");
-
-				// (in catch block, or uniq pointer) delete buf;
 			} // each chunk
 
-			GULPSF_LOG_L1("do_send() DONE SPLIT from packet={} B for ptr={}", cb , ptr);
+			GULPSF_LOG_L1("do_send() DONE SPLIT from packet={} B for ptr={}", cb , (const void *)buf->data());
 
 			GULPSF_LOG_L1("do_send() m_connection_type = {}", m_connection_type);
 
@@ -472,16 +493,16 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 		}				   // LOCK: chunking
 	}					   // a big block (to be chunked) - all chunks
 	else
-	{								   // small block
-		return do_send_chunk(ptr, cb); // just send as 1 big chunk
+	{									  // small block
+		return do_send_chunk(buf, 0, cb); // just send as 1 big chunk
 	}
 
-	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-} // do_send()
+	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_shared", false);
+} // do_send_shared()
 
 //---------------------------------------------------------------------------------
 template <class t_protocol_handler>
-bool connection<t_protocol_handler>::do_send_chunk(const void *ptr, size_t cb)
+bool connection<t_protocol_handler>::do_send_chunk(const shared_buffer &buf, size_t offset, size_t cb)
 {
 	GULPS_TRY_ENTRY();
 	// Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -533,8 +554,7 @@ bool connection<t_protocol_handler>::do_send_chunk(const void *ptr, size_t cb)
 		}
 	}
 
-	m_send_que.resize(m_send_que.size() + 1);
-	m_send_que.back().assign((const char *)ptr, cb);
+	m_send_que.push_back(send_que_entry{buf, offset, cb});
 
 	if(m_send_que.size() > 1)
 	{ // active operation should be in progress, nothing to do, just wait last operation callback
@@ -556,7 +576,7 @@ bool connection<t_protocol_handler>::do_send_chunk(const void *ptr, size_t cb)
 		auto size_now = m_send_que.front().size();
 		GULPSF_LOG_L1("do_send() NOW SENSD: packet={} B", size_now );
 		if(speed_limit_is_enabled())
-			do_send_handler_write(ptr, size_now); // (((H)))
+			do_send_handler_write(m_send_que.front().data(), size_now); // (((H)))
 
 		GULPS_CHECK_AND_ASSERT_MES(size_now == m_send_que.front().size(), false, "Unexpected queue size");
 		reset_timer(get_default_time(), false);
@@ -574,7 +594,7 @@ bool connection<t_protocol_handler>::do_send_chunk(const void *ptr, size_t cb)
 
 	return true;
 
-	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
 } // do_send_chunk
 //---------------------------------------------------------------------------------
 template <class t_protocol_handler>
@@ -82,6 +82,17 @@ enum t_connection_type
 
 std::string to_string(t_connection_type type);
 
+/// A slice of a shared send buffer, big packets are queued as several slices of the same buffer
+struct send_que_entry
+{
+	shared_buffer m_buf;
+	size_t m_offset;
+	size_t m_size;
+
+	const char *data() const { return m_buf->data() + m_offset; }
+	size_t size() const { return m_size; }
+};
+
 class connection_basic
 {
 	GULPS_CAT_MAJOR("epee_conn_basics");
@@ -93,7 +104,7 @@ class connection_basic
 	volatile uint32_t m_want_close_connection;
 	std::atomic<bool> m_was_shutdown;
 	critical_section m_send_que_lock;
-	std::list<std::string> m_send_que;
+	std::list<send_que_entry> m_send_que;
 	volatile bool m_is_multithreaded;
 	double m_start_time;
 	/// Strand to ensure the connection's handlers are not called concurrently.
@@ -102,6 +113,8 @@ class connection_basic
 	boost::asio::ip::tcp::socket socket_;
 
 	std::atomic<long> &m_ref_sock_count; // reference to external counter of existing sockets that we will ++/--
+
+	std::vector<char> m_recv_buffer; // empty unless grown with grow_recv_buffer()
   public:
 	// first counter is the ++/-- count of current sockets, the other socket_number is only-increasing ++ number generator
 	connection_basic(boost::asio::io_service &io_service, std::atomic<long> &ref_sock_count, std::atomic<long> &sock_number);
@@ -117,6 +130,10 @@ class connection_basic
 
 	void set_start_time();
 
+	// bigger receive buffer while big packets stream in:
+	void grow_recv_buffer(size_t size);
+	void release_recv_buffer();
+
 	// config for rate limit
 
 	static void set_rate_up_limit(uint64_t limit);
@@ -111,6 +111,7 @@ struct http_header_info
 	std::string m_cookie;			 //"Cookie:"
 	std::string m_user_agent;		 //"User-Agent:"
 	std::string m_origin;			 //"Origin:"
+	std::string m_accept_encoding;   //"Accept-Encoding:"
 	fields_list m_etc_fields;
 
 	void clear()
@@ -125,6 +126,7 @@ struct http_header_info
 		m_cookie.clear();
 		m_user_agent.clear();
 		m_origin.clear();
+		m_accept_encoding.clear();
 		m_etc_fields.clear();
 	}
 };
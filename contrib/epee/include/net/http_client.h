@@ -265,13 +265,14 @@ class http_simple_client_template : public i_target_handler
 	std::string m_chunked_cache;
 	critical_section m_lock;
 	bool m_ssl;
+	bool m_stale_connection;
 
   public:
 
 	GULPS_CAT_MAJOR("epee_http_client");
 
 	explicit http_simple_client_template()
-		: i_target_handler(), m_net_client(), m_host_buff(), m_port(), m_auth(), m_header_cache(), m_response_info(), m_len_in_summary(0), m_len_in_remain(0), m_pcontent_encoding_handler(nullptr), m_state(), m_chunked_state(), m_chunked_cache(), m_lock(), m_ssl(false)
+		: i_target_handler(), m_net_client(), m_host_buff(), m_port(), m_auth(), m_header_cache(), m_response_info(), m_len_in_summary(0), m_len_in_remain(0), m_pcontent_encoding_handler(nullptr), m_state(), m_chunked_state(), m_chunked_cache(), m_lock(), m_ssl(false), m_stale_connection(false)
 	{
 	}
 
@@ -338,6 +339,9 @@ class http_simple_client_template : public i_target_handler
 	inline bool invoke(const boost::string_ref uri, const boost::string_ref method, const std::string &body, std::chrono::milliseconds timeout, const http_response_info **ppresponse_info = NULL, const fields_list &additional_params = fields_list())
 	{
 		CRITICAL_REGION_LOCAL(m_lock);
+		//a kept-alive connection may have been dropped by the server while idle, in which case
+		//the first exchange on it fails without any response and is retried on a new connection
+		bool reused_connection = true;
 		if(!is_connected())
 		{
 			GULPS_LOG_L1("Reconnecting...");
@@ -346,6 +350,7 @@ class http_simple_client_template : public i_target_handler
 				GULPSF_LOG_L1("Failed to connect to {}:{}", m_host_buff , m_port);
 				return false;
 			}
+			reused_connection = false;
 		}
 
 		std::string req_buff{};
@@ -353,6 +358,9 @@ class http_simple_client_template : public i_target_handler
 		req_buff.append(method.data(), method.size()).append(" ").append(uri.data(), uri.size()).append(" HTTP/1.1\r\n");
 		add_field(req_buff, "Host", m_host_buff);
 		add_field(req_buff, "Content-Length", std::to_string(body.size()));
+#ifdef HTTP_ENABLE_GZIP
+		add_field(req_buff, "Accept-Encoding", "gzip, deflate");
+#endif
 
 		//handle "additional_params"
 		for(const auto &field : additional_params)
@@ -368,24 +376,21 @@ class http_simple_client_template : public i_target_handler
 			req_buff += "\r\n";
 			//--
 
-			bool res = m_net_client.send(req_buff, timeout);
-			if(!res)
+			bool res = send_and_receive(req_buff, body, timeout);
+			if(!res && reused_connection && m_stale_connection)
 			{
-				GULPSF_LOG_L1("HTTP_CLIENT: Failed to SEND");
-				return false;
+				GULPS_LOG_L1("Kept-alive connection was closed by the server, reconnecting...");
+				disconnect();
+				if(!connect(timeout))
+				{
+					GULPSF_LOG_L1("Failed to connect to {}:{}", m_host_buff , m_port);
+					return false;
+				}
+				res = send_and_receive(req_buff, body, timeout);
 			}
-			if(body.size())
-				res = m_net_client.send(body, timeout);
 			if(!res)
-			{
-				GULPSF_LOG_L1("HTTP_CLIENT: Failed to SEND");
-				return false;
-			}
-
-			m_response_info.clear();
-			m_state = reciev_machine_state_header;
-			if(!handle_reciev(timeout))
 				return false;
+			reused_connection = false;
 			if(m_response_info.m_response_code != 401)
 			{
 				if(ppresponse_info)
@@ -426,6 +431,29 @@ class http_simple_client_template : public i_target_handler
 	}
 	//---------------------------------------------------------------------------
   private:
+	//---------------------------------------------------------------------------
+	inline bool send_and_receive(const std::string &req_buff, const std::string &body, std::chrono::milliseconds timeout)
+	{
+		m_response_info.clear();
+		m_stale_connection = true;
+		bool res = m_net_client.send(req_buff, timeout);
+		if(!res)
+		{
+			GULPSF_LOG_L1("HTTP_CLIENT: Failed to SEND");
+			return false;
+		}
+		if(body.size())
+			res = m_net_client.send(body, timeout);
+		if(!res)
+		{
+			GULPSF_LOG_L1("HTTP_CLIENT: Failed to SEND");
+			return false;
+		}
+		m_stale_connection = false;
+
+		m_state = reciev_machine_state_header;
+		return handle_reciev(timeout);
+	}
 	//---------------------------------------------------------------------------
 	inline bool handle_reciev(std::chrono::milliseconds timeout)
 	{
@@ -437,7 +465,8 @@ class http_simple_client_template : public i_target_handler
 		{
 			if(need_more_data)
 			{
-				if(!m_net_client.recv(recv_buffer, timeout))
+				const bool recv_ok = m_net_client.recv(recv_buffer, timeout);
+				if(!recv_ok)
 				{
 					GULPS_ERROR("Unexpected recv fail");
 					m_state = reciev_machine_state_error;
@@ -447,6 +476,8 @@ class http_simple_client_template : public i_target_handler
 					//connection is going to be closed
 					if(reciev_machine_state_body_connection_close != m_state)
 					{
+						//closed before a single byte of the response, the request was never handled
+						m_stale_connection = recv_ok && m_state == reciev_machine_state_header && m_header_cache.empty();
 						m_state = reciev_machine_state_error;
 					}
 				}
@@ -477,7 +508,9 @@ class http_simple_client_template : public i_target_handler
 		m_header_cache.clear();
 		if(m_state != reciev_machine_state_error)
 		{
-			if(m_response_info.m_header_info.m_connection.size() && !string_tools::compare_no_case("close", m_response_info.m_header_info.m_connection))
+			const std::string &connection = m_response_info.m_header_info.m_connection;
+			const bool is_http10 = m_response_info.m_http_ver_hi == 1 && m_response_info.m_http_ver_lo == 0;
+			if(!string_tools::compare_no_case("close", connection) || (is_http10 && string_tools::compare_no_case("keep-alive", connection)))
 				disconnect();
 
 			return true;
@@ -30,11 +30,11 @@
 #include "http_auth.h"
 #include "http_base.h"
 #include "net_utils_base.h"
-#include "to_nonconst_iterator.h"
+#include "syncobj.h"
 #include <boost/optional/optional.hpp>
 #include <string>
 
-
+#define HTTP_COMPRESS_THRESHOLD 1024
 
 namespace epee
 {
@@ -51,6 +51,7 @@ struct http_server_config
 	std::string m_folder;
 	std::vector<std::string> m_access_control_origins;
 	boost::optional<login> m_user;
+	size_t m_compress_threshold = HTTP_COMPRESS_THRESHOLD; //bodies smaller than this are sent uncompressed, 0 disables compression
 	critical_section m_lock;
 };
 
@@ -108,7 +109,7 @@ class simple_http_connection_handler
 		http_body_transfer_undefined
 	};
 
-	bool handle_buff_in(std::string &buf);
+	bool handle_buff_in(const char *buf, size_t cb);
 
 	bool analize_cached_request_header_and_invoke_state(size_t pos);
 
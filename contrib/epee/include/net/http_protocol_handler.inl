@@ -27,10 +27,16 @@
 #include "file_io_utils.h"
 #include "http_protocol_handler.h"
 #include "net_parse_helpers.h"
-#include "reg_exp_definer.h"
 #include "string_tools.h"
+#include "time_helper.h"
 #include <boost/lexical_cast.hpp>
-#include <boost/regex.hpp>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+#ifdef HTTP_ENABLE_GZIP
+#include <zlib.h>
+#endif
 
 #include "common/gulps.hpp"
 
@@ -57,54 +63,382 @@ struct multipart_entry
 	std::string m_body;
 };
 
-inline bool match_boundary(const std::string &content_type, std::string &boundary)
+//--------------------------------------------------------------------------------------------
+// Hand-written request parsing. These used to be boost::regex searches, and the functions
+// below reproduce the semantics of those expressions (noted above each one) without
+// building any temporary objects: everything is scanned in place with memchr.
+//--------------------------------------------------------------------------------------------
+inline bool is_http_token_char(char c)
+{
+	//[\w-]
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+inline bool is_http_space(char c)
+{
+	//\s
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+inline bool is_http_digit(char c)
 {
-	STATIC_REGEXP_EXPR_1(rexp_match_boundary, "boundary=(.*?)(($)|([;\\s,]))", boost::regex::icase | boost::regex::normal);
-	//											        1
-	boost::smatch result;
-	if(boost::regex_search(content_type, result, rexp_match_boundary, boost::match_default) && result[0].matched)
+	return c >= '0' && c <= '9';
+}
+
+inline bool equal_no_case(const char *s, const char *s_end, const char *lit, size_t lit_len)
+{
+	if(static_cast<size_t>(s_end - s) != lit_len)
+		return false;
+	for(size_t i = 0; i < lit_len; ++i)
 	{
-		boundary = result[1];
+		if(std::tolower(static_cast<unsigned char>(s[i])) != std::tolower(static_cast<unsigned char>(lit[i])))
+			return false;
+	}
+	return true;
+}
+
+template <size_t N>
+inline bool equal_no_case(const char *s, const char *s_end, const char (&lit)[N])
+{
+	return equal_no_case(s, s_end, lit, N - 1);
+}
+
+template <size_t N>
+inline bool starts_with_no_case(const char *s, const char *s_end, const char (&lit)[N])
+{
+	return static_cast<size_t>(s_end - s) >= N - 1 && equal_no_case(s, s + N - 1, lit, N - 1);
+}
+
+inline bool parse_http_number(const char *begin, const char *end, size_t &val)
+{
+	val = 0;
+	for(; begin != end; ++begin)
+	{
+		const size_t digit = *begin - '0';
+		if(val > (std::numeric_limits<size_t>::max() - digit) / 10)
+			return false;
+		val = val * 10 + digit;
+	}
+	return true;
+}
+
+struct http_request_line
+{
+	http::http_method method;
+	const char *method_begin;
+	const char *method_end;
+	const char *uri_begin;
+	const char *uri_end;
+	int ver_hi;
+	int ver_lo;
+	const char *line_begin;
+	const char *line_end; // past the terminating '\n'
+};
+
+// ^((OPTIONS|GET|HEAD|POST|PUT|DELETE|TRACE) (\S+) HTTP/(\d+).(\d+))\r?\n, icase, first matching line
+inline bool match_request_line_at(const char *p, const char *end, http_request_line &rl)
+{
+	rl.line_begin = rl.method_begin = p;
+	if(starts_with_no_case(p, end, "OPTIONS "))
+		rl.method = http::http_method_options;
+	else if(starts_with_no_case(p, end, "GET "))
+		rl.method = http::http_method_get;
+	else if(starts_with_no_case(p, end, "HEAD "))
+		rl.method = http::http_method_head;
+	else if(starts_with_no_case(p, end, "POST "))
+		rl.method = http::http_method_post;
+	else if(starts_with_no_case(p, end, "PUT "))
+		rl.method = http::http_method_put;
+	else if(starts_with_no_case(p, end, "DELETE ") || starts_with_no_case(p, end, "TRACE "))
+		rl.method = http::http_method_etc;
+	else
+		return false;
+
+	p = static_cast<const char *>(memchr(p, ' ', end - p));
+	rl.method_end = p++;
+
+	rl.uri_begin = p;
+	while(p != end && !is_http_space(*p))
+		++p;
+	rl.uri_end = p;
+	if(rl.uri_begin == rl.uri_end || p == end || *p != ' ')
+		return false;
+	++p;
+
+	if(!starts_with_no_case(p, end, "HTTP/"))
+		return false;
+	p += 5;
+
+	const char *hi_begin = p;
+	while(p != end && is_http_digit(*p))
+		++p;
+
+	// (\d+).(\d+) backtracks over the major digits, the separator may be any character
+	for(const char *hi_end = p; hi_end != hi_begin; --hi_end)
+	{
+		const char *lo_begin = hi_end + 1;
+		if(lo_begin >= end || !is_http_digit(*lo_begin))
+			continue;
+		const char *lo_end = lo_begin;
+		while(lo_end != end && is_http_digit(*lo_end))
+			++lo_end;
+
+		const char *eol = lo_end;
+		if(eol != end && *eol == '\r')
+			++eol;
+		if(eol == end || *eol != '\n')
+			continue;
+
+		size_t hi, lo;
+		if(!parse_http_number(hi_begin, hi_end, hi) || !parse_http_number(lo_begin, lo_end, lo) ||
+		   hi > static_cast<size_t>(std::numeric_limits<int>::max()) || lo > static_cast<size_t>(std::numeric_limits<int>::max()))
+			return false;
+		rl.ver_hi = static_cast<int>(hi);
+		rl.ver_lo = static_cast<int>(lo);
+		rl.line_end = eol + 1;
 		return true;
 	}
+	return false;
+}
 
+inline bool parse_request_line(const char *begin, const char *end, http_request_line &rl)
+{
+	const char *p = begin;
+	while(p != end)
+	{
+		if(match_request_line_at(p, end, rl))
+			return true;
+		p = static_cast<const char *>(memchr(p, '\n', end - p));
+		if(p == nullptr)
+			return false;
+		++p;
+	}
 	return false;
 }
 
-inline bool parse_header(std::string::const_iterator it_begin, std::string::const_iterator it_end, multipart_entry &entry)
+// Calls cb(name_begin, name_end, value_begin, value_end) for every field, same as
+// \n?([\w-]+?) ?: ?((.*?)(\r?\n))[^\t ] searched repeatedly over [begin, end).
+// A value runs up to the first line break not followed by a space or tab, so folded
+// continuation lines stay part of the value.
+template <class t_callback>
+inline void parse_header_fields(const char *begin, const char *end, t_callback cb)
 {
-	STATIC_REGEXP_EXPR_1(rexp_mach_field,
-						 "\n?((Content-Disposition)|(Content-Type)"
-						 //  12                     3
-						 "|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",
-						 //4               56    7
-						 boost::regex::icase | boost::regex::normal);
+	const char *p = begin;
+	while(p != end)
+	{
+		const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+		const char *line_end = eol ? eol : end;
 
-	boost::smatch result;
-	std::string::const_iterator it_current_bound = it_begin;
-	std::string::const_iterator it_end_bound = it_end;
+		const char *name_begin = nullptr;
+		const char *name_end = nullptr;
+		const char *colon = p;
+		while((colon = static_cast<const char *>(memchr(colon, ':', line_end - colon))) != nullptr)
+		{
+			name_end = colon;
+			if(name_end != p && name_end[-1] == ' ')
+				--name_end;
+			name_begin = name_end;
+			while(name_begin != p && is_http_token_char(name_begin[-1]))
+				--name_begin;
+			if(name_begin != name_end)
+				break;
+			++colon;
+		}
 
-	//lookup all fields and fill well-known fields
-	while(boost::regex_search(it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched)
+		if(colon == nullptr)
+		{
+			if(eol == nullptr)
+				return;
+			p = eol + 1;
+			continue;
+		}
+
+		const char *value_begin = colon + 1;
+		if(value_begin != end && *value_begin == ' ')
+			++value_begin;
+
+		const char *term = value_begin;
+		for(;;)
+		{
+			term = static_cast<const char *>(memchr(term, '\n', end - term));
+			if(term == nullptr || term + 1 == end)
+				return;
+			if(term[1] != ' ' && term[1] != '\t')
+				break;
+			++term;
+		}
+
+		const char *value_end = term;
+		if(value_end != value_begin && value_end[-1] == '\r')
+			--value_end;
+
+		cb(name_begin, name_end, value_begin, value_end);
+		p = term + 1;
+	}
+}
+
+// First \d+ in the field
+inline bool parse_content_length(const std::string &str, size_t &len)
+{
+	const char *p = str.data();
+	const char *end = p + str.size();
+	while(p != end && !is_http_digit(*p))
+		++p;
+	if(p == end)
+		return false;
+	const char *digits_end = p;
+	while(digits_end != end && is_http_digit(*digits_end))
+		++digits_end;
+	return parse_http_number(p, digits_end, len);
+}
+
+// boundary=(.*?)(($)|([;\s,])), icase
+inline bool match_boundary(const std::string &content_type, std::string &boundary)
+{
+	const char *begin = content_type.data();
+	const char *end = begin + content_type.size();
+	for(const char *p = begin; p != end; ++p)
 	{
-		const size_t field_val = 6;
-		const size_t field_etc_name = 4;
-
-		int i = 2;				//start position = 2
-		if(result[i++].matched) //"Content-Disposition"
-			entry.m_content_disposition = result[field_val];
-		else if(result[i++].matched) //"Content-Type"
-			entry.m_content_type = result[field_val];
-		else if(result[i++].matched) //e.t.c (HAVE TO BE MATCHED!)
-			entry.m_etc_header_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
+		if(!starts_with_no_case(p, end, "boundary="))
+			continue;
+		const char *b = p + 9;
+		const char *e = b;
+		while(e != end && *e != ';' && *e != ',' && !is_http_space(*e))
+			++e;
+		boundary.assign(b, e);
+		return true;
+	}
+	return false;
+}
+
+inline bool parse_header(std::string::const_iterator it_begin, std::string::const_iterator it_end, multipart_entry &entry)
+{
+	const char *begin = &*it_begin;
+	parse_header_fields(begin, begin + (it_end - it_begin), [&entry](const char *nb, const char *ne, const char *vb, const char *ve) {
+		if(equal_no_case(nb, ne, "Content-Disposition"))
+			entry.m_content_disposition.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Content-Type"))
+			entry.m_content_type.assign(vb, ve);
 		else
+			entry.m_etc_header_fields.emplace_back(std::string(nb, ne), std::string(vb, ve));
+	});
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+// Response compression
+//--------------------------------------------------------------------------------------------
+enum http_content_coding
+{
+	http_coding_identity,
+	http_coding_gzip,
+	http_coding_deflate
+};
+
+// True for a "q=0", "q=0.0" ... parameter, which refuses the coding it is attached to
+inline bool is_refused_coding(const char *params, const char *end)
+{
+	for(const char *p = params; p != end; ++p)
+	{
+		if(!starts_with_no_case(p, end, "q="))
+			continue;
+		p += 2;
+		if(p == end || *p != '0')
+			return false;
+		for(++p; p != end && (*p == '.' || *p == '0'); ++p)
+			;
+		return p == end || is_http_space(*p) || *p == ';';
+	}
+	return false;
+}
+
+// Picks the response coding from an Accept-Encoding value, gzip is preferred over deflate
+inline http_content_coding select_content_coding(const std::string &accept_encoding)
+{
+	bool gzip = false, deflate = false;
+	const char *p = accept_encoding.data();
+	const char *end = p + accept_encoding.size();
+	while(p != end)
+	{
+		const char *item_end = static_cast<const char *>(memchr(p, ',', end - p));
+		if(item_end == nullptr)
+			item_end = end;
+		const char *params = static_cast<const char *>(memchr(p, ';', item_end - p));
+		const char *name_end = params ? params : item_end;
+		while(p != name_end && is_http_space(*p))
+			++p;
+		while(name_end != p && is_http_space(name_end[-1]))
+			--name_end;
+
+		if(!params || !is_refused_coding(params, item_end))
 		{
-			GULPSF_LOG_ERROR("simple_http_connection_handler::parse_header() not matched last entry in:{}", std::string(it_current_bound, it_end));
+			if(equal_no_case(p, name_end, "gzip") || equal_no_case(p, name_end, "x-gzip") || equal_no_case(p, name_end, "*"))
+				gzip = true;
+			else if(equal_no_case(p, name_end, "deflate"))
+				deflate = true;
 		}
 
-		it_current_bound = result[(int)result.size() - 1].first;
+		p = item_end == end ? end : item_end + 1;
 	}
+	return gzip ? http_coding_gzip : deflate ? http_coding_deflate : http_coding_identity;
+}
+
+#ifdef HTTP_ENABLE_GZIP
+inline bool compress_http_body(const std::string &body, std::string &packed, http_content_coding coding)
+{
+	if(body.size() > std::numeric_limits<uInt>::max())
+		return false;
+
+	z_stream zstream;
+	memset(&zstream, 0, sizeof(zstream));
+	// 15 bits window, +16 selects the gzip wrapper instead of the zlib one ("deflate" in HTTP)
+	const int window_bits = coding == http_coding_gzip ? 15 + 16 : 15;
+	if(deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	packed.resize(deflateBound(&zstream, body.size()));
+	zstream.next_in = (Bytef *)body.data();
+	zstream.avail_in = (uInt)body.size();
+	zstream.next_out = (Bytef *)&packed[0];
+	zstream.avail_out = (uInt)packed.size();
+
+	const int ret = deflate(&zstream, Z_FINISH);
+	packed.resize(packed.size() - zstream.avail_out);
+	deflateEnd(&zstream);
+	return ret == Z_STREAM_END;
+}
+#endif
+
+// Compresses the response body in place when the client accepts it and the body is at
+// least threshold bytes, small bodies are not worth the cpu and the extra header bytes
+inline bool compress_response(const http_request_info &query_info, http_response_info &response, size_t threshold)
+{
+#ifdef HTTP_ENABLE_GZIP
+	if(threshold == 0 || response.m_body.size() < threshold || query_info.m_header_info.m_accept_encoding.empty())
+		return false;
+
+	for(const auto &field : response.m_additional_fields)
+	{
+		if(!string_tools::compare_no_case(field.first, "Content-Encoding"))
+			return false;
+	}
+
+	const http_content_coding coding = select_content_coding(query_info.m_header_info.m_accept_encoding);
+	if(coding == http_coding_identity)
+		return false;
+
+	std::string packed;
+	if(!compress_http_body(response.m_body, packed, coding) || packed.size() >= response.m_body.size())
+		return false;
+
+	GULPSF_LOG_L3("Compressed response body {} -> {} bytes", response.m_body.size(), packed.size());
+	response.m_body.swap(packed);
+	response.m_additional_fields.emplace_back("Content-Encoding", coding == http_coding_gzip ? "gzip" : "deflate");
+	response.m_additional_fields.emplace_back("Vary", "Accept-Encoding");
 	return true;
+#else
+	return false;
+#endif
 }
 
 inline bool handle_part_of_multipart(std::string::const_iterator it_begin, std::string::const_iterator it_end, multipart_entry &entry)
@@ -219,29 +553,22 @@ bool simple_http_connection_handler<t_connection_context>::set_ready_state()
 template <class t_connection_context>
 bool simple_http_connection_handler<t_connection_context>::handle_recv(const void *ptr, size_t cb)
 {
-	std::string buf((const char *)ptr, cb);
-	//GULPSF_PRINT("HTTP_RECV: {}\r\n{}", ptr , buf);
-	//file_io_utils::save_string_to_file(string_tools::get_current_module_folder() + "/" + boost::lexical_cast<std::string>(ptr), std::string((const char*)ptr, cb));
-
-	bool res = handle_buff_in(buf);
+	bool res = handle_buff_in((const char *)ptr, cb);
 	if(m_want_close /*m_state == http_state_connection_close || m_state == http_state_error*/)
 		return false;
 	return res;
 }
 //--------------------------------------------------------------------------------------------
 template <class t_connection_context>
-bool simple_http_connection_handler<t_connection_context>::handle_buff_in(std::string &buf)
+bool simple_http_connection_handler<t_connection_context>::handle_buff_in(const char *buf, size_t cb)
 {
 
 	size_t ndel;
 
-	if(m_cache.size())
-		m_cache += buf;
-	else
-		m_cache.swap(buf);
+	m_cache.append(buf, cb);
 
 	m_is_stop_handling = false;
-	while(!m_is_stop_handling)
+	while(!m_is_stop_handling && !m_want_close)
 	{
 		switch(m_state)
 		{
@@ -300,7 +627,10 @@ bool simple_http_connection_handler<t_connection_context>::handle_buff_in(std::s
 			break;
 		}
 		case http_state_retriving_body:
-			return handle_retriving_query_body();
+			//a pipelined request may follow the body in the same buffer, keep going
+			if(!handle_retriving_query_body())
+				return false;
+			break;
 		case http_state_connection_close:
 			return false;
 		default:
@@ -317,51 +647,27 @@ bool simple_http_connection_handler<t_connection_context>::handle_buff_in(std::s
 
 	return true;
 }
-//--------------------------------------------------------------------------------------------
-inline bool analize_http_method(const boost::smatch &result, http::http_method &method, int &http_ver_major, int &http_ver_minor)
-{
-	GULPS_CHECK_AND_ASSERT_MES(result[0].matched, false, "simple_http_connection_handler::analize_http_method() assert failed...");
-	http_ver_major = boost::lexical_cast<int>(result[11]);
-	http_ver_minor = boost::lexical_cast<int>(result[12]);
-
-	if(result[3].matched)
-		method = http::http_method_options;
-	else if(result[4].matched)
-		method = http::http_method_get;
-	else if(result[5].matched)
-		method = http::http_method_head;
-	else if(result[6].matched)
-		method = http::http_method_post;
-	else if(result[7].matched)
-		method = http::http_method_put;
-	else
-		method = http::http_method_etc;
-
-	return true;
-}
-
 //--------------------------------------------------------------------------------------------
 template <class t_connection_context>
 bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line()
 {
-	STATIC_REGEXP_EXPR_1(rexp_match_command_line, "^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+).(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
-	//											    123         4     5      6      7     8        9        10          11     12
-	//size_t match_len = 0;
-	boost::smatch result;
-	if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
+	http_request_line rl;
+	if(parse_request_line(m_cache.data(), m_cache.data() + m_cache.size(), rl))
 	{
-		analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi);
-		m_query_info.m_URI = result[10];
+		m_query_info.m_http_method = rl.method;
+		m_query_info.m_http_ver_hi = rl.ver_hi;
+		m_query_info.m_http_ver_lo = rl.ver_lo;
+		m_query_info.m_URI.assign(rl.uri_begin, rl.uri_end);
 		if(!parse_uri(m_query_info.m_URI, m_query_info.m_uri_content))
 		{
 			m_state = http_state_error;
 			GULPS_ERROR("Failed to parse URI: m_query_info.m_URI");
 			return false;
 		}
-		m_query_info.m_http_method_str = result[2];
-		m_query_info.m_full_request_str = result[0];
+		m_query_info.m_http_method_str.assign(rl.method_begin, rl.method_end);
+		m_query_info.m_full_request_str.assign(rl.line_begin, rl.line_end);
 
-		m_cache.erase(m_cache.begin(), to_nonsonst_iterator(m_cache, result[0].second));
+		m_cache.erase(0, rl.line_end - m_cache.data());
 
 		m_state = http_state_retriving_header;
 
@@ -382,6 +688,11 @@ std::string::size_type simple_http_connection_handler<t_connection_context>::mat
 {
 
 	//Here we returning head size, including terminating sequence (\r\n\r\n or \n\n)
+	//a request without any header fields is left with just the empty line after the request line
+	if(!buf.compare(0, 2, "\r\n"))
+		return 2;
+	if(!buf.compare(0, 1, "\n"))
+		return 1;
 	std::string::size_type res = buf.find("\r\n\r\n");
 	if(std::string::npos != res)
 		return res + 4;
@@ -489,69 +800,44 @@ bool simple_http_connection_handler<t_connection_context>::handle_query_measure(
 template <class t_connection_context>
 bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info &body_info, const std::string &m_cache_to_process, size_t pos)
 {
-	STATIC_REGEXP_EXPR_1(rexp_mach_field,
-						 "\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)|(Origin)"
-						 //  12            3         4                5              6                   7                  8      9        10           11
-						 "|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",
-						 //11             1213   14
-						 boost::regex::icase | boost::regex::normal);
-
-	boost::smatch result;
-	std::string::const_iterator it_current_bound = m_cache_to_process.begin();
-	std::string::const_iterator it_end_bound = m_cache_to_process.begin() + pos;
+	const char *begin = m_cache_to_process.data();
 
 	body_info.clear();
 
 	//lookup all fields and fill well-known fields
-	while(boost::regex_search(it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched)
-	{
-		const size_t field_val = 14;
-		const size_t field_etc_name = 12;
-
-		int i = 2;				//start position = 2
-		if(result[i++].matched) //"Connection"
-			body_info.m_connection = result[field_val];
-		else if(result[i++].matched) //"Referer"
-			body_info.m_referer = result[field_val];
-		else if(result[i++].matched) //"Content-Length"
-			body_info.m_content_length = result[field_val];
-		else if(result[i++].matched) //"Content-Type"
-			body_info.m_content_type = result[field_val];
-		else if(result[i++].matched) //"Transfer-Encoding"
-			body_info.m_transfer_encoding = result[field_val];
-		else if(result[i++].matched) //"Content-Encoding"
-			body_info.m_content_encoding = result[field_val];
-		else if(result[i++].matched) //"Host"
-			body_info.m_host = result[field_val];
-		else if(result[i++].matched) //"Cookie"
-			body_info.m_cookie = result[field_val];
-		else if(result[i++].matched) //"User-Agent"
-			body_info.m_user_agent = result[field_val];
-		else if(result[i++].matched) //"Origin"
-			body_info.m_origin = result[field_val];
-		else if(result[i++].matched) //e.t.c (HAVE TO BE MATCHED!)
-			body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
-		else
-		{
-			GULPSF_LOG_ERROR("simple_http_connection_handler<t_connection_context>::parse_cached_header() not matched last entry in:{}", m_cache_to_process);
-		}
-
-		it_current_bound = result[(int)result.size() - 1].first;
-	}
+	parse_header_fields(begin, begin + pos, [&body_info](const char *nb, const char *ne, const char *vb, const char *ve) {
+		if(equal_no_case(nb, ne, "Connection"))
+			body_info.m_connection.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Referer"))
+			body_info.m_referer.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Content-Length"))
+			body_info.m_content_length.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Content-Type"))
+			body_info.m_content_type.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Transfer-Encoding"))
+			body_info.m_transfer_encoding.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Content-Encoding"))
+			body_info.m_content_encoding.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Host"))
+			body_info.m_host.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Cookie"))
+			body_info.m_cookie.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "User-Agent"))
+			body_info.m_user_agent.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Origin"))
+			body_info.m_origin.assign(vb, ve);
+		else if(equal_no_case(nb, ne, "Accept-Encoding"))
+			body_info.m_accept_encoding.assign(vb, ve);
+		else //e.t.c
+			body_info.m_etc_fields.emplace_back(std::string(nb, ne), std::string(vb, ve));
+	});
 	return true;
 }
 //-----------------------------------------------------------------------------------
 template <class t_connection_context>
 bool simple_http_connection_handler<t_connection_context>::get_len_from_content_lenght(const std::string &str, size_t &OUT len)
 {
-	STATIC_REGEXP_EXPR_1(rexp_mach_field, "\\d+", boost::regex::normal);
-	std::string res;
-	boost::smatch result;
-	if(!(boost::regex_search(str, result, rexp_mach_field, boost::match_default) && result[0].matched))
-		return false;
-
-	len = boost::lexical_cast<size_t>(result[0]);
-	return true;
+	return parse_content_length(str, len);
 }
 //-----------------------------------------------------------------------------------
 template <class t_connection_context>
@@ -564,6 +850,7 @@ bool simple_http_connection_handler<t_connection_context>::handle_request_and_se
 	if(query_info.m_http_method != http::http_method_options)
 	{
 		res = handle_request(query_info, response);
+		compress_response(query_info, response, m_config.m_compress_threshold);
 	}
 	else
 	{
@@ -577,8 +864,9 @@ bool simple_http_connection_handler<t_connection_context>::handle_request_and_se
 	GULPSF_LOG_L3("HTTP_RESPONSE_HEAD: << \r\n{}", response_data);
 
 	m_psnd_hndlr->do_send((void *)response_data.data(), response_data.size());
+	// hand the body over instead of copying it, large JSON responses can be hundreds of MB
 	if((response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options))
-		m_psnd_hndlr->do_send((void *)response.m_body.data(), response.m_body.size());
+		m_psnd_hndlr->do_send_shared(make_shared_buffer(std::move(response.m_body)));
 	return res;
 }
 //-----------------------------------------------------------------------------------
@@ -634,16 +922,23 @@ std::string simple_http_connection_handler<t_connection_context>::get_response_h
 	buf += "Accept-Ranges: bytes\r\n";
 	//Wed, 01 Dec 2010 03:27:41 GMT"
 
+	//HTTP/1.1 connections are persistent unless the client says otherwise, HTTP/1.0 ones only on request
 	string_tools::trim(m_query_info.m_header_info.m_connection);
-	if(m_query_info.m_header_info.m_connection.size())
+	const bool is_http10 = m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0;
+	bool close_after_send = !string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection);
+	if(is_http10 && !close_after_send)
 	{
-		if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection))
-		{
-			//closing connection after sending
-			buf += "Connection: close\r\n";
-			m_state = http_state_connection_close;
-			m_want_close = true;
-		}
+		if(string_tools::compare_no_case("keep-alive", m_query_info.m_header_info.m_connection))
+			close_after_send = true;
+		else
+			buf += "Connection: keep-alive\r\n";
+	}
+	if(close_after_send)
+	{
+		//closing connection after sending
+		buf += "Connection: close\r\n";
+		m_state = http_state_connection_close;
+		m_want_close = true;
 	}
 
 	// Cross-origin resource sharing
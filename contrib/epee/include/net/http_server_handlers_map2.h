@@ -27,6 +27,8 @@
 #pragma once
 #include "http_base.h"
 #include "jsonrpc_structs.h"
+#include "rpc_admission.h"
+#include "rpc_metrics.h"
 #include "storages/portable_storage.h"
 #include "storages/portable_storage_template_helper.h"
 
@@ -34,6 +36,49 @@
 
 
 
+// Per call site lookup of the metrics entry, the static keeps the registry
+// lock off the request path after the first call
+#define RPC_METRICS_SCOPE(name)                                                                                                    \
+	static epee::net_utils::rpc_method_metrics &rpc_metrics_entry = epee::net_utils::rpc_metrics::instance().get(name);          \
+	epee::net_utils::rpc_call_scope rpc_metrics_scope(rpc_metrics_entry, query_info.m_body.size(), response_info.m_body);
+
+namespace epee
+{
+namespace net_utils
+{
+struct rpc_busy_response
+{
+	std::string status;
+
+	BEGIN_KV_SERIALIZE_MAP(rpc_busy_response)
+	KV_SERIALIZE(status)
+	END_KV_SERIALIZE_MAP()
+};
+
+inline void store_rpc_busy(const rpc_admission &admission, http::http_response_info &response_info, bool binary)
+{
+	rpc_busy_response busy;
+	busy.status = admission.busy_status();
+	if(binary)
+		epee::serialization::store_t_to_binary(busy, response_info.m_body);
+	else
+		epee::serialization::store_t_to_json(busy, response_info.m_body);
+}
+}
+}
+
+// Takes a slot of the method's cost class for the rest of the scope, or
+// answers 503 with the body written by store_busy when the class is full
+#define RPC_ADMISSION_CHECK(name, store_busy)                                                       \
+	epee::net_utils::rpc_admission::ticket rpc_admission_ticket = m_rpc_admission.admit(name);       \
+	if(!rpc_admission_ticket)                                                                        \
+	{                                                                                                \
+		response_info.m_response_code = 503;                                                         \
+		response_info.m_response_comment = "Service Unavailable";                                    \
+		store_busy;                                                                                  \
+		return true;                                                                                 \
+	}
+
 #define CHAIN_HTTP_TO_MAP2(context_type)                                                                                                         \
 	bool handle_http_request(const epee::net_utils::http::http_request_info &query_info,                                                         \
 							 epee::net_utils::http::http_response_info &response,                                                                \
@@ -68,6 +113,8 @@
 	else if((query_info.m_URI == s_pattern) && (cond))                                                                         \
 	{                                                                                                                          \
 		handled = true;                                                                                                        \
+		RPC_METRICS_SCOPE(s_pattern)                                                                                           \
+		RPC_ADMISSION_CHECK(s_pattern, epee::net_utils::store_rpc_busy(m_rpc_admission, response_info, false))                 \
 		uint64_t ticks = misc_utils::get_tick_count();                                                                         \
 		boost::value_initialized<command_type::request> req;                                                                   \
 		bool parse_res = epee::serialization::load_t_from_json(static_cast<command_type::request &>(req), query_info.m_body);  \
@@ -89,6 +136,7 @@
 		response_info.m_mime_tipe = "application/json";                                                                        \
 		response_info.m_header_info.m_content_type = " application/json";                                                      \
 		GULPSF_LOG_L1("{} processed with {}/{}/{}ms", s_pattern, ticks1 - ticks, ticks2 - ticks1, ticks3 - ticks2); \
+		rpc_metrics_scope.success();                                                                                           \
 	}
 
 #define MAP_URI_AUTO_JON2(s_pattern, callback_f, command_type) MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, true)
@@ -98,6 +146,8 @@
 	{                                                                                                                            \
 		GULPS_CAT_MAJOR("epee_http_serv");                                                                                            \
 		handled = true;                                                                                                          \
+		RPC_METRICS_SCOPE(s_pattern)                                                                                             \
+		RPC_ADMISSION_CHECK(s_pattern, epee::net_utils::store_rpc_busy(m_rpc_admission, response_info, true))                    \
 		uint64_t ticks = misc_utils::get_tick_count();                                                                           \
 		boost::value_initialized<command_type::request> req;                                                                     \
 		bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request &>(req), query_info.m_body);  \
@@ -117,8 +167,21 @@
 		response_info.m_mime_tipe = " application/octet-stream";                                                                 \
 		response_info.m_header_info.m_content_type = " application/octet-stream";                                                \
 		GULPSF_LOG_L1("{}() processed with {}/{}/{}ms", s_pattern, ticks1 - ticks, ticks2 - ticks1, ticks3 - ticks2); \
+		rpc_metrics_scope.success();                                                                                             \
 	}
 
+// Serves a Prometheus text exposition, callback_f(std::string &body) appends the metrics
+#define MAP_URI_METRICS2_IF(s_pattern, callback_f, cond)                      \
+	else if((query_info.m_URI == s_pattern) && (cond))                        \
+	{                                                                         \
+		handled = true;                                                       \
+		callback_f(response_info.m_body);                                     \
+		response_info.m_mime_tipe = "text/plain";                             \
+		response_info.m_header_info.m_content_type = " text/plain; version=0.0.4"; \
+	}
+
+#define MAP_URI_METRICS2(s_pattern, callback_f) MAP_URI_METRICS2_IF(s_pattern, callback_f, true)
+
 #define CHAIN_URI_MAP2(callback)                             \
 	else                                                     \
 	{                                                        \
@@ -159,6 +222,16 @@
 		if(false)                                                                                                           \
 			return true; //just a stub to have "else if"
 
+#define STORE_JSON_RPC_BUSY()                                                                                       \
+	{                                                                                                               \
+		epee::json_rpc::error_response rsp;                                                                         \
+		rsp.id = id_;                                                                                               \
+		rsp.jsonrpc = "2.0";                                                                                        \
+		rsp.error.code = -32000;                                                                                    \
+		rsp.error.message = m_rpc_admission.busy_status();                                                          \
+		epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response &>(rsp), response_info.m_body); \
+	}
+
 #define PREPARE_OBJECTS_FROM_JSON(command_type)                                                                                                                                                \
 	handled = true;                                                                                                                                                                            \
 	boost::value_initialized<epee::json_rpc::request<command_type::request>> req_;                                                                                                             \
@@ -190,6 +263,8 @@
 #define MAP_JON_RPC_WE_IF(method_name, callback_f, command_type, cond)                                                            \
 	else if((callback_name == method_name) && (cond))                                                                             \
 	{                                                                                                                             \
+		RPC_METRICS_SCOPE(method_name)                                                                                            \
+		RPC_ADMISSION_CHECK(method_name, STORE_JSON_RPC_BUSY())                                                                   \
 		PREPARE_OBJECTS_FROM_JSON(command_type)                                                                                   \
 		epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp);                                                      \
 		fail_resp.jsonrpc = "2.0";                                                                                                \
@@ -200,6 +275,7 @@
 			return true;                                                                                                          \
 		}                                                                                                                         \
 		FINALIZE_OBJECTS_TO_JSON(method_name)                                                                                     \
+		rpc_metrics_scope.success();                                                                                              \
 		return true;                                                                                                              \
 	}
 
@@ -208,6 +284,8 @@
 #define MAP_JON_RPC_WERI(method_name, callback_f, command_type)                                                                   \
 	else if(callback_name == method_name)                                                                                         \
 	{                                                                                                                             \
+		RPC_METRICS_SCOPE(method_name)                                                                                            \
+		RPC_ADMISSION_CHECK(method_name, STORE_JSON_RPC_BUSY())                                                                   \
 		PREPARE_OBJECTS_FROM_JSON(command_type)                                                                                   \
 		epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp);                                                      \
 		fail_resp.jsonrpc = "2.0";                                                                                                \
@@ -218,12 +296,15 @@
 			return true;                                                                                                          \
 		}                                                                                                                         \
 		FINALIZE_OBJECTS_TO_JSON(method_name)                                                                                     \
+		rpc_metrics_scope.success();                                                                                              \
 		return true;                                                                                                              \
 	}
 
 #define MAP_JON_RPC(method_name, callback_f, command_type)                                                                        \
 	else if(callback_name == method_name)                                                                                         \
 	{                                                                                                                             \
+		RPC_METRICS_SCOPE(method_name)                                                                                            \
+		RPC_ADMISSION_CHECK(method_name, STORE_JSON_RPC_BUSY())                                                                   \
 		PREPARE_OBJECTS_FROM_JSON(command_type)                                                                                   \
 		if(!callback_f(req.params, resp.result))                                                                                  \
 		{                                                                                                                         \
@@ -236,6 +317,7 @@
 			return true;                                                                                                          \
 		}                                                                                                                         \
 		FINALIZE_OBJECTS_TO_JSON(method_name)                                                                                     \
+		rpc_metrics_scope.success();                                                                                              \
 		return true;                                                                                                              \
 	}
 
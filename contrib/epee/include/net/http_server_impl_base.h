@@ -123,5 +123,6 @@ class http_server_impl_base : public net_utils::http::i_http_server_handler<t_co
 
   protected:
 	net_utils::boosted_tcp_server<net_utils::http::http_custom_handler<t_connection_context>> m_net_server;
+	net_utils::rpc_admission m_rpc_admission;
 };
 }
@@ -72,6 +72,25 @@ struct bucket_head2
 #define LEVIN_PROTOCOL_VER_0 0
 #define LEVIN_PROTOCOL_VER_1 1
 
+/// Serializes a notification (header and payload) once, so it can be queued on many connections
+inline net_utils::shared_buffer make_notify_buffer(int command, const std::string &in_buff)
+{
+	bucket_head2 head = {0};
+	head.m_signature = LEVIN_SIGNATURE;
+	head.m_have_to_return_data = false;
+	head.m_cb = in_buff.size();
+
+	head.m_command = command;
+	head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+	head.m_flags = LEVIN_PACKET_REQUEST;
+
+	std::string packet;
+	packet.reserve(sizeof(head) + in_buff.size());
+	packet.append((const char *)&head, sizeof(head));
+	packet.append(in_buff);
+	return net_utils::make_shared_buffer(std::move(packet));
+}
+
 template <class t_connection_context = net_utils::connection_context_base>
 struct levin_commands_handler
 {
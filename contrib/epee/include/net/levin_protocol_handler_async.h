@@ -91,6 +91,7 @@ class async_protocol_handler_config
 	int invoke_async(int command, const std::string &in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
 	int notify(int command, const std::string &in_buff, boost::uuids::uuid connection_id);
+	int notify(const net_utils::shared_buffer &packet, boost::uuids::uuid connection_id);
 	bool close(boost::uuids::uuid connection_id);
 	bool update_connection_context(const t_connection_context &contxt);
 	bool request_callback(boost::uuids::uuid connection_id);
@@ -400,8 +401,14 @@ class async_protocol_handler
 				}
 				{
 					std::string buff_to_invoke;
-					if(m_cache_in_buffer.size() == m_current_head.m_cb)
+					if(m_cache_in_buffer.size() - m_current_head.m_cb < m_current_head.m_cb)
+					{
+						// big packet with the start of the next one behind it: move the packet
+						// and copy out the tail, instead of copying the packet
 						buff_to_invoke.swap(m_cache_in_buffer);
+						m_cache_in_buffer.assign(buff_to_invoke, (std::string::size_type)m_current_head.m_cb, std::string::npos);
+						buff_to_invoke.resize((std::string::size_type)m_current_head.m_cb);
+					}
 					else
 					{
 						buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
@@ -466,10 +473,12 @@ class async_protocol_handler
 							m_current_head.m_have_to_return_data = false;
 							m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
 							m_current_head.m_flags = LEVIN_PACKET_RESPONSE;
-							std::string send_buff((const char *)&m_current_head, sizeof(m_current_head));
+							std::string send_buff;
+							send_buff.reserve(sizeof(m_current_head) + return_buff.size());
+							send_buff.append((const char *)&m_current_head, sizeof(m_current_head));
 							send_buff += return_buff;
 							CRITICAL_REGION_BEGIN(m_send_lock);
-							if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
+							if(!m_pservice_endpoint->do_send_shared(net_utils::make_shared_buffer(std::move(send_buff))))
 								return false;
 							CRITICAL_REGION_END();
 							GULPS_LOG_L1(m_connection_context , "LEVIN_PACKET_SENT. [len=" , m_current_head.m_cb
@@ -526,6 +535,13 @@ class async_protocol_handler
 		return true;
 	}
 
+	size_t get_recv_size_hint() const
+	{
+		if(m_state != stream_state_body || m_cache_in_buffer.size() >= m_current_head.m_cb)
+			return 0;
+		return m_current_head.m_cb - m_cache_in_buffer.size();
+	}
+
 	bool after_init_connection()
 	{
 		if(!m_connection_initialized)
@@ -682,6 +698,12 @@ class async_protocol_handler
 	}
 
 	int notify(int command, const std::string &in_buff)
+	{
+		return notify(make_notify_buffer(command, in_buff));
+	}
+
+	/// Sends a packet built by make_notify_buffer, the buffer is shared and not copied
+	int notify(const net_utils::shared_buffer &packet)
 	{
 		misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
 			boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -694,22 +716,11 @@ class async_protocol_handler
 		if(m_deletion_initiated)
 			return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-		bucket_head2 head = {0};
-		head.m_signature = LEVIN_SIGNATURE;
-		head.m_have_to_return_data = false;
-		head.m_cb = in_buff.size();
+		GULPS_CHECK_AND_ASSERT_MES(packet->size() >= sizeof(bucket_head2), -1, "Notify packet is shorter than its header");
+		const bucket_head2 &head = *(const bucket_head2 *)packet->data();
 
-		head.m_command = command;
-		head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-		head.m_flags = LEVIN_PACKET_REQUEST;
 		CRITICAL_REGION_BEGIN(m_send_lock);
-		if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-		{
-			GULPS_LOG_ERROR(m_connection_context, "Failed to do_send()");
-			return -1;
-		}
-
-		if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+		if(!m_pservice_endpoint->do_send_shared(packet))
 		{
 			GULPS_LOG_ERROR(m_connection_context, "Failed to do_send()");
 			return -1;
@@ -878,6 +889,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template <class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(const net_utils::shared_buffer &packet, boost::uuids::uuid connection_id)
+{
+	async_protocol_handler<t_connection_context> *aph;
+	int r = find_and_lock_connection(connection_id, aph);
+	return LEVIN_OK == r ? aph->notify(packet) : r;
+}
+//------------------------------------------------------------------------------------------
+template <class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
 	CRITICAL_REGION_LOCAL(m_connects_lock);
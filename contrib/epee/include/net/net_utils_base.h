@@ -30,6 +30,8 @@
 #include "serialization/keyvalue_serialization.h"
 #include <boost/asio/io_service.hpp>
 #include <boost/uuid/uuid.hpp>
+#include <memory>
+#include <string>
 #include <type_traits>
 #include <typeinfo>
 
@@ -319,9 +321,20 @@ struct connection_context_base
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
+/// Immutable, reference counted send buffer. One serialized packet can be queued
+/// on any number of connections and is freed after the last write completes.
+typedef std::shared_ptr<const std::string> shared_buffer;
+
+inline shared_buffer make_shared_buffer(std::string &&data)
+{
+	return std::make_shared<const std::string>(std::move(data));
+}
+
 struct i_service_endpoint
 {
 	virtual bool do_send(const void *ptr, size_t cb) = 0;
+	/// Queues a shared buffer without copying it, endpoints that can't hold a reference fall back to a copy
+	virtual bool do_send_shared(const shared_buffer &buf) { return do_send(buf->data(), buf->size()); }
 	virtual bool close() = 0;
 	virtual bool call_run_once_service_io() = 0;
 	virtual bool request_callback() = 0;
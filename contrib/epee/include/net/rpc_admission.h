@@ -0,0 +1,152 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+namespace epee
+{
+namespace net_utils
+{
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+// Admission control for the synchronous RPC handlers. Each method belongs
+// to a cost class, and every class except light can be capped to a number
+// of concurrent calls, so expensive methods cannot occupy all the worker
+// threads and starve cheap ones. A call that finds its class full waits
+// for a slot, but is turned away straight away if the estimated wait is
+// over the queue budget, and when the budget runs out while waiting.
+//
+// A waiting call blocks its worker thread as much as a running one, so
+// once the worker threads are known, running and waiting calls of the
+// capped classes together never take more than all but one of them. Past
+// that a call is turned away at once, and the last worker stays free for
+// light calls.
+//
+// With no limits set every call is admitted without taking a lock.
+class rpc_admission
+{
+  public:
+	enum cost_class
+	{
+		cost_light = 0,
+		cost_medium,
+		cost_heavy,
+		cost_class_count
+	};
+
+	struct class_stats
+	{
+		uint64_t limit;
+		uint64_t active;
+		uint64_t waiting;
+		uint64_t admitted;
+		uint64_t shed;
+		uint64_t avg_service_us;
+	};
+
+	// Holds a slot of a cost class until destroyed. A default constructed
+	// or moved-from ticket holds nothing; one that failed admission is false.
+	class ticket
+	{
+	  public:
+		ticket() : m_owner(nullptr), m_class(cost_light), m_admitted(true) {}
+		ticket(ticket &&o) : m_owner(o.m_owner), m_class(o.m_class), m_admitted(o.m_admitted), m_start(o.m_start) { o.m_owner = nullptr; }
+		ticket(const ticket &) = delete;
+		ticket &operator=(const ticket &) = delete;
+		~ticket();
+
+		explicit operator bool() const { return m_admitted; }
+
+	  private:
+		friend class rpc_admission;
+		ticket(rpc_admission *owner, cost_class cls, bool admitted) :
+			m_owner(owner), m_class(cls), m_admitted(admitted), m_start(std::chrono::steady_clock::now()) {}
+
+		rpc_admission *m_owner;
+		cost_class m_class;
+		bool m_admitted;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	rpc_admission() : m_enabled(false), m_queue_budget_us(1000000), m_max_occupied(0), m_occupied(0), m_busy_status("BUSY") {}
+	rpc_admission(const rpc_admission &) = delete;
+	rpc_admission &operator=(const rpc_admission &) = delete;
+
+	// Configuration, to be done before the server starts taking calls
+	void set_limit(cost_class cls, uint64_t max_concurrent);
+	void set_worker_threads(uint64_t threads) { m_max_occupied = threads > 1 ? threads - 1 : threads; }
+	void set_cost(const std::string &method, cost_class cls);
+	void set_queue_budget(std::chrono::milliseconds budget) { m_queue_budget_us = budget.count() * 1000; }
+	void set_busy_status(const std::string &status) { m_busy_status = status; }
+	const std::string &busy_status() const { return m_busy_status; }
+
+	cost_class cost_of(const char *method) const;
+	ticket admit(const char *method);
+	class_stats get_stats(cost_class cls) const;
+
+	// Appends the per class gauges and counters in the Prometheus text format
+	void write_prometheus(std::string &out, const std::string &prefix) const;
+
+	static const char *class_name(cost_class cls);
+	static bool parse_class(const std::string &name, cost_class &cls);
+
+  private:
+	struct class_state
+	{
+		mutable boost::mutex lock;
+		boost::condition_variable slot_freed;
+		uint64_t limit = 0; // 0 is unlimited
+		uint64_t active = 0;
+		uint64_t waiting = 0;
+		std::atomic<uint64_t> admitted{0};
+		std::atomic<uint64_t> shed{0};
+		std::atomic<uint64_t> avg_service_us{0};
+	};
+
+	void release(cost_class cls, uint64_t service_us);
+	bool occupy_worker();
+	void free_worker();
+
+	bool m_enabled;
+	uint64_t m_queue_budget_us;
+	uint64_t m_max_occupied; // 0 is unlimited
+	std::atomic<uint64_t> m_occupied; // workers held by running or waiting calls of capped classes
+	std::string m_busy_status;
+	std::map<std::string, cost_class> m_costs;
+	class_state m_classes[cost_class_count];
+};
+}
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.h"
+
+namespace epee
+{
+namespace net_utils
+{
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+struct rpc_method_metrics
+{
+	latency_histogram latency; // microseconds, parse to serialize
+	std::atomic<uint64_t> calls{0};
+	std::atomic<uint64_t> errors{0};
+	std::atomic<uint64_t> in_flight{0};
+	std::atomic<uint64_t> request_bytes{0};
+	std::atomic<uint64_t> response_bytes{0};
+};
+
+// Process wide registry of per-method RPC statistics. The URI map macros
+// look their entry up once per call site and keep the reference, so the
+// registry lock is only taken the first time a method is hit and when
+// the stats are read out.
+class rpc_metrics
+{
+  public:
+	static rpc_metrics &instance();
+
+	rpc_method_metrics &get(const std::string &method);
+
+	// Entries are never removed, so the pointers stay valid
+	std::vector<std::pair<std::string, const rpc_method_metrics *>> methods() const;
+
+	uint64_t total_in_flight() const;
+
+	// Appends all methods in the Prometheus text exposition format, with
+	// metric names starting with prefix
+	void write_prometheus(std::string &out, const std::string &prefix) const;
+
+	// Appends one histogram family (HELP, TYPE, buckets, sum, count) in
+	// seconds. Samples are in microseconds; the fixed "le" bounds are
+	// resolved against the log-linear buckets, so a sample within 1/8 of
+	// a bound may be reported one bound higher.
+	static void write_prometheus_histogram(std::string &out, const std::string &name, const std::string &help,
+										   const std::vector<std::pair<std::string, latency_histogram::snapshot>> &series);
+
+  private:
+	rpc_metrics() {}
+
+	mutable boost::mutex m_lock;
+	std::map<std::string, std::unique_ptr<rpc_method_metrics>> m_methods;
+};
+
+// Accounts one call for the lifetime of the object. The call counts as an
+// error unless success() is reached, so early returns from the handler
+// macros are caught without having to touch every failure path.
+class rpc_call_scope
+{
+  public:
+	rpc_call_scope(rpc_method_metrics &metrics, size_t request_size, const std::string &response_body) :
+		m_metrics(metrics), m_response_body(response_body), m_start(std::chrono::steady_clock::now()), m_ok(false)
+	{
+		m_metrics.calls.fetch_add(1, std::memory_order_relaxed);
+		m_metrics.in_flight.fetch_add(1, std::memory_order_relaxed);
+		m_metrics.request_bytes.fetch_add(request_size, std::memory_order_relaxed);
+	}
+
+	~rpc_call_scope()
+	{
+		m_metrics.latency.record(latency_histogram::micros_since(m_start));
+		m_metrics.response_bytes.fetch_add(m_response_body.size(), std::memory_order_relaxed);
+		if(!m_ok)
+			m_metrics.errors.fetch_add(1, std::memory_order_relaxed);
+		m_metrics.in_flight.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	rpc_call_scope(const rpc_call_scope &) = delete;
+	rpc_call_scope &operator=(const rpc_call_scope &) = delete;
+
+	void success() { m_ok = true; }
+
+  private:
+	rpc_method_metrics &m_metrics;
+	const std::string &m_response_body;
+	std::chrono::steady_clock::time_point m_start;
+	bool m_ok;
+};
+}
+}
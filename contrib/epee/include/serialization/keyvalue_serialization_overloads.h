@@ -202,7 +202,7 @@ static bool unserialize_stl_container_t_obj(stl_container &container, t_storage
 	if(!hsec_array || !hchild_section)
 		return false;
 	res = val._load(stg, hchild_section);
-	container.insert(container.end(), val);
+	container.insert(container.end(), std::move(val));
 	while(stg.get_next_section(hsec_array, hchild_section))
 	{
 		typename stl_container::value_type val_l = typename stl_container::value_type();
@@ -0,0 +1,237 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#pragma once
+
+#include <cstdio>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "common/gulps.hpp"
+#include "parserse_base_utils.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_json.h"
+
+namespace epee
+{
+namespace serialization
+{
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+// Storage for the kv serialization store path which writes JSON directly
+// into a string as fields are visited, instead of building a
+// portable_storage tree first and dumping it. The output has the same
+// layout as portable_storage::dump_as_json, except that fields come in
+// declaration order rather than sorted by name.
+//
+// The kv serialization only ever opens scopes, so a scope is closed when
+// a value is written to one of its parents, or in finish().
+class kv_json_writer
+{
+	GULPS_CAT_MAJOR("epee_kv_json");
+
+	struct scope
+	{
+		bool is_array;
+		size_t indent;
+		size_t count;
+	};
+
+  public:
+	typedef scope *hsection;
+	typedef scope *harray;
+	typedef storage_entry meta_entry;
+
+	kv_json_writer(std::string &out, size_t indent = 0, bool insert_newlines = true) : m_out(out), m_newline(insert_newlines ? "\r\n" : "")
+	{
+		m_scopes.push_back({false, indent, 0});
+		m_out += "{";
+		m_out += m_newline;
+	}
+
+	template <class t_value>
+	bool set_value(const char *value_name, const t_value &v, hsection hparent_section)
+	{
+		begin_entry(value_name, hparent_section);
+		write_value(v);
+		return true;
+	}
+
+	hsection open_section(const char *section_name, hsection hparent_section, bool create_if_notexist = false)
+	{
+		scope &parent = begin_entry(section_name, hparent_section);
+		return push_section(parent.indent + 1);
+	}
+
+	template <class t_value>
+	harray insert_first_value(const char *value_name, const t_value &target, hsection hparent_section)
+	{
+		scope &parent = begin_entry(value_name, hparent_section);
+		harray harr = push_array(parent.indent + 1);
+		insert_next_value(harr, target);
+		return harr;
+	}
+
+	template <class t_value>
+	bool insert_next_value(harray hval_array, const t_value &target)
+	{
+		begin_element(hval_array);
+		write_value(target);
+		return true;
+	}
+
+	harray insert_first_section(const char *section_name, hsection &hinserted_childsection, hsection hparent_section)
+	{
+		scope &parent = begin_entry(section_name, hparent_section);
+		harray harr = push_array(parent.indent + 1);
+		insert_next_section(harr, hinserted_childsection);
+		return harr;
+	}
+
+	bool insert_next_section(harray hsec_array, hsection &hinserted_childsection)
+	{
+		begin_element(hsec_array);
+		hinserted_childsection = push_section(hsec_array->indent);
+		return true;
+	}
+
+	// closes every open scope, including the root section
+	void finish()
+	{
+		while(!m_scopes.empty())
+			pop_scope();
+	}
+
+  private:
+	scope &begin_entry(const char *name, hsection hparent_section)
+	{
+		scope &s = close_to(hparent_section ? hparent_section : &m_scopes.front());
+		if(s.count++)
+		{
+			m_out += ",";
+			m_out += m_newline;
+		}
+		m_out.append((s.indent + 1) * 2, ' ');
+		m_out += "\"";
+		misc_utils::parse::transform_to_escape_sequence(name, m_out);
+		m_out += "\": ";
+		return s;
+	}
+
+	void begin_element(harray harr)
+	{
+		scope &s = close_to(harr);
+		if(s.count++)
+			m_out += ",";
+	}
+
+	scope &close_to(scope *target)
+	{
+		while(!m_scopes.empty() && &m_scopes.back() != target)
+			pop_scope();
+		GULPS_CHECK_AND_ASSERT_THROW_MES(!m_scopes.empty(), "kv_json_writer: write to a closed scope");
+		return m_scopes.back();
+	}
+
+	hsection push_section(size_t indent)
+	{
+		m_out += "{";
+		m_out += m_newline;
+		m_scopes.push_back({false, indent, 0});
+		return &m_scopes.back();
+	}
+
+	harray push_array(size_t indent)
+	{
+		m_out += "[";
+		m_scopes.push_back({true, indent, 0});
+		return &m_scopes.back();
+	}
+
+	void pop_scope()
+	{
+		const scope &s = m_scopes.back();
+		if(s.is_array)
+		{
+			m_out += "]";
+		}
+		else
+		{
+			if(s.count)
+				m_out += m_newline;
+			m_out.append(s.indent * 2, ' ');
+			m_out += "}";
+		}
+		m_scopes.pop_back();
+	}
+
+	void write_value(const std::string &v)
+	{
+		m_out += "\"";
+		misc_utils::parse::transform_to_escape_sequence(v, m_out);
+		m_out += "\"";
+	}
+
+	void write_value(bool v)
+	{
+		m_out += v ? "true" : "false";
+	}
+
+	void write_value(int8_t v) { m_out += std::to_string(static_cast<int32_t>(v)); }
+	void write_value(uint8_t v) { m_out += std::to_string(static_cast<int32_t>(v)); }
+	void write_value(int16_t v) { m_out += std::to_string(v); }
+	void write_value(uint16_t v) { m_out += std::to_string(v); }
+	void write_value(int32_t v) { m_out += std::to_string(v); }
+	void write_value(uint32_t v) { m_out += std::to_string(v); }
+	void write_value(int64_t v) { m_out += std::to_string(v); }
+	void write_value(uint64_t v) { m_out += std::to_string(v); }
+
+	void write_value(double v)
+	{
+		// same as the default std::ostream formatting used by dump_as_json
+		char buf[32];
+		int len = snprintf(buf, sizeof(buf), "%g", v);
+		m_out.append(buf, len);
+	}
+
+	void write_value(const storage_entry &v)
+	{
+		const scope &s = m_scopes.back();
+		std::stringstream ss;
+		dump_as_json(ss, v, s.is_array ? s.indent : s.indent + 1, !m_newline.empty());
+		m_out += ss.str();
+	}
+
+	std::string &m_out;
+	std::string m_newline;
+	std::deque<scope> m_scopes;
+};
+}
+}
@@ -62,6 +62,7 @@ bool invoke_remote_command2(int command, const t_arg &out_struct, t_result &resu
 		return false;
 	}
 	serialization::portable_storage stg_ret;
+	stg_ret.set_move_values(true);
 	if(!stg_ret.load_from_binary(buff_to_recv))
 	{
 		GULPSF_LOG_ERROR("Failed to load_from_binary on command {}", command);
@@ -107,6 +108,7 @@ bool invoke_remote_command2(boost::uuids::uuid conn_id, int command, const t_arg
 		return false;
 	}
 	typename serialization::portable_storage stg_ret;
+	stg_ret.set_move_values(true);
 	if(!stg_ret.load_from_binary(buff_to_recv))
 	{
 		GULPSF_LOG_ERROR("Failed to load_from_binary on command {}", command);
@@ -132,6 +134,7 @@ bool async_invoke_remote_command2(boost::uuids::uuid conn_id, int command, const
 			return false;
 		}
 		serialization::portable_storage stg_ret;
+		stg_ret.set_move_values(true);
 		if(!stg_ret.load_from_binary(buff))
 		{
 			GULPSF_LOG_ERROR("Failed to load_from_binary on command {}", command);
@@ -181,6 +184,7 @@ int buff_to_t_adapter(int command, const std::string &in_buff, std::string &buff
 {
 	GULPS_CAT_MAJOR("epee_lev_abs_inv2");
 	serialization::portable_storage strg;
+	strg.set_move_values(true);
 	if(!strg.load_from_binary(in_buff))
 	{
 		GULPSF_LOG_ERROR("Failed to load_from_binary in command {}", command);
@@ -212,6 +216,7 @@ int buff_to_t_adapter(t_owner *powner, int command, const std::string &in_buff,
 {
 	GULPS_CAT_MAJOR("epee_lev_abs_inv2");
 	serialization::portable_storage strg;
+	strg.set_move_values(true);
 	if(!strg.load_from_binary(in_buff))
 	{
 		GULPSF_LOG_ERROR("Failed to load_from_binary in notify {}", command);
@@ -35,10 +35,8 @@ namespace misc_utils
 {
 namespace parse
 {
-inline std::string transform_to_escape_sequence(const std::string &src)
+inline void transform_to_escape_sequence(const std::string &src, std::string &res)
 {
-	//std::stringstream res;
-	std::string res;
 	for(std::string::const_iterator it = src.begin(); it != src.end(); ++it)
 	{
 		switch(*it)
@@ -76,6 +74,11 @@ inline std::string transform_to_escape_sequence(const std::string &src)
 			res.push_back(*it);
 		}
 	}
+}
+inline std::string transform_to_escape_sequence(const std::string &src)
+{
+	std::string res;
+	transform_to_escape_sequence(src, res);
 	return res;
 }
 /*
@@ -51,7 +51,7 @@ class portable_storage
 	typedef epee::serialization::harray harray;
 	typedef storage_entry meta_entry;
 
-	portable_storage() {}
+	portable_storage() : m_move_values(false) {}
 	virtual ~portable_storage() {}
 	hsection open_section(const std::string &section_name, hsection hparent_section, bool create_if_notexist = false);
 	template <class t_value>
@@ -87,8 +87,13 @@ class portable_storage
 	bool dump_as_json(std::string &targetObj, size_t indent = 0, bool insert_newlines = true);
 	bool load_from_json(const std::string &source);
 
+	//let get_value() and friends move strings out instead of copying them, for storages that are
+	//loaded into a single struct and then dropped - every value can only be read once after that
+	void set_move_values(bool move_values) { m_move_values = move_values; }
+
   private:
 	section m_root;
+	bool m_move_values;
 	hsection get_root_section() { return &m_root; }
 	storage_entry *find_storage_entry(const std::string &pentry_name, hsection psection);
 	template <class entry_type>
@@ -197,9 +202,16 @@ template <class to_type>
 struct get_value_visitor : boost::static_visitor<void>
 {
 	to_type &m_target;
-	get_value_visitor(to_type &target) : m_target(target) {}
+	bool m_move;
+	get_value_visitor(to_type &target, bool move) : m_target(target), m_move(move) {}
 	template <class from_type>
-	void operator()(const from_type &v) { convert_t(v, m_target); }
+	void operator()(from_type &v)
+	{
+		if(m_move)
+			move_t(v, m_target);
+		else
+			convert_t(v, m_target);
+	}
 };
 
 template <class t_value>
@@ -213,7 +225,7 @@ bool portable_storage::get_value(const std::string &value_name, t_value &val, hs
 	if(!pentry)
 		return false;
 
-	get_value_visitor<t_value> gvv(val);
+	get_value_visitor<t_value> gvv(val, m_move_values);
 	boost::apply_visitor(gvv, *pentry);
 	return true;
 	//	GULPS_CATCH_ENTRY("portable_storage::template<>get_value", false);
@@ -289,14 +301,18 @@ template <class to_type>
 struct get_first_value_visitor : boost::static_visitor<bool>
 {
 	to_type &m_target;
-	get_first_value_visitor(to_type &target) : m_target(target) {}
+	bool m_move;
+	get_first_value_visitor(to_type &target, bool move) : m_target(target), m_move(move) {}
 	template <class from_type>
-	bool operator()(const array_entry_t<from_type> &a)
+	bool operator()(array_entry_t<from_type> &a)
 	{
-		const from_type *pv = a.get_first_val();
+		from_type *pv = a.get_first_val();
 		if(!pv)
 			return false;
-		convert_t(*pv, m_target);
+		if(m_move)
+			move_t(*pv, m_target);
+		else
+			convert_t(*pv, m_target);
 		return true;
 	}
 };
@@ -315,7 +331,7 @@ harray portable_storage::get_first_value(const std::string &value_name, t_value
 		return nullptr;
 	array_entry &ar_entry = boost::get<array_entry>(*pentry);
 
-	get_first_value_visitor<t_value> gfv(target);
+	get_first_value_visitor<t_value> gfv(target, m_move_values);
 	if(!boost::apply_visitor(gfv, ar_entry))
 		return nullptr;
 	return &ar_entry;
@@ -326,15 +342,19 @@ template <class to_type>
 struct get_next_value_visitor : boost::static_visitor<bool>
 {
 	to_type &m_target;
-	get_next_value_visitor(to_type &target) : m_target(target) {}
+	bool m_move;
+	get_next_value_visitor(to_type &target, bool move) : m_target(target), m_move(move) {}
 	template <class from_type>
-	bool operator()(const array_entry_t<from_type> &a)
+	bool operator()(array_entry_t<from_type> &a)
 	{
 		//TODO: optimize code here: work without get_next_val function
-		const from_type *pv = a.get_next_val();
+		from_type *pv = a.get_next_val();
 		if(!pv)
 			return false;
-		convert_t(*pv, m_target);
+		if(m_move)
+			move_t(*pv, m_target);
+		else
+			convert_t(*pv, m_target);
 		return true;
 	}
 };
@@ -346,7 +366,7 @@ bool portable_storage::get_next_value(harray hval_array, t_value &target)
 	//GULPS_TRY_ENTRY();
 	GULPS_CHECK_AND_ASSERT(hval_array, false);
 	array_entry &ar_entry = *hval_array;
-	get_next_value_visitor<t_value> gnv(target);
+	get_next_value_visitor<t_value> gnv(target, m_move_values);
 	if(!boost::apply_visitor(gnv, ar_entry))
 		return false;
 	return true;
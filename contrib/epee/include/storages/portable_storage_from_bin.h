@@ -135,7 +135,7 @@ storage_entry throwable_buffer_reader::read_ae()
 	//TODO: add some optimization here later
 	while(size--)
 		sa.m_array.push_back(read<type_name>());
-	return storage_entry(array_entry(sa));
+	return storage_entry(array_entry(std::move(sa)));
 }
 
 inline storage_entry throwable_buffer_reader::load_storage_array_entry(uint8_t type)
@@ -289,7 +289,7 @@ inline void throwable_buffer_reader::read(section &sec)
 		//read section name string
 		std::string sec_name;
 		read_sec_name(sec_name);
-		sec.m_entries.insert(std::make_pair(sec_name, load_storage_entry()));
+		sec.m_entries.insert(std::make_pair(std::move(sec_name), load_storage_entry()));
 	}
 }
 inline void throwable_buffer_reader::read(std::string &str)
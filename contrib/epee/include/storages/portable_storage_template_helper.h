@@ -29,6 +29,7 @@
 #include <string>
 
 #include "file_io_utils.h"
+#include "kv_json_writer.h"
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
 
@@ -61,9 +62,10 @@ bool load_t_from_json_file(t_struct &out, const std::string &json_file)
 template <class t_struct>
 bool store_t_to_json(t_struct &str_in, std::string &json_buff, size_t indent = 0, bool insert_newlines = true)
 {
-	portable_storage ps;
-	str_in.store(ps);
-	ps.dump_as_json(json_buff, indent, insert_newlines);
+	json_buff.clear();
+	kv_json_writer writer(json_buff, indent, insert_newlines);
+	str_in.store(writer);
+	writer.finish();
 	return true;
 }
 //-----------------------------------------------------------------------------------------------------------
@@ -87,6 +89,7 @@ template <class t_struct>
 bool load_t_from_binary(t_struct &out, const std::string &binary_buff)
 {
 	portable_storage ps;
+	ps.set_move_values(true);
 	bool rs = ps.load_from_binary(binary_buff);
 	if(!rs)
 		return false;
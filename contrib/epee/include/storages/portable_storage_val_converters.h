@@ -205,5 +205,17 @@ void convert_t(const from_type &from, to_type &to)
 {
 	convert_to_same<from_type, to_type, std::is_same<to_type, from_type>::value>::convert(from, to);
 }
+
+//same as convert_t, but strings are moved out of the source instead of being copied
+template <class from_type, class to_type>
+void move_t(from_type &from, to_type &to)
+{
+	convert_t(from, to);
+}
+
+inline void move_t(std::string &from, std::string &to)
+{
+	to = std::move(from);
+}
 }
 }
@@ -34,6 +34,8 @@
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/thread.hpp>
 
+#include "latency_histogram.h"
+
 namespace epee
 {
 
@@ -116,6 +118,32 @@ class critical_section
 	}
 };
 
+// critical_section that records how long lock() had to wait, in microseconds.
+// An uncontended acquisition is recorded as a zero wait without reading the clock.
+class timed_critical_section : public critical_section
+{
+	latency_histogram m_wait;
+
+  public:
+	timed_critical_section() {}
+	timed_critical_section(const timed_critical_section &section) : critical_section() {}
+	timed_critical_section &operator=(const timed_critical_section &section) { return *this; }
+
+	void lock()
+	{
+		if(critical_section::tryLock())
+		{
+			m_wait.record(0);
+			return;
+		}
+		auto start = std::chrono::steady_clock::now();
+		critical_section::lock();
+		m_wait.record(latency_histogram::micros_since(start));
+	}
+
+	const latency_histogram &wait_histogram() const { return m_wait; }
+};
+
 template <class t_lock>
 class critical_region_t
 {
@@ -26,7 +26,7 @@
 
 #pragma once
 extern "C" {
-#include "zlib/zlib.h"
+#include <zlib.h>
 }
 #pragma comment(lib, "zlibstat.lib")
 
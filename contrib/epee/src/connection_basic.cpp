@@ -143,6 +143,8 @@ connection_basic_pimpl::connection_basic_pimpl(const std::string &name) : m_thro
 // static variables:
 int connection_basic_pimpl::m_default_tos;
 
+#define RECV_BUFFER_MAX_SIZE (1024 * 1024) // largest single socket read
+
 // methods:
 connection_basic::connection_basic(boost::asio::io_service &io_service, std::atomic<long> &ref_sock_count, std::atomic<long> &sock_number)
 	: mI(new connection_basic_pimpl("peer")),
@@ -183,6 +185,18 @@ connection_basic::~connection_basic() noexcept(false)
 	GULPSF_LOG_L1("Destructing connection p2p#{} to {}", mI->m_peer_number, remote_addr_str);
 }
 
+void connection_basic::grow_recv_buffer(size_t size)
+{
+	size = std::min<size_t>(size, RECV_BUFFER_MAX_SIZE);
+	if(m_recv_buffer.size() < size)
+		m_recv_buffer.resize(size);
+}
+
+void connection_basic::release_recv_buffer()
+{
+	std::vector<char>().swap(m_recv_buffer);
+}
+
 void connection_basic::set_rate_up_limit(uint64_t limit)
 {
 	{
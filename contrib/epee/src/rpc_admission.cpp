@@ -0,0 +1,225 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "net/rpc_admission.h"
+
+#include <boost/chrono/duration.hpp>
+#include <boost/thread/locks.hpp>
+#include <fmt/format.h>
+
+#include "latency_histogram.h"
+
+namespace epee
+{
+namespace net_utils
+{
+rpc_admission::ticket::~ticket()
+{
+	if(m_owner && m_admitted)
+		m_owner->release(m_class, latency_histogram::micros_since(m_start));
+}
+
+void rpc_admission::set_limit(cost_class cls, uint64_t max_concurrent)
+{
+	m_classes[cls].limit = max_concurrent;
+	m_enabled = false;
+	for(const class_state &st : m_classes)
+		m_enabled |= st.limit != 0;
+}
+
+void rpc_admission::set_cost(const std::string &method, cost_class cls)
+{
+	m_costs[method] = cls;
+}
+
+rpc_admission::cost_class rpc_admission::cost_of(const char *method) const
+{
+	auto it = m_costs.find(method);
+	return it == m_costs.end() ? cost_light : it->second;
+}
+
+rpc_admission::ticket rpc_admission::admit(const char *method)
+{
+	if(!m_enabled)
+		return ticket();
+
+	const cost_class cls = cost_of(method);
+	class_state &st = m_classes[cls];
+	if(st.limit == 0)
+	{
+		st.admitted.fetch_add(1, std::memory_order_relaxed);
+		return ticket(this, cls, true);
+	}
+
+	// Running or waiting, the call holds on to this worker thread from here
+	if(!occupy_worker())
+	{
+		st.shed.fetch_add(1, std::memory_order_relaxed);
+		return ticket(this, cls, false);
+	}
+
+	boost::unique_lock<boost::mutex> lock(st.lock);
+	if(st.active >= st.limit)
+	{
+		// Everyone queued ahead of us, and us, need a slot to free up first
+		const uint64_t expected_wait_us = (st.waiting + 1) * st.avg_service_us.load(std::memory_order_relaxed) / st.limit;
+		if(expected_wait_us > m_queue_budget_us)
+		{
+			free_worker();
+			st.shed.fetch_add(1, std::memory_order_relaxed);
+			return ticket(this, cls, false);
+		}
+
+		++st.waiting;
+		const auto deadline = boost::chrono::steady_clock::now() + boost::chrono::microseconds(m_queue_budget_us);
+		while(st.active >= st.limit)
+		{
+			if(st.slot_freed.wait_until(lock, deadline) == boost::cv_status::timeout && st.active >= st.limit)
+			{
+				--st.waiting;
+				free_worker();
+				st.shed.fetch_add(1, std::memory_order_relaxed);
+				return ticket(this, cls, false);
+			}
+		}
+		--st.waiting;
+	}
+	++st.active;
+	st.admitted.fetch_add(1, std::memory_order_relaxed);
+	return ticket(this, cls, true);
+}
+
+void rpc_admission::release(cost_class cls, uint64_t service_us)
+{
+	class_state &st = m_classes[cls];
+
+	// EWMA with a 1/8 weight, updates racing each other may lose a sample
+	const uint64_t avg = st.avg_service_us.load(std::memory_order_relaxed);
+	st.avg_service_us.store(avg - avg / 8 + service_us / 8, std::memory_order_relaxed);
+
+	if(st.limit == 0)
+		return;
+	{
+		boost::lock_guard<boost::mutex> lock(st.lock);
+		--st.active;
+		st.slot_freed.notify_one();
+	}
+	free_worker();
+}
+
+bool rpc_admission::occupy_worker()
+{
+	if(m_max_occupied == 0)
+		return true;
+	uint64_t occupied = m_occupied.load(std::memory_order_relaxed);
+	do
+	{
+		if(occupied >= m_max_occupied)
+			return false;
+	} while(!m_occupied.compare_exchange_weak(occupied, occupied + 1, std::memory_order_relaxed));
+	return true;
+}
+
+void rpc_admission::free_worker()
+{
+	if(m_max_occupied != 0)
+		m_occupied.fetch_sub(1, std::memory_order_relaxed);
+}
+
+rpc_admission::class_stats rpc_admission::get_stats(cost_class cls) const
+{
+	const class_state &st = m_classes[cls];
+	class_stats s;
+	{
+		boost::lock_guard<boost::mutex> lock(st.lock);
+		s.limit = st.limit;
+		s.active = st.active;
+		s.waiting = st.waiting;
+	}
+	s.admitted = st.admitted.load(std::memory_order_relaxed);
+	s.shed = st.shed.load(std::memory_order_relaxed);
+	s.avg_service_us = st.avg_service_us.load(std::memory_order_relaxed);
+	return s;
+}
+
+void rpc_admission::write_prometheus(std::string &out, const std::string &prefix) const
+{
+	class_stats stats[cost_class_count];
+	for(int i = 0; i < cost_class_count; ++i)
+		stats[i] = get_stats(static_cast<cost_class>(i));
+
+	const struct
+	{
+		const char *name;
+		const char *type;
+		const char *help;
+		uint64_t class_stats::*value;
+	} families[] = {
+		{"_rpc_admission_limit", "gauge", "Concurrent calls allowed per cost class, 0 is unlimited.", &class_stats::limit},
+		{"_rpc_admission_active", "gauge", "Calls holding a slot of the cost class.", &class_stats::active},
+		{"_rpc_admission_waiting", "gauge", "Calls waiting for a slot of the cost class.", &class_stats::waiting},
+		{"_rpc_admission_admitted_total", "counter", "Calls admitted per cost class.", &class_stats::admitted},
+		{"_rpc_admission_shed_total", "counter", "Calls answered BUSY because the cost class was saturated.", &class_stats::shed}};
+
+	for(const auto &f : families)
+	{
+		const std::string name = prefix + f.name;
+		out += fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, f.help, name, f.type);
+		for(int i = 0; i < cost_class_count; ++i)
+			out += fmt::format("{}{{class=\"{}\"}} {}\n", name, class_name(static_cast<cost_class>(i)), stats[i].*f.value);
+	}
+}
+
+const char *rpc_admission::class_name(cost_class cls)
+{
+	switch(cls)
+	{
+	case cost_light:
+		return "light";
+	case cost_medium:
+		return "medium";
+	case cost_heavy:
+		return "heavy";
+	default:
+		return "unknown";
+	}
+}
+
+bool rpc_admission::parse_class(const std::string &name, cost_class &cls)
+{
+	for(int i = 0; i < cost_class_count; ++i)
+	{
+		if(name == class_name(static_cast<cost_class>(i)))
+		{
+			cls = static_cast<cost_class>(i);
+			return true;
+		}
+	}
+	return false;
+}
+}
+}
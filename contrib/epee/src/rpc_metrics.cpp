@@ -0,0 +1,138 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include "net/rpc_metrics.h"
+
+#include <boost/thread/locks.hpp>
+#include <fmt/format.h>
+
+namespace epee
+{
+namespace net_utils
+{
+namespace
+{
+// Prometheus "le" bounds, microseconds and their label text
+const std::pair<uint64_t, const char *> histogram_bounds[] = {
+	{100, "0.0001"}, {250, "0.00025"}, {500, "0.0005"}, {1000, "0.001"}, {2500, "0.0025"}, {5000, "0.005"},
+	{10000, "0.01"}, {25000, "0.025"}, {50000, "0.05"}, {100000, "0.1"}, {250000, "0.25"}, {500000, "0.5"},
+	{1000000, "1"}, {2500000, "2.5"}, {5000000, "5"}, {10000000, "10"}, {30000000, "30"}};
+
+void write_family_header(std::string &out, const std::string &name, const char *type, const std::string &help)
+{
+	out += "# HELP " + name + " " + help + "\n";
+	out += "# TYPE " + name + " " + type + "\n";
+}
+
+template <class F>
+void write_method_family(std::string &out, const std::string &name, const char *type, const std::string &help,
+						  const std::vector<std::pair<std::string, const rpc_method_metrics *>> &methods, F value)
+{
+	write_family_header(out, name, type, help);
+	for(const auto &m : methods)
+		out += fmt::format("{}{{method=\"{}\"}} {}\n", name, m.first, value(*m.second));
+}
+}
+
+rpc_metrics &rpc_metrics::instance()
+{
+	static rpc_metrics metrics;
+	return metrics;
+}
+
+rpc_method_metrics &rpc_metrics::get(const std::string &method)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	std::unique_ptr<rpc_method_metrics> &entry = m_methods[method];
+	if(!entry)
+		entry.reset(new rpc_method_metrics());
+	return *entry;
+}
+
+std::vector<std::pair<std::string, const rpc_method_metrics *>> rpc_metrics::methods() const
+{
+	std::vector<std::pair<std::string, const rpc_method_metrics *>> res;
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	res.reserve(m_methods.size());
+	for(const auto &m : m_methods)
+		res.emplace_back(m.first, m.second.get());
+	return res;
+}
+
+uint64_t rpc_metrics::total_in_flight() const
+{
+	uint64_t n = 0;
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	for(const auto &m : m_methods)
+		n += m.second->in_flight.load(std::memory_order_relaxed);
+	return n;
+}
+
+void rpc_metrics::write_prometheus(std::string &out, const std::string &prefix) const
+{
+	const auto all = methods();
+
+	write_method_family(out, prefix + "_rpc_requests_total", "counter", "RPC calls received.", all,
+						 [](const rpc_method_metrics &m) { return m.calls.load(std::memory_order_relaxed); });
+	write_method_family(out, prefix + "_rpc_errors_total", "counter", "RPC calls that failed to parse or whose handler failed.", all,
+						 [](const rpc_method_metrics &m) { return m.errors.load(std::memory_order_relaxed); });
+	write_method_family(out, prefix + "_rpc_in_flight", "gauge", "RPC calls currently being processed.", all,
+						 [](const rpc_method_metrics &m) { return m.in_flight.load(std::memory_order_relaxed); });
+	write_method_family(out, prefix + "_rpc_request_bytes_total", "counter", "Bytes of RPC request bodies received.", all,
+						 [](const rpc_method_metrics &m) { return m.request_bytes.load(std::memory_order_relaxed); });
+	write_method_family(out, prefix + "_rpc_response_bytes_total", "counter", "Bytes of RPC response bodies produced, before compression.", all,
+						 [](const rpc_method_metrics &m) { return m.response_bytes.load(std::memory_order_relaxed); });
+
+	std::vector<std::pair<std::string, latency_histogram::snapshot>> series;
+	series.reserve(all.size());
+	for(const auto &m : all)
+		series.emplace_back("method=\"" + m.first + "\"", m.second->latency.get_snapshot());
+	write_prometheus_histogram(out, prefix + "_rpc_request_duration_seconds", "Time from request parse to response serialization.", series);
+}
+
+void rpc_metrics::write_prometheus_histogram(std::string &out, const std::string &name, const std::string &help,
+											 const std::vector<std::pair<std::string, latency_histogram::snapshot>> &series)
+{
+	write_family_header(out, name, "histogram", help);
+	for(const auto &s : series)
+	{
+		// Use the bucket total rather than the count so that the series stays
+		// monotonic when a sample is recorded while we read
+		uint64_t total = 0;
+		for(uint64_t b : s.second.buckets)
+			total += b;
+		const std::string sep = s.first.empty() ? "" : ",";
+		for(const auto &b : histogram_bounds)
+			out += fmt::format("{}_bucket{{{}{}le=\"{}\"}} {}\n", name, s.first, sep, b.second, s.second.count_below(b.first + 1));
+		out += fmt::format("{}_bucket{{{}{}le=\"+Inf\"}} {}\n", name, s.first, sep, total);
+		const std::string labels = s.first.empty() ? "" : "{" + s.first + "}";
+		out += fmt::format("{}_sum{} {:.6f}\n", name, labels, s.second.sum / 1e6);
+		out += fmt::format("{}_count{} {}\n", name, labels, total);
+	}
+}
+}
+}
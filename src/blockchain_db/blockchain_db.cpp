@@ -326,6 +326,30 @@ bool BlockchainDB::get_tx(const crypto::hash &h, cryptonote::transaction &tx) co
 	return true;
 }
 
+size_t BlockchainDB::get_tx_blobs(const std::vector<crypto::hash> &hs, std::vector<cryptonote::blobdata> &bds, std::vector<uint64_t> &heights) const
+{
+	size_t found = 0;
+	bds.clear();
+	bds.resize(hs.size());
+	heights.assign(hs.size(), std::numeric_limits<uint64_t>::max());
+	for(size_t i = 0; i < hs.size(); ++i)
+	{
+		if(!get_tx_blob(hs[i], bds[i]))
+			continue;
+		heights[i] = get_tx_block_height(hs[i]);
+		++found;
+	}
+	return found;
+}
+
+void BlockchainDB::has_key_images(const std::vector<crypto::key_image> &imgs, std::vector<bool> &spent) const
+{
+	spent.clear();
+	spent.reserve(imgs.size());
+	for(const crypto::key_image &img : imgs)
+		spent.push_back(has_key_image(img));
+}
+
 transaction BlockchainDB::get_tx(const crypto::hash &h) const
 {
 	transaction tx;
@@ -229,6 +229,16 @@ class DB_OPEN_FAILURE : public DB_EXCEPTION
 	DB_OPEN_FAILURE(const char *s) : DB_EXCEPTION(s) {}
 };
 
+/**
+ * @brief thrown when a read-only open finds a DB that only a writer can migrate
+ */
+class DB_NEEDS_MIGRATION : public DB_EXCEPTION
+{
+  public:
+	DB_NEEDS_MIGRATION() : DB_EXCEPTION("The db needs migration by the daemon first") {}
+	DB_NEEDS_MIGRATION(const char *s) : DB_EXCEPTION(s) {}
+};
+
 /**
  * @brief thrown when creating the BlockchainDB fails
  */
@@ -762,6 +772,28 @@ class BlockchainDB
 	virtual void block_txn_stop() = 0;
 	virtual void block_txn_abort() = 0;
 
+	/**
+   * @brief pins a read snapshot of the database to the calling thread
+   *
+   * While the snapshot is held, every read made from this thread sees the
+   * database as it was when the snapshot was taken, regardless of blocks
+   * being written concurrently. Readers never wait for the writer.
+   *
+   * If the calling thread already has a snapshot (or is the writer), that
+   * one is reused and false is returned; the caller must then not call
+   * block_rtxn_stop(). Use db_rtxn_guard rather than calling this directly.
+   *
+   * The default implementation does nothing, for backends without MVCC.
+   *
+   * @return true if a new snapshot was taken, otherwise false
+   */
+	virtual bool block_rtxn_start() const { return false; }
+
+	/**
+   * @brief releases the read snapshot taken by block_rtxn_start()
+   */
+	virtual void block_rtxn_stop() const {}
+
 	virtual void set_hard_fork(HardFork *hf);
 
 	// adds a block with the given metadata to the top of the blockchain, returns the new height
@@ -1118,6 +1150,22 @@ class BlockchainDB
    * @return true iff the transaction was found
    */
 	virtual bool get_tx_blob(const crypto::hash &h, cryptonote::blobdata &tx) const = 0;
+
+	/**
+   * @brief fetches the blobs and block heights of several transactions
+   *
+   * Results are in the order of the request. Transactions that are not found
+   * get an empty blob and a height of uint64_t max. Subclasses may visit the
+   * transactions in storage order, the default implementation looks them up
+   * one by one.
+   *
+   * @param hs the hashes to look for
+   * @param bds return-by-reference the transaction blobs
+   * @param heights return-by-reference the heights of the transactions' blocks
+   *
+   * @return the number of transactions found
+   */
+	virtual size_t get_tx_blobs(const std::vector<crypto::hash> &hs, std::vector<cryptonote::blobdata> &bds, std::vector<uint64_t> &heights) const;
 	virtual bool get_tx_blob_indexed(const crypto::hash& h, cryptonote::blobdata& bd, std::vector<uint64_t>& o_idx) const = 0;
 
 	/**
@@ -1303,6 +1351,17 @@ class BlockchainDB
    */
 	virtual bool has_key_image(const crypto::key_image &img) const = 0;
 
+	/**
+   * @brief check if several key images are stored as spent
+   *
+   * Results are in the order of the request. Subclasses may visit the key
+   * images in storage order, the default implementation checks them one by one.
+   *
+   * @param imgs the key images to check for
+   * @param spent return-by-reference whether each image is present
+   */
+	virtual void has_key_images(const std::vector<crypto::key_image> &imgs, std::vector<bool> &spent) const;
+
 	/**
    * @brief add a txpool transaction
    *
@@ -1535,6 +1594,32 @@ private:
 	std::unordered_set<crypto::public_key> bad_outpks;
 }; // class BlockchainDB
 
+/**
+ * @brief RAII holder for a BlockchainDB read snapshot
+ *
+ * Reads done on this thread while the guard is alive are served from a single
+ * consistent snapshot, so that callers can do several dependent lookups (eg,
+ * height then hash at height - 1) without holding the blockchain lock.
+ * Nested guards on the same thread share the outermost snapshot.
+ */
+class db_rtxn_guard
+{
+  public:
+	db_rtxn_guard(const BlockchainDB *db) : m_db(db), m_active(db->block_rtxn_start()) {}
+	~db_rtxn_guard()
+	{
+		if(m_active)
+			m_db->block_rtxn_stop();
+	}
+
+	db_rtxn_guard(const db_rtxn_guard &) = delete;
+	db_rtxn_guard &operator=(const db_rtxn_guard &) = delete;
+
+  private:
+	const BlockchainDB *m_db;
+	bool m_active;
+};
+
 BlockchainDB *new_db(const std::string &db_type);
 
 } // namespace cryptonote
@@ -66,7 +66,7 @@ using namespace crypto;
 
 // Increase when the DB changes in a non backward compatible way, and there
 // is no automatic conversion, so that a full resync is needed.
-#define VERSION 1
+#define VERSION 2
 
 namespace
 {
@@ -162,6 +162,23 @@ int compare_hash32(const MDB_val *a, const MDB_val *b)
 	return 0;
 }
 
+// Returns the positions of the 32 byte keys in db order, so that a batch of
+// lookups only ever moves a cursor forward
+template <typename T>
+std::vector<size_t> sort_by_hash32(const std::vector<T> &keys)
+{
+	static_assert(sizeof(T) == 32, "sort_by_hash32 needs 32 byte keys");
+	std::vector<size_t> order(keys.size());
+	for(size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+		MDB_val va = {sizeof(T), (void *)&keys[a]};
+		MDB_val vb = {sizeof(T), (void *)&keys[b]};
+		return compare_hash32(&va, &vb) < 0;
+	});
+	return order;
+}
+
 int compare_string(const MDB_val *a, const MDB_val *b)
 {
 	const char *va = (const char *)a->mv_data;
@@ -189,6 +206,8 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
  *
+ * rct_distribution block ID     cumulative number of RingCT outputs
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -215,6 +234,8 @@ const char *const LMDB_TXPOOL_BLOB = "txpool_blob";
 const char *const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char *const LMDB_HF_VERSIONS = "hf_versions";
 
+const char *const LMDB_RCT_DISTRIBUTION = "rct_distribution";
+
 const char *const LMDB_PROPERTIES = "properties";
 
 const char zerokey[8] = {0};
@@ -747,6 +768,24 @@ void BlockchainLMDB::add_block(const block &blk, const size_t &block_size, const
 	if(result)
 		throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
 
+	// the block's transactions are already in, so this count includes the block's own outputs
+	CURSOR(output_amounts)
+	CURSOR(rct_distribution)
+	MDB_val_copy<uint64_t> rct_key(0);
+	MDB_val rct_v;
+	mdb_size_t num_rct_outs = 0;
+	result = mdb_cursor_get(m_cur_output_amounts, &rct_key, &rct_v, MDB_SET);
+	if(result == MDB_SUCCESS)
+		mdb_cursor_count(m_cur_output_amounts, &num_rct_outs);
+	else if(result != MDB_NOTFOUND)
+		throw0(DB_ERROR(lmdb_error("Failed to count RingCT outputs: ", result).c_str()));
+
+	uint64_t cum_rct = num_rct_outs;
+	MDB_val_set(val_rct, cum_rct);
+	result = mdb_cursor_put(m_cur_rct_distribution, &key, &val_rct, MDB_APPEND);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to add RingCT distribution to db transaction: ", result).c_str()));
+
 	m_cum_size += block_size;
 	m_cum_count++;
 }
@@ -766,6 +805,7 @@ void BlockchainLMDB::remove_block()
 	CURSOR(block_info)
 	CURSOR(block_heights)
 	CURSOR(blocks)
+	CURSOR(rct_distribution)
 	MDB_val_copy<uint64_t> k(m_height - 1);
 	MDB_val h = k;
 	if((result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
@@ -788,6 +828,11 @@ void BlockchainLMDB::remove_block()
 
 	if((result = mdb_cursor_del(m_cur_block_info, 0)))
 		throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+	if((result = mdb_cursor_get(m_cur_rct_distribution, &k, NULL, MDB_SET)))
+		throw1(DB_ERROR(lmdb_error("Failed to locate RingCT distribution for removal: ", result).c_str()));
+	if((result = mdb_cursor_del(m_cur_rct_distribution, 0)))
+		throw1(DB_ERROR(lmdb_error("Failed to add removal of RingCT distribution to db transaction: ", result).c_str()));
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash &blk_hash, const transaction &tx, const crypto::hash &tx_hash)
@@ -1243,6 +1288,11 @@ void BlockchainLMDB::open(const std::string &filename, const int db_flags)
 
 	lmdb_db_open(txn, LMDB_HF_VERSIONS, MDB_INTEGERKEY | MDB_CREATE, m_hf_versions, "Failed to open db handle for m_hf_versions");
 
+	// only version 2 has this subdb and a read-only open can't create it, so
+	// readers open it once the version is known
+	if(!(mdb_flags & MDB_RDONLY))
+		lmdb_db_open(txn, LMDB_RCT_DISTRIBUTION, MDB_INTEGERKEY | MDB_CREATE, m_rct_distribution, "Failed to open db handle for m_rct_distribution");
+
 	lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
 	mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
@@ -1288,6 +1338,14 @@ void BlockchainLMDB::open(const std::string &filename, const int db_flags)
 			// Note that there was a schema change within version 0 as well.
 			// See commit e5d2680094ee15889934fe28901e4e133cda56f2 2015/07/10
 			// We don't handle the old format previous to that commit.
+			if(mdb_flags & MDB_RDONLY)
+			{
+				const uint32_t db_version = *(const uint32_t *)v.mv_data;
+				txn.abort();
+				mdb_env_close(m_env);
+				m_open = false;
+				throw0(DB_NEEDS_MIGRATION(("Existing lmdb database is version " + std::to_string(db_version) + " and needs migration by the daemon first").c_str()));
+			}
 			txn.commit();
 			m_open = true;
 			migrate(*(const uint32_t *)v.mv_data);
@@ -1314,7 +1372,9 @@ void BlockchainLMDB::open(const std::string &filename, const int db_flags)
 		return;
 	}
 
-	if(!(mdb_flags & MDB_RDONLY))
+	if(mdb_flags & MDB_RDONLY)
+		lmdb_db_open(txn, LMDB_RCT_DISTRIBUTION, MDB_INTEGERKEY, m_rct_distribution, "Failed to open db handle for m_rct_distribution");
+	else
 	{
 		// only write version on an empty DB
 		if(m_height == 0)
@@ -1348,7 +1408,11 @@ void BlockchainLMDB::close()
 		GULPS_LOG_L3("close() first calling batch_abort() due to active batch transaction");
 		batch_abort();
 	}
-	this->sync();
+	// a read-only env can't be synced, mdb_env_sync fails with EACCES
+	unsigned int env_flags = 0;
+	mdb_env_get_flags(m_env, &env_flags);
+	if(!(env_flags & MDB_RDONLY))
+		this->sync();
 	m_tinfo.reset();
 
 	// FIXME: not yet thread safe!!!  Use with care.
@@ -1405,6 +1469,8 @@ void BlockchainLMDB::reset()
 	(void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
 	if(auto result = mdb_drop(txn, m_hf_versions, 0))
 		throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
+	if(auto result = mdb_drop(txn, m_rct_distribution, 0))
+		throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_distribution: ", result).c_str()));
 	if(auto result = mdb_drop(txn, m_properties, 0))
 		throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
 
@@ -2267,6 +2333,61 @@ bool BlockchainLMDB::get_tx_blob_indexed(const crypto::hash& h, cryptonote::blob
 	return true;
 }
 
+size_t BlockchainLMDB::get_tx_blobs(const std::vector<crypto::hash> &hs, std::vector<cryptonote::blobdata> &bds, std::vector<uint64_t> &heights) const
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	bds.clear();
+	bds.resize(hs.size());
+	heights.assign(hs.size(), std::numeric_limits<uint64_t>::max());
+
+	TXN_PREFIX_RDONLY();
+	RCURSOR(tx_indices);
+	RCURSOR(txs);
+
+	// First pass: walk tx_indices in hash order. After each seek the cursor sits on the
+	// smallest stored hash >= the previous query, which answers every query up to it
+	// without another seek.
+	std::vector<std::pair<uint64_t, size_t>> tx_ids;
+	tx_ids.reserve(hs.size());
+	MDB_val cur = {0, nullptr};
+	for(size_t i : sort_by_hash32(hs))
+	{
+		MDB_val k = {sizeof(crypto::hash), (void *)&hs[i]};
+		if(cur.mv_data == nullptr || compare_hash32(&k, &cur) > 0)
+		{
+			cur = k;
+			int result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &cur, MDB_GET_BOTH_RANGE);
+			if(result == MDB_NOTFOUND)
+				break;
+			if(result)
+				throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx index from hash: ", result).c_str()));
+		}
+		if(compare_hash32(&k, &cur) == 0)
+		{
+			const txindex *tip = (const txindex *)cur.mv_data;
+			tx_ids.emplace_back(tip->data.tx_id, i);
+			heights[i] = tip->data.block_id;
+		}
+	}
+
+	// Second pass: the blobs, in tx id order
+	std::sort(tx_ids.begin(), tx_ids.end());
+	for(const auto &id : tx_ids)
+	{
+		MDB_val_set(val_tx_id, id.first);
+		MDB_val result;
+		int get_result = mdb_cursor_get(m_cur_txs, &val_tx_id, &result, MDB_SET);
+		if(get_result)
+			throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from tx id: ", get_result).c_str()));
+		bds[id.second].assign(reinterpret_cast<char *>(result.mv_data), result.mv_size);
+	}
+
+	TXN_POSTFIX_RDONLY();
+	return tx_ids.size();
+}
+
 uint64_t BlockchainLMDB::get_tx_count() const
 {
 	GULPS_LOG_L3("BlockchainLMDB::", __func__);
@@ -2518,6 +2639,37 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image &img) const
 	return ret;
 }
 
+void BlockchainLMDB::has_key_images(const std::vector<crypto::key_image> &imgs, std::vector<bool> &spent) const
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	spent.assign(imgs.size(), false);
+
+	TXN_PREFIX_RDONLY();
+	RCURSOR(spent_keys);
+
+	// Same forward walk as get_tx_blobs: the cursor sits on the smallest spent key
+	// image >= the previous query, so it only has to seek when we pass it
+	MDB_val cur = {0, nullptr};
+	for(size_t i : sort_by_hash32(imgs))
+	{
+		MDB_val k = {sizeof(crypto::key_image), (void *)&imgs[i]};
+		if(cur.mv_data == nullptr || compare_hash32(&k, &cur) > 0)
+		{
+			cur = k;
+			int result = mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &cur, MDB_GET_BOTH_RANGE);
+			if(result == MDB_NOTFOUND)
+				break;
+			if(result)
+				throw0(DB_ERROR(lmdb_error("DB error attempting to check key images: ", result).c_str()));
+		}
+		spent[i] = compare_hash32(&k, &cur) == 0;
+	}
+
+	TXN_POSTFIX_RDONLY();
+}
+
 bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image &)> f) const
 {
 	GULPS_LOG_L3("BlockchainLMDB::", __func__);
@@ -2915,6 +3067,13 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
 	return ret;
 }
 
+bool BlockchainLMDB::block_rtxn_start() const
+{
+	MDB_txn *mtxn;
+	mdb_txn_cursors *mcur;
+	return block_rtxn_start(&mtxn, &mcur);
+}
+
 void BlockchainLMDB::block_rtxn_stop() const
 {
 	GULPS_LOG_L3("BlockchainLMDB::", __func__);
@@ -3284,7 +3443,6 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
 	check_open();
 
 	TXN_PREFIX_RDONLY();
-	RCURSOR(output_amounts);
 
 	distribution.clear();
 	const uint64_t db_height = height();
@@ -3292,7 +3450,47 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
 		return false;
 	distribution.resize(db_height - from_height, 0);
 
-	bool fret = true;
+	if(amount == 0)
+	{
+		// RingCT outputs have a per block cumulative count, so this is a slice of that
+		RCURSOR(rct_distribution);
+
+		uint64_t prev_cum = 0;
+		MDB_val_copy<uint64_t> k(from_height > 0 ? from_height - 1 : 0);
+		MDB_val v;
+		MDB_cursor_op op = MDB_SET;
+		if(from_height == 0)
+		{
+			base = 0;
+		}
+		else
+		{
+			int ret = mdb_cursor_get(m_cur_rct_distribution, &k, &v, MDB_SET);
+			if(ret)
+				throw0(DB_ERROR(lmdb_error("Failed to get RingCT distribution: ", ret).c_str()));
+			prev_cum = *(const uint64_t *)v.mv_data;
+			base = prev_cum;
+			op = MDB_NEXT;
+		}
+
+		for(uint64_t i = 0; i < distribution.size(); ++i)
+		{
+			int ret = mdb_cursor_get(m_cur_rct_distribution, &k, &v, op);
+			op = MDB_NEXT;
+			if(ret)
+				throw0(DB_ERROR(lmdb_error("Failed to get RingCT distribution: ", ret).c_str()));
+			const uint64_t cum = *(const uint64_t *)v.mv_data;
+			distribution[i] = cum - prev_cum;
+			prev_cum = cum;
+		}
+
+		TXN_POSTFIX_RDONLY();
+
+		return true;
+	}
+
+	RCURSOR(output_amounts);
+
 	MDB_val_set(k, amount);
 	MDB_val v;
 	MDB_cursor_op op = MDB_SET;
@@ -3979,12 +4177,87 @@ void BlockchainLMDB::migrate_0_1()
 	txn.commit();
 }
 
+void BlockchainLMDB::migrate_1_2()
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	uint64_t m_height;
+	int result;
+	mdb_txn_safe txn(false);
+	MDB_val k, v;
+
+	GULPS_INFO_CLR(gulps::COLOR_YELLOW, "Migrating blockchain from DB version 1 to 2 - this may take a while:");
+	GULPS_INFO("building rct_distribution table...");
+
+	result = mdb_txn_begin(m_env, NULL, 0, txn);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+	MDB_stat db_stats;
+	if((result = mdb_stat(txn, m_blocks, &db_stats)))
+		throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+	m_height = db_stats.ms_entries;
+	GULPSF_INFO("Total number of blocks: {}", m_height);
+
+	result = mdb_drop(txn, m_rct_distribution, 0);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_distribution: ", result).c_str()));
+
+	// RingCT outputs are stored in chain order, so their heights never decrease
+	std::vector<uint64_t> counts(m_height, 0);
+	MDB_cursor *c_amounts;
+	result = mdb_cursor_open(txn, m_output_amounts, &c_amounts);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+	uint64_t amount = 0;
+	k.mv_data = &amount;
+	k.mv_size = sizeof(amount);
+	MDB_cursor_op op = MDB_SET;
+	while(1)
+	{
+		result = mdb_cursor_get(c_amounts, &k, &v, op);
+		op = MDB_NEXT_DUP;
+		if(result == MDB_NOTFOUND)
+			break;
+		if(result)
+			throw0(DB_ERROR(lmdb_error("Failed to enumerate RingCT outputs: ", result).c_str()));
+		const outkey *ok = (const outkey *)v.mv_data;
+		if(ok->data.height >= m_height)
+			throw0(DB_ERROR("RingCT output height is above the chain height"));
+		counts[ok->data.height]++;
+	}
+	mdb_cursor_close(c_amounts);
+
+	uint64_t cum = 0;
+	for(uint64_t i = 0; i < m_height; ++i)
+	{
+		if(i % 100000 == 0)
+			GULPSF_INFO("  {}/{}", i, m_height);
+		cum += counts[i];
+		MDB_val_copy<uint64_t> key(i);
+		MDB_val_copy<uint64_t> val(cum);
+		result = mdb_put(txn, m_rct_distribution, &key, &val, MDB_APPEND);
+		if(result)
+			throw0(DB_ERROR(lmdb_error("Failed to add RingCT distribution to the db: ", result).c_str()));
+	}
+
+	uint32_t version = 2;
+	v.mv_data = (void *)&version;
+	v.mv_size = sizeof(version);
+	MDB_val_copy<const char *> vk("version");
+	result = mdb_put(txn, m_properties, &vk, &v, 0);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+	txn.commit();
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
 	switch(oldversion)
 	{
 	case 0:
 		migrate_0_1(); /* FALLTHRU */
+	case 1:
+		migrate_1_2(); /* FALLTHRU */
 	default:;
 	}
 }
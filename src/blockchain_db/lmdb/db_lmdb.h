@@ -76,6 +76,8 @@ typedef struct mdb_txn_cursors
 	MDB_cursor *m_txc_txpool_blob;
 
 	MDB_cursor *m_txc_hf_versions;
+
+	MDB_cursor *m_txc_rct_distribution;
 } mdb_txn_cursors;
 
 #define m_cur_blocks m_cursors->m_txc_blocks
@@ -90,6 +92,7 @@ typedef struct mdb_txn_cursors
 #define m_cur_txpool_meta m_cursors->m_txc_txpool_meta
 #define m_cur_txpool_blob m_cursors->m_txc_txpool_blob
 #define m_cur_hf_versions m_cursors->m_txc_hf_versions
+#define m_cur_rct_distribution m_cursors->m_txc_rct_distribution
 
 typedef struct mdb_rflags
 {
@@ -106,6 +109,7 @@ typedef struct mdb_rflags
 	bool m_rf_txpool_meta;
 	bool m_rf_txpool_blob;
 	bool m_rf_hf_versions;
+	bool m_rf_rct_distribution;
 } mdb_rflags;
 
 typedef struct mdb_threadinfo
@@ -236,6 +240,7 @@ class BlockchainLMDB : public BlockchainDB
 
 	virtual bool get_tx_blob(const crypto::hash &h, cryptonote::blobdata &tx) const;
 	virtual bool get_tx_blob_indexed(const crypto::hash& h, cryptonote::blobdata& bd, std::vector<uint64_t>& o_idx) const;
+	virtual size_t get_tx_blobs(const std::vector<crypto::hash> &hs, std::vector<cryptonote::blobdata> &bds, std::vector<uint64_t> &heights) const;
 
 	virtual uint64_t get_tx_count() const;
 
@@ -259,6 +264,7 @@ class BlockchainLMDB : public BlockchainDB
 	virtual std::vector<uint64_t> get_tx_amount_output_indices(const uint64_t tx_id) const;
 
 	virtual bool has_key_image(const crypto::key_image &img) const;
+	virtual void has_key_images(const std::vector<crypto::key_image> &imgs, std::vector<bool> &spent) const;
 
 	virtual void add_txpool_tx(const transaction &tx, const txpool_tx_meta_t &meta);
 	virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta);
@@ -288,6 +294,7 @@ class BlockchainLMDB : public BlockchainDB
 	virtual void block_txn_stop();
 	virtual void block_txn_abort();
 	virtual bool block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) const;
+	virtual bool block_rtxn_start() const;
 	virtual void block_rtxn_stop() const;
 
 	virtual void pop_block(block &blk, std::vector<transaction> &txs);
@@ -379,6 +386,9 @@ class BlockchainLMDB : public BlockchainDB
 	// migrate from DB version 0 to 1
 	void migrate_0_1();
 
+	// migrate from DB version 1 to 2
+	void migrate_1_2();
+
 	void cleanup_batch();
 
   private:
@@ -403,6 +413,8 @@ class BlockchainLMDB : public BlockchainDB
 	MDB_dbi m_hf_starting_heights;
 	MDB_dbi m_hf_versions;
 
+	MDB_dbi m_rct_distribution;
+
 	MDB_dbi m_properties;
 
 	mutable uint64_t m_cum_size; // used in batch size estimation
@@ -41,6 +41,9 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#pragma once
+
+#include <algorithm>
 #include <vector>
 #include <random>
 
@@ -58,6 +61,11 @@ public:
 		bytes.resize(bits_number/8, 0);
 	}
 
+	inline void clear()
+	{
+		std::fill(bytes.begin(), bytes.end(), 0);
+	}
+
 	inline void add_element(const void* data, size_t data_len)
 	{
 		crypto::hash h = crypto::cn_fast_hash(data, data_len);
@@ -66,7 +74,7 @@ public:
 		memcpy(&seed, h.data, sizeof(seed));
 
 		std::mt19937_64 mtgen(seed);
-		std::uniform_int_distribution<uint16_t> dist(0, bits_number-1);
+		std::uniform_int_distribution<size_t> dist(0, bits_number-1);
 
 		for(size_t i=0; i < hash_number; i++)
 			set_bit(dist(mtgen));
@@ -80,7 +88,7 @@ public:
 		memcpy(&seed, h.data, sizeof(seed));
 
 		std::mt19937_64 mtgen(seed);
-		std::uniform_int_distribution<uint16_t> dist(0, bits_number-1);
+		std::uniform_int_distribution<size_t> dist(0, bits_number-1);
 
 		for(size_t i=0; i < hash_number; i++)
 		{
@@ -115,3 +123,42 @@ private:
 			bytes[byte] |= (1<<bit);
 	}
 };
+
+// Remembers at least the last `capacity` elements. Once the current generation is full
+// it becomes the previous one and the oldest generation is forgotten.
+class rolling_bloom_filter
+{
+public:
+	rolling_bloom_filter() : capacity(0), count(0) {}
+
+	inline void init(size_t num_of_elements)
+	{
+		capacity = num_of_elements;
+		count = 0;
+		current.init(num_of_elements);
+		previous.init(num_of_elements);
+	}
+
+	inline void add_element(const void* data, size_t data_len)
+	{
+		if(count >= capacity)
+		{
+			std::swap(current, previous);
+			current.clear();
+			count = 0;
+		}
+		current.add_element(data, data_len);
+		count++;
+	}
+
+	inline bool not_present(const void* data, size_t data_len)
+	{
+		return current.not_present(data, data_len) && previous.not_present(data, data_len);
+	}
+
+private:
+	size_t capacity;
+	size_t count;
+	bloom_filter current;
+	bloom_filter previous;
+};
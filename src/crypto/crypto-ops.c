@@ -1901,6 +1901,48 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h)
 	s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* ge_tobytes of n points, s is n * 32 bytes. Montgomery's trick turns the field
+   inversions of each run of GE_TOBYTES_BATCH points into one inversion plus 3 muls each */
+
+#define GE_TOBYTES_BATCH 64
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, size_t n)
+{
+	fe acc[GE_TOBYTES_BATCH];
+	fe recip;
+	fe zinv;
+	fe x;
+	fe y;
+	size_t i, j, cnt;
+
+	for(i = 0; i < n; i += cnt)
+	{
+		cnt = n - i < GE_TOBYTES_BATCH ? n - i : GE_TOBYTES_BATCH;
+
+		/* acc[j] = Z_0 * ... * Z_j */
+		fe_copy(acc[0], h[i].Z);
+		for(j = 1; j < cnt; j++)
+			fe_mul(acc[j], acc[j - 1], h[i + j].Z);
+
+		fe_invert(recip, acc[cnt - 1]);
+		for(j = cnt; j-- > 0;)
+		{
+			if(j > 0)
+			{
+				fe_mul(zinv, recip, acc[j - 1]);
+				fe_mul(recip, recip, h[i + j].Z);
+			}
+			else
+				fe_copy(zinv, recip);
+
+			fe_mul(x, h[i + j].X, zinv);
+			fe_mul(y, h[i + j].Y, zinv);
+			fe_tobytes(s + 32 * (i + j), y);
+			s[32 * (i + j) + 31] ^= fe_isnegative(x) << 7;
+		}
+	}
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -329,6 +329,70 @@ bool crypto_ops::derive_subaddress_public_key(const public_key &out_key, const k
 	return true;
 }
 
+void crypto_ops::generate_key_derivations(const public_key *keys1, const secret_key *keys2, std::size_t count, key_derivation *derivations, bool *valid)
+{
+	std::vector<ge_p2> points(count);
+	ge_p3 point;
+	ge_p1p1 point2;
+	bool point_ok = false;
+	for(size_t i = 0; i < count; i++)
+	{
+		assert(sc_check(&keys2[i]) == 0);
+		if(i == 0 || keys1[i] != keys1[i - 1])
+			point_ok = ge_frombytes_vartime(&point, &keys1[i]) == 0;
+		valid[i] = point_ok;
+		if(!point_ok)
+		{
+			points[i] = ge_p2{{0}, {1}, {1}};
+			continue;
+		}
+		ge_scalarmult(&points[i], &unwrap(keys2[i]), &point);
+		ge_mul8(&point2, &points[i]);
+		ge_p1p1_to_p2(&points[i], &point2);
+	}
+
+	ge_tobytes_batch(reinterpret_cast<unsigned char *>(derivations), points.data(), count);
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!valid[i])
+			memset(&derivations[i], 0, sizeof(key_derivation));
+	}
+}
+
+void crypto_ops::derive_subaddress_public_keys(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *results, bool *valid)
+{
+	std::vector<ge_p2> points(count);
+	ec_scalar scalar;
+	ge_p3 point1;
+	ge_p3 point2;
+	ge_cached point3;
+	ge_p1p1 point4;
+	bool point_ok = false;
+	for(size_t i = 0; i < count; i++)
+	{
+		if(i == 0 || out_keys[i] != out_keys[i - 1])
+			point_ok = ge_frombytes_vartime(&point1, &out_keys[i]) == 0;
+		valid[i] = point_ok;
+		if(!point_ok)
+		{
+			points[i] = ge_p2{{0}, {1}, {1}};
+			continue;
+		}
+		derivation_to_scalar(derivations[i], output_indices[i], scalar);
+		ge_scalarmult_base(&point2, &scalar);
+		ge_p3_to_cached(&point3, &point2);
+		ge_sub(&point4, &point1, &point3);
+		ge_p1p1_to_p2(&points[i], &point4);
+	}
+
+	ge_tobytes_batch(reinterpret_cast<unsigned char *>(results), points.data(), count);
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!valid[i])
+			memset(&results[i], 0, sizeof(public_key));
+	}
+}
+
 #ifdef HAVE_EC_64
 
 bool crypto_ops::generate_key_derivation_64(const public_key &key1, const secret_key &key2, key_derivation &derivation)
@@ -367,6 +431,68 @@ bool crypto_ops::derive_subaddress_public_key_64(const public_key& out_key, cons
 	return true;
 }
 
+void crypto_ops::generate_key_derivations_64(const public_key *keys1, const secret_key *keys2, std::size_t count, key_derivation *derivations, bool *valid)
+{
+	std::vector<ge64_p2> points(count);
+	ge64_p3 point;
+	ge64_p1p1 point2;
+	bool point_ok = false;
+	for(size_t i = 0; i < count; i++)
+	{
+		assert(sc_check(&keys2[i]) == 0);
+		if(i == 0 || keys1[i] != keys1[i - 1])
+			point_ok = ge64_frombytes_vartime(&point, &keys1[i]) == 0;
+		valid[i] = point_ok;
+		if(!point_ok)
+		{
+			points[i] = ge64_p2{{0}, {1}, {1}};
+			continue;
+		}
+		ge64_scalarmult(&points[i], &unwrap(keys2[i]), &point);
+		ge64_mul8(&point2, &points[i]);
+		ge64_p1p1_to_p2(&points[i], &point2);
+	}
+
+	ge64_tobytes_batch(reinterpret_cast<unsigned char *>(derivations), points.data(), count);
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!valid[i])
+			memset(&derivations[i], 0, sizeof(key_derivation));
+	}
+}
+
+void crypto_ops::derive_subaddress_public_keys_64(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *results, bool *valid)
+{
+	std::vector<ge64_p2> points(count);
+	ec_scalar scalar;
+	ge64_p3 point1;
+	ge64_p3 point3;
+	ge64_p1p1 point4;
+	bool point_ok = false;
+	for(size_t i = 0; i < count; i++)
+	{
+		if(i == 0 || out_keys[i] != out_keys[i - 1])
+			point_ok = ge64_frombytes_vartime(&point1, &out_keys[i]) == 0;
+		valid[i] = point_ok;
+		if(!point_ok)
+		{
+			points[i] = ge64_p2{{0}, {1}, {1}};
+			continue;
+		}
+		derivation_to_scalar(derivations[i], output_indices[i], scalar);
+		ge64_scalarmult_base(&point3, &scalar);
+		ge64_sub(&point4, &point1, &point3);
+		ge64_p1p1_to_p2(&points[i], &point4);
+	}
+
+	ge64_tobytes_batch(reinterpret_cast<unsigned char *>(results), points.data(), count);
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!valid[i])
+			memset(&results[i], 0, sizeof(public_key));
+	}
+}
+
 #endif
 
 struct s_comm
@@ -171,11 +171,19 @@ class crypto_ops
 	friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
 	static bool derive_subaddress_public_key(const public_key &, const key_derivation &, std::size_t, public_key &);
 	friend bool derive_subaddress_public_key(const public_key &, const key_derivation &, std::size_t, public_key &);
+	static void generate_key_derivations(const public_key *, const secret_key *, std::size_t, key_derivation *, bool *);
+	friend void generate_key_derivations(const public_key *, const secret_key *, std::size_t, key_derivation *, bool *);
+	static void derive_subaddress_public_keys(const public_key *, const key_derivation *, const std::size_t *, std::size_t, public_key *, bool *);
+	friend void derive_subaddress_public_keys(const public_key *, const key_derivation *, const std::size_t *, std::size_t, public_key *, bool *);
 #ifdef HAVE_EC_64
 	static bool generate_key_derivation_64(const public_key &, const secret_key &, key_derivation &);
 	friend bool generate_key_derivation_64(const public_key &, const secret_key &, key_derivation &);
 	static bool derive_subaddress_public_key_64(const public_key &, const key_derivation &, std::size_t, public_key &);
 	friend bool derive_subaddress_public_key_64(const public_key &, const key_derivation &, std::size_t, public_key &);
+	static void generate_key_derivations_64(const public_key *, const secret_key *, std::size_t, key_derivation *, bool *);
+	friend void generate_key_derivations_64(const public_key *, const secret_key *, std::size_t, key_derivation *, bool *);
+	static void derive_subaddress_public_keys_64(const public_key *, const key_derivation *, const std::size_t *, std::size_t, public_key *, bool *);
+	friend void derive_subaddress_public_keys_64(const public_key *, const key_derivation *, const std::size_t *, std::size_t, public_key *, bool *);
 #endif
 	static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
 	friend void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
@@ -282,6 +290,20 @@ inline bool derive_subaddress_public_key(const public_key &out_key, const key_de
 {
 	return crypto_ops::derive_subaddress_public_key(out_key, derivation, output_index, result);
 }
+
+/* Batched forms of the two calls above for output scanning, entry i of every array belongs together.
+   * * A run of equal public keys (or output keys) is decompressed only once, so group entries by key.
+   * * The final point encodings share one field inversion per 64 entries.
+   * valid[i] is set to false, and the result zeroed, where the key at i does not decompress.
+   */
+inline void generate_key_derivations(const public_key *keys1, const secret_key *keys2, std::size_t count, key_derivation *derivations, bool *valid)
+{
+	crypto_ops::generate_key_derivations(keys1, keys2, count, derivations, valid);
+}
+inline void derive_subaddress_public_keys(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *results, bool *valid)
+{
+	crypto_ops::derive_subaddress_public_keys(out_keys, derivations, output_indices, count, results, valid);
+}
 #ifdef HAVE_EC_64
 inline bool generate_key_derivation_64(const public_key &key1, const secret_key &key2, key_derivation &derivation)
 {
@@ -292,6 +314,15 @@ inline bool derive_subaddress_public_key_64(const public_key &out_key, const key
 {
 	return crypto_ops::derive_subaddress_public_key_64(out_key, derivation, output_index, result);
 }
+
+inline void generate_key_derivations_64(const public_key *keys1, const secret_key *keys2, std::size_t count, key_derivation *derivations, bool *valid)
+{
+	crypto_ops::generate_key_derivations_64(keys1, keys2, count, derivations, valid);
+}
+inline void derive_subaddress_public_keys_64(const public_key *out_keys, const key_derivation *derivations, const std::size_t *output_indices, std::size_t count, public_key *results, bool *valid)
+{
+	crypto_ops::derive_subaddress_public_keys_64(out_keys, derivations, output_indices, count, results, valid);
+}
 #endif
 
 /* Generation and checking of a standard signature.
@@ -319,6 +319,42 @@ void ge64_tobytes(unsigned char s[32], const ge64_p2* h)
 	s[31] ^= fe64_isnegative(x) << 7;
 }
 
+/* ge64_tobytes of n points, one inversion per GE64_TOBYTES_BATCH points */
+#define GE64_TOBYTES_BATCH 64
+
+void ge64_tobytes_batch(unsigned char* s, const ge64_p2* h, size_t n)
+{
+	fe64 acc[GE64_TOBYTES_BATCH];
+	fe64 recip, zinv, x, y;
+	size_t i, j, cnt;
+
+	for(i = 0; i < n; i += cnt)
+	{
+		cnt = n - i < GE64_TOBYTES_BATCH ? n - i : GE64_TOBYTES_BATCH;
+
+		fe64_copy(acc[0], h[i].z);
+		for(j = 1; j < cnt; j++)
+			fe64_mul(acc[j], acc[j - 1], h[i + j].z);
+
+		fe64_invert(recip, acc[cnt - 1]);
+		for(j = cnt; j-- > 0;)
+		{
+			if(j > 0)
+			{
+				fe64_mul(zinv, recip, acc[j - 1]);
+				fe64_mul(recip, recip, h[i + j].z);
+			}
+			else
+				fe64_copy(zinv, recip);
+
+			fe64_mul(x, h[i + j].x, zinv);
+			fe64_mul(y, h[i + j].y, zinv);
+			fe64_pack(s + 32 * (i + j), y);
+			s[32 * (i + j) + 31] ^= fe64_isnegative(x) << 7;
+		}
+	}
+}
+
 /* no overflow for this particular order */
 extern const uint64_t sc64_reduce_order[16];
 
@@ -81,6 +81,9 @@
 GULPS_CAT_MAJOR("blockchain");
 
 #define FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE (100 * 1024 * 1024) // 100 MB
+#define INDEXED_BLOCKS_CHUNK_SIZE 100
+#define INDEXED_BLOCKS_CACHE_SAFE_DEPTH 30 // blocks below the top before a chunk may be cached
+#define INDEXED_BLOCKS_CACHE_MAX_SIZE (256 * 1024 * 1024) // 256 MB
 
 using namespace crypto;
 
@@ -157,7 +160,8 @@ static const struct
 
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool &tx_pool) : m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_sz_limit(0), m_current_block_cumul_sz_median(0),
-												  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_cancel(false)
+												  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_cancel(false),
+												  m_indexed_blocks_cache(INDEXED_BLOCKS_CHUNK_SIZE, INDEXED_BLOCKS_CACHE_MAX_SIZE), m_core_events(nullptr)
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
 }
@@ -182,6 +186,13 @@ bool Blockchain::have_tx_keyimg_as_spent(const crypto::key_image &key_im) const
 	return m_db->has_key_image(key_im);
 }
 //------------------------------------------------------------------
+void Blockchain::have_tx_keyimgs_as_spent(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent) const
+{
+	GULPS_LOG_L3("Blockchain::", __func__);
+	// Same as above, no lock, but the whole batch is read from one db snapshot
+	m_db->has_key_images(key_images, spent);
+}
+//------------------------------------------------------------------
 // This function makes sure that each "input" in an input (mixins) exists
 // and collects the public key for each from the transaction it was included in
 // via the visitor passed to it.
@@ -604,6 +615,7 @@ block Blockchain::pop_block_from_blockchain()
 	try
 	{
 		m_db->pop_block(popped_block, popped_txs);
+		invalidate_indexed_blocks_cache(m_db->height());
 	}
 	// anything that could cause this to throw is likely catastrophic,
 	// so we re-throw
@@ -646,6 +658,9 @@ block Blockchain::pop_block_from_blockchain()
 	update_next_cumulative_size_limit();
 	m_tx_pool.on_blockchain_dec(m_db->height() - 1, get_tail_id());
 
+	if(i_core_events *events = m_core_events)
+		events->on_block_removed(m_db->height(), get_block_hash(popped_block), popped_block.tx_hashes);
+
 	return popped_block;
 }
 //------------------------------------------------------------------
@@ -655,6 +670,7 @@ bool Blockchain::reset_and_set_genesis_block(const block &b)
 	CRITICAL_REGION_LOCAL(m_blockchain_lock);
 	m_timestamps_and_difficulties_height = 0;
 	m_alternative_chains.clear();
+	invalidate_indexed_blocks_cache(0);
 	m_db->reset();
 	m_hardfork->init();
 
@@ -667,7 +683,7 @@ bool Blockchain::reset_and_set_genesis_block(const block &b)
 crypto::hash Blockchain::get_tail_id(uint64_t &height) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
+	db_rtxn_guard rtxn_guard(m_db);
 	height = m_db->height() - 1;
 	return get_tail_id();
 }
@@ -767,19 +783,20 @@ crypto::hash Blockchain::get_block_id_by_height(uint64_t height) const
 bool Blockchain::get_block_by_hash(const crypto::hash &h, block &blk, bool *orphan) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-	// try to find block in main chain
+	// try to find block in main chain, this only needs a db snapshot
 	try
 	{
+		db_rtxn_guard rtxn_guard(m_db);
 		blk = m_db->get_block(h);
 		if(orphan)
 			*orphan = false;
 		return true;
 	}
-	// try to find block in alternative chain
+	// try to find block in alternative chain, which lives in memory and needs the lock
 	catch(const BLOCK_DNE &e)
 	{
+		CRITICAL_REGION_LOCAL(m_blockchain_lock);
 		blocks_ext_by_hash::const_iterator it_alt = m_alternative_chains.find(h);
 		if(m_alternative_chains.end() != it_alt)
 		{
@@ -2227,7 +2244,7 @@ template <class t_ids_container, class t_blocks_container, class t_missed_contai
 bool Blockchain::get_blocks(const t_ids_container &block_ids, t_blocks_container &blocks, t_missed_container &missed_bs) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
+	db_rtxn_guard rtxn_guard(m_db);
 
 	for(const auto &block_hash : block_ids)
 	{
@@ -2258,23 +2275,27 @@ template <class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_transactions_blobs(const t_ids_container &txs_ids, t_tx_container &txs, t_missed_container &missed_txs) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
+	// Only reads the db, so we don't have to wait for a block being added. The blobs
+	// are looked up in db order in a single db transaction.
 
-	for(const auto &tx_hash : txs_ids)
+	try
 	{
-		try
+		const std::vector<crypto::hash> ids(txs_ids.begin(), txs_ids.end());
+		std::vector<cryptonote::blobdata> blobs;
+		std::vector<uint64_t> heights;
+		m_db->get_tx_blobs(ids, blobs, heights);
+		for(size_t i = 0; i < ids.size(); ++i)
 		{
-			cryptonote::blobdata tx;
-			if(m_db->get_tx_blob(tx_hash, tx))
-				txs.push_back(std::move(tx));
+			if(heights[i] != std::numeric_limits<uint64_t>::max())
+				txs.push_back(std::move(blobs[i]));
 			else
-				missed_txs.push_back(tx_hash);
-		}
-		catch(const std::exception &e)
-		{
-			return false;
+				missed_txs.push_back(ids[i]);
 		}
 	}
+	catch(const std::exception &e)
+	{
+		return false;
+	}
 	return true;
 }
 
@@ -2286,27 +2307,16 @@ template <class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_transactions(const t_ids_container &txs_ids, t_tx_container &txs, t_missed_container &missed_txs) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-	for(const auto &tx_hash : txs_ids)
+	std::list<cryptonote::blobdata> blobs;
+	if(!get_transactions_blobs(txs_ids, blobs, missed_txs))
+		return false;
+	for(const cryptonote::blobdata &blob : blobs)
 	{
-		try
-		{
-			cryptonote::blobdata tx;
-			if(m_db->get_tx_blob(tx_hash, tx))
-			{
-				txs.push_back(transaction());
-				if(!parse_and_validate_tx_from_blob(tx, txs.back()))
-				{
-					GULPS_LOG_ERROR("Invalid transaction");
-					return false;
-				}
-			}
-			else
-				missed_txs.push_back(tx_hash);
-		}
-		catch(const std::exception &e)
+		txs.push_back(transaction());
+		if(!parse_and_validate_tx_from_blob(blob, txs.back()))
 		{
+			GULPS_LOG_ERROR("Invalid transaction");
 			return false;
 		}
 	}
@@ -2429,6 +2439,51 @@ bool Blockchain::find_blockchain_supplement_indexed(const uint64_t req_start_blo
 	blocks.reserve(end_height - start_height);
 	out_idx.reserve(end_height - start_height);
 
+	for(size_t i = start_height; i < end_height; count++)
+	{
+		if(size >= FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE && count >= 3)
+			break;
+
+		// whole chunks deep enough not to be reorged are shared between requests
+		if(i % INDEXED_BLOCKS_CHUNK_SIZE == 0 && i + INDEXED_BLOCKS_CHUNK_SIZE <= end_height &&
+		   i + INDEXED_BLOCKS_CHUNK_SIZE + INDEXED_BLOCKS_CACHE_SAFE_DEPTH <= total_height)
+		{
+			const indexed_blocks_chunk *chunk = get_indexed_blocks_chunk(i);
+			if(chunk == nullptr)
+			{
+				m_db->block_txn_stop();
+				return false;
+			}
+			blocks.insert(blocks.end(), chunk->blocks.begin(), chunk->blocks.end());
+			out_idx.insert(out_idx.end(), chunk->out_idx.begin(), chunk->out_idx.end());
+			size += chunk->size;
+			i += INDEXED_BLOCKS_CHUNK_SIZE;
+			continue;
+		}
+
+		// don't let a batch run over the start of the next chunk
+		size_t batch_size = std::min<size_t>(tools::get_max_concurrency(), end_height - i);
+		batch_size = std::min<size_t>(batch_size, INDEXED_BLOCKS_CHUNK_SIZE - i % INDEXED_BLOCKS_CHUNK_SIZE);
+		if(!load_blocks_indexed(i, batch_size, blocks, out_idx, size))
+		{
+			m_db->block_txn_stop();
+			return false;
+		}
+		i += batch_size;
+	}
+
+	m_db->block_txn_stop();
+	return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::load_blocks_indexed(uint64_t start_height, size_t count, std::vector<block_complete_entry_v> &blocks,
+									 std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &out_idx, size_t &size) const
+{
+	const size_t end_height = start_height + count;
+	// pointers into blocks and out_idx are kept while filling them in
+	blocks.reserve(blocks.size() + count);
+	out_idx.reserve(out_idx.size() + count);
+
 	std::vector<block_complete_entry_v*> ent;
 	std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices*> idx;
 	std::vector<std::pair<block, bool>> b;
@@ -2450,13 +2505,9 @@ bool Blockchain::find_blockchain_supplement_indexed(const uint64_t req_start_blo
 	tools::threadpool &tpool = tools::threadpool::getInstance();
 	tools::threadpool::waiter waiter;
 
-	for(size_t i = start_height; i < end_height; count++)
+	for(size_t i = start_height; i < end_height;)
 	{
-		if(size >= FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE && count >= 3)
-			break;
-
 		size_t batch_size = std::min<size_t>(max_conc, end_height - i);
-
 		for(size_t bi = 0; bi < batch_size; bi++)
 		{
 			blocks.emplace_back();
@@ -2529,10 +2580,27 @@ bool Blockchain::find_blockchain_supplement_indexed(const uint64_t req_start_blo
 		i += batch_size;
 	}
 
-	m_db->block_txn_stop();
 	return true;
 }
 //------------------------------------------------------------------
+const indexed_blocks_chunk *Blockchain::get_indexed_blocks_chunk(uint64_t start_height) const
+{
+	const indexed_blocks_chunk *cached = m_indexed_blocks_cache.find(start_height);
+	if(cached != nullptr)
+		return cached;
+
+	indexed_blocks_chunk chunk;
+	if(!load_blocks_indexed(start_height, INDEXED_BLOCKS_CHUNK_SIZE, chunk.blocks, chunk.out_idx, chunk.size))
+		return nullptr;
+	return m_indexed_blocks_cache.insert(start_height, std::move(chunk));
+}
+//------------------------------------------------------------------
+void Blockchain::invalidate_indexed_blocks_cache(uint64_t height)
+{
+	CRITICAL_REGION_LOCAL(m_blockchain_lock);
+	m_indexed_blocks_cache.invalidate(height);
+}
+//------------------------------------------------------------------
 bool Blockchain::add_block_as_invalid(const block &bl, const crypto::hash &h)
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
@@ -2662,7 +2730,7 @@ bool Blockchain::check_for_double_spend(const transaction &tx, key_images_contai
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash &tx_id, std::vector<uint64_t> &indexs) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
+	db_rtxn_guard rtxn_guard(m_db);
 	uint64_t tx_index;
 	if(!m_db->tx_exists(tx_id, tx_index))
 	{
@@ -3859,6 +3927,9 @@ bool Blockchain::handle_block_to_main_chain(const block &bl, const crypto::hash
 	// appears to be a NOP *and* is called elsewhere.  wat?
 	m_tx_pool.on_blockchain_inc(new_height, id);
 
+	if(i_core_events *events = m_core_events)
+		events->on_block_added(new_height - 1, id, bl.tx_hashes);
+
 	return true;
 }
 //------------------------------------------------------------------
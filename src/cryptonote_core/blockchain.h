@@ -62,6 +62,7 @@
 
 #include "blockchain_db/blockchain_db.h"
 #include "checkpoints/checkpoints.h"
+#include "core_events.h"
 #include "common/util.h"
 #include "crypto/hash.h"
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -70,6 +71,7 @@
 #include "cryptonote_basic/verification_context.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "cryptonote_tx_utils.h"
+#include "indexed_blocks_cache.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "string_tools.h"
 #include "syncobj.h"
@@ -217,6 +219,9 @@ class Blockchain
 	/**
      * @brief gets the block with a given hash
      *
+     * Main chain blocks are read from a db snapshot without taking the
+     * blockchain lock, the lock is only taken to search alternative chains.
+     *
      * @param h the hash to look for
      * @param blk return-by-reference variable to put result block in
      * @param orphan if non-NULL, will be set to true if not in the main chain, false otherwise
@@ -275,6 +280,17 @@ class Blockchain
      */
 	bool have_tx_keyimg_as_spent(const crypto::key_image &key_im) const;
 
+	/**
+     * @brief check if several key images are already spent on the blockchain
+     *
+     * The key images are looked up in db order in a single db transaction,
+     * which is much cheaper than one have_tx_keyimg_as_spent call each.
+     *
+     * @param key_images the key images to search for
+     * @param spent return-by-reference whether each key image is spent, in request order
+     */
+	void have_tx_keyimgs_as_spent(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent) const;
+
 	/**
      * @brief get the current height of the blockchain
      *
@@ -440,6 +456,15 @@ class Blockchain
      */
 	bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash> &qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata>>> &blocks, uint64_t &total_height, uint64_t &start_height, size_t max_count) const;
 
+	/**
+     * @brief get recent pruned blocks with the global output indices of their transactions
+     *
+     * Same as find_blockchain_supplement above, but the transactions are pruned and returned
+     * with their output indices, as needed by the getblocks.bin RPC. Blocks deep enough in the
+     * chain are served from a cache of height aligned chunks shared between callers.
+     *
+     * @return true if a block found in common or req_start_block specified, else false
+     */
 	bool find_blockchain_supplement_indexed(const uint64_t req_start_block, const std::list<crypto::hash> &qblock_ids, std::vector<block_complete_entry_v>& blocks,
 			std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>& out_idx, uint64_t &total_height, uint64_t &start_height, size_t max_count) const;
 
@@ -680,6 +705,8 @@ class Blockchain
 	/**
      * @brief gets transactions based on a list of transaction hashes
      *
+     * These are served from a db snapshot and do not take the blockchain lock.
+     *
      * @tparam t_ids_container a standard-iterable container
      * @tparam t_tx_container a standard-iterable container
      * @tparam t_missed_container a standard-iterable container
@@ -751,6 +778,20 @@ class Blockchain
      */
 	void set_show_time_stats(bool stats) { m_show_time_stats = stats; }
 
+	/**
+     * @brief sets the receiver of block and txpool events
+     *
+     * @param events the receiver, or NULL to stop sending events
+     */
+	void set_core_events(i_core_events *events) { m_core_events = events; }
+
+	/**
+     * @brief gets the receiver of block and txpool events
+     *
+     * @return the receiver, or NULL if none is set
+     */
+	i_core_events *get_core_events() const { return m_core_events; }
+
 	/**
      * @brief gets the hardfork voting state object
      *
@@ -895,6 +936,16 @@ class Blockchain
      */
 	bool for_all_outputs(uint64_t amount, std::function<bool(uint64_t height)>) const;
 
+	/**
+     * @brief how long callers waited to take the blockchain lock
+     *
+     * @return a histogram of lock() wait times, in microseconds
+     */
+	const epee::latency_histogram &get_lock_wait_histogram() const
+	{
+		return m_blockchain_lock.wait_histogram();
+	}
+
 	/**
      * @brief get a reference to the BlockchainDB in use by Blockchain
      *
@@ -989,7 +1040,7 @@ class Blockchain
 
 	tx_memory_pool &m_tx_pool;
 
-	mutable epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
+	mutable epee::timed_critical_section m_blockchain_lock; // TODO: add here reader/writer lock
 
 	// main chain
 	transactions_container m_transactions;
@@ -1026,6 +1077,11 @@ class Blockchain
 	boost::thread_group m_async_pool;
 	std::unique_ptr<boost::asio::io_service::work> m_async_work_idle;
 
+	// pruned blocks and output indices for getblocks.bin, in height aligned chunks
+	mutable indexed_blocks_cache m_indexed_blocks_cache;
+
+	std::atomic<i_core_events *> m_core_events;
+
 	// all alternative chains
 	blocks_ext_by_hash m_alternative_chains; // crypto::hash -> block_extended_info
 
@@ -1045,6 +1101,32 @@ class Blockchain
 
 	std::atomic<bool> m_cancel;
 
+	/**
+     * @brief appends count pruned blocks starting at start_height, with their output indices
+     *
+     * The caller must hold m_blockchain_lock and a read txn.
+     *
+     * @param size incremented by the size of the block and transaction blobs appended
+     *
+     * @return false if a block or one of its transactions could not be loaded
+     */
+	bool load_blocks_indexed(uint64_t start_height, size_t count, std::vector<block_complete_entry_v> &blocks,
+			std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &out_idx, size_t &size) const;
+
+	/**
+     * @brief returns the cached chunk starting at start_height, loading and caching it if needed
+     *
+     * The caller must hold m_blockchain_lock and a read txn.
+     *
+     * @return the chunk, or nullptr if it could not be loaded
+     */
+	const indexed_blocks_chunk *get_indexed_blocks_chunk(uint64_t start_height) const;
+
+	/**
+     * @brief drops cached getblocks.bin chunks reaching at or above the given height
+     */
+	void invalidate_indexed_blocks_cache(uint64_t height);
+
 	/**
      * @brief collects the keys for all outputs being "spent" as an input
      *
@@ -839,11 +839,7 @@ bool core::is_key_image_spent(const crypto::key_image &key_image) const
 //-----------------------------------------------------------------------------------------------
 bool core::are_key_images_spent(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent) const
 {
-	spent.clear();
-	for(auto &ki : key_im)
-	{
-		spent.push_back(m_blockchain_storage.have_tx_keyimg_as_spent(ki));
-	}
+	m_blockchain_storage.have_tx_keyimgs_as_spent(key_im, spent);
 	return true;
 }
 //-----------------------------------------------------------------------------------------------
@@ -857,11 +853,11 @@ size_t core::get_block_sync_size(uint64_t height) const
 	return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
 }
 //-----------------------------------------------------------------------------------------------
-bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent) const
+bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent, bool include_unrelayed_txes) const
 {
 	spent.clear();
 
-	return m_mempool.check_for_key_images(key_im, spent);
+	return m_mempool.check_for_key_images(key_im, spent, include_unrelayed_txes);
 }
 //-----------------------------------------------------------------------------------------------
 std::pair<uint64_t, uint64_t> core::get_coinbase_tx_sum(const uint64_t start_offset, const size_t count)
@@ -739,10 +739,11 @@ class core : public i_miner_handler
       *
       * @param key_im list of key images to check
       * @param spent return-by-reference result for each image checked
+      * @param include_unrelayed_txes whether to count key images spent only by txes not relayed yet
       *
       * @return true
       */
-	bool are_key_images_spent_in_pool(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent) const;
+	bool are_key_images_spent_in_pool(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent, bool include_unrelayed_txes = true) const;
 
 	/**
       * @brief get the number of blocks to sync in one go
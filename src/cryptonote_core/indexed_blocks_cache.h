@@ -0,0 +1,141 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace cryptonote
+{
+/**
+ * @brief pruned blocks with the output indices of their transactions, as served by getblocks.bin
+ */
+struct indexed_blocks_chunk
+{
+	std::vector<block_complete_entry_v> blocks;
+	std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> out_idx;
+	size_t size = 0;
+};
+
+/**
+ * @brief memory bounded LRU cache of height aligned indexed_blocks_chunk, keyed by start height
+ *
+ * Not thread safe, Blockchain uses it under m_blockchain_lock.
+ */
+class indexed_blocks_cache
+{
+  public:
+	indexed_blocks_cache(uint64_t chunk_blocks, size_t max_size) : m_chunk_blocks(chunk_blocks), m_max_size(max_size), m_size(0) {}
+
+	/**
+	 * @brief returns the chunk starting at start_height and marks it as the most recently used
+	 *
+	 * @return the chunk, or nullptr if it is not cached
+	 */
+	const indexed_blocks_chunk *find(uint64_t start_height)
+	{
+		auto it = m_chunks.find(start_height);
+		if(it == m_chunks.end())
+			return nullptr;
+		m_lru.splice(m_lru.begin(), m_lru, it->second.lru_it);
+		return &it->second.chunk;
+	}
+
+	/**
+	 * @brief caches the chunk starting at start_height, evicting the least recently used ones to stay within the budget
+	 *
+	 * @return the cached chunk
+	 */
+	const indexed_blocks_chunk *insert(uint64_t start_height, indexed_blocks_chunk &&chunk)
+	{
+		erase(m_chunks.find(start_height));
+		while(!m_lru.empty() && m_size + chunk.size > m_max_size)
+			erase(m_chunks.find(m_lru.back()));
+
+		m_lru.push_front(start_height);
+		entry &e = m_chunks[start_height];
+		e.chunk = std::move(chunk);
+		e.lru_it = m_lru.begin();
+		m_size += e.chunk.size;
+		return &e.chunk;
+	}
+
+	/**
+	 * @brief drops every chunk whose range reaches height or above, when the chain is popped back to it
+	 */
+	void invalidate(uint64_t height)
+	{
+		auto it = m_chunks.lower_bound(height < m_chunk_blocks ? 0 : height - m_chunk_blocks + 1);
+		while(it != m_chunks.end())
+			it = erase(it);
+	}
+
+	size_t size() const { return m_size; }
+	size_t count() const { return m_chunks.size(); }
+
+  private:
+	struct entry
+	{
+		indexed_blocks_chunk chunk;
+		std::list<uint64_t>::iterator lru_it;
+	};
+
+	std::map<uint64_t, entry>::iterator erase(std::map<uint64_t, entry>::iterator it)
+	{
+		if(it == m_chunks.end())
+			return it;
+		m_size -= it->second.chunk.size;
+		m_lru.erase(it->second.lru_it);
+		return m_chunks.erase(it);
+	}
+
+	const uint64_t m_chunk_blocks;
+	const size_t m_max_size;
+	size_t m_size;
+	std::map<uint64_t, entry> m_chunks;
+	std::list<uint64_t> m_lru; // start heights, most recently used first
+};
+}
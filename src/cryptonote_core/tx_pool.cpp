@@ -254,6 +254,8 @@ bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_has
 			}
 			tvc.m_verifivation_impossible = true;
 			tvc.m_added_to_pool = true;
+			if(i_core_events *events = m_blockchain.get_core_events())
+				events->on_txpool_tx_added(id);
 		}
 		else
 		{
@@ -296,6 +298,8 @@ bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_has
 			return false;
 		}
 		tvc.m_added_to_pool = true;
+		if(i_core_events *events = m_blockchain.get_core_events())
+			events->on_txpool_tx_added(id);
 
 		if(meta.fee > 0 && !do_not_relay)
 			tvc.m_should_be_relayed = true;
@@ -371,6 +375,8 @@ void tx_memory_pool::prune(size_t bytes)
 			// remove first, in case this throws, so key images aren't removed
 			GULPSF_INFO("Pruning tx {} from txpool: size: {}, fee/byte: {}", txid , it->first.second , it->first.first);
 			m_blockchain.remove_txpool_tx(txid);
+			if(i_core_events *events = m_blockchain.get_core_events())
+				events->on_txpool_tx_removed(txid);
 			m_txpool_size -= txblob.size();
 			remove_transaction_keyimages(tx);
 			GULPSF_INFO("Pruned tx {} from txpool: size: {}, fee/byte: {}", txid , it->first.second , it->first.first);
@@ -388,6 +394,7 @@ void tx_memory_pool::prune(size_t bytes)
 //---------------------------------------------------------------------------------
 bool tx_memory_pool::insert_key_images(const transaction &tx, bool kept_by_block)
 {
+	boost::unique_lock<boost::shared_mutex> ki_lock(m_spent_key_images_lock);
 	for(const auto &in : tx.vin)
 	{
 		const crypto::hash id = get_transaction_hash(tx);
@@ -408,6 +415,7 @@ bool tx_memory_pool::remove_transaction_keyimages(const transaction &tx)
 {
 	CRITICAL_REGION_LOCAL(m_transactions_lock);
 	CRITICAL_REGION_LOCAL1(m_blockchain);
+	boost::unique_lock<boost::shared_mutex> ki_lock(m_spent_key_images_lock);
 	// ND: Speedup
 	// 1. Move transaction hash calcuation outside of loop. ._.
 	crypto::hash actual_hash = get_transaction_hash(tx);
@@ -466,6 +474,8 @@ bool tx_memory_pool::take_tx(const crypto::hash &id, transaction &tx, size_t &bl
 
 		// remove first, in case this throws, so key images aren't removed
 		m_blockchain.remove_txpool_tx(id);
+		if(i_core_events *events = m_blockchain.get_core_events())
+			events->on_txpool_tx_removed(id);
 		m_txpool_size -= blob_size;
 		remove_transaction_keyimages(tx);
 	}
@@ -538,6 +548,8 @@ bool tx_memory_pool::remove_stuck_transactions()
 				{
 					// remove first, so we only remove key images if the tx removal succeeds
 					m_blockchain.remove_txpool_tx(txid);
+					if(i_core_events *events = m_blockchain.get_core_events())
+						events->on_txpool_tx_removed(txid);
 					m_txpool_size -= bd.size();
 					remove_transaction_keyimages(tx);
 				}
@@ -860,16 +872,32 @@ bool tx_memory_pool::get_pool_for_rpc(std::vector<cryptonote::rpc::tx_in_pool> &
 	return true;
 }
 //---------------------------------------------------------------------------------
-bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image> &key_images, std::vector<bool> spent) const
+bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent, bool include_unrelayed_txes) const
 {
-	CRITICAL_REGION_LOCAL(m_transactions_lock);
-	CRITICAL_REGION_LOCAL1(m_blockchain);
+	boost::shared_lock<boost::shared_mutex> ki_lock(m_spent_key_images_lock);
+	db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
 
 	spent.clear();
 
+	txpool_tx_meta_t meta;
 	for(const auto &image : key_images)
 	{
-		spent.push_back(m_spent_key_images.find(image) == m_spent_key_images.end() ? false : true);
+		const key_images_container::const_iterator it = m_spent_key_images.find(image);
+		bool is_spent = it != m_spent_key_images.end();
+		if(is_spent && !include_unrelayed_txes)
+		{
+			// Only count it if at least one of the spending txes was relayed
+			is_spent = false;
+			for(const crypto::hash &txid : it->second)
+			{
+				if(m_blockchain.get_txpool_tx_meta(txid, meta) && meta.relayed)
+				{
+					is_spent = true;
+					break;
+				}
+			}
+		}
+		spent.push_back(is_spent);
 	}
 
 	return true;
@@ -1223,6 +1251,8 @@ size_t tx_memory_pool::validate()
 				}
 				// remove tx from db first
 				m_blockchain.remove_txpool_tx(txid);
+				if(i_core_events *events = m_blockchain.get_core_events())
+					events->on_txpool_tx_removed(txid);
 				m_txpool_size -= txblob.size();
 				remove_transaction_keyimages(tx);
 				auto sorted_it = find_tx_in_sorted_container(txid);
@@ -1253,7 +1283,10 @@ bool tx_memory_pool::init(size_t max_txpool_size)
 
 	m_txpool_max_size = max_txpool_size ? max_txpool_size : DEFAULT_TXPOOL_MAX_SIZE;
 	m_txs_by_fee_and_receive_time.clear();
-	m_spent_key_images.clear();
+	{
+		boost::unique_lock<boost::shared_mutex> ki_lock(m_spent_key_images_lock);
+		m_spent_key_images.clear();
+	}
 	m_txpool_size = 0;
 	std::vector<crypto::hash> remove;
 
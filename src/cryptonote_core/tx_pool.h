@@ -48,6 +48,7 @@
 #include "include_base_utils.h"
 
 #include <boost/serialization/version.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/utility.hpp>
 #include <queue>
 #include <set>
@@ -315,12 +316,16 @@ class tx_memory_pool : boost::noncopyable
 	/**
      * @brief check for presence of key images in the pool
      *
+     * This does not take the pool lock, so it does not have to wait while
+     * a block is being added to the chain.
+     *
      * @param key_images [in] vector of key images to check
      * @param spent [out] vector of bool to return
+     * @param include_unrelayed_txes [in] whether key images spent only by txes not relayed yet count
      *
      * @return true
      */
-	bool check_for_key_images(const std::vector<crypto::key_image> &key_images, std::vector<bool> spent) const;
+	bool check_for_key_images(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent, bool include_unrelayed_txes = true) const;
 
 	/**
      * @brief get a specific transaction from the pool
@@ -557,6 +562,8 @@ class tx_memory_pool : boost::noncopyable
 
 	//! container for spent key images from the transactions in the pool
 	key_images_container m_spent_key_images;
+	//! guards m_spent_key_images for readers not holding m_transactions_lock, writers hold both
+	mutable boost::shared_mutex m_spent_key_images_lock;
 
 	//TODO: this time should be a named constant somewhere, not hard-coded
 	//! interval on which to check for stale/"stuck" transactions
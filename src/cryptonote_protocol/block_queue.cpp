@@ -47,6 +47,7 @@
 #include "block_queue.h"
 #include "cryptonote_protocol_defs.h"
 #include "string_tools.h"
+#include <algorithm>
 #include <boost/uuid/nil_generator.hpp>
 #include <unordered_map>
 #include <vector>
@@ -76,9 +77,26 @@ void block_queue::add_blocks(uint64_t height, std::list<cryptonote::block_comple
 	boost::unique_lock<boost::recursive_mutex> lock(mutex);
 	std::list<crypto::hash> hashes;
 	bool has_hashes = remove_span(height, &hashes);
+	const uint64_t nblocks = bcel.size();
 	blocks.insert(span(height, std::move(bcel), connection_id, rate, size));
 	if(has_hashes)
 		set_span_hashes(height, connection_id, hashes);
+
+	if(nblocks == 0 || rate <= 0.0f)
+		return;
+	// same pseudo average as get_speed used to compute on the fly, but it survives
+	// the spans being popped off the queue, so we keep knowing how fast a peer is
+	const float block_size = size / (float)nblocks;
+	std::map<boost::uuids::uuid, peer_stats>::iterator i = peers.find(connection_id);
+	if(i == peers.end())
+	{
+		peers.insert(std::make_pair(connection_id, peer_stats{rate, block_size}));
+	}
+	else
+	{
+		i->second.rate = (i->second.rate + rate) / 2;
+		i->second.block_size = (i->second.block_size + block_size) / 2;
+	}
 }
 
 void block_queue::add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time)
@@ -391,27 +409,13 @@ bool block_queue::has_spans(const boost::uuids::uuid &connection_id) const
 float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
 {
 	boost::unique_lock<boost::recursive_mutex> lock(mutex);
-	std::unordered_map<boost::uuids::uuid, float> speeds;
-	for(const auto &span : blocks)
-	{
-		if(span.blocks.empty())
-			continue;
-		// note that the average below does not average over the whole set, but over the
-		// previous pseudo average and the latest rate: this gives much more importance
-		// to the latest measurements, which is fine here
-		std::unordered_map<boost::uuids::uuid, float>::iterator i = speeds.find(span.connection_id);
-		if(i == speeds.end())
-			speeds.insert(std::make_pair(span.connection_id, span.rate));
-		else
-			i->second = (i->second + span.rate) / 2;
-	}
 	float conn_rate = -1, best_rate = 0;
-	for(const auto &i : speeds)
+	for(const auto &i : peers)
 	{
 		if(i.first == connection_id)
-			conn_rate = i.second;
-		if(i.second > best_rate)
-			best_rate = i.second;
+			conn_rate = i.second.rate;
+		if(i.second.rate > best_rate)
+			best_rate = i.second.rate;
 	}
 
 	if(conn_rate <= 0)
@@ -424,6 +428,66 @@ float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
 	return speed;
 }
 
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t max_blocks, float target_seconds, size_t max_bytes) const
+{
+	boost::unique_lock<boost::recursive_mutex> lock(mutex);
+	std::map<boost::uuids::uuid, peer_stats>::const_iterator i = peers.find(connection_id);
+	if(i == peers.end() || i->second.rate <= 0.0f || i->second.block_size <= 0.0f)
+		return std::min(default_blocks, max_blocks); // unmeasured, start with the default
+
+	// as many blocks as this peer should deliver in the target time, but no span
+	// may take more than max_bytes of the queue's memory once filled
+	uint64_t nblocks = i->second.rate * target_seconds / i->second.block_size;
+	nblocks = std::min<uint64_t>(nblocks, max_bytes / i->second.block_size);
+	nblocks = std::max<uint64_t>(nblocks, 1);
+	nblocks = std::min(nblocks, max_blocks);
+	GULPSF_LOG_L2(" Span size for {}: {} ({} B/s, {} B/block)", boost::uuids::to_string(connection_id), nblocks, i->second.rate, i->second.block_size);
+	return nblocks;
+}
+
+float block_queue::get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const
+{
+	boost::unique_lock<boost::recursive_mutex> lock(mutex);
+	std::map<boost::uuids::uuid, peer_stats>::const_iterator i = peers.find(connection_id);
+	if(i == peers.end() || i->second.rate <= 0.0f)
+		return -1.0f;
+	return nblocks * i->second.block_size / i->second.rate;
+}
+
+size_t block_queue::get_scheduled_size(size_t default_block_size) const
+{
+	boost::unique_lock<boost::recursive_mutex> lock(mutex);
+	// until a peer has delivered a span there is nothing to average, but the
+	// reservations still count, at the caller's conservative block size
+	float avg_block_size = default_block_size;
+	if(!peers.empty())
+	{
+		avg_block_size = 0.0f;
+		for(const auto &i : peers)
+			avg_block_size += i.second.block_size;
+		avg_block_size /= peers.size();
+	}
+
+	float size = 0.0f;
+	block_map::const_iterator i = blocks.begin();
+	if(i != blocks.end() && is_blockchain_placeholder(*i))
+		++i;
+	for(; i != blocks.end(); ++i)
+	{
+		if(!i->blocks.empty())
+			continue;
+		std::map<boost::uuids::uuid, peer_stats>::const_iterator p = peers.find(i->connection_id);
+		size += i->nblocks * (p == peers.end() ? avg_block_size : p->second.block_size);
+	}
+	return size;
+}
+
+void block_queue::forget_peer(const boost::uuids::uuid &connection_id)
+{
+	boost::unique_lock<boost::recursive_mutex> lock(mutex);
+	peers.erase(connection_id);
+}
+
 bool block_queue::foreach(std::function<bool(const span &)> f, bool include_blockchain_placeholder) const
 {
 	boost::unique_lock<boost::recursive_mutex> lock(mutex);
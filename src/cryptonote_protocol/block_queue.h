@@ -49,6 +49,7 @@
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <list>
+#include <map>
 #include <set>
 #include <string>
 #include "crypto/hash.h"
@@ -80,6 +81,12 @@ class block_queue
 	};
 	typedef std::set<span> block_map;
 
+	struct peer_stats
+	{
+		float rate;		  // bytes per second, weighted towards the latest spans
+		float block_size; // average block size in bytes, weighted likewise
+	};
+
   public:
 	void add_blocks(uint64_t height, std::list<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
 	void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time = boost::date_time::min_date_time);
@@ -103,11 +110,16 @@ class block_queue
 	crypto::hash get_last_known_hash(const boost::uuids::uuid &connection_id) const;
 	bool has_spans(const boost::uuids::uuid &connection_id) const;
 	float get_speed(const boost::uuids::uuid &connection_id) const;
+	uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t max_blocks, float target_seconds, size_t max_bytes) const;
+	float get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const;
+	size_t get_scheduled_size(size_t default_block_size) const;
+	void forget_peer(const boost::uuids::uuid &connection_id);
 	bool foreach(std::function<bool(const span &)> f, bool include_blockchain_placeholder = false) const;
 	bool requested(const crypto::hash &hash) const;
 
   private:
 	block_map blocks;
+	std::map<boost::uuids::uuid, peer_stats> peers;
 	mutable boost::recursive_mutex mutex;
 };
 }
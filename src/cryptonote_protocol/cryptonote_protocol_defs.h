@@ -123,7 +123,7 @@ struct connection_info
 /************************************************************************/
 struct block_complete_entry
 {
-	block_complete_entry(blobdata block, std::list<blobdata> txs) : block(block), txs(txs)  {}
+	block_complete_entry(blobdata block, std::list<blobdata> txs) : block(std::move(block)), txs(std::move(txs))  {}
 
 	blobdata block;
 	std::list<blobdata> txs;
@@ -136,7 +136,7 @@ struct block_complete_entry
 // As far as epee is concerned, those two are interchangeable
 struct block_complete_entry_v
 {
-	block_complete_entry_v(blobdata block, std::vector<blobdata> txs) : block(block), txs(txs)  {}
+	block_complete_entry_v(blobdata block, std::vector<blobdata> txs) : block(std::move(block)), txs(std::move(txs))  {}
 
 	blobdata block;
 	std::vector<blobdata> txs;
@@ -54,6 +54,7 @@
 #include <string>
 
 #include "block_queue.h"
+#include "common/bloom_filter.hpp"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_basic/cryptonote_stat_info.h"
 #include "cryptonote_protocol_defs.h"
@@ -145,6 +146,7 @@ class t_cryptonote_protocol_handler : public i_cryptonote_protocol, cryptonote_p
 	//----------------- i_bc_protocol_layout ---------------------------------------
 	virtual bool relay_block(NOTIFY_NEW_BLOCK::request &arg, cryptonote_connection_context &exclude_context);
 	virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request &arg, cryptonote_connection_context &exclude_context);
+	virtual tx_relay_stats get_tx_relay_stats() const;
 	//----------------------------------------------------------------------------------
 	//bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
 	bool request_missing_objects(cryptonote_connection_context &context, bool check_having_blocks, bool force_next_span = false);
@@ -154,6 +156,8 @@ class t_cryptonote_protocol_handler : public i_cryptonote_protocol, cryptonote_p
 	void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
 	bool kick_idle_peers();
 	int try_add_next_blocks(cryptonote_connection_context &context);
+	bool flush_tx_relay_queue();
+	bool peer_knows_tx(const boost::uuids::uuid &connection_id, const crypto::hash &blob_hash);
 
 	t_core &m_core;
 
@@ -166,6 +170,26 @@ class t_cryptonote_protocol_handler : public i_cryptonote_protocol, cryptonote_p
 	block_queue m_block_queue;
 	epee::math_helper::once_a_time_seconds<30> m_idle_peer_kicker;
 
+	struct relay_tx_entry
+	{
+		crypto::hash blob_hash;
+		blobdata blob;
+		boost::uuids::uuid source;
+	};
+
+	// txs waiting for the next trickle and the txs each peer is known to have, both under m_tx_relay_lock
+	boost::mutex m_tx_relay_lock;
+	std::vector<relay_tx_entry> m_tx_relay_queue;
+	std::map<boost::uuids::uuid, rolling_bloom_filter> m_peer_known_txs;
+	rolling_bloom_filter m_received_txs;
+
+	std::atomic<uint64_t> m_txs_received;
+	std::atomic<uint64_t> m_duplicate_txs_received;
+	std::atomic<uint64_t> m_duplicate_bytes_received;
+	std::atomic<uint64_t> m_txs_relayed;
+	std::atomic<uint64_t> m_bytes_relayed;
+	std::atomic<uint64_t> m_bytes_saved;
+
 	boost::mutex m_buffer_mutex;
 	double get_avg_block_size();
 	boost::circular_buffer<size_t> m_avg_buffer = boost::circular_buffer<size_t>(10);
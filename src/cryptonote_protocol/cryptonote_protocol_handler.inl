@@ -71,9 +71,18 @@
 
 #define BLOCK_QUEUE_NBLOCKS_THRESHOLD 10					// chunks of N blocks
 #define BLOCK_QUEUE_SIZE_THRESHOLD (100 * 1024 * 1024)		// MB
+#define BLOCK_QUEUE_MAX_SIZE (128 * 1024 * 1024)			// MB, queued and in flight spans, hard limit
+#define BLOCK_QUEUE_MAX_SPAN_SIZE (BLOCK_QUEUE_MAX_SIZE / 16) // MB, largest span we ask a single peer for
+#define BLOCK_QUEUE_MAX_SPAN_FACTOR 10						// adaptive spans grow up to N times the sync size
+#define BLOCK_QUEUE_SPAN_TARGET_TIME 2.0f					// seconds a span should take to download
+#define BLOCK_QUEUE_DEFAULT_BLOCK_SIZE common_config::CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE // bytes, per in flight block before any peer is measured
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD (5 * 1000000) // microseconds
+#define REQUEST_NEXT_SCHEDULED_SPAN_MIN_THRESHOLD (1 * 1000000) // microseconds
+#define STRAGGLING_SPAN_FACTOR 3							// a span is straggling after N times its expected time
 #define IDLE_PEER_KICK_TIME (600 * 1000000)					// microseconds
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000)				// microseconds
+#define PEER_KNOWN_TXS_FILTER_SIZE 4000						// txs remembered per peer (per filter generation)
+#define RECEIVED_TXS_FILTER_SIZE 4000						// txs remembered for duplicate accounting (per filter generation)
 
 namespace cryptonote
 {
@@ -84,11 +93,18 @@ t_cryptonote_protocol_handler<t_core>::t_cryptonote_protocol_handler(t_core &rco
 																																								m_p2p(p_net_layout),
 																																								m_syncronized_connections_count(0),
 																																								m_synchronized(offline),
-																																								m_stopping(false)
+																																								m_stopping(false),
+																																							m_txs_received(0),
+																																							m_duplicate_txs_received(0),
+																																							m_duplicate_bytes_received(0),
+																																							m_txs_relayed(0),
+																																							m_bytes_relayed(0),
+																																							m_bytes_saved(0)
 
 {
 	if(!m_p2p)
 		m_p2p = &m_p2p_stub;
+	m_received_txs.init(RECEIVED_TXS_FILTER_SIZE);
 }
 //-----------------------------------------------------------------------------------------------------------------------
 template <class t_core>
@@ -750,6 +766,24 @@ int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int co
 		return 1;
 	}
 
+	// the sender has these txs, so they never go back to it
+	{
+		boost::unique_lock<boost::mutex> lock(m_tx_relay_lock);
+		for(const blobdata &tx_blob : arg.txs)
+		{
+			const crypto::hash blob_hash = get_blob_hash(tx_blob);
+			peer_knows_tx(context.m_connection_id, blob_hash);
+			++m_txs_received;
+			if(!m_received_txs.not_present(&blob_hash, sizeof(blob_hash)))
+			{
+				++m_duplicate_txs_received;
+				m_duplicate_bytes_received += tx_blob.size();
+			}
+			else
+				m_received_txs.add_element(&blob_hash, sizeof(blob_hash));
+		}
+	}
+
 	for(auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end();)
 	{
 		cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -1167,6 +1201,7 @@ template <class t_core>
 bool t_cryptonote_protocol_handler<t_core>::on_idle()
 {
 	m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
+	flush_tx_relay_queue();
 	return m_core.on_idle();
 }
 //------------------------------------------------------------------------------------------------------------------------
@@ -1271,11 +1306,25 @@ bool t_cryptonote_protocol_handler<t_core>::should_download_next_span(cryptonote
 		return true;
 	}
 	const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
-	if((now - request_time).total_microseconds() > REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD)
+	const int64_t elapsed = (now - request_time).total_microseconds();
+	if(elapsed > REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD)
 	{
 		GULPS_LOG_L1( context_str, " we should download it as this span was requested long ago");
 		return true;
 	}
+
+	// hedge a straggler early: if the peer holding the span has taken several times
+	// what its measured throughput predicts, and we're faster, ask for it as well
+	const float expected = m_block_queue.get_expected_span_time(span_connection_id, span.second);
+	if(expected > 0.0f && speed > span_speed)
+	{
+		const int64_t threshold = std::max<int64_t>(REQUEST_NEXT_SCHEDULED_SPAN_MIN_THRESHOLD, expected * STRAGGLING_SPAN_FACTOR * 1e6);
+		if(elapsed > threshold)
+		{
+			GULPSF_LOG_L1("{} we should download it as it is straggling ({} s, expected {} s)", context_str, elapsed / 1e6, expected);
+			return true;
+		}
+	}
 	return false;
 }
 //------------------------------------------------------------------------------------------------------------------------
@@ -1299,11 +1348,12 @@ bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_c
 		{
 			size_t nblocks = m_block_queue.get_num_filled_spans();
 			size_t size = m_block_queue.get_data_size();
-			if(nblocks < BLOCK_QUEUE_NBLOCKS_THRESHOLD || size < BLOCK_QUEUE_SIZE_THRESHOLD)
+			size_t scheduled_size = m_block_queue.get_scheduled_size(BLOCK_QUEUE_DEFAULT_BLOCK_SIZE);
+			if((nblocks < BLOCK_QUEUE_NBLOCKS_THRESHOLD || size < BLOCK_QUEUE_SIZE_THRESHOLD) && size + scheduled_size < BLOCK_QUEUE_MAX_SIZE)
 			{
 				if(!first)
 				{
-					GULPSF_LOG_L1("{} Block queue is {} and {}, resuming", context_str, nblocks , size );
+					GULPSF_LOG_L1("{} Block queue is {} and {} ({} in flight), resuming", context_str, nblocks , size , scheduled_size );
 				}
 				break;
 			}
@@ -1326,7 +1376,7 @@ bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_c
 
 			if(first)
 			{
-				GULPSF_LOG_L1("{} Block queue is {} and {}, pausing", context_str, nblocks , size );
+				GULPSF_LOG_L1("{} Block queue is {} and {} ({} in flight), pausing", context_str, nblocks , size , scheduled_size );
 				first = false;
 				context.m_state = cryptonote_connection_context::state_standby;
 			}
@@ -1358,7 +1408,9 @@ bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_c
 		NOTIFY_REQUEST_GET_OBJECTS::request req;
 		bool is_next = false;
 		size_t count = 0;
-		const size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+		const size_t sync_size = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+		const size_t count_limit = m_block_queue.get_span_size(context.m_connection_id, sync_size, sync_size * BLOCK_QUEUE_MAX_SPAN_FACTOR,
+															   BLOCK_QUEUE_SPAN_TARGET_TIME, BLOCK_QUEUE_MAX_SPAN_SIZE);
 		std::pair<uint64_t, uint64_t> span = std::make_pair(0, 0);
 		{
 			GULPS_LOG_L1(" checking for gap");
@@ -1673,7 +1725,105 @@ bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSA
 	// no check for success, so tell core they're relayed unconditionally
 	for(auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end(); ++tx_blob_it)
 		m_core.on_transaction_relayed(*tx_blob_it);
-	return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+
+	// txs are sent with the next trickle from on_idle, batched per peer
+	boost::unique_lock<boost::mutex> lock(m_tx_relay_lock);
+	for(blobdata &tx_blob : arg.txs)
+	{
+		relay_tx_entry entry;
+		entry.blob_hash = get_blob_hash(tx_blob);
+		entry.blob = std::move(tx_blob);
+		entry.source = exclude_context.m_connection_id;
+		m_tx_relay_queue.push_back(std::move(entry));
+	}
+	arg.txs.clear();
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------
+template <class t_core>
+bool t_cryptonote_protocol_handler<t_core>::peer_knows_tx(const boost::uuids::uuid &connection_id, const crypto::hash &blob_hash)
+{
+	// must be called with m_tx_relay_lock held, returns false if the peer didn't know it yet
+	auto it = m_peer_known_txs.find(connection_id);
+	if(it == m_peer_known_txs.end())
+	{
+		it = m_peer_known_txs.emplace(connection_id, rolling_bloom_filter()).first;
+		it->second.init(PEER_KNOWN_TXS_FILTER_SIZE);
+	}
+
+	if(!it->second.not_present(&blob_hash, sizeof(blob_hash)))
+		return true;
+	it->second.add_element(&blob_hash, sizeof(blob_hash));
+	return false;
+}
+//------------------------------------------------------------------------------------------------------------------------
+template <class t_core>
+bool t_cryptonote_protocol_handler<t_core>::flush_tx_relay_queue()
+{
+	std::vector<relay_tx_entry> txs;
+	{
+		boost::unique_lock<boost::mutex> lock(m_tx_relay_lock);
+		txs.swap(m_tx_relay_queue);
+	}
+	if(txs.empty())
+		return true;
+
+	// peers which need the same subset of txs share one serialized notification
+	std::map<std::vector<bool>, std::list<boost::uuids::uuid>> relay_groups;
+	m_p2p->for_each_connection([&](connection_context &context, nodetool::peerid_type peer_id, uint32_t support_flags) {
+		if(!peer_id)
+			return true;
+
+		std::vector<bool> selected(txs.size(), false);
+		bool any = false;
+		boost::unique_lock<boost::mutex> lock(m_tx_relay_lock);
+		for(size_t i = 0; i < txs.size(); ++i)
+		{
+			if(txs[i].source == context.m_connection_id)
+				continue;
+			if(peer_knows_tx(context.m_connection_id, txs[i].blob_hash))
+			{
+				m_bytes_saved += txs[i].blob.size();
+				continue;
+			}
+			selected[i] = true;
+			any = true;
+		}
+		if(any)
+			relay_groups[selected].push_back(context.m_connection_id);
+		return true;
+	});
+
+	for(const auto &group : relay_groups)
+	{
+		NOTIFY_NEW_TRANSACTIONS::request arg;
+		for(size_t i = 0; i < txs.size(); ++i)
+		{
+			if(group.first[i])
+				arg.txs.push_back(txs[i].blob);
+		}
+
+		std::string arg_buff;
+		epee::serialization::store_t_to_binary(arg, arg_buff);
+		GULPSF_LOG_L2("Relaying {} txes to {} peers", arg.txs.size(), group.second.size());
+		m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, arg_buff, group.second);
+		m_txs_relayed += arg.txs.size() * group.second.size();
+		m_bytes_relayed += arg_buff.size() * group.second.size();
+	}
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------
+template <class t_core>
+tx_relay_stats t_cryptonote_protocol_handler<t_core>::get_tx_relay_stats() const
+{
+	tx_relay_stats stats;
+	stats.txs_received = m_txs_received;
+	stats.duplicate_txs_received = m_duplicate_txs_received;
+	stats.duplicate_bytes_received = m_duplicate_bytes_received;
+	stats.txs_relayed = m_txs_relayed;
+	stats.bytes_relayed = m_bytes_relayed;
+	stats.bytes_saved = m_bytes_saved;
+	return stats;
 }
 //------------------------------------------------------------------------------------------------------------------------
 template <class t_core>
@@ -1703,6 +1853,10 @@ void t_cryptonote_protocol_handler<t_core>::on_connection_close(cryptonote_conne
 	}
 
 	m_block_queue.flush_spans(context.m_connection_id, false);
+	m_block_queue.forget_peer(context.m_connection_id);
+
+	boost::unique_lock<boost::mutex> lock(m_tx_relay_lock);
+	m_peer_known_txs.erase(context.m_connection_id);
 }
 
 //------------------------------------------------------------------------------------------------------------------------
@@ -51,6 +51,19 @@
 #include "p2p/net_node_common.h"
 namespace cryptonote
 {
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+struct tx_relay_stats
+{
+	uint64_t txs_received = 0;
+	uint64_t duplicate_txs_received = 0;
+	uint64_t duplicate_bytes_received = 0;
+	uint64_t txs_relayed = 0;
+	uint64_t bytes_relayed = 0;
+	uint64_t bytes_saved = 0; //!< tx bytes not sent because the peer already had them
+};
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
@@ -58,6 +71,7 @@ struct i_cryptonote_protocol
 {
 	virtual bool relay_block(NOTIFY_NEW_BLOCK::request &arg, cryptonote_connection_context &exclude_context) = 0;
 	virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request &arg, cryptonote_connection_context &exclude_context) = 0;
+	virtual tx_relay_stats get_tx_relay_stats() const = 0;
 	//virtual bool request_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)=0;
 };
 
@@ -74,5 +88,9 @@ struct cryptonote_protocol_stub : public i_cryptonote_protocol
 	{
 		return false;
 	}
+	virtual tx_relay_stats get_tx_relay_stats() const
+	{
+		return tx_relay_stats();
+	}
 };
 }
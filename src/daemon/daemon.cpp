@@ -46,6 +46,7 @@
 
 #include "daemon/daemon.h"
 #include "rpc/daemon_handler.h"
+#include "rpc/zmq_pub.h"
 #include "rpc/zmq_server.h"
 #include <boost/algorithm/string/split.hpp>
 #include <memory>
@@ -117,6 +118,7 @@ t_daemon::t_daemon(
 {
 	zmq_rpc_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_port);
 	zmq_rpc_bind_address = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_ip);
+	zmq_pub_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_pub_bind_port);
 }
 
 t_daemon::~t_daemon() = default;
@@ -187,11 +189,38 @@ bool t_daemon::run(bool interactive)
 
 		GULPSF_INFO("ZMQ server started at {}:{}.", zmq_rpc_bind_address, zmq_rpc_bind_port);
 
+		cryptonote::rpc::ZmqPublisher zmq_pub;
+		cryptonote::Blockchain &blockchain = mp_internals->core.get().get_blockchain_storage();
+		if(!zmq_pub_bind_port.empty())
+		{
+			if(!zmq_pub.addTCPSocket(zmq_rpc_bind_address, zmq_pub_bind_port))
+			{
+				GULPSF_ERROR("Failed to add TCP Socket ({}:{}) to ZMQ publisher", zmq_rpc_bind_address, zmq_pub_bind_port);
+
+				if(rpc_commands)
+					rpc_commands->stop_handling();
+
+				zmq_server.stop();
+
+				for(auto &rpc : mp_internals->rpcs)
+					rpc->stop();
+
+				return false;
+			}
+
+			zmq_pub.run();
+			blockchain.set_core_events(&zmq_pub);
+			GULPSF_INFO("ZMQ publisher started at {}:{}.", zmq_rpc_bind_address, zmq_pub_bind_port);
+		}
+
 		mp_internals->p2p.run(); // blocks until p2p goes down
 
 		if(rpc_commands)
 			rpc_commands->stop_handling();
 
+		blockchain.set_core_events(nullptr);
+		zmq_pub.stop();
+
 		zmq_server.stop();
 
 		for(auto &rpc : mp_internals->rpcs)
@@ -122,6 +122,7 @@ int main(int argc, char* argv[])
 			command_line::add_arg(core_settings, daemon_args::arg_max_concurrency);
 			command_line::add_arg(core_settings, daemon_args::arg_zmq_rpc_bind_ip);
 			command_line::add_arg(core_settings, daemon_args::arg_zmq_rpc_bind_port);
+			command_line::add_arg(core_settings, daemon_args::arg_zmq_pub_bind_port);
 			command_line::add_arg(core_settings, daemon_args::arg_display_timestamps);
 
 			daemonizer::init_options(hidden_options, visible_options);
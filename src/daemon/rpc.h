@@ -85,7 +85,7 @@ class t_rpc final
 	void run()
 	{
 		GULPSF_GLOBAL_PRINT("Starting {} RPC server...",m_description);
-		if(!m_server.run(2, false))
+		if(!m_server.run(m_server.rpc_threads(), false))
 		{
 			throw std::runtime_error("Failed to start " + m_description + " RPC server.");
 		}
@@ -610,6 +610,14 @@ bool t_rpc_command_executor::print_net_stats()
 								spercent,
 								tools::get_human_readable_bytes(slimit));
 
+	GULPSF_PRINT_SUCCESS("Transactions received {} ({} duplicates, {}), relayed {} ({}), {} saved by peer tx filters",
+								res.tx_received,
+								res.tx_duplicates_received,
+								tools::get_human_readable_bytes(res.tx_duplicate_bytes_received),
+								res.tx_relayed,
+								tools::get_human_readable_bytes(res.tx_bytes_relayed),
+								tools::get_human_readable_bytes(res.tx_relay_bytes_saved));
+
 	return true;
 }
 
@@ -59,7 +59,6 @@ using namespace epee;
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
-#include "get_output_distribution_cache.h"
 #include "misc_language.h"
 #include "p2p/net_node.h"
 #include "rpc/rpc_args.h"
@@ -71,6 +70,7 @@ using namespace epee;
 
 #define MAX_RESTRICTED_FAKE_OUTS_COUNT 40
 #define MAX_RESTRICTED_GLOBAL_FAKE_OUTS_COUNT 5000
+#define MAX_RESTRICTED_BATCH_LOOKUP_COUNT 10000
 
 extern gulps_log_level log_scr;
 
@@ -95,6 +95,11 @@ void core_rpc_server::init_options(boost::program_options::options_description &
 	command_line::add_arg(desc, arg_restricted_rpc);
 	command_line::add_arg(desc, arg_bootstrap_daemon_address);
 	command_line::add_arg(desc, arg_bootstrap_daemon_login);
+	command_line::add_arg(desc, arg_rpc_threads);
+	command_line::add_arg(desc, arg_rpc_max_medium_calls);
+	command_line::add_arg(desc, arg_rpc_max_heavy_calls);
+	command_line::add_arg(desc, arg_rpc_queue_budget_ms);
+	command_line::add_arg(desc, arg_rpc_method_cost);
 	cryptonote::rpc_args::init_options(desc);
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -139,6 +144,9 @@ bool core_rpc_server::init(
 	}
 	m_was_bootstrap_ever_used = false;
 
+	if(!init_admission(vm))
+		return false;
+
 	boost::optional<epee::net_utils::http::login> http_login{};
 
 	if(rpc_config->login)
@@ -149,6 +157,62 @@ bool core_rpc_server::init(
 		rng, std::move(port), std::move(rpc_config->bind_ip), std::move(rpc_config->access_control_origins), std::move(http_login));
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::init_admission(const boost::program_options::variables_map &vm)
+{
+	using cost = epee::net_utils::rpc_admission;
+	// Methods whose cost grows with the request or the chain. Anything not
+	// listed is light and never waits for a slot.
+	static const std::pair<const char *, cost::cost_class> default_costs[] = {
+		{"/get_blocks.bin", cost::cost_heavy}, {"/getblocks.bin", cost::cost_heavy},
+		{"/get_blocks_by_height.bin", cost::cost_heavy}, {"/getblocks_by_height.bin", cost::cost_heavy},
+		{"/get_outs.bin", cost::cost_heavy}, {"/get_outs", cost::cost_heavy},
+		{"/get_transactions", cost::cost_heavy}, {"/gettransactions", cost::cost_heavy}, {"/get_transactions.bin", cost::cost_heavy},
+		{"get_output_histogram", cost::cost_heavy}, {"get_output_distribution", cost::cost_heavy},
+		{"get_coinbase_tx_sum", cost::cost_heavy}, {"get_block_headers_range", cost::cost_heavy}, {"getblockheadersrange", cost::cost_heavy},
+		{"/get_hashes.bin", cost::cost_medium}, {"/gethashes.bin", cost::cost_medium},
+		{"/get_o_indexes.bin", cost::cost_medium}, {"/get_random_outs.bin", cost::cost_medium}, {"/getrandom_outs.bin", cost::cost_medium},
+		{"/get_random_rctouts.bin", cost::cost_medium}, {"/getrandom_rctouts.bin", cost::cost_medium},
+		{"/is_key_image_spent", cost::cost_medium}, {"/is_key_image_spent.bin", cost::cost_medium},
+		{"/get_transaction_pool", cost::cost_medium}, {"/get_transaction_pool_hashes.bin", cost::cost_medium},
+		{"get_block", cost::cost_medium}, {"getblock", cost::cost_medium}, {"get_txpool_backlog", cost::cost_medium},
+		{"get_alternate_chains", cost::cost_medium}};
+
+	m_rpc_threads = std::max<uint32_t>(1, command_line::get_arg(vm, arg_rpc_threads));
+
+	// One worker is always kept free of medium and heavy calls, running or waiting. Within the
+	// others each class may take them all by default, so a wallet syncing over a few connections
+	// isn't turned away while the server is otherwise idle.
+	const uint32_t shared_threads = std::max<uint32_t>(1, m_rpc_threads - 1);
+	uint32_t max_heavy = command_line::get_arg(vm, arg_rpc_max_heavy_calls);
+	uint32_t max_medium = command_line::get_arg(vm, arg_rpc_max_medium_calls);
+	if(max_heavy == 0)
+		max_heavy = shared_threads;
+	if(max_medium == 0)
+		max_medium = shared_threads;
+
+	for(const auto &c : default_costs)
+		m_rpc_admission.set_cost(c.first, c.second);
+	for(const std::string &entry : command_line::get_arg(vm, arg_rpc_method_cost))
+	{
+		const size_t pos = entry.find('=');
+		cost::cost_class cls;
+		if(pos == std::string::npos || !cost::parse_class(entry.substr(pos + 1), cls))
+		{
+			GULPSF_ERROR("Invalid --{} entry \"{}\", expected method=light|medium|heavy", arg_rpc_method_cost.name, entry);
+			return false;
+		}
+		m_rpc_admission.set_cost(entry.substr(0, pos), cls);
+	}
+
+	m_rpc_admission.set_limit(cost::cost_medium, max_medium);
+	m_rpc_admission.set_limit(cost::cost_heavy, max_heavy);
+	m_rpc_admission.set_worker_threads(m_rpc_threads);
+	m_rpc_admission.set_queue_budget(std::chrono::milliseconds(command_line::get_arg(vm, arg_rpc_queue_budget_ms)));
+	m_rpc_admission.set_busy_status(CORE_RPC_STATUS_BUSY);
+	GULPSF_INFO("RPC admission: {} threads, at most {} medium and {} heavy calls at once, {} of both", m_rpc_threads, max_medium, max_heavy, shared_threads);
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
 bool core_rpc_server::check_core_ready()
 {
 	if(!m_p2p.get_payload_object().is_synchronized())
@@ -228,6 +292,43 @@ bool core_rpc_server::on_get_info(const COMMAND_RPC_GET_INFO::request &req, COMM
 		boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
 		res.was_bootstrap_ever_used = m_was_bootstrap_ever_used;
 	}
+	res.rpc_in_flight = m_restricted ? 0 : epee::net_utils::rpc_metrics::instance().total_in_flight();
+	res.blockchain_lock_wait_us = m_restricted ? 0 : m_core.get_blockchain_storage().get_lock_wait_histogram().sum();
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::make_tx_scan_digest(const blobdata &tx_blob, COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest)
+{
+	cryptonote::transaction tx;
+	if(!cryptonote::parse_and_validate_tx_base_from_blob(tx_blob, tx))
+		return false;
+
+	// a partially parsed extra is fine as long as the keys made it
+	std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+	cryptonote::parse_tx_extra(tx.extra, tx_extra_fields);
+
+	cryptonote::tx_extra_pub_key pub_key_field;
+	digest.tx_pub_key = cryptonote::find_tx_extra_field_by_type(tx_extra_fields, pub_key_field) ? pub_key_field.pub_key : crypto::null_pkey;
+
+	cryptonote::tx_extra_additional_pub_keys additional_pub_keys;
+	if(cryptonote::find_tx_extra_field_by_type(tx_extra_fields, additional_pub_keys))
+		digest.additional_tx_pub_keys = std::move(additional_pub_keys.data);
+
+	digest.output_keys.reserve(tx.vout.size());
+	for(const cryptonote::tx_out &out : tx.vout)
+	{
+		if(out.target.type() == typeid(cryptonote::txout_to_key))
+			digest.output_keys.push_back(boost::get<cryptonote::txout_to_key>(out.target).key);
+		else
+			digest.output_keys.push_back(crypto::null_pkey);
+	}
+
+	digest.key_images.reserve(tx.vin.size());
+	for(const cryptonote::txin_v &in : tx.vin)
+	{
+		if(in.type() == typeid(cryptonote::txin_to_key))
+			digest.key_images.push_back(boost::get<cryptonote::txin_to_key>(in).k_image);
+	}
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -251,6 +352,26 @@ bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request &
 		return false;
 	}
 
+	if(req.digest)
+	{
+		res.digests.resize(res.blocks.size());
+		for(size_t i = 0; i < res.blocks.size(); i++)
+		{
+			COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest &bd = res.digests[i];
+			bd.txs.resize(res.blocks[i].txs.size());
+			for(size_t j = 0; j < bd.txs.size(); j++)
+			{
+				if(!make_tx_scan_digest(res.blocks[i].txs[j], bd.txs[j]))
+				{
+					res.status = "Failed";
+					return false;
+				}
+			}
+			bd.block = std::move(res.blocks[i].block);
+		}
+		res.blocks.clear();
+	}
+
 	res.status = CORE_RPC_STATUS_OK;
 	return true;
 }
@@ -647,6 +768,51 @@ bool core_rpc_server::on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::re
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_get_transactions_bin(const COMMAND_RPC_GET_TRANSACTIONS_BIN::request &req, COMMAND_RPC_GET_TRANSACTIONS_BIN::response &res)
+{
+	PERF_TIMER(on_get_transactions_bin);
+	bool ok;
+	if(use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTIONS_BIN>(invoke_http_mode::BIN, "/get_transactions.bin", req, res, ok))
+		return ok;
+
+	if(m_restricted && req.txs_hashes.size() > MAX_RESTRICTED_BATCH_LOOKUP_COUNT)
+	{
+		res.status = "Too many transactions requested";
+		return true;
+	}
+
+	std::vector<blobdata> blobs;
+	std::vector<uint64_t> heights;
+	try
+	{
+		m_core.get_blockchain_storage().get_db().get_tx_blobs(req.txs_hashes, blobs, heights);
+	}
+	catch(const std::exception &e)
+	{
+		GULPSF_ERROR("Failed to get transactions: {}", e.what());
+		res.status = "Failed";
+		return true;
+	}
+
+	res.txs.resize(req.txs_hashes.size());
+	for(size_t i = 0; i < req.txs_hashes.size(); ++i)
+	{
+		COMMAND_RPC_GET_TRANSACTIONS_BIN::entry &e = res.txs[i];
+		e.block_height = heights[i];
+		e.in_pool = false;
+		if(heights[i] != std::numeric_limits<uint64_t>::max())
+			e.tx_blob = std::move(blobs[i]);
+		else if(m_core.get_pool_transaction(req.txs_hashes[i], e.tx_blob))
+			e.in_pool = true;
+		else
+			res.missed_tx.push_back(req.txs_hashes[i]);
+	}
+
+	GULPSF_LOG_L2("{} transactions requested, {} not found", req.txs_hashes.size(), res.missed_tx.size());
+	res.status = CORE_RPC_STATUS_OK;
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
 bool core_rpc_server::on_is_key_image_spent(const COMMAND_RPC_IS_KEY_IMAGE_SPENT::request &req, COMMAND_RPC_IS_KEY_IMAGE_SPENT::response &res, bool request_has_rpc_origin)
 {
 	PERF_TIMER(on_is_key_image_spent);
@@ -680,34 +846,56 @@ bool core_rpc_server::on_is_key_image_spent(const COMMAND_RPC_IS_KEY_IMAGE_SPENT
 	for(size_t n = 0; n < spent_status.size(); ++n)
 		res.spent_status.push_back(spent_status[n] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN : COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
 
-	// check the pool too
-	std::vector<cryptonote::tx_info> txs;
-	std::vector<cryptonote::spent_key_image_info> ki;
-	r = m_core.get_pool_transactions_and_spent_keys_info(txs, ki, !request_has_rpc_origin || !m_restricted);
-	if(!r)
+	// check the pool too, this only looks at the pool's key images and does not wait for the pool lock
+	std::vector<bool> pool_spent_status;
+	r = m_core.are_key_images_spent_in_pool(key_images, pool_spent_status, !request_has_rpc_origin || !m_restricted);
+	if(!r || pool_spent_status.size() != res.spent_status.size())
 	{
 		res.status = "Failed";
 		return true;
 	}
-	for(std::vector<cryptonote::spent_key_image_info>::const_iterator i = ki.begin(); i != ki.end(); ++i)
+	for(size_t n = 0; n < res.spent_status.size(); ++n)
 	{
-		crypto::hash hash;
-		crypto::key_image spent_key_image;
-		if(parse_hash256(i->id_hash, hash))
-		{
-			memcpy(&spent_key_image, &hash, sizeof(hash)); // a bit dodgy, should be other parse functions somewhere
-			for(size_t n = 0; n < res.spent_status.size(); ++n)
-			{
-				if(res.spent_status[n] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT)
-				{
-					if(key_images[n] == spent_key_image)
-					{
-						res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
-						break;
-					}
-				}
-			}
-		}
+		if(res.spent_status[n] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT && pool_spent_status[n])
+			res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
+	}
+
+	res.status = CORE_RPC_STATUS_OK;
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_is_key_image_spent_bin(const COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request &req, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response &res, bool request_has_rpc_origin)
+{
+	PERF_TIMER(on_is_key_image_spent_bin);
+	bool ok;
+	if(use_bootstrap_daemon_if_necessary<COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN>(invoke_http_mode::BIN, "/is_key_image_spent.bin", req, res, ok))
+		return ok;
+
+	if(m_restricted && req.key_images.size() > MAX_RESTRICTED_BATCH_LOOKUP_COUNT)
+	{
+		res.status = "Too many key images requested";
+		return true;
+	}
+
+	std::vector<bool> spent_status;
+	std::vector<bool> pool_spent_status;
+	bool r = m_core.are_key_images_spent(req.key_images, spent_status);
+	r = r && m_core.are_key_images_spent_in_pool(req.key_images, pool_spent_status, !request_has_rpc_origin || !m_restricted);
+	if(!r || spent_status.size() != req.key_images.size() || pool_spent_status.size() != req.key_images.size())
+	{
+		res.status = "Failed";
+		return true;
+	}
+
+	res.spent_status.resize(req.key_images.size());
+	for(size_t n = 0; n < req.key_images.size(); ++n)
+	{
+		if(spent_status[n])
+			res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN;
+		else if(pool_spent_status[n])
+			res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
+		else
+			res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
 	}
 
 	res.status = CORE_RPC_STATUS_OK;
@@ -1334,6 +1522,9 @@ bool core_rpc_server::on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HE
 	if(use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH>(invoke_http_mode::JON_RPC, "getblockheaderbyhash", req, res, r))
 		return r;
 
+	// serve everything below from one db snapshot, without waiting for the blockchain lock
+	db_rtxn_guard rtxn_guard(&m_core.get_blockchain_storage().get_db());
+
 	crypto::hash block_hash;
 	bool hash_parsed = parse_hash256(req.hash, block_hash);
 	if(!hash_parsed)
@@ -1376,6 +1567,9 @@ bool core_rpc_server::on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEA
 	if(use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCK_HEADERS_RANGE>(invoke_http_mode::JON_RPC, "getblockheadersrange", req, res, r))
 		return r;
 
+	// the height check and all block lookups below see the same chain
+	db_rtxn_guard rtxn_guard(&m_core.get_blockchain_storage().get_db());
+
 	const uint64_t bc_height = m_core.get_current_blockchain_height();
 	if(req.start_height >= bc_height || req.end_height >= bc_height || req.start_height > req.end_height)
 	{
@@ -1427,6 +1621,8 @@ bool core_rpc_server::on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_
 	if(use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT>(invoke_http_mode::JON_RPC, "getblockheaderbyheight", req, res, r))
 		return r;
 
+	db_rtxn_guard rtxn_guard(&m_core.get_blockchain_storage().get_db());
+
 	if(m_core.get_current_blockchain_height() <= req.height)
 	{
 		error_resp.code = CORE_RPC_ERROR_CODE_TOO_BIG_HEIGHT;
@@ -1573,6 +1769,8 @@ bool core_rpc_server::on_get_info_json(const COMMAND_RPC_GET_INFO::request &req,
 		boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
 		res.was_bootstrap_ever_used = m_was_bootstrap_ever_used;
 	}
+	res.rpc_in_flight = m_restricted ? 0 : epee::net_utils::rpc_metrics::instance().total_in_flight();
+	res.blockchain_lock_wait_us = m_restricted ? 0 : m_core.get_blockchain_storage().get_lock_wait_histogram().sum();
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -1587,6 +1785,13 @@ bool core_rpc_server::on_get_net_stats(const COMMAND_RPC_GET_NET_STATS::request&
 		CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
 		epee::net_utils::network_throttle_manager::get_global_throttle_out().get_stats(res.total_packets_out, res.total_bytes_out);
 	}
+	const tx_relay_stats relay_stats = m_core.get_protocol()->get_tx_relay_stats();
+	res.tx_received = relay_stats.txs_received;
+	res.tx_duplicates_received = relay_stats.duplicate_txs_received;
+	res.tx_duplicate_bytes_received = relay_stats.duplicate_bytes_received;
+	res.tx_relayed = relay_stats.txs_relayed;
+	res.tx_bytes_relayed = relay_stats.bytes_relayed;
+	res.tx_relay_bytes_saved = relay_stats.bytes_saved;
 	res.status = CORE_RPC_STATUS_OK;
 	return true;
 }
@@ -2062,50 +2267,6 @@ bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DI
 	{
 		for(uint64_t amount : req.amounts)
 		{
-			static struct D
-			{
-				boost::mutex mutex;
-				std::vector<uint64_t> cached_distribution;
-				uint64_t cached_from, cached_to, cached_start_height, cached_base;
-				bool cached;
-				D() : cached_from(0), cached_to(0), cached_start_height(0), cached_base(0), cached(false) {}
-			} d;
-			boost::unique_lock<boost::mutex> lock(d.mutex);
-
-			if(d.cached && amount == 0 && d.cached_from == req.from_height && d.cached_to == req.to_height)
-			{
-				res.distributions.push_back({amount, d.cached_start_height, d.cached_distribution, d.cached_base});
-				if(req.cumulative)
-				{
-					auto &distribution = res.distributions.back().distribution;
-					distribution[0] += d.cached_base;
-					for(size_t n = 1; n < distribution.size(); ++n)
-						distribution[n] += distribution[n - 1];
-				}
-				continue;
-			}
-
-			// this is a slow operation, so we have precomputed caches of common cases
-			bool found = false;
-			for(const auto &slot : get_output_distribution_cache)
-			{
-				if(slot.amount == amount && slot.from_height == req.from_height && slot.to_height == req.to_height)
-				{
-					res.distributions.push_back({amount, slot.start_height, slot.distribution, slot.base});
-					found = true;
-					if(req.cumulative)
-					{
-						auto &distribution = res.distributions.back().distribution;
-						distribution[0] += slot.base;
-						for(size_t n = 1; n < distribution.size(); ++n)
-							distribution[n] += distribution[n - 1];
-					}
-					break;
-				}
-			}
-			if(found)
-				continue;
-
 			std::vector<uint64_t> distribution;
 			uint64_t start_height, base;
 			if(!m_core.get_output_distribution(amount, req.from_height, req.to_height, start_height, distribution, base))
@@ -2121,16 +2282,6 @@ bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DI
 					distribution.resize(req.to_height - offset + 1);
 			}
 
-			if(amount == 0)
-			{
-				d.cached_from = req.from_height;
-				d.cached_to = req.to_height;
-				d.cached_distribution = distribution;
-				d.cached_start_height = start_height;
-				d.cached_base = base;
-				d.cached = true;
-			}
-
 			if(req.cumulative)
 			{
 				distribution[0] += base;
@@ -2152,6 +2303,62 @@ bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DI
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_get_rpc_metrics(const COMMAND_RPC_GET_RPC_METRICS::request &req, COMMAND_RPC_GET_RPC_METRICS::response &res, epee::json_rpc::error &error_resp)
+{
+	PERF_TIMER(on_get_rpc_metrics);
+	for(const auto &m : epee::net_utils::rpc_metrics::instance().methods())
+	{
+		const epee::latency_histogram::snapshot latency = m.second->latency.get_snapshot();
+		res.methods.emplace_back();
+		rpc_method_stats &stats = res.methods.back();
+		stats.method = m.first;
+		stats.calls = m.second->calls.load(std::memory_order_relaxed);
+		stats.errors = m.second->errors.load(std::memory_order_relaxed);
+		stats.in_flight = m.second->in_flight.load(std::memory_order_relaxed);
+		stats.request_bytes = m.second->request_bytes.load(std::memory_order_relaxed);
+		stats.response_bytes = m.second->response_bytes.load(std::memory_order_relaxed);
+		stats.mean_us = latency.count ? latency.sum / latency.count : 0;
+		stats.p50_us = latency.percentile(0.5);
+		stats.p90_us = latency.percentile(0.9);
+		stats.p99_us = latency.percentile(0.99);
+		stats.max_us = latency.max;
+	}
+
+	const epee::latency_histogram::snapshot lock_wait = m_core.get_blockchain_storage().get_lock_wait_histogram().get_snapshot();
+	res.lock_acquisitions = lock_wait.count;
+	res.lock_contended = lock_wait.count - std::min(lock_wait.count, lock_wait.buckets[0]);
+	res.lock_wait_us = lock_wait.sum;
+	res.lock_wait_p99_us = lock_wait.percentile(0.99);
+	res.lock_wait_max_us = lock_wait.max;
+
+	for(int i = 0; i < epee::net_utils::rpc_admission::cost_class_count; ++i)
+	{
+		const auto cls = static_cast<epee::net_utils::rpc_admission::cost_class>(i);
+		const epee::net_utils::rpc_admission::class_stats cs = m_rpc_admission.get_stats(cls);
+		res.cost_classes.emplace_back();
+		rpc_cost_class_stats &stats = res.cost_classes.back();
+		stats.cost_class = epee::net_utils::rpc_admission::class_name(cls);
+		stats.limit = cs.limit;
+		stats.active = cs.active;
+		stats.waiting = cs.waiting;
+		stats.admitted = cs.admitted;
+		stats.shed = cs.shed;
+		stats.avg_service_us = cs.avg_service_us;
+	}
+	res.status = CORE_RPC_STATUS_OK;
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
+void core_rpc_server::on_get_metrics(std::string &body)
+{
+	PERF_TIMER(on_get_metrics);
+	epee::net_utils::rpc_metrics::instance().write_prometheus(body, "ryod");
+	m_rpc_admission.write_prometheus(body, "ryod");
+	epee::net_utils::rpc_metrics::write_prometheus_histogram(body, "ryod_blockchain_lock_wait_seconds",
+		"Time spent waiting to take the blockchain lock, uncontended acquisitions count as zero.",
+		{{"", m_core.get_blockchain_storage().get_lock_wait_histogram().get_snapshot()}});
+}
+//------------------------------------------------------------------------------------------------------------------------------
 
 const command_line::arg_descriptor<std::string, false, true, 2> core_rpc_server::arg_rpc_bind_port = {
 	"rpc-bind-port", "Port for RPC server", std::to_string(config<MAINNET>::RPC_DEFAULT_PORT), {{&cryptonote::arg_testnet_on, &cryptonote::arg_stagenet_on}}, [](std::array<bool, 2> testnet_stagenet, bool defaulted, std::string val) -> std::string {
@@ -2172,4 +2379,19 @@ const command_line::arg_descriptor<std::string> core_rpc_server::arg_bootstrap_d
 
 const command_line::arg_descriptor<std::string> core_rpc_server::arg_bootstrap_daemon_login = {
 	"bootstrap-daemon-login", "Specify username:password for the bootstrap daemon login", ""};
+
+const command_line::arg_descriptor<uint32_t> core_rpc_server::arg_rpc_threads = {
+	"rpc-threads", "Number of worker threads for each RPC server", 4};
+
+const command_line::arg_descriptor<uint32_t> core_rpc_server::arg_rpc_max_medium_calls = {
+	"rpc-max-medium-calls", "Maximum concurrent medium cost RPC calls, 0 to derive from --rpc-threads", 0};
+
+const command_line::arg_descriptor<uint32_t> core_rpc_server::arg_rpc_max_heavy_calls = {
+	"rpc-max-heavy-calls", "Maximum concurrent heavy cost RPC calls, 0 to derive from --rpc-threads", 0};
+
+const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_queue_budget_ms = {
+	"rpc-queue-budget-ms", "Longest a medium or heavy RPC call may wait for a slot before the server answers BUSY", 1000};
+
+const command_line::arg_descriptor<std::vector<std::string>> core_rpc_server::arg_rpc_method_cost = {
+	"rpc-method-cost", "Override the cost class of an RPC method, as method=light|medium|heavy (e.g. get_output_histogram=medium or /get_outs.bin=light)"};
 } // namespace cryptonote
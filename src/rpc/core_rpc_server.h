@@ -76,6 +76,11 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	static const command_line::arg_descriptor<bool> arg_restricted_rpc;
 	static const command_line::arg_descriptor<std::string> arg_bootstrap_daemon_address;
 	static const command_line::arg_descriptor<std::string> arg_bootstrap_daemon_login;
+	static const command_line::arg_descriptor<uint32_t> arg_rpc_threads;
+	static const command_line::arg_descriptor<uint32_t> arg_rpc_max_medium_calls;
+	static const command_line::arg_descriptor<uint32_t> arg_rpc_max_heavy_calls;
+	static const command_line::arg_descriptor<uint64_t> arg_rpc_queue_budget_ms;
+	static const command_line::arg_descriptor<std::vector<std::string>> arg_rpc_method_cost;
 
 	typedef epee::net_utils::connection_context_base connection_context;
 
@@ -89,6 +94,9 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 		const network_type nettype,
 		const std::string &port);
 	network_type nettype() const { return m_nettype; }
+	uint32_t rpc_threads() const { return m_rpc_threads; }
+	// Reads the same keys a wallet scans with, see tools::wallet2::block_scan_tx
+	static bool make_tx_scan_digest(const blobdata &tx_blob, COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest &digest);
 
 	CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
 
@@ -109,8 +117,10 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	MAP_URI_AUTO_BIN2("/getrandom_rctouts.bin", on_get_random_rct_outs, COMMAND_RPC_GET_RANDOM_RCT_OUTPUTS)
 	MAP_URI_AUTO_JON2("/get_transactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
 	MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
+	MAP_URI_AUTO_BIN2("/get_transactions.bin", on_get_transactions_bin, COMMAND_RPC_GET_TRANSACTIONS_BIN)
 	MAP_URI_AUTO_JON2("/get_alt_blocks_hashes", on_get_alt_blocks_hashes, COMMAND_RPC_GET_ALT_BLOCKS_HASHES)
 	MAP_URI_AUTO_JON2("/is_key_image_spent", on_is_key_image_spent, COMMAND_RPC_IS_KEY_IMAGE_SPENT)
+	MAP_URI_AUTO_BIN2("/is_key_image_spent.bin", on_is_key_image_spent_bin, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN)
 	MAP_URI_AUTO_JON2("/send_raw_transaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
 	MAP_URI_AUTO_JON2("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
 	MAP_URI_AUTO_JON2_IF("/start_mining", on_start_mining, COMMAND_RPC_START_MINING, !m_restricted)
@@ -134,6 +144,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	MAP_URI_AUTO_JON2_IF("/in_peers", on_in_peers, COMMAND_RPC_IN_PEERS, !m_restricted)
 	MAP_URI_AUTO_JON2("/get_outs", on_get_outs, COMMAND_RPC_GET_OUTPUTS)
 	MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
+	MAP_URI_METRICS2_IF("/metrics", on_get_metrics, !m_restricted)
 	BEGIN_JSON_RPC_MAP("/json_rpc")
 	MAP_JON_RPC("get_block_count", on_getblockcount, COMMAND_RPC_GETBLOCKCOUNT)
 	MAP_JON_RPC("getblockcount", on_getblockcount, COMMAND_RPC_GETBLOCKCOUNT)
@@ -167,6 +178,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	MAP_JON_RPC_WE_IF("sync_info", on_sync_info, COMMAND_RPC_SYNC_INFO, !m_restricted)
 	MAP_JON_RPC_WE("get_txpool_backlog", on_get_txpool_backlog, COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG)
 	MAP_JON_RPC_WE("get_output_distribution", on_get_output_distribution, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
+	MAP_JON_RPC_WE_IF("get_rpc_metrics", on_get_rpc_metrics, COMMAND_RPC_GET_RPC_METRICS, !m_restricted)
 	END_JSON_RPC_MAP()
 	END_URI_MAP2()
 
@@ -176,7 +188,9 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	bool on_get_blocks_by_height(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request &req, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response &res);
 	bool on_get_hashes(const COMMAND_RPC_GET_HASHES_FAST::request &req, COMMAND_RPC_GET_HASHES_FAST::response &res);
 	bool on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request &req, COMMAND_RPC_GET_TRANSACTIONS::response &res);
+	bool on_get_transactions_bin(const COMMAND_RPC_GET_TRANSACTIONS_BIN::request &req, COMMAND_RPC_GET_TRANSACTIONS_BIN::response &res);
 	bool on_is_key_image_spent(const COMMAND_RPC_IS_KEY_IMAGE_SPENT::request &req, COMMAND_RPC_IS_KEY_IMAGE_SPENT::response &res, bool request_has_rpc_origin = true);
+	bool on_is_key_image_spent_bin(const COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request &req, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response &res, bool request_has_rpc_origin = true);
 	bool on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request &req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response &res);
 	bool on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request &req, COMMAND_RPC_SEND_RAW_TX::response &res);
 	bool on_start_mining(const COMMAND_RPC_START_MINING::request &req, COMMAND_RPC_START_MINING::response &res);
@@ -202,6 +216,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	bool on_out_peers(const COMMAND_RPC_OUT_PEERS::request &req, COMMAND_RPC_OUT_PEERS::response &res);
 	bool on_in_peers(const COMMAND_RPC_IN_PEERS::request &req, COMMAND_RPC_IN_PEERS::response &res);
 	bool on_update(const COMMAND_RPC_UPDATE::request &req, COMMAND_RPC_UPDATE::response &res);
+	void on_get_metrics(std::string &body);
 
 	//json_rpc
 	bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request &req, COMMAND_RPC_GETBLOCKCOUNT::response &res);
@@ -227,11 +242,13 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	bool on_sync_info(const COMMAND_RPC_SYNC_INFO::request &req, COMMAND_RPC_SYNC_INFO::response &res, epee::json_rpc::error &error_resp);
 	bool on_get_txpool_backlog(const COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG::request &req, COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG::response &res, epee::json_rpc::error &error_resp);
 	bool on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request &req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response &res, epee::json_rpc::error &error_resp);
+	bool on_get_rpc_metrics(const COMMAND_RPC_GET_RPC_METRICS::request &req, COMMAND_RPC_GET_RPC_METRICS::response &res, epee::json_rpc::error &error_resp);
 	//-----------------------
 
   private:
 	bool check_core_busy();
 	bool check_core_ready();
+	bool init_admission(const boost::program_options::variables_map &vm);
 
 	//utils
 	uint64_t get_block_reward(const block &blk);
@@ -255,6 +272,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	bool m_was_bootstrap_ever_used;
 	network_type m_nettype;
 	bool m_restricted;
+	uint32_t m_rpc_threads;
 };
 }
 
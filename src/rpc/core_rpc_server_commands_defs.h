@@ -65,7 +65,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 1
-#define CORE_RPC_VERSION_MINOR 20
+#define CORE_RPC_VERSION_MINOR 25
 #define MAKE_CORE_RPC_VERSION(major, minor) (((major) << 16) | (minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -99,10 +99,40 @@ struct COMMAND_RPC_GET_BLOCKS_FAST
 		std::list<crypto::hash> block_ids; //*first 10 blocks id goes sequential, next goes in pow(2,n) offset, like 2, 4, 8, 16, 32, 64 and so on, and the last one is always genesis block */
 		uint64_t start_height;
 		bool prune;
+		bool digest; // fill digests instead of blocks
 		BEGIN_KV_SERIALIZE_MAP(request)
 		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
 		KV_SERIALIZE(start_height)
 		KV_SERIALIZE(prune)
+		KV_SERIALIZE_OPT(digest, false)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	// The parts of a tx a wallet needs to find its outputs and spends. Anything it matches is
+	// fetched in full afterwards with getblocks_by_height.bin.
+	struct tx_scan_digest
+	{
+		crypto::public_key tx_pub_key; // null if the tx has none
+		std::vector<crypto::public_key> additional_tx_pub_keys;
+		std::vector<crypto::public_key> output_keys; // null for outputs that aren't txout_to_key
+		std::vector<crypto::key_image> key_images;
+
+		BEGIN_KV_SERIALIZE_MAP(tx_scan_digest)
+		KV_SERIALIZE_VAL_POD_AS_BLOB(tx_pub_key)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(additional_tx_pub_keys)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(output_keys)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct block_scan_digest
+	{
+		blobdata block; // the miner tx is scanned from the block itself
+		std::vector<tx_scan_digest> txs;
+
+		BEGIN_KV_SERIALIZE_MAP(block_scan_digest)
+		KV_SERIALIZE(block)
+		KV_SERIALIZE(txs)
 		END_KV_SERIALIZE_MAP()
 	};
 
@@ -131,6 +161,7 @@ struct COMMAND_RPC_GET_BLOCKS_FAST
 		uint64_t current_height;
 		std::string status;
 		std::vector<block_output_indices> output_indices;
+		std::vector<block_scan_digest> digests;
 		bool untrusted;
 
 		BEGIN_KV_SERIALIZE_MAP(response)
@@ -139,6 +170,7 @@ struct COMMAND_RPC_GET_BLOCKS_FAST
 		KV_SERIALIZE(current_height)
 		KV_SERIALIZE(status)
 		KV_SERIALIZE(output_indices)
+		KV_SERIALIZE(digests)
 		KV_SERIALIZE(untrusted)
 		END_KV_SERIALIZE_MAP()
 	};
@@ -662,6 +694,73 @@ struct COMMAND_RPC_IS_KEY_IMAGE_SPENT
 	};
 };
 
+//-----------------------------------------------
+struct COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN
+{
+	struct request
+	{
+		std::vector<crypto::key_image> key_images;
+
+		BEGIN_KV_SERIALIZE_MAP(request)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct response
+	{
+		std::vector<uint8_t> spent_status; // COMMAND_RPC_IS_KEY_IMAGE_SPENT::STATUS, in request order
+		std::string status;
+		bool untrusted;
+
+		BEGIN_KV_SERIALIZE_MAP(response)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(spent_status)
+		KV_SERIALIZE(status)
+		KV_SERIALIZE(untrusted)
+		END_KV_SERIALIZE_MAP()
+	};
+};
+
+//-----------------------------------------------
+struct COMMAND_RPC_GET_TRANSACTIONS_BIN
+{
+	struct request
+	{
+		std::vector<crypto::hash> txs_hashes;
+
+		BEGIN_KV_SERIALIZE_MAP(request)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs_hashes)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct entry
+	{
+		blobdata tx_blob; // empty if the tx was not found
+		uint64_t block_height; // uint64_t max if in the pool or not found
+		bool in_pool;
+
+		BEGIN_KV_SERIALIZE_MAP(entry)
+		KV_SERIALIZE(tx_blob)
+		KV_SERIALIZE(block_height)
+		KV_SERIALIZE(in_pool)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct response
+	{
+		std::vector<entry> txs; // one per requested hash, in request order
+		std::vector<crypto::hash> missed_tx;
+		std::string status;
+		bool untrusted;
+
+		BEGIN_KV_SERIALIZE_MAP(response)
+		KV_SERIALIZE(txs)
+		KV_SERIALIZE_CONTAINER_POD_AS_BLOB(missed_tx)
+		KV_SERIALIZE(status)
+		KV_SERIALIZE(untrusted)
+		END_KV_SERIALIZE_MAP()
+	};
+};
+
 //-----------------------------------------------
 struct COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES
 {
@@ -976,6 +1075,8 @@ struct COMMAND_RPC_GET_INFO
 		std::string bootstrap_daemon_address;
 		uint64_t height_without_bootstrap;
 		bool was_bootstrap_ever_used;
+		uint64_t rpc_in_flight;
+		uint64_t blockchain_lock_wait_us;
 
 		BEGIN_KV_SERIALIZE_MAP(response)
 		KV_SERIALIZE(status)
@@ -1006,6 +1107,8 @@ struct COMMAND_RPC_GET_INFO
 		KV_SERIALIZE(bootstrap_daemon_address)
 		KV_SERIALIZE(height_without_bootstrap)
 		KV_SERIALIZE(was_bootstrap_ever_used)
+		KV_SERIALIZE(rpc_in_flight)
+		KV_SERIALIZE(blockchain_lock_wait_us)
 		END_KV_SERIALIZE_MAP()
 	};
 };
@@ -1026,6 +1129,12 @@ struct COMMAND_RPC_GET_NET_STATS
 		uint64_t total_bytes_in;
 		uint64_t total_packets_out;
 		uint64_t total_bytes_out;
+		uint64_t tx_received;
+		uint64_t tx_duplicates_received;
+		uint64_t tx_duplicate_bytes_received;
+		uint64_t tx_relayed;
+		uint64_t tx_bytes_relayed;
+		uint64_t tx_relay_bytes_saved;
 		std::string status;
 
 		BEGIN_KV_SERIALIZE_MAP(response)
@@ -1034,6 +1143,95 @@ struct COMMAND_RPC_GET_NET_STATS
 		KV_SERIALIZE(total_bytes_in)
 		KV_SERIALIZE(total_packets_out)
 		KV_SERIALIZE(total_bytes_out)
+		KV_SERIALIZE(tx_received)
+		KV_SERIALIZE(tx_duplicates_received)
+		KV_SERIALIZE(tx_duplicate_bytes_received)
+		KV_SERIALIZE(tx_relayed)
+		KV_SERIALIZE(tx_bytes_relayed)
+		KV_SERIALIZE(tx_relay_bytes_saved)
+		KV_SERIALIZE(status)
+		END_KV_SERIALIZE_MAP()
+	};
+};
+
+//-----------------------------------------------
+struct rpc_method_stats
+{
+	std::string method;
+	uint64_t calls;
+	uint64_t errors;
+	uint64_t in_flight;
+	uint64_t request_bytes;
+	uint64_t response_bytes;
+	uint64_t mean_us;
+	uint64_t p50_us;
+	uint64_t p90_us;
+	uint64_t p99_us;
+	uint64_t max_us;
+
+	BEGIN_KV_SERIALIZE_MAP(rpc_method_stats)
+	KV_SERIALIZE(method)
+	KV_SERIALIZE(calls)
+	KV_SERIALIZE(errors)
+	KV_SERIALIZE(in_flight)
+	KV_SERIALIZE(request_bytes)
+	KV_SERIALIZE(response_bytes)
+	KV_SERIALIZE(mean_us)
+	KV_SERIALIZE(p50_us)
+	KV_SERIALIZE(p90_us)
+	KV_SERIALIZE(p99_us)
+	KV_SERIALIZE(max_us)
+	END_KV_SERIALIZE_MAP()
+};
+
+struct rpc_cost_class_stats
+{
+	std::string cost_class;
+	uint64_t limit;
+	uint64_t active;
+	uint64_t waiting;
+	uint64_t admitted;
+	uint64_t shed;
+	uint64_t avg_service_us;
+
+	BEGIN_KV_SERIALIZE_MAP(rpc_cost_class_stats)
+	KV_SERIALIZE(cost_class)
+	KV_SERIALIZE(limit)
+	KV_SERIALIZE(active)
+	KV_SERIALIZE(waiting)
+	KV_SERIALIZE(admitted)
+	KV_SERIALIZE(shed)
+	KV_SERIALIZE(avg_service_us)
+	END_KV_SERIALIZE_MAP()
+};
+
+struct COMMAND_RPC_GET_RPC_METRICS
+{
+	struct request
+	{
+		BEGIN_KV_SERIALIZE_MAP(request)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct response
+	{
+		std::vector<rpc_method_stats> methods;
+		uint64_t lock_acquisitions;
+		uint64_t lock_contended;
+		uint64_t lock_wait_us;
+		uint64_t lock_wait_p99_us;
+		uint64_t lock_wait_max_us;
+		std::vector<rpc_cost_class_stats> cost_classes;
+		std::string status;
+
+		BEGIN_KV_SERIALIZE_MAP(response)
+		KV_SERIALIZE(methods)
+		KV_SERIALIZE(lock_acquisitions)
+		KV_SERIALIZE(lock_contended)
+		KV_SERIALIZE(lock_wait_us)
+		KV_SERIALIZE(lock_wait_p99_us)
+		KV_SERIALIZE(lock_wait_max_us)
+		KV_SERIALIZE(cost_classes)
 		KV_SERIALIZE(status)
 		END_KV_SERIALIZE_MAP()
 	};
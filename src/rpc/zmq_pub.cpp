@@ -0,0 +1,259 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "zmq_pub.h"
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "string_tools.h"
+
+namespace cryptonote
+{
+
+namespace rpc
+{
+
+namespace
+{
+void write_hash(rapidjson::Writer<rapidjson::StringBuffer> &writer, const crypto::hash &h)
+{
+	const std::string hex = epee::string_tools::pod_to_hex(h);
+	writer.String(hex.data(), hex.size());
+}
+
+}
+
+ZmqPublisher::ZmqPublisher(size_t max_queue_size) : context(1),
+													 max_queue_size(max_queue_size),
+													 dropped(0),
+													 stop_signal(false),
+													 running(false)
+{
+}
+
+ZmqPublisher::~ZmqPublisher()
+{
+	stop();
+}
+
+bool ZmqPublisher::addTCPSocket(std::string address, std::string port)
+{
+	try
+	{
+		std::string addr_prefix("tcp://");
+
+		pub_socket.reset(new zmq::socket_t(context, ZMQ_PUB));
+
+		// don't hang on shutdown because of slow subscribers
+		int linger = 0;
+		pub_socket->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+
+		std::string bind_address = addr_prefix + address + std::string(":") + port;
+		pub_socket->bind(bind_address.c_str());
+	}
+	catch(const std::exception &e)
+	{
+		GULPS_ERROR(std::string("Error creating ZMQ PUB Socket: "), e.what());
+		return false;
+	}
+	return true;
+}
+
+void ZmqPublisher::run()
+{
+	{
+		boost::unique_lock<boost::mutex> lock(queue_lock);
+		running = true;
+	}
+	run_thread = boost::thread(boost::bind(&ZmqPublisher::serve, this));
+}
+
+void ZmqPublisher::stop()
+{
+	if(!running)
+		return;
+
+	{
+		boost::unique_lock<boost::mutex> lock(queue_lock);
+		stop_signal = true;
+	}
+	queue_cond.notify_one();
+	run_thread.join();
+
+	boost::unique_lock<boost::mutex> lock(queue_lock);
+	queue.clear();
+	running = false;
+}
+
+void ZmqPublisher::on_block_added(uint64_t height, const crypto::hash &id, const std::vector<crypto::hash> &tx_hashes)
+{
+	publish({event_block_added, height, id, tx_hashes});
+}
+
+void ZmqPublisher::on_block_removed(uint64_t height, const crypto::hash &id, const std::vector<crypto::hash> &tx_hashes)
+{
+	publish({event_block_removed, height, id, tx_hashes});
+}
+
+void ZmqPublisher::on_txpool_tx_added(const crypto::hash &txid)
+{
+	publish({event_txpool_add, 0, txid, {}});
+}
+
+void ZmqPublisher::on_txpool_tx_removed(const crypto::hash &txid)
+{
+	publish({event_txpool_remove, 0, txid, {}});
+}
+
+const char *ZmqPublisher::event_topic(event_type type)
+{
+	switch(type)
+	{
+	case event_block_added:
+		return "block_added";
+	case event_block_removed:
+		return "block_removed";
+	case event_txpool_add:
+		return "txpool_add";
+	case event_txpool_remove:
+		return "txpool_remove";
+	}
+	return "";
+}
+
+std::string ZmqPublisher::event_body(const event &ev)
+{
+	rapidjson::StringBuffer buf;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+
+	writer.StartObject();
+	if(ev.type == event_block_added || ev.type == event_block_removed)
+	{
+		writer.Key("height");
+		writer.Uint64(ev.height);
+		writer.Key("hash");
+		write_hash(writer, ev.id);
+		writer.Key("tx_hashes");
+		writer.StartArray();
+		for(const crypto::hash &h : ev.tx_hashes)
+			write_hash(writer, h);
+		writer.EndArray();
+	}
+	else
+	{
+		writer.Key("tx_hash");
+		write_hash(writer, ev.id);
+	}
+	writer.EndObject();
+
+	return std::string(buf.GetString(), buf.GetSize());
+}
+
+void ZmqPublisher::send(const std::string &topic, const std::string &body)
+{
+	zmq::message_t topic_msg(topic.size());
+	memcpy(topic_msg.data(), topic.data(), topic.size());
+	zmq::message_t body_msg(body.size());
+	memcpy(body_msg.data(), body.data(), body.size());
+	pub_socket->send(topic_msg, ZMQ_SNDMORE);
+	pub_socket->send(body_msg);
+}
+
+void ZmqPublisher::publish(event &&ev)
+{
+	{
+		boost::unique_lock<boost::mutex> lock(queue_lock);
+		if(!running || stop_signal)
+			return;
+		// drop the oldest events rather than growing without bound when the sender can't keep up
+		if(queue.size() >= max_queue_size)
+		{
+			queue.pop_front();
+			++dropped;
+		}
+		queue.push_back(std::move(ev));
+	}
+	queue_cond.notify_one();
+}
+
+void ZmqPublisher::serve()
+{
+	std::deque<event> events;
+	while(true)
+	{
+		uint64_t n_dropped;
+		{
+			boost::unique_lock<boost::mutex> lock(queue_lock);
+			while(queue.empty() && !stop_signal)
+				queue_cond.wait(lock);
+			if(stop_signal)
+				return;
+			events.swap(queue);
+			n_dropped = dropped;
+			dropped = 0;
+		}
+
+		if(n_dropped)
+			GULPSF_WARN("ZMQ publisher queue full, dropped {} events", n_dropped);
+
+		try
+		{
+			for(const event &ev : events)
+			{
+				const std::string topic = event_topic(ev.type);
+				const std::string body = event_body(ev);
+				send(topic, body);
+				GULPS_LOG_L2("Published ", topic, ": ", body);
+			}
+		}
+		catch(const zmq::error_t &e)
+		{
+			GULPS_ERROR(std::string("ZMQ error: "), e.what());
+		}
+		events.clear();
+	}
+}
+
+} // namespace rpc
+
+} // namespace cryptonote
@@ -0,0 +1,138 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <zmq.hpp>
+
+#include "cryptonote_core/core_events.h"
+
+#include "common/gulps.hpp"
+
+namespace cryptonote
+{
+
+namespace rpc
+{
+
+static constexpr size_t DEFAULT_ZMQ_PUB_QUEUE_SIZE = 10000;
+
+/**
+ * @brief publishes block and txpool events on a ZMQ PUB socket
+ *
+ * Every event is sent as two frames: the topic ("block_added",
+ * "block_removed", "txpool_add" or "txpool_remove") followed by a compact
+ * JSON body, so subscribers can filter by topic prefix. The core callbacks
+ * only copy the event data into a queue; a dedicated thread owns the socket
+ * and does the formatting and sending, so no core lock is held meanwhile.
+ */
+class ZmqPublisher : public i_core_events
+{
+	GULPS_CAT_MAJOR("zmq_pub");
+  public:
+	ZmqPublisher(size_t max_queue_size = DEFAULT_ZMQ_PUB_QUEUE_SIZE);
+
+	~ZmqPublisher();
+
+	bool addTCPSocket(std::string address, std::string port);
+
+	void run();
+	void stop();
+
+	void on_block_added(uint64_t height, const crypto::hash &id, const std::vector<crypto::hash> &tx_hashes) override;
+	void on_block_removed(uint64_t height, const crypto::hash &id, const std::vector<crypto::hash> &tx_hashes) override;
+	void on_txpool_tx_added(const crypto::hash &txid) override;
+	void on_txpool_tx_removed(const crypto::hash &txid) override;
+
+  protected:
+	// sends one event to the subscribers, called on the publisher thread only
+	virtual void send(const std::string &topic, const std::string &body);
+
+  private:
+	enum event_type
+	{
+		event_block_added,
+		event_block_removed,
+		event_txpool_add,
+		event_txpool_remove
+	};
+
+	// only what the callbacks are given, the JSON body is built on the publisher thread
+	struct event
+	{
+		event_type type;
+		uint64_t height;
+		crypto::hash id;
+		std::vector<crypto::hash> tx_hashes;
+	};
+
+	static const char *event_topic(event_type type);
+	static std::string event_body(const event &ev);
+
+	void publish(event &&ev);
+	void serve();
+
+	zmq::context_t context;
+	std::unique_ptr<zmq::socket_t> pub_socket;
+
+	boost::mutex queue_lock;
+	boost::condition_variable queue_cond;
+	std::deque<event> queue;
+	size_t max_queue_size;
+	uint64_t dropped;
+
+	bool stop_signal;
+	bool running;
+	boost::thread run_thread;
+};
+
+} // namespace rpc
+
+} // namespace cryptonote
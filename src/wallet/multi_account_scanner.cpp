@@ -0,0 +1,333 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <memory>
+#include <tuple>
+
+#include "multi_account_scanner.h"
+#include "common/threadpool.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
+#include "wallet_errors.h"
+
+namespace tools
+{
+GULPS_CAT_MAJOR("wallet_tx_scan");
+
+constexpr size_t multi_account_scanner::parallel_account_count;
+
+bool tx_scan_keys::load(const crypto::hash &txid, const cryptonote::transaction &tx)
+{
+	std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+	if(!cryptonote::parse_tx_extra(tx.extra, tx_extra_fields))
+	{
+		// Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
+		GULPS_LOG_L0("Transaction extra has unsupported format: ", txid);
+	}
+
+	cryptonote::tx_extra_pub_key pub_key_field;
+	if(!cryptonote::find_tx_extra_field_by_type(tx_extra_fields, pub_key_field))
+	{
+		GULPS_LOG_L0("Public key wasn't found in the transaction extra. Skipping transaction ", txid);
+		return false;
+	}
+	tx_pub_key = pub_key_field.pub_key;
+
+	cryptonote::tx_extra_additional_pub_keys additional_pub_keys;
+	if(cryptonote::find_tx_extra_field_by_type(tx_extra_fields, additional_pub_keys))
+		additional_tx_pub_keys = std::move(additional_pub_keys.data);
+	else
+		additional_tx_pub_keys.clear();
+	return true;
+}
+
+size_t multi_account_scanner::add_account(const crypto::secret_key &view_secret_key, const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses)
+{
+	const size_t idx = m_view_keys.size();
+	m_view_keys.push_back(view_secret_key);
+	m_subaddresses.reserve(m_subaddresses.size() + subaddresses.size());
+	for(const auto &sub : subaddresses)
+		m_subaddresses.emplace(sub.first, std::make_pair(idx, sub.second));
+	return idx;
+}
+
+size_t multi_account_scanner::scan_tx(uint64_t height, size_t tx_idx, const crypto::hash &txid, const cryptonote::transaction &tx, std::vector<matched_output> &matches) const
+{
+	std::vector<tx_outputs> txos(1);
+	txos[0].block_height = height;
+	txos[0].tx_idx = tx_idx;
+	txos[0].txid = &txid;
+	txos[0].tx = &tx;
+	if(!txos[0].keys.load(txid, tx))
+		return 0;
+	return scan(txos, matches);
+}
+
+size_t multi_account_scanner::scan_block(uint64_t height, const cryptonote::block &blk, const std::vector<cryptonote::transaction> &txs, std::vector<matched_output> &matches) const
+{
+	THROW_WALLET_EXCEPTION_IF(txs.size() != blk.tx_hashes.size(), error::wallet_internal_error, "Wrong amount of transactions for block");
+
+	const crypto::hash miner_tx_hash = cryptonote::get_transaction_hash(blk.miner_tx);
+	std::vector<tx_outputs> txos;
+	txos.reserve(txs.size() + 1);
+	for(size_t i = 0; i <= txs.size(); i++)
+	{
+		tx_outputs txo;
+		txo.block_height = height;
+		txo.tx_idx = i;
+		txo.txid = i == 0 ? &miner_tx_hash : &blk.tx_hashes[i - 1];
+		txo.tx = i == 0 ? &blk.miner_tx : &txs[i - 1];
+		if(txo.keys.load(*txo.txid, *txo.tx))
+			txos.push_back(std::move(txo));
+	}
+	return scan(txos, matches);
+}
+
+size_t multi_account_scanner::scan_block(uint64_t height, const cryptonote::block_complete_entry_v &entry, std::vector<matched_output> &matches) const
+{
+	cryptonote::block blk;
+	bool r = cryptonote::parse_and_validate_block_from_blob(entry.block, blk);
+	THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, entry.block);
+
+	std::vector<cryptonote::transaction> txs(entry.txs.size());
+	for(size_t i = 0; i < entry.txs.size(); i++)
+	{
+		r = cryptonote::parse_and_validate_tx_base_from_blob(entry.txs[i], txs[i]);
+		THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, entry.txs[i]);
+	}
+	return scan_block(height, blk, txs, matches);
+}
+
+size_t multi_account_scanner::scan(const std::vector<tx_outputs> &txos, std::vector<matched_output> &matches) const
+{
+	const size_t prev_size = matches.size();
+	const size_t account_cnt = m_view_keys.size();
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	const size_t thd_cnt = tpool.get_max_concurrency();
+	if(txos.empty() || account_cnt == 0)
+		return 0;
+
+	if(account_cnt < parallel_account_count || thd_cnt < 2)
+	{
+		scan_accounts(txos, 0, account_cnt, matches);
+	}
+	else
+	{
+		const size_t per_thd = (account_cnt + thd_cnt - 1) / thd_cnt;
+		std::vector<std::vector<matched_output>> thd_matches(thd_cnt);
+		tools::threadpool::waiter waiter;
+		for(size_t i = 0; i < thd_cnt && i * per_thd < account_cnt; i++)
+		{
+			tpool.submit(&waiter, [&, i]() {
+				scan_accounts(txos, i * per_thd, std::min(account_cnt, (i + 1) * per_thd), thd_matches[i]);
+			});
+		}
+		waiter.wait();
+
+		for(auto &m : thd_matches)
+			matches.insert(matches.end(), m.begin(), m.end());
+	}
+
+	std::sort(matches.begin() + prev_size, matches.end(), [](const matched_output &a, const matched_output &b) {
+		return std::tie(a.account_idx, a.tx_idx, a.out_idx) < std::tie(b.account_idx, b.tx_idx, b.out_idx);
+	});
+	return matches.size() - prev_size;
+}
+
+void multi_account_scanner::scan_accounts(const std::vector<tx_outputs> &txos, size_t begin, size_t end, std::vector<matched_output> &matches) const
+{
+	// Everything below is batched over the accounts, with entries grouped by the key that
+	// gets decompressed: the tx pubkey for derivations and the output key for spend keys
+	const size_t acc_cnt = end - begin;
+	const crypto::secret_key *view_keys = &m_view_keys[begin];
+	std::vector<crypto::public_key> pub_keys;
+	std::vector<crypto::secret_key> sec_keys;
+	std::vector<crypto::key_derivation> derivations;
+	std::vector<crypto::public_key> out_keys;
+	std::vector<crypto::key_derivation> out_derivations;
+	std::vector<size_t> out_indices;
+	std::vector<size_t> out_accounts;
+	std::vector<crypto::public_key> spend_keys;
+	std::vector<bool> dropped;
+
+	auto find_account = [this](const crypto::public_key &spendkey, size_t account_idx) -> const cryptonote::subaddress_index * {
+		auto range = m_subaddresses.equal_range(spendkey);
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			if(it->second.first == account_idx)
+				return &it->second.second;
+		}
+		return nullptr;
+	};
+
+	auto derive_spend_keys = [&]() -> std::unique_ptr<bool[]> {
+		std::unique_ptr<bool[]> ok(new bool[out_keys.size()]);
+		spend_keys.resize(out_keys.size());
+#ifdef HAVE_EC_64
+		crypto::derive_subaddress_public_keys_64(out_keys.data(), out_derivations.data(), out_indices.data(), out_keys.size(), spend_keys.data(), ok.get());
+#else
+		crypto::derive_subaddress_public_keys(out_keys.data(), out_derivations.data(), out_indices.data(), out_keys.size(), spend_keys.data(), ok.get());
+#endif
+		return ok;
+	};
+
+	for(const tx_outputs &txo : txos)
+	{
+		const cryptonote::transaction &tx = *txo.tx;
+		const size_t additional_cnt = txo.keys.additional_tx_pub_keys.size();
+		const size_t matches_start = matches.size();
+
+		// derivations[k * acc_cnt + a], k = 0 is the main tx pubkey, k > 0 the additional ones
+		pub_keys.clear();
+		sec_keys.clear();
+		pub_keys.insert(pub_keys.end(), acc_cnt, txo.keys.tx_pub_key);
+		sec_keys.insert(sec_keys.end(), view_keys, view_keys + acc_cnt);
+		for(const crypto::public_key &pk : txo.keys.additional_tx_pub_keys)
+		{
+			pub_keys.insert(pub_keys.end(), acc_cnt, pk);
+			sec_keys.insert(sec_keys.end(), view_keys, view_keys + acc_cnt);
+		}
+
+		derivations.resize(pub_keys.size());
+		std::unique_ptr<bool[]> derivation_ok(new bool[pub_keys.size()]);
+#ifdef HAVE_EC_64
+		crypto::generate_key_derivations_64(pub_keys.data(), sec_keys.data(), pub_keys.size(), derivations.data(), derivation_ok.get());
+#else
+		crypto::generate_key_derivations(pub_keys.data(), sec_keys.data(), pub_keys.size(), derivations.data(), derivation_ok.get());
+#endif
+		for(size_t i = 0; i < derivations.size(); i++)
+		{
+			if(!derivation_ok[i])
+				memcpy(&derivations[i], rct::identity().bytes, sizeof(derivations[i]));
+		}
+
+		out_keys.clear();
+		out_derivations.clear();
+		out_indices.clear();
+		out_accounts.clear();
+		for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
+		{
+			if(tx.vout[out_idx].target.type() != typeid(cryptonote::txout_to_key))
+				continue;
+
+			const crypto::public_key &out_pubkey = boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key;
+			for(size_t a = 0; a < acc_cnt; a++)
+			{
+				out_keys.push_back(out_pubkey);
+				out_derivations.push_back(derivations[a]);
+				out_indices.push_back(out_idx);
+				out_accounts.push_back(a);
+			}
+		}
+
+		auto add_match = [&](size_t i, const cryptonote::subaddress_index &subaddr_index) {
+			matched_output m;
+			m.account_idx = begin + out_accounts[i];
+			m.block_height = txo.block_height;
+			m.txid = *txo.txid;
+			m.tx_idx = txo.tx_idx;
+			m.out_idx = out_indices[i];
+			m.out_key = out_keys[i];
+			m.derivation = out_derivations[i];
+			m.subaddr_index = subaddr_index;
+			matches.push_back(m);
+		};
+
+		std::unique_ptr<bool[]> derive_ok = derive_spend_keys();
+		size_t miss_cnt = 0;
+		for(size_t i = 0; i < out_keys.size(); i++)
+		{
+			const cryptonote::subaddress_index *found = derive_ok[i] ? find_account(spend_keys[i], begin + out_accounts[i]) : nullptr;
+			if(found != nullptr)
+			{
+				add_match(i, *found);
+				continue;
+			}
+
+			// keep the misses at the front for the additional tx pubkeys
+			if(derive_ok[i] && additional_cnt != 0)
+			{
+				out_keys[miss_cnt] = out_keys[i];
+				out_indices[miss_cnt] = out_indices[i];
+				out_accounts[miss_cnt] = out_accounts[i];
+				miss_cnt++;
+			}
+		}
+
+		if(miss_cnt == 0)
+			continue;
+
+		// An output past the additional pubkeys makes block_scan_tx drop the whole tx for that account
+		dropped.assign(acc_cnt, false);
+		size_t try_cnt = 0;
+		for(size_t i = 0; i < miss_cnt; i++)
+		{
+			if(out_indices[i] >= additional_cnt)
+			{
+				dropped[out_accounts[i]] = true;
+				continue;
+			}
+			out_keys[try_cnt] = out_keys[i];
+			out_indices[try_cnt] = out_indices[i];
+			out_accounts[try_cnt] = out_accounts[i];
+			out_derivations[try_cnt] = derivations[(out_indices[i] + 1) * acc_cnt + out_accounts[i]];
+			try_cnt++;
+		}
+		out_keys.resize(try_cnt);
+		out_derivations.resize(try_cnt);
+		out_indices.resize(try_cnt);
+		out_accounts.resize(try_cnt);
+
+		derive_ok = derive_spend_keys();
+		for(size_t i = 0; i < try_cnt; i++)
+		{
+			const cryptonote::subaddress_index *found = derive_ok[i] ? find_account(spend_keys[i], begin + out_accounts[i]) : nullptr;
+			if(found != nullptr)
+				add_match(i, *found);
+		}
+
+		auto drop = std::remove_if(matches.begin() + matches_start, matches.end(), [&](const matched_output &m) {
+			return dropped[m.account_idx - begin];
+		});
+		matches.erase(drop, matches.end());
+	}
+}
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace tools
+{
+// Public keys of a transaction needed to scan its outputs, read with a single tx extra parse
+struct tx_scan_keys
+{
+	crypto::public_key tx_pub_key;
+	std::vector<crypto::public_key> additional_tx_pub_keys;
+
+	// false if the tx has no public key, in which case there is nothing to scan
+	bool load(const crypto::hash &txid, const cryptonote::transaction &tx);
+};
+
+// Scans blocks for any number of view-only accounts at once. Blocks and tx extras are parsed
+// once and every derived output key is probed against one table holding all subaddresses.
+// Matches come out ordered by account, then by position in the block.
+class multi_account_scanner
+{
+  public:
+	struct matched_output
+	{
+		size_t account_idx;
+		uint64_t block_height;
+		crypto::hash txid;
+		size_t tx_idx; // 0 is the miner tx, same as block_output_indices
+		size_t out_idx;
+		crypto::public_key out_key;
+		crypto::key_derivation derivation;
+		cryptonote::subaddress_index subaddr_index;
+	};
+
+	// Accounts with at least this many keys are split across the thread pool
+	static constexpr size_t parallel_account_count = 256;
+
+	// Returns the account index used in matched_output. The main address must be in the
+	// subaddress table as {0, 0}, the same as wallet2::m_subaddresses.
+	size_t add_account(const crypto::secret_key &view_secret_key, const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses);
+	size_t account_count() const { return m_view_keys.size(); }
+
+	size_t scan_tx(uint64_t height, size_t tx_idx, const crypto::hash &txid, const cryptonote::transaction &tx, std::vector<matched_output> &matches) const;
+	size_t scan_block(uint64_t height, const cryptonote::block &blk, const std::vector<cryptonote::transaction> &txs, std::vector<matched_output> &matches) const;
+	// Parses a getblocks.bin entry, pruned txs are enough
+	size_t scan_block(uint64_t height, const cryptonote::block_complete_entry_v &entry, std::vector<matched_output> &matches) const;
+
+  private:
+	struct tx_outputs
+	{
+		uint64_t block_height;
+		size_t tx_idx;
+		const crypto::hash *txid;
+		const cryptonote::transaction *tx;
+		tx_scan_keys keys;
+	};
+
+	size_t scan(const std::vector<tx_outputs> &txos, std::vector<matched_output> &matches) const;
+	void scan_accounts(const std::vector<tx_outputs> &txos, size_t begin, size_t end, std::vector<matched_output> &matches) const;
+
+	std::vector<crypto::secret_key> m_view_keys;
+	// Subaddress spend key -> owning account and index. Different accounts can share a spend key.
+	std::unordered_multimap<crypto::public_key, std::pair<size_t, cryptonote::subaddress_index>> m_subaddresses;
+};
+}
@@ -52,12 +52,14 @@
 #include <boost/format.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/utility/value_init.hpp>
+#include <exception>
 #include <numeric>
 #include <random>
 #include <tuple>
 #include <regex>
 
 
+#include "blockchain_db/blockchain_db.h"
 #include "common/apply_permutation.h"
 #include "common/base58.h"
 #include "common/boost_serialization_helper.h"
@@ -148,6 +150,49 @@ std::string get_default_ringdb_path()
 	dir /= ".shared-ringdb";
 	return dir.string();
 }
+
+// Folds the parts of a transfer that change after it is received, the cache journal
+// rewrites a transfer whenever this differs from the value it had at the last store
+uint64_t transfer_fingerprint(const tools::wallet2::transfer_details &td)
+{
+	uint64_t h = td.m_block_height ^ (td.m_spent_height << 1) ^ (uint64_t(td.m_spent) << 63) ^
+				 (uint64_t(td.m_key_image_known) << 62) ^ (uint64_t(td.m_key_image_partial) << 61);
+	for(size_t i = 0; i < sizeof(crypto::hash); i += sizeof(uint64_t))
+	{
+		uint64_t a, b;
+		memcpy(&a, td.m_txid.data + i, sizeof(a));
+		memcpy(&b, &td.m_key_image.data[i], sizeof(b));
+		h = (h ^ a) * 0x9e3779b97f4a7c15ull;
+		h = (h ^ b) * 0x9e3779b97f4a7c15ull;
+	}
+	return h ^ td.m_global_output_index;
+}
+
+// Calls take(entry) in order for the entries accept lets through with min_height < height <= max_height
+// that come after the cursor. Stops at the first position change once max_count entries were taken,
+// so a page always ends on a whole tx. Returns true if an accepted entry was left for the next page.
+template <typename T, typename A, typename F>
+bool walk_transfer_index(const std::multimap<tools::wallet2::transfer_position, const T *> *index, uint64_t min_height, uint64_t max_height,
+						 const boost::optional<tools::wallet2::transfer_position> &after, size_t max_count, A accept, F take)
+{
+	if(index == nullptr || min_height >= max_height)
+		return false;
+	const tools::wallet2::transfer_position first = {min_height + 1, crypto::null_hash};
+	auto it = after && !(*after < first) ? index->upper_bound(*after) : index->lower_bound(first);
+	size_t count = 0;
+	tools::wallet2::transfer_position last = first;
+	for(; it != index->end() && it->first.height <= max_height; ++it)
+	{
+		if(!accept(*it->second))
+			continue;
+		if(max_count != 0 && count >= max_count && !(it->first == last))
+			return true;
+		take(*it->second);
+		++count;
+		last = it->first;
+	}
+	return false;
+}
 }
 
 namespace
@@ -165,6 +210,8 @@ struct options
 	const command_line::arg_descriptor<bool> stagenet = {"stagenet", tools::wallet2::tr("For stagenet. Daemon must also be launched with --stagenet flag"), false};
 	const command_line::arg_descriptor<bool> force_network = {"force-network", tools::wallet2::tr("Disregard mainnet/testnet/stagenet network checks. Don't use this option."), false};
 	const command_line::arg_descriptor<bool> restricted = {"restricted-rpc", tools::wallet2::tr("Restricts to view-only commands"), false};
+	const command_line::arg_descriptor<bool> refresh_from_digests = {"refresh-from-digests", tools::wallet2::tr("Scan compact tx digests from the daemon and download only the blocks that match"), false};
+	const command_line::arg_descriptor<std::string> local_blockchain_dir = {"local-blockchain-dir", tools::wallet2::tr("Refresh from the blockchain database of a daemon on this host, found in data directory <arg>"), ""};
 	const command_line::arg_descriptor<std::string, false, true> shared_ringdb_dir = {
 		"shared-ringdb-dir", tools::wallet2::tr("Set shared ring database path"),
 		get_default_ringdb_path(),
@@ -256,6 +303,10 @@ std::unique_ptr<tools::wallet2> make_basic(const boost::program_options::variabl
 	wallet->init(std::move(daemon_address), std::move(login));
 	boost::filesystem::path ringdb_path = command_line::get_arg(vm, opts.shared_ringdb_dir);
 	wallet->set_ring_database(ringdb_path.string());
+	wallet->refresh_from_digests(command_line::get_arg(vm, opts.refresh_from_digests));
+	const std::string local_blockchain_dir = command_line::get_arg(vm, opts.local_blockchain_dir);
+	THROW_WALLET_EXCEPTION_IF(!wallet->set_local_blockchain(local_blockchain_dir), tools::error::wallet_internal_error,
+							  tools::wallet2::tr("failed to open the blockchain database in ") + local_blockchain_dir);
 	return wallet;
 }
 
@@ -599,6 +650,9 @@ namespace tools
 const size_t MAX_SPLIT_ATTEMPTS = 30;
 
 constexpr const std::chrono::seconds wallet2::rpc_timeout;
+constexpr const size_t wallet2::block_dl_connections;
+constexpr const uint64_t wallet2::block_dl_safe_depth;
+const uint64_t wallet2::rct_recent_blocks = RECENT_OUTPUT_ZONE / common_config::DIFFICULTY_TARGET;
 const char *wallet2::tr(const char *str) { return i18n_translate(str, "tools::wallet2"); }
 
 wallet2::wallet2(network_type nettype, bool restricted) : m_multisig_rescan_info(NULL),
@@ -636,7 +690,10 @@ wallet2::wallet2(network_type nettype, bool restricted) : m_multisig_rescan_info
 														  m_subaddress_lookahead_minor(SUBADDRESS_LOOKAHEAD_MINOR),
 														  m_key_on_device(false),
 														  m_ring_history_saved(false),
-														  m_ringdb()
+														  m_refresh_from_digests(false),
+														  m_ringdb(),
+														  m_rct_distribution_start(0),
+														  m_rct_timestamps_start(0)
 {
 }
 
@@ -668,6 +725,8 @@ void wallet2::init_options(boost::program_options::options_description &desc_par
 	command_line::add_arg(desc_params, opts.force_network);
 	command_line::add_arg(desc_params, opts.restricted);
 	command_line::add_arg(desc_params, opts.shared_ringdb_dir);
+	command_line::add_arg(desc_params, opts.refresh_from_digests);
+	command_line::add_arg(desc_params, opts.local_blockchain_dir);
 }
 
 std::unique_ptr<wallet2> wallet2::make_from_json(const boost::program_options::variables_map &vm, const std::string &json_file, const std::function<boost::optional<tools::password_container>(const char *, bool)> &password_prompter)
@@ -720,6 +779,9 @@ bool wallet2::init(std::string daemon_address, boost::optional<epee::net_utils::
 	m_upper_transaction_size_limit = upper_transaction_size_limit;
 	m_daemon_address = std::move(daemon_address);
 	m_daemon_login = std::move(daemon_login);
+	m_daemon_ssl = ssl;
+	m_rct_distribution.clear();
+	m_rct_timestamps.clear();
 	return m_http_client.set_server(get_daemon_address(), get_daemon_login(), ssl);
 }
 //----------------------------------------------------------------------------------------------------
@@ -1222,13 +1284,12 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 						td.m_block_height = height;
 						td.m_internal_output_index = o;
 						td.m_global_output_index = o_indices[o];
-						td.m_tx = (const cryptonote::transaction_prefix &)tx;
+						td.set_tx(tx);
 						td.m_txid = txid;
 						td.m_key_image = tx_scan_info[o].ki;
 						td.m_key_image_known = !m_watch_only && !m_multisig;
 						td.m_key_image_partial = m_multisig;
 						td.m_amount = amount;
-						td.m_pk_index = 0;
 						td.m_subaddr_index = tx_scan_info[o].received->index;
 						expand_subaddresses(tx_scan_info[o].received->index);
 						if(tx.vout[o].amount == 0)
@@ -1295,10 +1356,9 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 						td.m_block_height = height;
 						td.m_internal_output_index = o;
 						td.m_global_output_index = o_indices[o];
-						td.m_tx = (const cryptonote::transaction_prefix &)tx;
+						td.set_tx(tx);
 						td.m_txid = txid;
 						td.m_amount = amount;
-						td.m_pk_index = 0;
 						td.m_subaddr_index = tx_scan_info[o].received->index;
 						expand_subaddresses(tx_scan_info[o].received->index);
 						if(tx.vout[o].amount == 0)
@@ -1494,7 +1554,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 					m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
 			}
 			else
-				m_payments.emplace(payment_id, payment);
+				index_payment(*m_payments.emplace(payment_id, payment));
 			GULPS_LOG_L2("Payment found in ", (pool ? "pool" : "block"), ": ", payment_id, " / ", payment.m_tx_hash, " / ", payment.m_amount);
 		}
 	}
@@ -1512,7 +1572,9 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 		{
 			try
 			{
-				m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+				auto entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+				if(entry.second)
+					index_confirmed_tx(*entry.first);
 			}
 			catch(...)
 			{
@@ -1548,6 +1610,10 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
 		entry.first->second.m_subaddr_account = subaddr_account;
 		entry.first->second.m_subaddr_indices = subaddr_indices;
 	}
+	else
+	{
+		m_confirmed_txs_index.remove({entry.first->second.m_block_height, txid}, entry.first->second.m_subaddr_account, &*entry.first);
+	}
 
 	for(const auto &in : tx.vin)
 	{
@@ -1559,6 +1625,7 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
 	entry.first->second.m_block_height = height;
 	entry.first->second.m_timestamp = ts;
 	entry.first->second.m_unlock_time = tx.unlock_time;
+	index_confirmed_tx(*entry.first);
 
 	add_rings(tx);
 }
@@ -1983,7 +2050,20 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 	THROW_WALLET_EXCEPTION_IF(res->blocks_parsed.size() == 0, error::wallet_internal_error, "Integrated blocks vector is empty");
 	THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(res->blocks_parsed.front().block_height), error::wallet_internal_error, "Index out of bounds of hashchain");
 	GULPSF_LOG_L1("Integrating results blocks: {} - {}", res->blocks_parsed.front().block_height, res->blocks_parsed.back().block_height);
-	
+
+	// The blocks past the first one we don't have are new, a reorg detaches everything above it.
+	// Matched blocks of a digest refresh are downloaded before any of them is committed, so a
+	// failed download leaves the wallet where it was and the next refresh scans them again.
+	size_t first_new_block = 0;
+	while(first_new_block < res->blocks_parsed.size())
+	{
+		const auto& bl = res->blocks_parsed[first_new_block];
+		if(bl.block_height >= m_blockchain.size() || m_blockchain[bl.block_height] != bl.block_hash)
+			break;
+		first_new_block++;
+	}
+	pull_matched_txs(res, first_new_block);
+
 	for(auto& bl : res->blocks_parsed)
 	{
 		if(bl.block_height < m_blockchain.size())
@@ -2239,7 +2319,7 @@ bool wallet2::refresh(uint64_t &blocks_fetched, bool &received_money, bool &ok)
 	return ok;
 }
 //----------------------------------------------------------------------------------------------------
-bool wallet2::get_output_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution)
+bool wallet2::get_output_distribution(uint64_t from_height, uint64_t &start_height, std::vector<uint64_t> &distribution)
 {
 	uint32_t rpc_version;
 	boost::optional<std::string> result = m_node_rpc_proxy.get_rpc_version(rpc_version);
@@ -2271,7 +2351,7 @@ bool wallet2::get_output_distribution(uint64_t &start_height, std::vector<uint64
 	cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
 	cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
 	req.amounts.push_back(0);
-	req.from_height = 0;
+	req.from_height = from_height;
 	req.cumulative = true;
 	m_daemon_rpc_mutex.lock();
 	bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req, res, m_http_client, rpc_timeout);
@@ -2306,8 +2386,159 @@ bool wallet2::get_output_distribution(uint64_t &start_height, std::vector<uint64
 	return true;
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::update_rct_distribution(uint64_t height)
+{
+	if(!m_rct_distribution.empty() && m_rct_distribution_start + m_rct_distribution.size() >= height)
+		return true;
+
+	// ask for the last cached block again, its cumulative count tells us whether the daemon still agrees with us
+	const bool incremental = !m_rct_distribution.empty();
+	const uint64_t from_height = incremental ? m_rct_distribution_start + m_rct_distribution.size() - 1 : 0;
+	uint64_t start_height;
+	std::vector<uint64_t> distribution;
+	if(get_output_distribution(from_height, start_height, distribution) && !distribution.empty())
+	{
+		if(!incremental)
+		{
+			m_rct_distribution_start = start_height;
+			m_rct_distribution = std::move(distribution);
+			return true;
+		}
+		if(start_height == from_height && distribution.front() == m_rct_distribution.back())
+		{
+			m_rct_distribution.insert(m_rct_distribution.end(), distribution.begin() + 1, distribution.end());
+			return true;
+		}
+	}
+
+	if(!incremental)
+		return false;
+	GULPS_LOG_L1("RingCT distribution cache does not match the daemon, refetching");
+	m_rct_distribution.clear();
+	m_rct_timestamps.clear();
+	return update_rct_distribution(height);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::get_block_timestamps(uint64_t start_height, uint64_t end_height, std::vector<uint64_t> &timestamps)
+{
+	cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request req = AUTO_VAL_INIT(req);
+	cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response res = AUTO_VAL_INIT(res);
+	req.start_height = start_height;
+	req.end_height = end_height;
+	m_daemon_rpc_mutex.lock();
+	bool r = net_utils::invoke_http_json_rpc("/json_rpc", "getblockheadersrange", req, res, m_http_client, rpc_timeout);
+	m_daemon_rpc_mutex.unlock();
+	if(!r)
+	{
+		GULPS_WARN("Failed to request block headers: no connection to daemon");
+		return false;
+	}
+	if(res.status != CORE_RPC_STATUS_OK)
+	{
+		GULPS_WARN("Failed to request block headers: ", res.status);
+		return false;
+	}
+	if(res.headers.size() != end_height - start_height + 1)
+	{
+		GULPS_WARN("Failed to request block headers: not the expected number of results");
+		return false;
+	}
+	timestamps.clear();
+	timestamps.reserve(res.headers.size());
+	for(const cryptonote::block_header_response &header : res.headers)
+		timestamps.push_back(header.timestamp);
+	return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::update_rct_timestamps(uint64_t recent_cutoff)
+{
+	const uint64_t top = m_rct_distribution_start + m_rct_distribution.size();
+	if(m_rct_timestamps.empty() || m_rct_timestamps_start < m_rct_distribution_start || m_rct_timestamps_start > top)
+	{
+		m_rct_timestamps.clear();
+		m_rct_timestamps_start = top;
+	}
+	else if(m_rct_timestamps_start + m_rct_timestamps.size() > top)
+		m_rct_timestamps.resize(top - m_rct_timestamps_start);
+
+	// ask for the last cached block again, a different timestamp means the chain was reorganised under us
+	std::vector<uint64_t> timestamps;
+	if(m_rct_timestamps_start + m_rct_timestamps.size() < top)
+	{
+		const uint64_t from_height = m_rct_timestamps_start + m_rct_timestamps.size() - (m_rct_timestamps.empty() ? 0 : 1);
+		if(!get_block_timestamps(from_height, top - 1, timestamps))
+			return false;
+		if(m_rct_timestamps.empty())
+			m_rct_timestamps = std::move(timestamps);
+		else if(timestamps.front() == m_rct_timestamps.back())
+			m_rct_timestamps.insert(m_rct_timestamps.end(), timestamps.begin() + 1, timestamps.end());
+		else
+		{
+			GULPS_LOG_L1("RingCT timestamp cache does not match the daemon, refetching");
+			m_rct_timestamps.clear();
+			m_rct_timestamps_start = top;
+		}
+	}
+
+	// blocks that came slower than the target push the cutoff further back
+	uint64_t unlocked, recent, stop_height;
+	while(!get_rct_histogram_entry(recent_cutoff, unlocked, recent, &stop_height))
+	{
+		const uint64_t count = std::min<uint64_t>(m_rct_timestamps_start - m_rct_distribution_start, std::max<uint64_t>(rct_recent_blocks, m_rct_timestamps.size()));
+		if(!get_block_timestamps(m_rct_timestamps_start - count, m_rct_timestamps_start - 1, timestamps))
+			return false;
+		m_rct_timestamps.insert(m_rct_timestamps.begin(), timestamps.begin(), timestamps.end());
+		m_rct_timestamps_start -= count;
+	}
+
+	// the cutoff only moves forward, so the blocks below the one that ended the count are not needed again
+	if(stop_height > m_rct_timestamps_start)
+	{
+		m_rct_timestamps.erase(m_rct_timestamps.begin(), m_rct_timestamps.begin() + (stop_height - m_rct_timestamps_start));
+		m_rct_timestamps_start = stop_height;
+	}
+	return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::get_rct_histogram_entry(uint64_t recent_cutoff, uint64_t &unlocked, uint64_t &recent, uint64_t *stop_height) const
+{
+	const uint64_t top = m_rct_distribution_start + m_rct_distribution.size();
+	unlocked = 0;
+	recent = 0;
+	if(stop_height)
+		*stop_height = m_rct_distribution_start;
+	if(top < m_rct_distribution_start + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE)
+		return true;
+	const uint64_t unlocked_idx = top - m_rct_distribution_start - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+	unlocked = m_rct_distribution[unlocked_idx];
+
+	// walk back from the newest unlocked block, blocks without outputs are skipped like the daemon does
+	for(uint64_t idx = unlocked_idx;; --idx)
+	{
+		const uint64_t outputs_before = idx > 0 ? m_rct_distribution[idx - 1] : 0;
+		if(m_rct_distribution[idx] != outputs_before)
+		{
+			const uint64_t height = m_rct_distribution_start + idx;
+			if(height < m_rct_timestamps_start)
+				return false;
+			if(m_rct_timestamps[height - m_rct_timestamps_start] < recent_cutoff)
+			{
+				recent = unlocked - m_rct_distribution[idx];
+				if(stop_height)
+					*stop_height = height;
+				return true;
+			}
+		}
+		if(idx == 0)
+			break;
+	}
+	recent = unlocked;
+	return true;
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::detach_blockchain(uint64_t height)
 {
+	m_cache_journal.valid = false;
 	GULPS_LOG_L0("Detaching blockchain on height ", height);
 
 	// size  1 2 3 4 5 6 7 8 9
@@ -2352,6 +2583,17 @@ void wallet2::detach_blockchain(uint64_t height)
 	m_blockchain.crop(height);
 	m_local_bc_height -= blocks_detached;
 
+	if(height <= m_rct_distribution_start)
+		m_rct_distribution.clear();
+	else if(height - m_rct_distribution_start < m_rct_distribution.size())
+		m_rct_distribution.resize(height - m_rct_distribution_start);
+	if(height <= m_rct_timestamps_start)
+		m_rct_timestamps.clear();
+	else if(height - m_rct_timestamps_start < m_rct_timestamps.size())
+		m_rct_timestamps.resize(height - m_rct_timestamps_start);
+
+	m_payments_index.remove_from_height(height);
+	m_confirmed_txs_index.remove_from_height(height);
 	for(auto it = m_payments.begin(); it != m_payments.end();)
 	{
 		if(height <= it->second.m_block_height)
@@ -2379,6 +2621,7 @@ bool wallet2::deinit()
 //----------------------------------------------------------------------------------------------------
 bool wallet2::clear()
 {
+	m_cache_journal.valid = false;
 	m_blockchain.clear();
 	m_transfers.clear();
 	m_key_images.clear();
@@ -2388,6 +2631,8 @@ bool wallet2::clear()
 	m_tx_keys.clear();
 	m_additional_tx_keys.clear();
 	m_confirmed_txs.clear();
+	m_payments_index.clear();
+	m_confirmed_txs_index.clear();
 	m_unconfirmed_payments.clear();
 	m_scanned_pool_txs[0].clear();
 	m_scanned_pool_txs[1].clear();
@@ -3750,6 +3995,8 @@ void wallet2::load(const std::string &wallet_, const epee::wipeable_string &pass
 				iss << cache_data;
 				boost::archive::portable_binary_iarchive ar(iss);
 				ar >> *this;
+				reset_cache_journal(cache_file_data.iv, cache_file_data.cache_data.size());
+				load_cache_journal(key);
 			}
 			catch(...)
 			{
@@ -3837,6 +4084,7 @@ void wallet2::load(const std::string &wallet_, const epee::wipeable_string &pass
 		add_subaddress_account(tr("Primary account"));
 
 	m_local_bc_height = m_blockchain.size();
+	rebuild_transfer_indices();
 
 	try
 	{
@@ -3936,6 +4184,13 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 			}
 		}
 	}
+	else
+	{
+		crypto::chacha_key key;
+		generate_chacha_key_from_secret_keys(key);
+		if(store_cache_journal(key))
+			return;
+	}
 	// preparing wallet data
 	std::stringstream oss;
 	boost::archive::portable_binary_oarchive ar(oss);
@@ -3976,6 +4231,9 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 		{
 			GULPS_LOG_ERROR("error removing file: ", old_file);
 		}
+		boost::system::error_code ec;
+		boost::filesystem::remove(old_file + ".journal", ec);
+		m_cache_journal.valid = false;
 		// remove old keys file
 		r = boost::filesystem::remove(old_keys_file);
 		if(!r)
@@ -4015,7 +4273,269 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 		// here we have "*.new" file, we need to rename it to be without ".new"
 		std::error_code e = tools::replace_file(new_file, m_wallet_file);
 		THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+
+		// the journal extended the old cache, the new one already holds all of it
+		reset_cache_journal(cache_file_data.iv, cache_file_data.cache_data.size());
+		boost::system::error_code ec;
+		boost::filesystem::remove(m_wallet_file + ".journal", ec);
+	}
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_cache_journal(const crypto::chacha_iv &snapshot_iv, uint64_t snapshot_size)
+{
+	cache_journal_state &cj = m_cache_journal;
+	// multisig info is updated in place in ways the fingerprint does not see
+	cj.valid = !m_multisig && !m_blockchain.empty();
+	cj.snapshot_iv = snapshot_iv;
+	cj.snapshot_size = snapshot_size;
+	cj.journal_size = 0;
+	cj.blockchain_size = m_blockchain.size();
+	cj.blockchain_top = cj.valid ? m_blockchain[m_blockchain.size() - 1] : crypto::null_hash;
+	cj.transfers.resize(m_transfers.size());
+	for(size_t i = 0; i < m_transfers.size(); ++i)
+		cj.transfers[i] = transfer_fingerprint(m_transfers[i]);
+	cj.payments = m_payments.size();
+	cj.confirmed_txs = m_confirmed_txs.size();
+	cj.tx_keys = m_tx_keys.size();
+	cj.subaddresses = m_subaddresses.size();
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::store_cache_journal(const crypto::chacha_key &key)
+{
+	cache_journal_state &cj = m_cache_journal;
+
+	// keep the journal well below the size of the cache, loading it has to replay every record
+	if(!cj.valid || m_multisig || cj.journal_size * 2 > cj.snapshot_size)
+		return false;
+
+	// a reorg below the last stored block, or anything else that removed data, needs a full rewrite
+	const uint64_t bc_size = m_blockchain.size();
+	if(bc_size < cj.blockchain_size || !m_blockchain.is_in_bounds(cj.blockchain_size - 1) ||
+	   m_blockchain[cj.blockchain_size - 1] != cj.blockchain_top || m_transfers.size() < cj.transfers.size())
+		return false;
+
+	std::vector<std::pair<crypto::hash, payment_details>> payments;
+	for(const auto &p : m_payments)
+		if(p.second.m_block_height >= cj.blockchain_size)
+			payments.push_back(p);
+	std::vector<std::pair<crypto::hash, confirmed_transfer_details>> confirmed_txs;
+	for(const auto &c : m_confirmed_txs)
+		if(c.second.m_block_height >= cj.blockchain_size)
+			confirmed_txs.push_back(c);
+	if(m_payments.size() != cj.payments + payments.size() || m_confirmed_txs.size() != cj.confirmed_txs + confirmed_txs.size())
+		return false;
+
+	std::vector<uint64_t> fingerprints(m_transfers.size());
+	std::vector<std::pair<uint64_t, transfer_details>> transfers;
+	for(size_t i = 0; i < m_transfers.size(); ++i)
+	{
+		fingerprints[i] = transfer_fingerprint(m_transfers[i]);
+		if(i >= cj.transfers.size() || fingerprints[i] != cj.transfers[i])
+			transfers.emplace_back(i, m_transfers[i]);
+	}
+
+	uint64_t bc_start = cj.blockchain_size;
+	std::vector<crypto::hash> blockchain;
+	blockchain.reserve(bc_size - bc_start);
+	for(uint64_t h = bc_start; h < bc_size; ++h)
+		blockchain.push_back(m_blockchain[h]);
+
+	const bool tx_keys_changed = m_tx_keys.size() != cj.tx_keys;
+	const bool subaddresses_changed = m_subaddresses.size() != cj.subaddresses;
+	std::stringstream oss;
+	{
+		boost::archive::portable_binary_oarchive ar(oss);
+		ar << bc_start << blockchain << transfers << payments << confirmed_txs;
+		ar << tx_keys_changed << subaddresses_changed;
+		if(tx_keys_changed)
+			ar << m_tx_keys << m_additional_tx_keys;
+		if(subaddresses_changed)
+			ar << m_subaddresses;
+		// the rest is small and changes in place, so it is written whole
+		ar << m_unconfirmed_txs << m_unconfirmed_payments << m_tx_notes << m_address_book;
+		ar << m_scanned_pool_txs[0] << m_scanned_pool_txs[1] << m_subaddress_labels;
+		ar << m_attributes << m_account_tags << m_ring_history_saved;
+	}
+
+	const std::string data = oss.str();
+	wallet2::cache_journal_record record = boost::value_initialized<wallet2::cache_journal_record>();
+	record.snapshot_iv = cj.snapshot_iv;
+	record.iv = crypto::rand<crypto::chacha_iv>();
+	record.cache_data.resize(data.size());
+	crypto::chacha20(data.data(), data.size(), key, record.iv, &record.cache_data[0]);
+
+	std::string blob;
+	bool r = ::serialization::dump_binary(record, blob);
+	THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to serialize cache journal record");
+	if(!epee::file_io_utils::append_string_to_file(m_wallet_file + ".journal", blob))
+	{
+		// a partial record at the end is dropped on load, the full store removes the journal anyway
+		GULPS_WARN("Failed to append to ", m_wallet_file, ".journal, rewriting the wallet cache");
+		return false;
+	}
+
+	cj.journal_size += blob.size();
+	cj.blockchain_size = bc_size;
+	cj.blockchain_top = m_blockchain[bc_size - 1];
+	cj.transfers.swap(fingerprints);
+	cj.payments = m_payments.size();
+	cj.confirmed_txs = m_confirmed_txs.size();
+	cj.tx_keys = m_tx_keys.size();
+	cj.subaddresses = m_subaddresses.size();
+	GULPS_LOG_L1("Appended ", blob.size(), " bytes to the cache journal: ", blockchain.size(), " blocks, ", transfers.size(),
+				 " transfers, ", payments.size(), " payments, ", confirmed_txs.size(), " outgoing txes");
+	return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_journal(const crypto::chacha_key &key)
+{
+	const std::string journal_file = m_wallet_file + ".journal";
+	boost::system::error_code e;
+	if(!boost::filesystem::exists(journal_file, e) || e)
+		return;
+
+	std::string buf;
+	if(!epee::file_io_utils::load_file_to_string(journal_file, buf))
+	{
+		GULPS_WARN("Failed to read ", journal_file, ", the wallet will resync the blocks it holds");
+		m_cache_journal.valid = false;
+		return;
+	}
+
+	std::istringstream iss(buf);
+	binary_archive<false> ar(iss);
+	uint64_t consumed = 0;
+	size_t records = 0;
+	while(consumed < buf.size())
+	{
+		// serialization::serialize would insist on the record being the last thing in the stream
+		wallet2::cache_journal_record record;
+		if(!::do_serialize(ar, record) || !iss.good())
+			break;
+		// records left behind by a store that was interrupted before removing the journal
+		if(memcmp(&record.snapshot_iv, &m_cache_journal.snapshot_iv, sizeof(crypto::chacha_iv)))
+			break;
+
+		std::string data;
+		data.resize(record.cache_data.size());
+		crypto::chacha20(record.cache_data.data(), record.cache_data.size(), key, record.iv, &data[0]);
+		if(!apply_cache_journal_record(data))
+			break;
+		consumed = iss.tellg();
+		++records;
+	}
+
+	reset_cache_journal(m_cache_journal.snapshot_iv, m_cache_journal.snapshot_size);
+	m_cache_journal.journal_size = consumed;
+	// anything we could not replay must not have more records appended after it
+	if(consumed != buf.size())
+	{
+		GULPS_WARN("Ignored ", buf.size() - consumed, " bytes at the end of ", journal_file);
+		m_cache_journal.valid = false;
+	}
+	GULPS_LOG_L1("Replayed ", records, " cache journal records");
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::apply_cache_journal_record(const std::string &data)
+{
+	uint64_t bc_start;
+	std::vector<crypto::hash> blockchain;
+	std::vector<std::pair<uint64_t, transfer_details>> transfers;
+	std::vector<std::pair<crypto::hash, payment_details>> payments;
+	std::vector<std::pair<crypto::hash, confirmed_transfer_details>> confirmed_txs;
+	std::unordered_map<crypto::hash, unconfirmed_transfer_details> unconfirmed_txs;
+	std::unordered_multimap<crypto::hash, pool_payment_details> unconfirmed_payments;
+	std::unordered_map<crypto::hash, crypto::secret_key> tx_keys;
+	std::unordered_map<crypto::hash, std::vector<crypto::secret_key>> additional_tx_keys;
+	std::unordered_map<crypto::hash, std::string> tx_notes;
+	std::vector<address_book_row> address_book;
+	std::unordered_set<crypto::hash> scanned_pool_txs[2];
+	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+	std::vector<std::vector<std::string>> subaddress_labels;
+	std::unordered_map<std::string, std::string> attributes;
+	std::pair<std::map<std::string, std::string>, std::vector<std::string>> account_tags;
+	bool ring_history_saved, tx_keys_changed, subaddresses_changed;
+	try
+	{
+		std::istringstream iss(data);
+		boost::archive::portable_binary_iarchive ar(iss);
+		ar >> bc_start >> blockchain >> transfers >> payments >> confirmed_txs;
+		ar >> tx_keys_changed >> subaddresses_changed;
+		if(tx_keys_changed)
+			ar >> tx_keys >> additional_tx_keys;
+		if(subaddresses_changed)
+			ar >> subaddresses;
+		ar >> unconfirmed_txs >> unconfirmed_payments >> tx_notes >> address_book;
+		ar >> scanned_pool_txs[0] >> scanned_pool_txs[1] >> subaddress_labels;
+		ar >> attributes >> account_tags >> ring_history_saved;
+	}
+	catch(const std::exception &e)
+	{
+		GULPS_WARN("Failed to parse cache journal record: ", e.what());
+		return false;
 	}
+
+	if(bc_start != m_blockchain.size())
+		return false;
+	size_t transfer_count = m_transfers.size();
+	for(const auto &t : transfers)
+	{
+		if(t.first > transfer_count)
+			return false;
+		if(t.first == transfer_count)
+			++transfer_count;
+	}
+
+	for(const crypto::hash &h : blockchain)
+		m_blockchain.push_back(h);
+
+	for(auto &t : transfers)
+	{
+		const size_t idx = t.first;
+		if(idx < m_transfers.size())
+		{
+			const transfer_details &old = m_transfers[idx];
+			auto ki = m_key_images.find(old.m_key_image);
+			if(ki != m_key_images.end() && ki->second == idx)
+				m_key_images.erase(ki);
+			auto pk = m_pub_keys.find(old.get_public_key());
+			if(pk != m_pub_keys.end() && pk->second == idx)
+				m_pub_keys.erase(pk);
+			m_transfers[idx] = std::move(t.second);
+		}
+		else
+		{
+			m_transfers.push_back(std::move(t.second));
+		}
+		const transfer_details &td = m_transfers[idx];
+		if(td.m_key_image_known)
+			m_key_images[td.m_key_image] = idx;
+		m_pub_keys[td.get_public_key()] = idx;
+	}
+
+	for(auto &p : payments)
+		m_payments.emplace(std::move(p));
+	for(auto &c : confirmed_txs)
+		m_confirmed_txs[c.first] = std::move(c.second);
+
+	m_unconfirmed_txs.swap(unconfirmed_txs);
+	m_unconfirmed_payments.swap(unconfirmed_payments);
+	if(tx_keys_changed)
+	{
+		m_tx_keys.swap(tx_keys);
+		m_additional_tx_keys.swap(additional_tx_keys);
+	}
+	if(subaddresses_changed)
+		m_subaddresses.swap(subaddresses);
+	m_tx_notes.swap(tx_notes);
+	m_address_book.swap(address_book);
+	m_scanned_pool_txs[0].swap(scanned_pool_txs[0]);
+	m_scanned_pool_txs[1].swap(scanned_pool_txs[1]);
+	m_subaddress_labels.swap(subaddress_labels);
+	m_attributes.swap(attributes);
+	m_account_tags.swap(account_tags);
+	m_ring_history_saved = ring_history_saved;
+	return true;
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance(uint32_t index_major) const
@@ -4096,6 +4616,26 @@ uint64_t wallet2::unlocked_balance_all() const
 	return r;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::index_payment(const payment_container::value_type &payment)
+{
+	m_payments_index.add({payment.second.m_block_height, payment.second.m_tx_hash}, payment.second.m_subaddr_index.major, &payment);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_confirmed_tx(const std::pair<const crypto::hash, confirmed_transfer_details> &tx)
+{
+	m_confirmed_txs_index.add({tx.second.m_block_height, tx.first}, tx.second.m_subaddr_account, &tx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_transfer_indices()
+{
+	m_payments_index.clear();
+	m_confirmed_txs_index.clear();
+	for(const auto &p : m_payments)
+		index_payment(p);
+	for(const auto &c : m_confirmed_txs)
+		index_confirmed_tx(c);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::get_transfers(wallet2::transfer_container &incoming_transfers) const
 {
 	incoming_transfers = m_transfers;
@@ -4114,32 +4654,25 @@ void wallet2::get_payments(const crypto::uniform_payment_id &payment_id, std::li
 	});
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::get_payments(std::list<std::pair<crypto::hash, wallet2::payment_details>> &payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t> &subaddr_account, const std::set<uint32_t> &subaddr_indices) const
+bool wallet2::get_payments(std::list<std::pair<crypto::hash, wallet2::payment_details>> &payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t> &subaddr_account, const std::set<uint32_t> &subaddr_indices,
+						   const boost::optional<transfer_position> &after, size_t max_count) const
 {
-	auto range = std::make_pair(m_payments.begin(), m_payments.end());
-	std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type &x) {
-		if(min_height < x.second.m_block_height && max_height >= x.second.m_block_height &&
-		   (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
-		   (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
-		{
-			payments.push_back(x);
-		}
-	});
+	return walk_transfer_index(m_payments_index.get(subaddr_account), min_height, max_height, after, max_count,
+		[&subaddr_indices](const payment_container::value_type &x) {
+			return subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1;
+		},
+		[&payments](const payment_container::value_type &x) { payments.push_back(x); });
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::get_payments_out(std::list<std::pair<crypto::hash, wallet2::confirmed_transfer_details>> &confirmed_payments,
-							   uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t> &subaddr_account, const std::set<uint32_t> &subaddr_indices) const
+bool wallet2::get_payments_out(std::list<std::pair<crypto::hash, wallet2::confirmed_transfer_details>> &confirmed_payments,
+							   uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t> &subaddr_account, const std::set<uint32_t> &subaddr_indices,
+							   const boost::optional<transfer_position> &after, size_t max_count) const
 {
-	for(auto i = m_confirmed_txs.begin(); i != m_confirmed_txs.end(); ++i)
-	{
-		if(i->second.m_block_height <= min_height || i->second.m_block_height > max_height)
-			continue;
-		if(subaddr_account && *subaddr_account != i->second.m_subaddr_account)
-			continue;
-		if(!subaddr_indices.empty() && std::count_if(i->second.m_subaddr_indices.begin(), i->second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
-			continue;
-		confirmed_payments.push_back(*i);
-	}
+	return walk_transfer_index(m_confirmed_txs_index.get(subaddr_account), min_height, max_height, after, max_count,
+		[&subaddr_indices](const std::pair<const crypto::hash, confirmed_transfer_details> &x) {
+			return subaddr_indices.empty() || std::count_if(x.second.m_subaddr_indices.begin(), x.second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) != 0;
+		},
+		[&confirmed_payments](const std::pair<const crypto::hash, confirmed_transfer_details> &x) { confirmed_payments.push_back(x); });
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_unconfirmed_payments_out(std::list<std::pair<crypto::hash, wallet2::unconfirmed_transfer_details>> &unconfirmed_payments, const boost::optional<uint32_t> &subaddr_account, const std::set<uint32_t> &subaddr_indices) const
@@ -4233,7 +4766,7 @@ void wallet2::rescan_blockchain(bool refresh)
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(const transfer_details &td) const
 {
-	return is_transfer_unlocked(td.m_tx.unlock_time, td.m_block_height);
+	return is_transfer_unlocked(td.m_unlock_time, td.m_block_height);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height) const
@@ -5305,6 +5838,48 @@ bool wallet2::set_ring_database(const std::string &filename)
 	return true;
 }
 
+bool wallet2::set_local_blockchain(const std::string &data_dir)
+{
+	m_local_db.reset();
+	if(data_dir.empty())
+		return true;
+
+	std::unique_ptr<cryptonote::BlockchainDB> db(cryptonote::new_db("lmdb"));
+	const std::string filename = (boost::filesystem::path(data_dir) / db->get_db_name()).string();
+	try
+	{
+		// The daemon stays the only writer, LMDB readers in other processes never block it
+		db->open(filename, DBF_RDONLY);
+	}
+	catch(const cryptonote::DB_NEEDS_MIGRATION &e)
+	{
+		GULPS_WARN("Blockchain database ", filename, ": ", e.what(), ", refreshing from the daemon instead");
+		return true;
+	}
+	catch(const std::exception &e)
+	{
+		GULPS_LOG_ERROR("Failed to open blockchain database ", filename, ": ", e.what());
+		return false;
+	}
+	if(!db->is_open())
+	{
+		GULPS_LOG_ERROR("Failed to open blockchain database ", filename);
+		return false;
+	}
+
+	cryptonote::block b;
+	generate_genesis(b);
+	if(db->height() == 0 || db->get_block_hash_from_height(0) != get_block_hash(b))
+	{
+		GULPS_LOG_ERROR("Blockchain database ", filename, " is empty or for another network");
+		return false;
+	}
+
+	GULPS_LOG_L0("Refreshing from blockchain database ", filename);
+	m_local_db = std::move(db);
+	return true;
+}
+
 bool wallet2::add_rings(const crypto::chacha_key &key, const cryptonote::transaction_prefix &tx)
 {
 	if(!m_ringdb)
@@ -5568,6 +6143,26 @@ bool wallet2::tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_out
 	return true;
 }
 
+void wallet2::get_outs(std::vector<std::vector<std::vector<tools::wallet2::get_outs_entry>>> &outs, const std::vector<std::vector<size_t>> &selected_transfers, size_t fake_outputs_count)
+{
+	// rings are picked per input, so the inputs of all the transactions go out in a single request
+	std::vector<size_t> all_transfers;
+	for(const std::vector<size_t> &tx_transfers : selected_transfers)
+		all_transfers.insert(all_transfers.end(), tx_transfers.begin(), tx_transfers.end());
+
+	std::vector<std::vector<get_outs_entry>> all_outs;
+	get_outs(all_outs, all_transfers, fake_outputs_count);
+
+	outs.clear();
+	outs.reserve(selected_transfers.size());
+	auto it = all_outs.begin();
+	for(const std::vector<size_t> &tx_transfers : selected_transfers)
+	{
+		outs.emplace_back(std::make_move_iterator(it), std::make_move_iterator(it + tx_transfers.size()));
+		it += tx_transfers.size();
+	}
+}
+
 void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count)
 {
 	GULPS_LOG_L2("fake_outputs_count: ", fake_outputs_count);
@@ -5586,48 +6181,79 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
 		bool is_shortly_after_segregation_fork = height >= segregation_fork_height && height < segregation_fork_height + SEGREGATION_FORK_VICINITY;
 		bool is_after_segregation_fork = height >= segregation_fork_height;
 
-		// get histogram for the amounts we need
+		// get histogram for the amounts we need, RingCT is served from the local distribution cache when we have it
 		cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::request req_t = AUTO_VAL_INIT(req_t);
 		cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::response resp_t = AUTO_VAL_INIT(resp_t);
-		m_daemon_rpc_mutex.lock();
 		for(size_t idx : selected_transfers)
 			req_t.amounts.push_back(m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount());
 		std::sort(req_t.amounts.begin(), req_t.amounts.end());
 		auto end = std::unique(req_t.amounts.begin(), req_t.amounts.end());
 		req_t.amounts.resize(std::distance(req_t.amounts.begin(), end));
-		req_t.unlocked = true;
-		req_t.recent_cutoff = time(NULL) - RECENT_OUTPUT_ZONE;
-		bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_histogram", req_t, resp_t, m_http_client, rpc_timeout);
-		m_daemon_rpc_mutex.unlock();
-		THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
-		THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_histogram");
-		THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_histogram_error, resp_t.status);
+		const uint64_t recent_cutoff = time(NULL) - RECENT_OUTPUT_ZONE;
+		const bool rct_cached = !req_t.amounts.empty() && req_t.amounts.front() == 0 && update_rct_distribution(height) && update_rct_timestamps(recent_cutoff);
+		bool r;
+		if(rct_cached)
+			req_t.amounts.erase(req_t.amounts.begin());
+		if(!req_t.amounts.empty())
+		{
+			req_t.unlocked = true;
+			req_t.recent_cutoff = recent_cutoff;
+			m_daemon_rpc_mutex.lock();
+			r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_histogram", req_t, resp_t, m_http_client, rpc_timeout);
+			m_daemon_rpc_mutex.unlock();
+			THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
+			THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_histogram");
+			THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_histogram_error, resp_t.status);
+		}
+		if(rct_cached)
+		{
+			uint64_t unlocked, recent;
+			get_rct_histogram_entry(recent_cutoff, unlocked, recent);
+			resp_t.histogram.emplace_back(0, m_rct_distribution.back(), unlocked, recent);
+		}
 
 		// if we want to segregate fake outs pre or post fork, get distribution
 		std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> segregation_limit;
 		if(is_after_segregation_fork && (m_segregate_pre_fork_outputs || m_key_reuse_mitigation2))
 		{
+			if(rct_cached && segregation_fork_height > RECENT_OUTPUT_BLOCKS && segregation_fork_height - RECENT_OUTPUT_BLOCKS >= m_rct_distribution_start &&
+			   segregation_fork_height - m_rct_distribution_start < m_rct_distribution.size())
+			{
+				uint64_t till_fork = m_rct_distribution[segregation_fork_height - m_rct_distribution_start];
+				uint64_t recent = till_fork - m_rct_distribution[segregation_fork_height - RECENT_OUTPUT_BLOCKS - m_rct_distribution_start];
+				segregation_limit[0] = std::make_pair(till_fork, recent);
+			}
+
 			cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req_t = AUTO_VAL_INIT(req_t);
 			cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response resp_t = AUTO_VAL_INIT(resp_t);
 			for(size_t idx : selected_transfers)
-				req_t.amounts.push_back(m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount());
+			{
+				const uint64_t amount = m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount();
+				if(segregation_limit.find(amount) == segregation_limit.end())
+					req_t.amounts.push_back(amount);
+			}
 			std::sort(req_t.amounts.begin(), req_t.amounts.end());
 			auto end = std::unique(req_t.amounts.begin(), req_t.amounts.end());
 			req_t.amounts.resize(std::distance(req_t.amounts.begin(), end));
-			req_t.from_height = std::max<uint64_t>(segregation_fork_height, RECENT_OUTPUT_BLOCKS) - RECENT_OUTPUT_BLOCKS;
-			req_t.to_height = segregation_fork_height + 1;
-			req_t.cumulative = true;
-			m_daemon_rpc_mutex.lock();
-			bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req_t, resp_t, m_http_client, rpc_timeout * 1000);
-			m_daemon_rpc_mutex.unlock();
-			THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
-			THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_distribution");
-			THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_output_distribution, resp_t.status);
+			if(!req_t.amounts.empty())
+			{
+				req_t.from_height = std::max<uint64_t>(segregation_fork_height, RECENT_OUTPUT_BLOCKS) - RECENT_OUTPUT_BLOCKS;
+				req_t.to_height = segregation_fork_height + 1;
+				req_t.cumulative = true;
+				m_daemon_rpc_mutex.lock();
+				bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req_t, resp_t, m_http_client, rpc_timeout * 1000);
+				m_daemon_rpc_mutex.unlock();
+				THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
+				THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_distribution");
+				THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_output_distribution, resp_t.status);
+			}
 
 			// check we got all data
 			for(size_t idx : selected_transfers)
 			{
 				const uint64_t amount = m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount();
+				if(segregation_limit.find(amount) != segregation_limit.end())
+					continue;
 				bool found = false;
 				for(const auto &d : resp_t.distributions)
 				{
@@ -5929,7 +6555,7 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
 			{
 				size_t i = base + n;
 				if(req.outputs[i].index == td.m_global_output_index)
-					if(daemon_resp.outs[i].key == boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key)
+					if(daemon_resp.outs[i].key == td.get_public_key())
 						if(daemon_resp.outs[i].mask == mask)
 							real_out_found = true;
 			}
@@ -5937,7 +6563,7 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
 									  "Daemon response did not include the requested real output");
 
 			// pick real out first (it will be sorted when done)
-			outs.back().push_back(std::make_tuple(td.m_global_output_index, boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key, mask));
+			outs.back().push_back(std::make_tuple(td.m_global_output_index, td.get_public_key(), mask));
 
 			// then pick outs from an existing ring, if any
 			bool existing_ring_found = false;
@@ -6128,8 +6754,8 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
 		real_oe.second.dest = rct::pk2rct(td.get_public_key());
 		real_oe.second.mask = rct::commit(td.amount(), td.m_mask);
 		*it_to_replace = real_oe;
-		src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
-		src.real_out_additional_tx_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+		src.real_out_tx_key = td.m_tx_pub_key;
+		src.real_out_additional_tx_keys = td.get_additional_tx_pub_keys();
 		src.real_output = it_to_replace - src.outputs.begin();
 		src.real_output_in_tx_index = td.m_internal_output_index;
 		src.mask = td.m_mask;
@@ -6278,6 +6904,41 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
 	GULPS_LOG_L2("transfer_selected_rct done");
 }
 
+void wallet2::construct_txes(size_t tx_count, const std::function<void(size_t)> &construct_tx)
+{
+	// devices and multisig signing keep state between calls, so those are built one at a time
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	if(tx_count < 2 || tpool.get_max_concurrency() < 2 || m_key_on_device || m_multisig)
+	{
+		for(size_t i = 0; i < tx_count; ++i)
+			construct_tx(i);
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors(tx_count);
+	tools::threadpool::waiter waiter;
+	for(size_t i = 0; i < tx_count; ++i)
+	{
+		tpool.submit(&waiter, [&, i]() {
+			try
+			{
+				construct_tx(i);
+			}
+			catch(...)
+			{
+				errors[i] = std::current_exception();
+			}
+		});
+	}
+	waiter.wait();
+
+	for(const std::exception_ptr &e : errors)
+	{
+		if(e)
+			std::rethrow_exception(e);
+	}
+}
+
 std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices) const
 {
 	struct pick_out
@@ -6436,6 +7097,25 @@ static uint32_t get_count_above(const std::vector<wallet2::transfer_details> &tr
 	return count;
 }
 
+static void push_per_subaddr(std::vector<std::pair<uint32_t, std::vector<size_t>>> &indices_per_subaddr, uint32_t index_minor, size_t idx)
+{
+	auto found = std::find_if(indices_per_subaddr.begin(), indices_per_subaddr.end(), [&index_minor](const std::pair<uint32_t, std::vector<size_t>> &x) { return x.first == index_minor; });
+	if(found == indices_per_subaddr.end())
+		indices_per_subaddr.push_back({index_minor, {idx}});
+	else
+		found->second.push_back(idx);
+}
+
+// Subaddresses with the most unlocked money first, ties in random order
+static void sort_per_subaddr(std::vector<std::pair<uint32_t, std::vector<size_t>>> &indices_per_subaddr, std::map<uint32_t, uint64_t> &unlocked_balance_per_subaddr, std::mt19937 &g)
+{
+	std::shuffle(indices_per_subaddr.begin(), indices_per_subaddr.end(), g);
+	auto sort_predicate = [&unlocked_balance_per_subaddr](const std::pair<uint32_t, std::vector<size_t>> &x, const std::pair<uint32_t, std::vector<size_t>> &y) {
+		return unlocked_balance_per_subaddr[x.first] > unlocked_balance_per_subaddr[y.first];
+	};
+	std::sort(indices_per_subaddr.begin(), indices_per_subaddr.end(), sort_predicate);
+}
+
 // Another implementation of transaction creation that is hopefully better
 // While there is anything left to pay, it goes through random outputs and tries
 // to fill the next destination/amount. If it fully fills it, it will use the
@@ -6557,32 +7237,14 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
 		const transfer_details &td = m_transfers[i];
 		if(!td.m_spent && !td.m_key_image_partial && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
 		{
-			const uint32_t index_minor = td.m_subaddr_index.minor;
-			auto find_predicate = [&index_minor](const std::pair<uint32_t, std::vector<size_t>> &x) { return x.first == index_minor; };
 			if((td.is_rct()) || is_valid_decomposed_amount(td.amount()))
 			{
-				auto found = std::find_if(unused_transfers_indices_per_subaddr.begin(), unused_transfers_indices_per_subaddr.end(), find_predicate);
-				if(found == unused_transfers_indices_per_subaddr.end())
-				{
-					unused_transfers_indices_per_subaddr.push_back({index_minor, {i}});
-				}
-				else
-				{
-					found->second.push_back(i);
-				}
+				push_per_subaddr(unused_transfers_indices_per_subaddr, td.m_subaddr_index.minor, i);
 				++num_nondust_outputs;
 			}
 			else
 			{
-				auto found = std::find_if(unused_dust_indices_per_subaddr.begin(), unused_dust_indices_per_subaddr.end(), find_predicate);
-				if(found == unused_dust_indices_per_subaddr.end())
-				{
-					unused_dust_indices_per_subaddr.push_back({index_minor, {i}});
-				}
-				else
-				{
-					found->second.push_back(i);
-				}
+				push_per_subaddr(unused_dust_indices_per_subaddr, td.m_subaddr_index.minor, i);
 				++num_dust_outputs;
 			}
 		}
@@ -6592,13 +7254,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
 	{
 		std::random_device rd;
 		std::mt19937 g(rd());
-		std::shuffle(unused_transfers_indices_per_subaddr.begin(), unused_transfers_indices_per_subaddr.end(), g);
-		std::shuffle(unused_dust_indices_per_subaddr.begin(), unused_dust_indices_per_subaddr.end(), g);
-		auto sort_predicate = [&unlocked_balance_per_subaddr](const std::pair<uint32_t, std::vector<size_t>> &x, const std::pair<uint32_t, std::vector<size_t>> &y) {
-			return unlocked_balance_per_subaddr[x.first] > unlocked_balance_per_subaddr[y.first];
-		};
-		std::sort(unused_transfers_indices_per_subaddr.begin(), unused_transfers_indices_per_subaddr.end(), sort_predicate);
-		std::sort(unused_dust_indices_per_subaddr.begin(), unused_dust_indices_per_subaddr.end(), sort_predicate);
+		sort_per_subaddr(unused_transfers_indices_per_subaddr, unlocked_balance_per_subaddr, g);
+		sort_per_subaddr(unused_dust_indices_per_subaddr, unlocked_balance_per_subaddr, g);
 	}
 
 	GULPS_LOG_L2("Starting with ", num_nondust_outputs, " non-dust outputs and ", num_dust_outputs, " dust outputs");
@@ -6902,10 +7559,10 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
 
 	GULPS_LOG_L1("Done creating ", txes.size(), " transactions, ", print_money(accumulated_fee), " total fee, ", print_money(accumulated_change), " total change");
 
+	// the rings are all known by now, so the real transactions can be signed side by side
 	hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-	for(std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
-	{
-		TX &tx = *i;
+	construct_txes(txes.size(), [&](size_t n) {
+		TX &tx = txes[n];
 		cryptonote::transaction test_tx;
 		pending_tx test_ptx;
 		transfer_selected_rct(tx.dsts,				 /* NOMOD std::vector<cryptonote::tx_destination_entry> dsts,*/
@@ -6922,7 +7579,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
 		tx.tx = test_tx;
 		tx.ptx = test_ptx;
 		tx.bytes = txBlob.size();
-	}
+	});
 
 	std::vector<wallet2::pending_tx> ptx_vector;
 	for(std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
@@ -7137,9 +7794,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
 	GULPS_LOG_L1("Done creating ", txes.size(), " transactions, ", print_money(accumulated_fee), " total fee, ", print_money(accumulated_change), " total change");
 
 	hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-	for(std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
-	{
-		TX &tx = *i;
+	construct_txes(txes.size(), [&](size_t n) {
+		TX &tx = txes[n];
 		cryptonote::transaction test_tx;
 		pending_tx test_ptx;
 		transfer_selected_rct(tx.dsts, tx.selected_transfers, fake_outs_count, tx.outs, unlock_time, tx.fee, payment_id,
@@ -7148,7 +7804,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
 		tx.tx = test_tx;
 		tx.ptx = test_ptx;
 		tx.bytes = txBlob.size();
-	}
+	});
 
 	std::vector<wallet2::pending_tx> ptx_vector;
 	for(std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
@@ -7164,6 +7820,183 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
 	// if we made it this far, we're OK to actually send the transactions
 	return ptx_vector;
 }
+
+std::vector<wallet2::pending_tx> wallet2::create_transactions_batch(const std::vector<std::vector<cryptonote::tx_destination_entry>> &dsts, const size_t fake_outs_count, const uint64_t unlock_time, uint32_t priority, const crypto::uniform_payment_id* payment_id, uint32_t subaddr_account, std::set<uint32_t> subaddr_indices)
+{
+	//ensure device is let in NONE mode in any case
+	hw::device &hwdev = m_account.get_device();
+	boost::unique_lock<hw::device> hwdev_lock(hwdev);
+	hw::reset_mode rst(hwdev);
+
+	struct TX
+	{
+		std::vector<size_t> selected_transfers;
+		uint64_t needed_money = 0;
+		uint64_t fee = 0;
+		pending_tx ptx;
+		size_t bytes = 0;
+	};
+	std::vector<TX> txes(dsts.size());
+	const uint64_t upper_transaction_size_limit = get_upper_transaction_size_limit();
+	const bool bulletproof = use_fork_rules(FORK_BULLETPROOFS, 0);
+	const uint64_t fee_multiplier = get_fee_multiplier(priority);
+
+	THROW_WALLET_EXCEPTION_IF(dsts.empty(), error::zero_destination);
+	uint64_t needed_money = 0;
+	for(size_t n = 0; n < dsts.size(); ++n)
+	{
+		THROW_WALLET_EXCEPTION_IF(dsts[n].empty(), error::zero_destination);
+		THROW_WALLET_EXCEPTION_IF(bulletproof && dsts[n].size() > cryptonote::common_config::BULLETPROOF_MAX_OUTPUTS - 1, error::wallet_internal_error,
+								  "Too many destinations in transaction " + std::to_string(n));
+		for(const auto &dt : dsts[n])
+		{
+			THROW_WALLET_EXCEPTION_IF(0 == dt.amount, error::zero_destination);
+			txes[n].needed_money += dt.amount;
+			THROW_WALLET_EXCEPTION_IF(txes[n].needed_money < dt.amount, error::tx_sum_overflow, dsts[n], 0, m_nettype);
+		}
+		needed_money += txes[n].needed_money;
+		THROW_WALLET_EXCEPTION_IF(needed_money < txes[n].needed_money, error::tx_sum_overflow, dsts[n], 0, m_nettype);
+	}
+
+	// grouped by subaddress like create_transactions_2, so that a transaction spending from
+	// a single one does not link it to the others
+	std::map<uint32_t, uint64_t> unlocked_balance_per_subaddr = unlocked_balance_per_subaddress(subaddr_account);
+	std::vector<std::pair<uint32_t, std::vector<size_t>>> unused_transfers_indices_per_subaddr;
+	for(size_t i = 0; i < m_transfers.size(); ++i)
+	{
+		const transfer_details &td = m_transfers[i];
+		if(!td.m_spent && !td.m_key_image_partial && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account &&
+		   (subaddr_indices.empty() || subaddr_indices.count(td.m_subaddr_index.minor) == 1))
+			push_per_subaddr(unused_transfers_indices_per_subaddr, td.m_subaddr_index.minor, i);
+	}
+	{
+		std::random_device rd;
+		std::mt19937 g(rd());
+		sort_per_subaddr(unused_transfers_indices_per_subaddr, unlocked_balance_per_subaddr, g);
+	}
+
+	// takes inputs from unused until they pay for the transaction and the fee its size estimate
+	// calls for, false if they run out or the transaction would grow too large first
+	const auto add_inputs = [&](TX &tx, size_t n_outputs, std::vector<size_t> &unused, uint64_t &found_money) {
+		while(found_money < tx.needed_money + tx.fee)
+		{
+			const size_t estimated_tx_size = estimate_rct_tx_size(tx.selected_transfers.size() + 1, fake_outs_count, n_outputs, bulletproof);
+			if(unused.empty() || estimated_tx_size >= upper_transaction_size_limit)
+				return false;
+			size_t idx = pop_best_value(unused, tx.selected_transfers);
+			tx.selected_transfers.push_back(idx);
+			found_money += m_transfers[idx].amount();
+			tx.fee = std::max(tx.fee, calculate_fee(fake_outs_count + 1, estimated_tx_size, fee_multiplier));
+		}
+		return true;
+	};
+
+	// pick the inputs of every transaction before anything is signed, the fee comes from the size
+	// estimate so that no trial transaction is needed to settle on the inputs
+	uint64_t accumulated_fee = 0;
+	for(size_t n = 0; n < txes.size(); ++n)
+	{
+		TX &tx = txes[n];
+		const size_t n_outputs = dsts[n].size() + 1; // with change
+		uint64_t found_money = 0;
+
+		// the richest subaddress that pays for the transaction on its own, and only if none
+		// can, inputs from several of them in that order
+		bool filled = false;
+		for(auto &unused : unused_transfers_indices_per_subaddr)
+		{
+			TX trial = tx;
+			std::vector<size_t> trial_unused = unused.second;
+			found_money = 0;
+			if(add_inputs(trial, n_outputs, trial_unused, found_money))
+			{
+				tx = std::move(trial);
+				unused.second = std::move(trial_unused);
+				filled = true;
+				break;
+			}
+		}
+		if(!filled)
+		{
+			found_money = 0;
+			for(auto &unused : unused_transfers_indices_per_subaddr)
+				if(!filled)
+					filled = add_inputs(tx, n_outputs, unused.second, found_money);
+		}
+		if(!filled)
+		{
+			GULPS_ERROR("Transaction ", n + 1, "/", txes.size(), " needs ", print_money(tx.needed_money), " and ", print_money(tx.fee), " fee, more than the inputs left cover in a transaction of the size limit");
+			THROW_WALLET_EXCEPTION(error::tx_not_possible, unlocked_balance(subaddr_account), needed_money, accumulated_fee + tx.fee);
+		}
+		accumulated_fee += tx.fee;
+		GULPS_LOG_L2("Picked ", tx.selected_transfers.size(), " inputs for transaction ", n, ", paying ", print_money(tx.needed_money), " with ", print_money(tx.fee), " fee");
+	}
+
+	// ring members for all of them in one go
+	std::vector<std::vector<size_t>> selected_transfers;
+	selected_transfers.reserve(txes.size());
+	for(const TX &tx : txes)
+		selected_transfers.push_back(tx.selected_transfers);
+	std::vector<std::vector<std::vector<get_outs_entry>>> outs;
+	get_outs(outs, selected_transfers, fake_outs_count);
+
+	hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
+	construct_txes(txes.size(), [&](size_t n) {
+		TX &tx = txes[n];
+		cryptonote::transaction test_tx;
+		transfer_selected_rct(dsts[n], tx.selected_transfers, fake_outs_count, outs[n], unlock_time, tx.fee, payment_id, test_tx, tx.ptx, bulletproof);
+		tx.bytes = get_object_blobsize(tx.ptx.tx);
+	});
+
+	// the estimate should be on the safe side, if it was not the transaction is built again with the right fee,
+	// and when its inputs no longer cover that it takes more of them, with new rings
+	for(size_t n = 0; n < txes.size(); ++n)
+	{
+		TX &tx = txes[n];
+		uint64_t needed_fee = calculate_fee(fake_outs_count + 1, tx.bytes, fee_multiplier);
+		while(needed_fee > tx.fee)
+		{
+			GULPS_LOG_L1("Transaction ", n + 1, "/", txes.size(), " needs ", print_money(needed_fee), " fee, estimated ", print_money(tx.fee), ", rebuilding it");
+			tx.fee = needed_fee;
+			uint64_t found_money = 0;
+			for(size_t idx : tx.selected_transfers)
+				found_money += m_transfers[idx].amount();
+			const size_t n_inputs = tx.selected_transfers.size();
+
+			// the subaddress it spends from first, the others only if that one runs out
+			const uint32_t index_minor = m_transfers[tx.selected_transfers.front()].m_subaddr_index.minor;
+			bool filled = found_money >= tx.needed_money + tx.fee;
+			for(auto &unused : unused_transfers_indices_per_subaddr)
+				if(!filled && unused.first == index_minor)
+					filled = add_inputs(tx, dsts[n].size() + 1, unused.second, found_money);
+			for(auto &unused : unused_transfers_indices_per_subaddr)
+				if(!filled && unused.first != index_minor)
+					filled = add_inputs(tx, dsts[n].size() + 1, unused.second, found_money);
+			if(!filled)
+			{
+				GULPS_ERROR("Transaction ", n + 1, "/", txes.size(), " needs ", print_money(tx.fee), " fee, more than its inputs cover, and no inputs are left");
+				THROW_WALLET_EXCEPTION(error::tx_not_possible, found_money, tx.needed_money, tx.fee);
+			}
+			if(tx.selected_transfers.size() != n_inputs)
+				get_outs(outs[n], tx.selected_transfers, fake_outs_count);
+			cryptonote::transaction test_tx;
+			transfer_selected_rct(dsts[n], tx.selected_transfers, fake_outs_count, outs[n], unlock_time, tx.fee, payment_id, test_tx, tx.ptx, bulletproof);
+			tx.bytes = get_object_blobsize(tx.ptx.tx);
+			needed_fee = calculate_fee(fake_outs_count + 1, tx.bytes, fee_multiplier);
+		}
+	}
+
+	std::vector<wallet2::pending_tx> ptx_vector;
+	ptx_vector.reserve(txes.size());
+	for(size_t n = 0; n < txes.size(); ++n)
+	{
+		const TX &tx = txes[n];
+		GULPS_LOG_L1("  Transaction ", n + 1, "/", txes.size(), ": ", tx.bytes, " bytes, sending ", print_money(tx.needed_money), " in ", tx.selected_transfers.size(), " outputs to ",
+					 dsts[n].size(), " destination(s), including ", print_money(tx.ptx.fee), " fee, ", print_money(tx.ptx.change_dts.amount), " change");
+		ptx_vector.push_back(tx.ptx);
+	}
+	return ptx_vector;
+}
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_hard_fork_info(uint8_t version, uint64_t &earliest_height) const
 {
@@ -7375,13 +8208,10 @@ std::string wallet2::get_spend_proof(const crypto::hash &txid, const std::string
 
 		// derive the real output keypair
 		const transfer_details &in_td = m_transfers[found->second];
-		const txout_to_key *const in_tx_out_pkey = boost::get<txout_to_key>(std::addressof(in_td.m_tx.vout[in_td.m_internal_output_index].target));
-		THROW_WALLET_EXCEPTION_IF(in_tx_out_pkey == nullptr, error::wallet_internal_error, "Output is not txout_to_key");
-		const crypto::public_key in_tx_pub_key = get_tx_pub_key_from_extra(in_td.m_tx, in_td.m_pk_index);
-		const std::vector<crypto::public_key> in_additionakl_tx_pub_keys = get_additional_tx_pub_keys_from_extra(in_td.m_tx);
+		const std::vector<crypto::public_key> in_additionakl_tx_pub_keys = in_td.get_additional_tx_pub_keys();
 		keypair in_ephemeral;
 		crypto::key_image in_img;
-		THROW_WALLET_EXCEPTION_IF(!generate_key_image_helper(m_account.get_keys(), m_subaddresses, in_tx_out_pkey->key, in_tx_pub_key, in_additionakl_tx_pub_keys, in_td.m_internal_output_index, in_ephemeral, in_img, m_account.get_device()),
+		THROW_WALLET_EXCEPTION_IF(!generate_key_image_helper(m_account.get_keys(), m_subaddresses, in_td.get_public_key(), in_td.m_tx_pub_key, in_additionakl_tx_pub_keys, in_td.m_internal_output_index, in_ephemeral, in_img, m_account.get_device()),
 								  error::wallet_internal_error, "failed to generate key image");
 		THROW_WALLET_EXCEPTION_IF(in_key->k_image != in_img, error::wallet_internal_error, "key image mismatch");
 
@@ -7950,9 +8780,9 @@ std::string wallet2::get_reserve_proof(const boost::optional<std::pair<uint32_t,
 		subaddr_indices.insert(td.m_subaddr_index);
 
 		// get tx pub key
-		const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
+		const crypto::public_key tx_pub_key = td.m_tx_pub_key;
 		THROW_WALLET_EXCEPTION_IF(tx_pub_key == crypto::null_pkey, error::wallet_internal_error, "The tx public key isn't found");
-		const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+		const std::vector<crypto::public_key> additional_tx_pub_keys = td.get_additional_tx_pub_keys();
 
 		// determine which tx pub key was used for deriving the output key
 		const crypto::public_key *tx_pub_key_used = &tx_pub_key;
@@ -8329,18 +9159,6 @@ bool wallet2::verify(const std::string &data, const cryptonote::account_public_a
 	return crypto::check_signature(hash, address.m_spend_public_key, s);
 }
 //----------------------------------------------------------------------------------------------------
-crypto::public_key wallet2::get_tx_pub_key_from_received_outs(const tools::wallet2::transfer_details &td) const
-{
-	std::vector<tx_extra_field> tx_extra_fields;
-	parse_tx_extra(td.m_tx.extra, tx_extra_fields);
-
-	tx_extra_pub_key pub_key_field;
-	THROW_WALLET_EXCEPTION_IF(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field), error::wallet_internal_error,
-							  "Public key wasn't found in the transaction extra");
-
-	return pub_key_field.pub_key;
-}
-
 bool wallet2::export_key_images(const std::string &filename) const
 {
 	std::vector<std::pair<crypto::key_image, crypto::signature>> ski = export_key_images();
@@ -8375,21 +9193,11 @@ std::vector<std::pair<crypto::key_image, crypto::signature>> wallet2::export_key
 		crypto::cn_fast_hash(&td.m_key_image, sizeof(td.m_key_image), hash);
 
 		// get ephemeral public key
-		const cryptonote::tx_out &out = td.m_tx.vout[td.m_internal_output_index];
-		THROW_WALLET_EXCEPTION_IF(out.target.type() != typeid(txout_to_key), error::wallet_internal_error,
-								  "Output is not txout_to_key");
-		const cryptonote::txout_to_key &o = boost::get<const cryptonote::txout_to_key>(out.target);
-		const crypto::public_key pkey = o.key;
+		const crypto::public_key pkey = td.get_public_key();
 
 		// get tx pub key
-		std::vector<tx_extra_field> tx_extra_fields;
-		if(!parse_tx_extra(td.m_tx.extra, tx_extra_fields))
-		{
-			// Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-		}
-
-		crypto::public_key tx_pub_key = get_tx_pub_key_from_received_outs(td);
-		const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+		const crypto::public_key &tx_pub_key = td.m_tx_pub_key;
+		const std::vector<crypto::public_key> additional_tx_pub_keys = td.get_additional_tx_pub_keys();
 
 		// generate ephemeral secret key
 		crypto::key_image ki;
@@ -8486,6 +9294,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 		return 0;
 	}
 
+	// spent outgoing payments are rewritten below, the cache journal only records additions
+	m_cache_journal.valid = false;
+
 	for(size_t n = 0; n < signed_key_images.size(); ++n)
 	{
 		const transfer_details &td = m_transfers[n];
@@ -8493,11 +9304,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 		const crypto::signature &signature = signed_key_images[n].second;
 
 		// get ephemeral public key
-		const cryptonote::tx_out &out = td.m_tx.vout[td.m_internal_output_index];
-		THROW_WALLET_EXCEPTION_IF(out.target.type() != typeid(txout_to_key), error::wallet_internal_error,
-								  "Non txout_to_key output found");
-		const cryptonote::txout_to_key &o = boost::get<cryptonote::txout_to_key>(out.target);
-		const crypto::public_key pkey = o.key;
+		const crypto::public_key pkey = td.get_public_key();
 
 		std::vector<const crypto::public_key *> pkeys;
 		pkeys.push_back(&pkey);
@@ -8547,11 +9354,8 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 	for(size_t i=0; i < m_transfers.size(); i++)
 	{
 		// Collect all key images from inputs to our outputs (we will look for change)
-		for(const cryptonote::txin_v &in : m_transfers[i].m_tx.vin)
-		{
-			if(in.type() == typeid(cryptonote::txin_to_key))
-				out_kimg_map.insert({ boost::get<cryptonote::txin_to_key>(in).k_image, i });
-		}
+		for(const crypto::key_image &ki : m_transfers[i].m_input_key_images)
+			out_kimg_map.insert({ ki, i });
 	}
 
 	for(size_t i = 0; i < signed_key_images.size(); ++i)
@@ -8681,6 +9485,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 		{
 			if(j->second.m_tx_hash == *spent_txid)
 			{
+				m_payments_index.remove({j->second.m_block_height, j->second.m_tx_hash}, j->second.m_subaddr_index.major, &*j);
 				m_payments.erase(j);
 				break;
 			}
@@ -8700,7 +9505,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 
 		crypto::hash spent_txid = crypto::null_hash; // spent txid is unknown
 		memcpy(&spent_txid, &n, sizeof(uint64_t));
-		m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+		auto entry = m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+		if(entry.second)
+			index_confirmed_tx(*entry.first);
 	}
 
 	return m_transfers[signed_key_images.size() - 1].m_block_height;
@@ -8716,19 +9523,23 @@ wallet2::payment_container wallet2::export_payments() const
 }
 void wallet2::import_payments(const payment_container &payments)
 {
+	m_cache_journal.valid = false;
 	m_payments.clear();
 	for(auto const &p : payments)
 	{
 		m_payments.emplace(p);
 	}
+	rebuild_transfer_indices();
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash, wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
+	m_cache_journal.valid = false;
 	m_confirmed_txs.clear();
 	for(auto const &p : confirmed_payments)
 	{
 		m_confirmed_txs.emplace(p);
 	}
+	rebuild_transfer_indices();
 }
 
 std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> wallet2::export_blockchain() const
@@ -8745,6 +9556,7 @@ std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> wallet2::export_bloc
 
 void wallet2::import_blockchain(const std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> &bc)
 {
+	m_cache_journal.valid = false;
 	m_blockchain.clear();
 	if(std::get<0>(bc))
 	{
@@ -8780,6 +9592,7 @@ std::vector<tools::wallet2::transfer_details> wallet2::export_outputs() const
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_outputs(const std::vector<tools::wallet2::transfer_details> &outputs)
 {
+	m_cache_journal.valid = false;
 	m_transfers.clear();
 	m_transfers.reserve(outputs.size());
 	for(size_t i = 0; i < outputs.size(); ++i)
@@ -8789,17 +9602,16 @@ size_t wallet2::import_outputs(const std::vector<tools::wallet2::transfer_detail
 		// the hot wallet wouldn't have known about key images (except if we already exported them)
 		cryptonote::keypair in_ephemeral;
 
-		THROW_WALLET_EXCEPTION_IF(td.m_tx.vout.empty(), error::wallet_internal_error, "tx with no outputs at index " + boost::lexical_cast<std::string>(i));
-		crypto::public_key tx_pub_key = get_tx_pub_key_from_received_outs(td);
-		const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+		THROW_WALLET_EXCEPTION_IF(td.m_tx_pub_key == crypto::null_pkey, error::wallet_internal_error, "Public key wasn't found in the transaction extra at index " + boost::lexical_cast<std::string>(i));
+		const std::vector<crypto::public_key> additional_tx_pub_keys = td.get_additional_tx_pub_keys();
 
-		const crypto::public_key &out_key = boost::get<cryptonote::txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key;
-		bool r = cryptonote::generate_key_image_helper(m_account.get_keys(), m_subaddresses, out_key, tx_pub_key, additional_tx_pub_keys, td.m_internal_output_index, in_ephemeral, td.m_key_image, m_account.get_device());
+		const crypto::public_key &out_key = td.get_public_key();
+		bool r = cryptonote::generate_key_image_helper(m_account.get_keys(), m_subaddresses, out_key, td.m_tx_pub_key, additional_tx_pub_keys, td.m_internal_output_index, in_ephemeral, td.m_key_image, m_account.get_device());
 		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
 		expand_subaddresses(td.m_subaddr_index);
 		td.m_key_image_known = true;
 		td.m_key_image_partial = false;
-		THROW_WALLET_EXCEPTION_IF(in_ephemeral.pub != boost::get<cryptonote::txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key,
+		THROW_WALLET_EXCEPTION_IF(in_ephemeral.pub != out_key,
 								  error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key at index " + boost::lexical_cast<std::string>(i));
 
 		m_key_images[td.m_key_image] = m_transfers.size();
@@ -8900,8 +9712,8 @@ crypto::key_image wallet2::get_multisig_composite_key_image(size_t n) const
 	GULPS_CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad output index");
 
 	const transfer_details &td = m_transfers[n];
-	const crypto::public_key tx_key = get_tx_pub_key_from_received_outs(td);
-	const std::vector<crypto::public_key> additional_tx_keys = cryptonote::get_additional_tx_pub_keys_from_extra(td.m_tx);
+	const crypto::public_key &tx_key = td.m_tx_pub_key;
+	const std::vector<crypto::public_key> additional_tx_keys = td.get_additional_tx_pub_keys();
 	crypto::key_image ki;
 	std::vector<crypto::key_image> pkis;
 	for(const auto &info : td.m_multisig_info)
@@ -8922,7 +9734,7 @@ cryptonote::blobdata wallet2::export_multisig()
 	for(size_t n = 0; n < m_transfers.size(); ++n)
 	{
 		transfer_details &td = m_transfers[n];
-		const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+		const std::vector<crypto::public_key> additional_tx_pub_keys = td.get_additional_tx_pub_keys();
 		crypto::key_image ki;
 		td.m_multisig_k.clear();
 		info[n].m_LR.clear();
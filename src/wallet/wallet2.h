@@ -78,6 +78,17 @@
 #include "wallet_errors.h"
 
 class Serialization_portability_wallet_Test;
+class wallet_cache_journal_store_and_load_Test;
+class wallet_block_ranges;
+class multi_account_scanner_wallet;
+class wallet_scan_digest;
+class wallet_rct_distribution;
+class wallet_tx_batch;
+
+namespace cryptonote
+{
+class BlockchainDB;
+}
 
 namespace tools
 {
@@ -159,9 +170,21 @@ public:
 class wallet2
 {
 	friend class ::Serialization_portability_wallet_Test;
+	friend class ::wallet_cache_journal_store_and_load_Test;
+	friend class ::wallet_block_ranges;
+	friend class ::multi_account_scanner_wallet;
+	friend class ::wallet_scan_digest;
+	friend class ::wallet_rct_distribution;
+	friend class ::wallet_tx_batch;
 
   public:
 	static constexpr const std::chrono::seconds rpc_timeout = std::chrono::minutes(3) + std::chrono::seconds(30);
+	// Number of getblocks.bin requests kept in flight while the wallet is far behind the daemon
+	static constexpr const size_t block_dl_connections = 4;
+	// Parallel ranges stop this many blocks below the daemon's tip, the rest is pulled by chain history
+	static constexpr const uint64_t block_dl_safe_depth = 100;
+	// Block timestamps the cached RingCT histogram fetches at a time, the recent output zone in target block times
+	static const uint64_t rct_recent_blocks;
 
 	enum RefreshType
 	{
@@ -234,42 +257,72 @@ class wallet2
 	struct transfer_details
 	{
 		uint64_t m_block_height;
-		cryptonote::transaction_prefix m_tx;
 		crypto::hash m_txid;
+		// Only what the wallet still needs from the tx prefix is kept, a busy wallet holds millions of these
+		uint64_t m_unlock_time;
+		crypto::public_key m_out_key;
+		crypto::public_key m_tx_pub_key;
+		crypto::public_key m_additional_tx_pub_key; // null_pkey if the tx has none for this output
+		std::vector<crypto::key_image> m_input_key_images; // lets a watch-only wallet find change when importing key images
 		size_t m_internal_output_index;
 		uint64_t m_global_output_index;
-		bool m_spent;
 		uint64_t m_spent_height;
 		crypto::key_image m_key_image; //TODO: key_image stored twice :(
 		rct::key m_mask;
 		uint64_t m_amount;
+		cryptonote::subaddress_index m_subaddr_index;
+		uint32_t m_tx_size;
+		bool m_spent;
 		bool m_rct;
 		bool m_key_image_known;
-		size_t m_pk_index;
-		cryptonote::subaddress_index m_subaddr_index;
 		bool m_key_image_partial;
 		std::vector<rct::key> m_multisig_k;
 		std::vector<multisig_info> m_multisig_info; // one per other participant
 
 		bool is_rct() const { return m_rct; }
 		uint64_t amount() const { return m_amount; }
-		const crypto::public_key &get_public_key() const { return boost::get<const cryptonote::txout_to_key>(m_tx.vout[m_internal_output_index].target).key; }
+		const crypto::public_key &get_public_key() const { return m_out_key; }
+		// Indexed by output like the tx extra field, only the entry for this output is meaningful
+		std::vector<crypto::public_key> get_additional_tx_pub_keys() const
+		{
+			if(m_additional_tx_pub_key == crypto::null_pkey)
+				return {};
+			return std::vector<crypto::public_key>(m_internal_output_index + 1, m_additional_tx_pub_key);
+		}
+		// m_internal_output_index must be set first
+		void set_tx(const cryptonote::transaction_prefix &tx, size_t pk_index = 0)
+		{
+			m_unlock_time = tx.unlock_time;
+			m_out_key = boost::get<const cryptonote::txout_to_key>(tx.vout[m_internal_output_index].target).key;
+			m_tx_pub_key = cryptonote::get_tx_pub_key_from_extra(tx, pk_index);
+			const std::vector<crypto::public_key> additional_tx_pub_keys = cryptonote::get_additional_tx_pub_keys_from_extra(tx);
+			m_additional_tx_pub_key = m_internal_output_index < additional_tx_pub_keys.size() ? additional_tx_pub_keys[m_internal_output_index] : crypto::null_pkey;
+			m_input_key_images.clear();
+			for(const cryptonote::txin_v &in : tx.vin)
+				if(in.type() == typeid(cryptonote::txin_to_key))
+					m_input_key_images.push_back(boost::get<const cryptonote::txin_to_key>(in).k_image);
+			m_tx_size = cryptonote::get_object_blobsize(tx);
+		}
 
 		BEGIN_SERIALIZE_OBJECT()
 		FIELD(m_block_height)
-		FIELD(m_tx)
 		FIELD(m_txid)
+		FIELD(m_unlock_time)
+		FIELD(m_out_key)
+		FIELD(m_tx_pub_key)
+		FIELD(m_additional_tx_pub_key)
+		FIELD(m_input_key_images)
 		FIELD(m_internal_output_index)
 		FIELD(m_global_output_index)
-		FIELD(m_spent)
 		FIELD(m_spent_height)
 		FIELD(m_key_image)
 		FIELD(m_mask)
 		FIELD(m_amount)
+		FIELD(m_subaddr_index)
+		FIELD(m_tx_size)
+		FIELD(m_spent)
 		FIELD(m_rct)
 		FIELD(m_key_image_known)
-		FIELD(m_pk_index)
-		FIELD(m_subaddr_index)
 		FIELD(m_key_image_partial)
 		FIELD(m_multisig_k)
 		FIELD(m_multisig_info)
@@ -367,6 +420,19 @@ class wallet2
 	typedef std::vector<transfer_details> transfer_container;
 	typedef std::unordered_multimap<crypto::hash, payment_details> payment_container;
 
+	// Where a payment or outgoing tx sits in the transfer history, which is ordered by block height then txid
+	struct transfer_position
+	{
+		uint64_t height;
+		crypto::hash txid;
+
+		bool operator<(const transfer_position &other) const
+		{
+			return height < other.height || (height == other.height && memcmp(txid.data, other.txid.data, sizeof(txid.data)) < 0);
+		}
+		bool operator==(const transfer_position &other) const { return height == other.height && txid == other.txid; }
+	};
+
 	struct multisig_sig
 	{
 		rct::rctSig sigs;
@@ -457,6 +523,21 @@ class wallet2
 		END_SERIALIZE()
 	};
 
+	// One store() worth of changes, appended to the cache journal. snapshot_iv ties
+	// the record to the cache file it extends, records of an older snapshot are ignored.
+	struct cache_journal_record
+	{
+		crypto::chacha_iv snapshot_iv;
+		crypto::chacha_iv iv;
+		std::string cache_data;
+
+		BEGIN_SERIALIZE_OBJECT()
+		FIELD(snapshot_iv)
+		FIELD(iv)
+		FIELD(cache_data)
+		END_SERIALIZE()
+	};
+
 	// GUI Address book
 	struct address_book_row
 	{
@@ -710,6 +791,12 @@ class wallet2
 	std::vector<wallet2::pending_tx> create_transactions_all(uint64_t below, const cryptonote::account_public_address &address, bool is_subaddress, const size_t fake_outs_count, const uint64_t unlock_time, uint32_t priority, const crypto::uniform_payment_id* payment_id, uint32_t subaddr_account, std::set<uint32_t> subaddr_indices, bool trusted_daemon);
 	std::vector<wallet2::pending_tx> create_transactions_single(const crypto::key_image &ki, const cryptonote::account_public_address &address, bool is_subaddress, const size_t fake_outs_count, const uint64_t unlock_time, uint32_t priority, const crypto::uniform_payment_id* payment_id, bool trusted_daemon);
 	std::vector<wallet2::pending_tx> create_transactions_from(const cryptonote::account_public_address &address, bool is_subaddress, std::vector<size_t> unused_transfers_indices, std::vector<size_t> unused_dust_indices, const size_t fake_outs_count, const uint64_t unlock_time, uint32_t priority, const crypto::uniform_payment_id* payment_id, bool trusted_daemon);
+	// one transaction per destination list: inputs are picked for all of them up front, ring members
+	// are fetched in a single request and the transactions are signed in parallel
+	std::vector<wallet2::pending_tx> create_transactions_batch(const std::vector<std::vector<cryptonote::tx_destination_entry>> &dsts, const size_t fake_outs_count, const uint64_t unlock_time, uint32_t priority, const crypto::uniform_payment_id* payment_id, uint32_t subaddr_account, std::set<uint32_t> subaddr_indices);
+	// calls construct_tx for every index, on the threadpool unless the keys are on a device or the wallet is multisig,
+	// and rethrows the first error on the calling thread
+	void construct_txes(size_t tx_count, const std::function<void(size_t)> &construct_tx);
 	bool load_multisig_tx(cryptonote::blobdata blob, multisig_tx_set &exported_txs, std::function<bool(const multisig_tx_set &)> accept_func = NULL);
 	bool load_multisig_tx_from_file(const std::string &filename, multisig_tx_set &exported_txs, std::function<bool(const multisig_tx_set &)> accept_func = NULL);
 	bool sign_multisig_tx_from_file(const std::string &filename, std::vector<crypto::hash> &txids, std::function<bool(const multisig_tx_set &)> accept_func);
@@ -718,9 +805,13 @@ class wallet2
 	bool check_connection(uint32_t *version = NULL, uint32_t timeout = 200000);
 	void get_transfers(wallet2::transfer_container &incoming_transfers) const;
 	void get_payments(const crypto::uniform_payment_id &payment_id, std::list<wallet2::payment_details> &payments, uint64_t min_height = 0, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {}) const;
-	void get_payments(std::list<std::pair<crypto::hash, wallet2::payment_details>> &payments, uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {}) const;
-	void get_payments_out(std::list<std::pair<crypto::hash, wallet2::confirmed_transfer_details>> &confirmed_payments,
-						  uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {}) const;
+	// Ordered by transfer_position. Paging starts past after and stops once max_count entries
+	// (0 for no limit) are found, but never in the middle of a tx. Returns true if entries are left past the page.
+	bool get_payments(std::list<std::pair<crypto::hash, wallet2::payment_details>> &payments, uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {},
+					  const boost::optional<transfer_position> &after = boost::none, size_t max_count = 0) const;
+	bool get_payments_out(std::list<std::pair<crypto::hash, wallet2::confirmed_transfer_details>> &confirmed_payments,
+						  uint64_t min_height, uint64_t max_height = (uint64_t)-1, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {},
+						  const boost::optional<transfer_position> &after = boost::none, size_t max_count = 0) const;
 	void get_unconfirmed_payments_out(std::list<std::pair<crypto::hash, wallet2::unconfirmed_transfer_details>> &unconfirmed_payments, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {}) const;
 	void get_unconfirmed_payments(std::list<std::pair<crypto::hash, wallet2::pool_payment_details>> &unconfirmed_payments, const boost::optional<uint32_t> &subaddr_account = boost::none, const std::set<uint32_t> &subaddr_indices = {}) const;
 
@@ -786,10 +877,7 @@ class wallet2
 			// we're loading an older wallet without a pubkey map, rebuild it
 			for(size_t i = 0; i < m_transfers.size(); ++i)
 			{
-				const transfer_details &td = m_transfers[i];
-				const cryptonote::tx_out &out = td.m_tx.vout[td.m_internal_output_index];
-				const cryptonote::txout_to_key &o = boost::get<const cryptonote::txout_to_key>(out.target);
-				m_pub_keys.emplace(o.key, i);
+				m_pub_keys.emplace(m_transfers[i].get_public_key(), i);
 			}
 			return;
 		}
@@ -1065,6 +1153,13 @@ class wallet2
 
 	bool set_ring_database(const std::string &filename);
 	const std::string get_ring_database() const { return m_ring_database; }
+	// Refresh from the database of a daemon running on this host instead of getblocks.bin, empty to stop.
+	// A database the daemon has yet to migrate leaves the wallet refreshing over RPC.
+	bool set_local_blockchain(const std::string &data_dir);
+	bool has_local_blockchain() const { return m_local_db != nullptr; }
+	// Scan per-tx digests from the daemon and download only the blocks that match
+	void refresh_from_digests(bool enable) { m_refresh_from_digests = enable; }
+	bool refresh_from_digests() const { return m_refresh_from_digests; }
 	bool get_ring(const crypto::key_image &key_image, std::vector<uint64_t> &outs);
 	bool get_rings(const crypto::hash &txid, std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &outs);
 	bool set_ring(const crypto::key_image &key_image, const std::vector<uint64_t> &outs, bool relative);
@@ -1116,12 +1211,19 @@ class wallet2
 	void set_spent(size_t idx, uint64_t height);
 	void set_unspent(size_t idx);
 	void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count);
+	void get_outs(std::vector<std::vector<std::vector<get_outs_entry>>> &outs, const std::vector<std::vector<size_t>> &selected_transfers, size_t fake_outputs_count);
 	bool tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, uint64_t global_index, const crypto::public_key &tx_public_key, const rct::key &mask, uint64_t real_index, bool unlocked) const;
-	crypto::public_key get_tx_pub_key_from_received_outs(const tools::wallet2::transfer_details &td) const;
 	bool should_pick_a_second_output(bool use_rct, size_t n_transfers, const std::vector<size_t> &unused_transfers_indices, const std::vector<size_t> &unused_dust_indices) const;
 	std::vector<size_t> get_only_rct(const std::vector<size_t> &unused_dust_indices, const std::vector<size_t> &unused_transfers_indices) const;
 	void scan_output(const cryptonote::transaction &tx, const crypto::public_key &tx_pub_key, size_t i, tx_scan_info_t &tx_scan_info, int &num_vouts_received, std::unordered_map<cryptonote::subaddress_index, uint64_t> &tx_money_got_in_outs, std::vector<size_t> &outs) const;
 	void trim_hashchain();
+	void reset_cache_journal(const crypto::chacha_iv &snapshot_iv, uint64_t snapshot_size);
+	bool store_cache_journal(const crypto::chacha_key &key);
+	void load_cache_journal(const crypto::chacha_key &key);
+	bool apply_cache_journal_record(const std::string &data);
+	void index_payment(const payment_container::value_type &payment);
+	void index_confirmed_tx(const std::pair<const crypto::hash, confirmed_transfer_details> &tx);
+	void rebuild_transfer_indices();
 	crypto::key_image get_multisig_composite_key_image(size_t n) const;
 	rct::multisig_kLRki get_multisig_composite_kLRki(size_t n, const crypto::public_key &ignore, std::unordered_set<rct::key> &used_L, std::unordered_set<rct::key> &new_used_L) const;
 	rct::multisig_kLRki get_multisig_kLRki(size_t n, const rct::key &k) const;
@@ -1132,15 +1234,103 @@ class wallet2
 	bool remove_rings(const cryptonote::transaction_prefix &tx);
 	bool get_ring(const crypto::chacha_key &key, const crypto::key_image &key_image, std::vector<uint64_t> &outs);
 
-	bool get_output_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution);
+	bool get_output_distribution(uint64_t from_height, uint64_t &start_height, std::vector<uint64_t> &distribution);
+	bool update_rct_distribution(uint64_t height);
+	bool get_block_timestamps(uint64_t start_height, uint64_t end_height, std::vector<uint64_t> &timestamps);
+	// Fetches the block timestamps get_rct_histogram_entry needs for this cutoff, and drops the older ones
+	bool update_rct_timestamps(uint64_t recent_cutoff);
+	// The amount 0 histogram entry from the cached distribution. Like the daemon, recent counts the unlocked
+	// outputs back from the newest until one whose block timestamp is before the cutoff, the height of that block
+	// goes to stop_height. Returns false if the cached timestamps end before such a block.
+	bool get_rct_histogram_entry(uint64_t recent_cutoff, uint64_t &unlocked, uint64_t &recent, uint64_t *stop_height = NULL) const;
 
 	uint64_t get_segregation_fork_height() const;
 
 	cryptonote::account_base m_account;
 	boost::optional<epee::net_utils::http::login> m_daemon_login;
 	std::string m_daemon_address;
+	bool m_daemon_ssl = false;
 	std::string m_wallet_file;
 	std::string m_keys_file;
+
+	// What the cache file and its journal hold, so store() only appends what changed since.
+	// Blocks, payments and confirmed txs are only ever appended between reorgs, transfers
+	// are appended or updated in place and are compared through a fingerprint. Tx keys and
+	// subaddresses only grow, they are written whole when their count changed.
+	struct cache_journal_state
+	{
+		bool valid = false;
+		crypto::chacha_iv snapshot_iv;
+		uint64_t snapshot_size = 0;
+		uint64_t journal_size = 0;
+		uint64_t blockchain_size = 0;
+		crypto::hash blockchain_top;
+		std::vector<uint64_t> transfers;
+		size_t payments = 0;
+		size_t confirmed_txs = 0;
+		size_t tx_keys = 0;
+		size_t subaddresses = 0;
+	};
+	cache_journal_state m_cache_journal;
+
+	// Height ordered views of m_payments and m_confirmed_txs, overall and per subaddress account,
+	// so that polling for recent transfers does not walk the whole history. Elements of the hash
+	// maps keep their address on rehash, the views are not stored and are rebuilt on load.
+	template <typename T>
+	struct transfer_index
+	{
+		typedef std::multimap<transfer_position, const T *> height_map;
+		height_map by_height;
+		std::map<uint32_t, height_map> by_account;
+
+		const height_map *get(const boost::optional<uint32_t> &account) const
+		{
+			if(!account)
+				return &by_height;
+			auto it = by_account.find(*account);
+			return it == by_account.end() ? nullptr : &it->second;
+		}
+		void add(const transfer_position &pos, uint32_t account, const T *entry)
+		{
+			by_height.emplace(pos, entry);
+			by_account[account].emplace(pos, entry);
+		}
+		void remove(const transfer_position &pos, uint32_t account, const T *entry)
+		{
+			remove(by_height, pos, entry);
+			auto it = by_account.find(account);
+			if(it != by_account.end())
+				remove(it->second, pos, entry);
+		}
+		void remove_from_height(uint64_t height)
+		{
+			const transfer_position pos = {height, crypto::null_hash};
+			by_height.erase(by_height.lower_bound(pos), by_height.end());
+			for(auto &a : by_account)
+				a.second.erase(a.second.lower_bound(pos), a.second.end());
+		}
+		void clear()
+		{
+			by_height.clear();
+			by_account.clear();
+		}
+
+	  private:
+		static void remove(height_map &map, const transfer_position &pos, const T *entry)
+		{
+			auto range = map.equal_range(pos);
+			for(auto it = range.first; it != range.second; ++it)
+			{
+				if(it->second == entry)
+				{
+					map.erase(it);
+					return;
+				}
+			}
+		}
+	};
+	transfer_index<payment_container::value_type> m_payments_index;
+	transfer_index<std::pair<const crypto::hash, confirmed_transfer_details>> m_confirmed_txs_index;
 	epee::net_utils::http::http_simple_client m_http_client;
 	hashchain m_blockchain;
 	std::atomic<uint64_t> m_local_bc_height; //temporary workaround
@@ -1226,7 +1416,15 @@ class wallet2
 #endif
 	std::string m_ring_database;
 	bool m_ring_history_saved;
+	bool m_refresh_from_digests;
 	std::unique_ptr<ringdb> m_ringdb;
+	std::unique_ptr<cryptonote::BlockchainDB> m_local_db;
+	// cumulative RingCT output counts per block, starting at m_rct_distribution_start
+	uint64_t m_rct_distribution_start;
+	std::vector<uint64_t> m_rct_distribution;
+	// timestamps of the blocks from m_rct_timestamps_start to the top of the distribution
+	uint64_t m_rct_timestamps_start;
+	std::vector<uint64_t> m_rct_timestamps;
 
 	struct wallet_rpc_scan_data
 	{
@@ -1249,9 +1447,12 @@ class wallet2
 
 		size_t dl_order;
 		uint64_t blocks_start_height;
+		uint64_t current_height;
 		const std::list<crypto::hash> short_chain_history;
 		std::vector<cryptonote::block_complete_entry_v> blocks_bin;
 		std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
+		// In digest refreshes blocks_bin holds no txs, these stand in for them until a block matches
+		std::vector<std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest>> tx_digests;
 
 		std::vector<block_complete_entry_parsed> blocks_parsed;
 		std::vector<found_output_idx> indices_found;
@@ -1260,6 +1461,8 @@ class wallet2
 	};
 
 	std::unique_ptr<wallet_rpc_scan_data> pull_blocks(uint64_t start_height, const std::list<crypto::hash> &short_chain_history);
+	std::unique_ptr<wallet_rpc_scan_data> pull_blocks(epee::net_utils::http::http_simple_client &client, uint64_t start_height, const std::list<crypto::hash> &short_chain_history);
+	std::unique_ptr<wallet_rpc_scan_data> pull_blocks_local(uint64_t start_height, const std::list<crypto::hash> &short_chain_history);
 
 	struct wallet_refresh_ctx
 	{
@@ -1299,6 +1502,15 @@ class wallet2
 		size_t start_height;
 		std::list<crypto::hash> short_chain_history;
 
+		// State of the last pushed range, parallel ranges must link up to it
+		size_t dl_order;
+		uint64_t top_height;
+		crypto::hash top_hash;
+		uint64_t daemon_height;
+		size_t last_range_size;
+		bool parallel_dl;
+		std::vector<std::unique_ptr<epee::net_utils::http::http_simple_client>> dl_clients;
+
 		std::thread thd;
 		std::atomic<bool> error;
 		bool refreshed;
@@ -1308,8 +1520,17 @@ class wallet2
 
 	void integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& res);
 	void block_download_thd(wallet2::wallet_block_dl_ctx& ctx);
+	void push_block_range(wallet2::wallet_block_dl_ctx& ctx, std::unique_ptr<wallet_rpc_scan_data>& range);
+	bool link_block_range(wallet2::wallet_block_dl_ctx& ctx, std::unique_ptr<wallet_rpc_scan_data>& range);
+	bool parallel_block_download(wallet2::wallet_block_dl_ctx& ctx);
+	bool link_block_ranges(wallet2::wallet_block_dl_ctx& ctx, uint64_t base_height, uint64_t stride, std::vector<std::unique_ptr<wallet_rpc_scan_data>>& ranges,
+						   const std::function<std::unique_ptr<wallet_rpc_scan_data>(uint64_t)>& pull_range);
 	void block_scan_thd(const wallet_scan_ctx& ctx);
 	bool block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid, const cryptonote::transaction& tx, bloom_filter& in_kimg, std::unordered_set<crypto::key_image>& inc_kimg);
+	bool block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest& digest, bloom_filter& in_kimg, std::unordered_set<crypto::key_image>& inc_kimg);
+	bool block_scan_outputs(const wallet_scan_ctx& ctx, const crypto::public_key& tx_pub_key, const std::vector<crypto::public_key>& additional_tx_pub_keys,
+							std::vector<crypto::public_key>& out_keys, std::vector<size_t>& out_indices, std::unordered_set<crypto::key_image>& inc_kimg);
+	void pull_matched_txs(std::unique_ptr<wallet_rpc_scan_data>& res, size_t first_new_block);
 	using tx_call_map = std::unordered_map<crypto::hash, std::pair<std::function<void()>, uint64_t>>;
 	inline void add_new_tx_call(tx_call_map& map, const crypto::hash& txid, const cryptonote::transaction& tx, const std::vector<uint64_t>& o_indices, 
 								uint64_t height, uint64_t ts, bool miner_tx)
@@ -1323,7 +1544,7 @@ class wallet2
 };
 }
 BOOST_CLASS_VERSION(tools::wallet2, 24)
-BOOST_CLASS_VERSION(tools::wallet2::transfer_details, 9)
+BOOST_CLASS_VERSION(tools::wallet2::transfer_details, 10)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_info, 1)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_info::LR, 0)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_tx_set, 1)
@@ -1358,16 +1579,16 @@ namespace boost
 namespace serialization
 {
 template <class Archive>
-inline typename std::enable_if<!Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+inline typename std::enable_if<!Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const cryptonote::transaction_prefix &tx, size_t &pk_index, const boost::serialization::version_type ver)
 {
 }
 template <class Archive>
-inline typename std::enable_if<Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+inline typename std::enable_if<Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const cryptonote::transaction_prefix &tx, size_t &pk_index, const boost::serialization::version_type ver)
 {
 	if(ver < 1)
 	{
 		x.m_mask = rct::identity();
-		x.m_amount = x.m_tx.vout[x.m_internal_output_index].amount;
+		x.m_amount = tx.vout[x.m_internal_output_index].amount;
 	}
 	if(ver < 2)
 	{
@@ -1375,7 +1596,7 @@ inline typename std::enable_if<Archive::is_loading::value, void>::type initializ
 	}
 	if(ver < 4)
 	{
-		x.m_rct = x.m_tx.vout[x.m_internal_output_index].amount == 0;
+		x.m_rct = tx.vout[x.m_internal_output_index].amount == 0;
 	}
 	if(ver < 6)
 	{
@@ -1383,7 +1604,7 @@ inline typename std::enable_if<Archive::is_loading::value, void>::type initializ
 	}
 	if(ver < 7)
 	{
-		x.m_pk_index = 0;
+		pk_index = 0;
 	}
 	if(ver < 8)
 	{
@@ -1397,54 +1618,55 @@ inline typename std::enable_if<Archive::is_loading::value, void>::type initializ
 	}
 }
 
+// Up to version 9 transfer_details held the whole tx prefix, only ever loaded
 template <class Archive>
-inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+inline void serialize_legacy_transfer_details(Archive &a, tools::wallet2::transfer_details &x, cryptonote::transaction_prefix &tx, size_t &pk_index, const boost::serialization::version_type ver)
 {
 	a &x.m_block_height;
 	a &x.m_global_output_index;
 	a &x.m_internal_output_index;
 	if(ver < 3)
 	{
-		cryptonote::transaction tx;
-		a &tx;
-		x.m_tx = (const cryptonote::transaction_prefix &)tx;
-		x.m_txid = cryptonote::get_transaction_hash(tx);
+		cryptonote::transaction full_tx;
+		a &full_tx;
+		tx = (const cryptonote::transaction_prefix &)full_tx;
+		x.m_txid = cryptonote::get_transaction_hash(full_tx);
 	}
 	else
 	{
-		a &x.m_tx;
+		a &tx;
 	}
 	a &x.m_spent;
 	a &x.m_key_image;
 	if(ver < 1)
 	{
 		// ensure mask and amount are set
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	a &x.m_mask;
 	a &x.m_amount;
 	if(ver < 2)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	a &x.m_spent_height;
 	if(ver < 3)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	a &x.m_txid;
 	if(ver < 4)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	a &x.m_rct;
 	if(ver < 5)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	if(ver < 6)
@@ -1458,19 +1680,19 @@ inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boo
 	a &x.m_key_image_known;
 	if(ver < 7)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
-	a &x.m_pk_index;
+	a &pk_index;
 	if(ver < 8)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	a &x.m_subaddr_index;
 	if(ver < 9)
 	{
-		initialize_transfer_details(a, x, ver);
+		initialize_transfer_details(a, x, tx, pk_index, ver);
 		return;
 	}
 	a &x.m_multisig_info;
@@ -1478,6 +1700,40 @@ inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boo
 	a &x.m_key_image_partial;
 }
 
+template <class Archive>
+inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+{
+	if(ver < 10)
+	{
+		cryptonote::transaction_prefix tx;
+		size_t pk_index = 0;
+		serialize_legacy_transfer_details(a, x, tx, pk_index, ver);
+		x.set_tx(tx, pk_index);
+		return;
+	}
+	a &x.m_block_height;
+	a &x.m_txid;
+	a &x.m_unlock_time;
+	a &x.m_out_key;
+	a &x.m_tx_pub_key;
+	a &x.m_additional_tx_pub_key;
+	a &x.m_input_key_images;
+	a &x.m_internal_output_index;
+	a &x.m_global_output_index;
+	a &x.m_spent_height;
+	a &x.m_key_image;
+	a &x.m_mask;
+	a &x.m_amount;
+	a &x.m_subaddr_index;
+	a &x.m_tx_size;
+	a &x.m_spent;
+	a &x.m_rct;
+	a &x.m_key_image_known;
+	a &x.m_key_image_partial;
+	a &x.m_multisig_info;
+	a &x.m_multisig_k;
+}
+
 template <class Archive>
 inline void serialize(Archive &a, tools::wallet2::multisig_info::LR &x, const boost::serialization::version_type ver)
 {
@@ -39,6 +39,8 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "wallet2.h"
+#include "multi_account_scanner.h"
+#include "blockchain_db/blockchain_db.h"
 #include "crypto/crypto.h"
 #include "device/device_default.hpp"
 
@@ -47,47 +49,340 @@ namespace tools
 GULPS_CAT_MAJOR("wallet_tx_scan");
 
 std::unique_ptr<wallet2::wallet_rpc_scan_data> wallet2::pull_blocks(uint64_t start_height, const std::list<crypto::hash> &short_chain_history)
+{
+	if(m_local_db)
+		return pull_blocks_local(start_height, short_chain_history);
+
+	boost::lock_guard<boost::mutex> lock(m_daemon_rpc_mutex);
+	return pull_blocks(m_http_client, start_height, short_chain_history);
+}
+
+std::unique_ptr<wallet2::wallet_rpc_scan_data> wallet2::pull_blocks(epee::net_utils::http::http_simple_client &client, uint64_t start_height, const std::list<crypto::hash> &short_chain_history)
 {
 	cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
 	cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
 	req.block_ids = short_chain_history;
 	req.prune = true;
+	req.digest = m_refresh_from_digests;
 	req.start_height = start_height;
-	m_daemon_rpc_mutex.lock();
 	bool r = false;
 	for(size_t i=0; i <= 3 && r != true; i++)
 	{
 		GULPSF_LOG_L1("invoke_http_bin attempt {}", i);
-		r = epee::net_utils::invoke_http_bin("/getblocks.bin", req, res, m_http_client, rpc_timeout);
+		r = epee::net_utils::invoke_http_bin("/getblocks.bin", req, res, client, rpc_timeout);
 	}
-	m_daemon_rpc_mutex.unlock();
 	THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "getblocks.bin");
 	THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks.bin");
 	THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
-	THROW_WALLET_EXCEPTION_IF(res.blocks.size() != res.output_indices.size(), error::wallet_internal_error,
-							  "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + ") and output_indices (" +
+
+	// daemons that don't know about digests send full blocks back
+	const size_t blocks_cnt = res.digests.empty() ? res.blocks.size() : res.digests.size();
+	THROW_WALLET_EXCEPTION_IF(blocks_cnt != res.output_indices.size(), error::wallet_internal_error,
+							  "mismatched blocks (" + boost::lexical_cast<std::string>(blocks_cnt) + ") and output_indices (" +
 								  boost::lexical_cast<std::string>(res.output_indices.size()) + ") sizes from daemon");
 
-	GULPSF_LOG_L1("Pulled blocks {}-{} / {}.", res.start_height, std::max(res.start_height+res.blocks.size()-1, res.start_height), res.current_height);
+	GULPSF_LOG_L1("Pulled blocks {}-{} / {}.", res.start_height, std::max(res.start_height+blocks_cnt-1, res.start_height), res.current_height);
 
 	std::unique_ptr<wallet2::wallet_rpc_scan_data> ret(new wallet_rpc_scan_data);
 	ret->blocks_start_height = res.start_height;
-	ret->blocks_bin = std::move(res.blocks);
+	ret->current_height = res.current_height;
+	if(res.digests.empty())
+	{
+		ret->blocks_bin = std::move(res.blocks);
+	}
+	else
+	{
+		ret->blocks_bin.reserve(blocks_cnt);
+		ret->tx_digests.reserve(blocks_cnt);
+		for(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_scan_digest &bd : res.digests)
+		{
+			ret->blocks_bin.emplace_back(std::move(bd.block), std::vector<cryptonote::blobdata>());
+			ret->tx_digests.emplace_back(std::move(bd.txs));
+		}
+	}
 	ret->o_indices = std::move(res.output_indices);
 	return ret;
 }
 
+// Same as getblocks.bin, but read straight from the database of a daemon on this host. Nothing
+// gets serialised and transactions are not pruned, the scanner only parses the prefix anyway.
+std::unique_ptr<wallet2::wallet_rpc_scan_data> wallet2::pull_blocks_local(uint64_t start_height, const std::list<crypto::hash> &short_chain_history)
+{
+	const cryptonote::BlockchainDB &db = *m_local_db;
+	// the daemon keeps writing, one snapshot for the whole range keeps the heights and indices consistent
+	cryptonote::db_rtxn_guard rtxn_guard(&db);
+
+	const uint64_t db_height = db.height();
+	if(start_height > 0)
+	{
+		THROW_WALLET_EXCEPTION_IF(start_height >= db_height, error::get_blocks_error, "start height past the local blockchain");
+	}
+	else
+	{
+		THROW_WALLET_EXCEPTION_IF(short_chain_history.empty() || short_chain_history.back() != db.get_block_hash_from_height(0),
+								  error::get_blocks_error, "genesis block mismatch with the local blockchain");
+
+		auto it = short_chain_history.begin();
+		for(; it != short_chain_history.end(); ++it)
+		{
+			if(db.block_exists(*it, &start_height))
+				break;
+		}
+		THROW_WALLET_EXCEPTION_IF(it == short_chain_history.end(), error::get_blocks_error, "no split point with the local blockchain");
+	}
+
+	const uint64_t end_height = std::min<uint64_t>(db_height, start_height + COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT);
+	std::unique_ptr<wallet2::wallet_rpc_scan_data> ret(new wallet_rpc_scan_data);
+	ret->blocks_start_height = start_height;
+	ret->current_height = db_height;
+	ret->blocks_bin.reserve(end_height - start_height);
+	ret->o_indices.resize(end_height - start_height);
+
+	cryptonote::block bl;
+	for(uint64_t height = start_height; height < end_height; height++)
+	{
+		cryptonote::blobdata block_blob = db.get_block_blob_from_height(height);
+		THROW_WALLET_EXCEPTION_IF(!cryptonote::parse_and_validate_block_from_blob(block_blob, bl), error::block_parse_error, block_blob);
+
+		std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices> &indices = ret->o_indices[height - start_height].indices;
+		indices.resize(bl.tx_hashes.size() + 1);
+
+		uint64_t miner_tx_id;
+		const crypto::hash miner_tx_hash = cryptonote::get_transaction_hash(bl.miner_tx);
+		THROW_WALLET_EXCEPTION_IF(!db.tx_exists(miner_tx_hash, miner_tx_id), error::wallet_internal_error,
+								  "miner tx " + epee::string_tools::pod_to_hex(miner_tx_hash) + " not found in the local blockchain");
+		indices[0].indices = db.get_tx_amount_output_indices(miner_tx_id);
+
+		std::vector<cryptonote::blobdata> txs(bl.tx_hashes.size());
+		for(size_t i = 0; i < bl.tx_hashes.size(); i++)
+		{
+			THROW_WALLET_EXCEPTION_IF(!db.get_tx_blob_indexed(bl.tx_hashes[i], txs[i], indices[i + 1].indices), error::wallet_internal_error,
+									  "tx " + epee::string_tools::pod_to_hex(bl.tx_hashes[i]) + " not found in the local blockchain");
+		}
+
+		ret->blocks_bin.emplace_back(std::move(block_blob), std::move(txs));
+	}
+
+	GULPSF_LOG_L1("Read blocks {}-{} / {} from the local blockchain.", start_height, std::max(end_height, start_height + 1) - 1, db_height);
+	return ret;
+}
+
+// Digest refreshes only come with the txs of the blocks that matched an output or spend one of
+// our key images, those from first_new_block on are downloaded in full before integration
+void wallet2::pull_matched_txs(std::unique_ptr<wallet_rpc_scan_data>& res, size_t first_new_block)
+{
+	if(res->tx_digests.empty())
+		return;
+
+	auto spends_ours = [&](const std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest>& digests) {
+		for(const auto& digest : digests)
+		{
+			for(const crypto::key_image& ki : digest.key_images)
+			{
+				if(m_key_images.find(ki) != m_key_images.end() || res->incoming_kimg.find(ki) != res->incoming_kimg.end())
+					return true;
+			}
+		}
+		return false;
+	};
+
+	std::vector<size_t> blk_idx;
+	for(const auto& i : res->indices_found)
+	{
+		if(i.tx_idx != 0 && i.block_idx >= first_new_block && !res->blocks_parsed[i.block_idx].skipped)
+			blk_idx.push_back(i.block_idx);
+	}
+	for(size_t i = first_new_block; i < res->blocks_parsed.size(); i++)
+	{
+		if(!res->blocks_parsed[i].skipped && spends_ours(res->tx_digests[i]))
+			blk_idx.push_back(i);
+	}
+	if(blk_idx.empty())
+		return;
+
+	std::sort(blk_idx.begin(), blk_idx.end());
+	blk_idx.erase(std::unique(blk_idx.begin(), blk_idx.end()), blk_idx.end());
+
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request req = AUTO_VAL_INIT(req);
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response res_bl = AUTO_VAL_INIT(res_bl);
+	req.heights.reserve(blk_idx.size());
+	for(size_t i : blk_idx)
+		req.heights.push_back(res->blocks_parsed[i].block_height);
+
+	bool r;
+	{
+		boost::lock_guard<boost::mutex> lock(m_daemon_rpc_mutex);
+		r = epee::net_utils::invoke_http_bin("/getblocks_by_height.bin", req, res_bl, m_http_client, rpc_timeout);
+	}
+	THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "getblocks_by_height.bin");
+	THROW_WALLET_EXCEPTION_IF(res_bl.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks_by_height.bin");
+	THROW_WALLET_EXCEPTION_IF(res_bl.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res_bl.status);
+	THROW_WALLET_EXCEPTION_IF(res_bl.blocks.size() != blk_idx.size(), error::wallet_internal_error, "Wrong number of blocks from daemon");
+
+	GULPSF_LOG_L1("Pulled {} matched blocks out of {}.", blk_idx.size(), res->blocks_parsed.size());
+
+	cryptonote::block bl;
+	crypto::hash tx_hash, tx_prefix_hash;
+	auto bl_it = res_bl.blocks.begin();
+	for(size_t i : blk_idx)
+	{
+		wallet_rpc_scan_data::block_complete_entry_parsed& blke = res->blocks_parsed[i];
+		const cryptonote::block_complete_entry& entry = *bl_it++;
+		THROW_WALLET_EXCEPTION_IF(!cryptonote::parse_and_validate_block_from_blob(entry.block, bl), error::block_parse_error, entry.block);
+		// a reorg between the two requests, nothing is committed yet and the next refresh starts over from the split
+		THROW_WALLET_EXCEPTION_IF(cryptonote::get_block_hash(bl) != blke.block_hash, error::wallet_internal_error,
+								  "Block " + std::to_string(blke.block_height) + " changed while refreshing");
+		THROW_WALLET_EXCEPTION_IF(entry.txs.size() != blke.block.tx_hashes.size(), error::wallet_internal_error,
+								  "Wrong amount of transactions for block");
+
+		size_t txi = 0;
+		blke.txes.resize(entry.txs.size());
+		for(const cryptonote::blobdata& tx_blob : entry.txs)
+		{
+			THROW_WALLET_EXCEPTION_IF(!cryptonote::parse_and_validate_tx_from_blob(tx_blob, blke.txes[txi], tx_hash, tx_prefix_hash), error::tx_parse_error, tx_blob);
+			THROW_WALLET_EXCEPTION_IF(tx_hash != blke.block.tx_hashes[txi], error::wallet_internal_error,
+									  "Transaction " + epee::string_tools::pod_to_hex(tx_hash) + " out of place in block " + std::to_string(blke.block_height));
+			txi++;
+		}
+	}
+}
+
+void wallet2::push_block_range(wallet2::wallet_block_dl_ctx& ctx, std::unique_ptr<wallet_rpc_scan_data>& range)
+{
+	drop_from_short_history(ctx.short_chain_history, 3);
+	// prepend the last 3 blocks, should be enough to guard against a block or two's reorg
+	cryptonote::block bl;
+	for(auto it=range->blocks_bin.rbegin(); it != range->blocks_bin.rend() && std::distance(range->blocks_bin.rbegin(), it) < 3; ++it)
+	{
+		bool ok = cryptonote::parse_and_validate_block_from_blob(it->block, bl);
+		THROW_WALLET_EXCEPTION_IF(!ok, error::block_parse_error, it->block);
+		ctx.short_chain_history.push_front(cryptonote::get_block_hash(bl));
+		// the top block is prepended first and ends up behind the other two
+		if(it == range->blocks_bin.rbegin())
+			ctx.top_hash = ctx.short_chain_history.front();
+	}
+
+	range->dl_order = ctx.dl_order++;
+	ctx.top_height = range->blocks_start_height + range->blocks_bin.size() - 1;
+	ctx.daemon_height = std::max(ctx.daemon_height, range->current_height);
+	ctx.last_range_size = range->blocks_bin.size();
+
+	ctx.refresh_ctx.m_scan_in_queue.wait_for_size(ctx.scan_thd_cnt + 1);
+	ctx.refresh_ctx.m_scan_in_queue.push(std::move(range));
+	GULPS_LOG_L1("Pushed blocks...");
+}
+
+// Checks that a range pulled by height continues from the last pushed block, trims the
+// blocks we already have down to the one block of overlap integration needs, and pushes it
+bool wallet2::link_block_range(wallet2::wallet_block_dl_ctx& ctx, std::unique_ptr<wallet_rpc_scan_data>& range)
+{
+	if(range->blocks_bin.empty() || range->blocks_start_height > ctx.top_height)
+		return false;
+
+	const size_t overlap = ctx.top_height - range->blocks_start_height;
+	if(overlap + 1 >= range->blocks_bin.size())
+		return true; // nothing new in this one
+
+	cryptonote::block bl;
+	bool ok = cryptonote::parse_and_validate_block_from_blob(range->blocks_bin[overlap].block, bl);
+	THROW_WALLET_EXCEPTION_IF(!ok, error::block_parse_error, range->blocks_bin[overlap].block);
+	if(cryptonote::get_block_hash(bl) != ctx.top_hash)
+	{
+		GULPSF_LOG_L1("Block range {} does not link up to {} - {}", range->blocks_start_height, ctx.top_height, ctx.top_hash);
+		return false;
+	}
+
+	range->blocks_bin.erase(range->blocks_bin.begin(), range->blocks_bin.begin() + overlap);
+	range->o_indices.erase(range->o_indices.begin(), range->o_indices.begin() + overlap);
+	if(!range->tx_digests.empty())
+		range->tx_digests.erase(range->tx_digests.begin(), range->tx_digests.begin() + overlap);
+	range->blocks_start_height = ctx.top_height;
+	push_block_range(ctx, range);
+	return true;
+}
+
+bool wallet2::parallel_block_download(wallet2::wallet_block_dl_ctx& ctx)
+{
+	// Size the ranges by what the daemon sent last time, it cuts responses short by size.
+	// Each range starts on the last block of the previous one so they can be linked up.
+	const uint64_t stride = std::max<size_t>(ctx.last_range_size, 2) - 1;
+	const uint64_t stop_height = ctx.daemon_height - block_dl_safe_depth;
+	const size_t conn_cnt = std::min<uint64_t>(block_dl_connections, (stop_height - ctx.top_height) / stride);
+	if(conn_cnt < 2)
+		return true;
+
+	while(ctx.dl_clients.size() < conn_cnt)
+	{
+		std::unique_ptr<epee::net_utils::http::http_simple_client> client(new epee::net_utils::http::http_simple_client());
+		if(!client->set_server(get_daemon_address(), get_daemon_login(), m_daemon_ssl))
+			return false;
+		ctx.dl_clients.push_back(std::move(client));
+	}
+
+	const uint64_t base_height = ctx.top_height;
+	const std::list<crypto::hash> no_history;
+	std::vector<std::unique_ptr<wallet_rpc_scan_data>> ranges(conn_cnt);
+	std::vector<std::thread> thds;
+	thds.reserve(conn_cnt);
+	GULPSF_LOG_L1("Pulling {} block ranges of {} from {}", conn_cnt, stride, base_height);
+	for(size_t i=0; i < conn_cnt; i++)
+	{
+		thds.emplace_back([&, i]() {
+			try
+			{
+				ranges[i] = pull_blocks(*ctx.dl_clients[i], base_height + i * stride, no_history);
+			}
+			catch(const std::exception &e)
+			{
+				GULPSF_LOG_L1("Pulling block range from {} failed: {}", base_height + i * stride, e.what());
+			}
+		});
+	}
+	for(auto& t : thds)
+		t.join();
+
+	return link_block_ranges(ctx, base_height, stride, ranges, [&](uint64_t height) {
+		return pull_blocks(*ctx.dl_clients[0], height, no_history);
+	});
+}
+
+// Pushes the ranges pulled from base_height + i * stride in order. A short response leaves a gap
+// before the next range and a failed pull leaves no range at all, both are pulled again in order.
+bool wallet2::link_block_ranges(wallet2::wallet_block_dl_ctx& ctx, uint64_t base_height, uint64_t stride, std::vector<std::unique_ptr<wallet_rpc_scan_data>>& ranges,
+								const std::function<std::unique_ptr<wallet_rpc_scan_data>(uint64_t)>& pull_range)
+{
+	for(size_t i=0; i < ranges.size() && m_run.load(std::memory_order_relaxed); i++)
+	{
+		while(ctx.top_height < base_height + i * stride && m_run.load(std::memory_order_relaxed))
+		{
+			const uint64_t top_height = ctx.top_height;
+			std::unique_ptr<wallet_rpc_scan_data> gap = pull_range(top_height);
+			if(!link_block_range(ctx, gap) || ctx.top_height == top_height)
+				return false;
+		}
+
+		if(!ranges[i])
+			ranges[i] = pull_range(ctx.top_height);
+		if(!link_block_range(ctx, ranges[i]))
+			return false;
+	}
+	return true;
+}
+
 void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 {
 	size_t try_count = 0;
-	size_t last_top_height = 0;
-	size_t current_top_height = 0;
 	bool first_round = true;
 	std::unique_ptr<wallet2::wallet_rpc_scan_data> pull_res;
 	ctx.refreshed = false;
 	ctx.error = false;
 	ctx.cancelled = false;
-	size_t dl_order = 0;
+	ctx.dl_order = 0;
+	ctx.top_height = 0;
+	ctx.daemon_height = 0;
+	ctx.last_range_size = 0;
+	// the local database has no round trips to hide
+	ctx.parallel_dl = !m_local_db;
 
 	while(m_run.load(std::memory_order_relaxed))
 	{
@@ -104,8 +399,7 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 				throw std::exception();
 			}
 
-			current_top_height = pull_res->blocks_start_height + pull_res->blocks_bin.size()-1;
-			if(last_top_height == current_top_height)
+			if(ctx.top_height == pull_res->blocks_start_height + pull_res->blocks_bin.size()-1)
 			{
 				GULPS_LOG_L1("No more blocks from daemon.");
 				ctx.refresh_ctx.m_scan_in_queue.set_finish_flag();
@@ -113,8 +407,6 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 				return;
 			}
 
-			last_top_height = current_top_height;
-			pull_res->dl_order = dl_order++;
 			if(first_round)
 			{
 				// Use chain history from now on
@@ -122,19 +414,30 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 				first_round = false;
 			}
 
-			drop_from_short_history(ctx.short_chain_history, 3);
-			// prepend the last 3 blocks, should be enough to guard against a block or two's reorg
-			cryptonote::block bl;
-			for(auto it=pull_res->blocks_bin.rbegin(); it != pull_res->blocks_bin.rend() && std::distance(pull_res->blocks_bin.rbegin(), it) < 3; ++it)
+			push_block_range(ctx, pull_res);
+
+			// Far below the tip the chain is settled, so fetch several ranges at once by height.
+			// Anything that does not link up is dropped and the history based pull picks up from there.
+			while(ctx.parallel_dl && m_run.load(std::memory_order_relaxed) &&
+				ctx.daemon_height > ctx.top_height + block_dl_safe_depth + 2 * COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT)
 			{
-				bool ok = cryptonote::parse_and_validate_block_from_blob(it->block, bl);
-				THROW_WALLET_EXCEPTION_IF(!ok, error::block_parse_error, it->block);
-				ctx.short_chain_history.push_front(cryptonote::get_block_hash(bl));
-			}
+				const uint64_t top_height = ctx.top_height;
+				bool ok = false;
+				try
+				{
+					ok = parallel_block_download(ctx);
+				}
+				catch(const std::exception &e)
+				{
+					GULPS_LOG_L1("Parallel block download failed: ", e.what());
+				}
 
-			ctx.refresh_ctx.m_scan_in_queue.wait_for_size(ctx.scan_thd_cnt + 1);
-			ctx.refresh_ctx.m_scan_in_queue.push(std::move(pull_res));
-			GULPS_LOG_L1("Pushed blocks...");
+				if(!ok || ctx.top_height == top_height)
+				{
+					GULPS_LOG_L1("Falling back to sequential block download");
+					ctx.parallel_dl = false;
+				}
+			}
 		}
 		catch(...)
 		{
@@ -169,8 +472,6 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 
 bool wallet2::block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid, const cryptonote::transaction& tx, bloom_filter& in_kimg, std::unordered_set<crypto::key_image>& inc_kimg)
 {
-	hw::core::device_default dummy_dev;
-	const cryptonote::account_keys &keys = ctx.account.get_keys();
 	GULPS_LOG_L2("Scanning tx ", txid);
 	for(const auto& tx_in : tx.vin)
 	{
@@ -181,133 +482,172 @@ bool wallet2::block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid
 		in_kimg.add_element(&ki, sizeof(crypto::key_image));
 	}
 
-	std::vector<cryptonote::tx_extra_field> tx_extra_fields;
-	if(!parse_tx_extra(tx.extra, tx_extra_fields))
+	tx_scan_keys tx_keys;
+	if(!tx_keys.load(txid, tx))
+		return false;
+
+	std::vector<crypto::public_key> out_keys;
+	std::vector<size_t> out_indices;
+	out_keys.reserve(tx.vout.size());
+	out_indices.reserve(tx.vout.size());
+	for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
 	{
-		// Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-		GULPS_LOG_L0("Transaction extra has unsupported format: ", txid);
+		if(tx.vout[out_idx].target.type() != typeid(cryptonote::txout_to_key))
+		{
+			GULPS_LOG_L0("Wrong type id in transaction out");
+			continue;
+		}
+		out_keys.push_back(boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key);
+		out_indices.push_back(out_idx);
 	}
 
-	cryptonote::tx_extra_pub_key pub_key_field;
-	if(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field))
+	return block_scan_outputs(ctx, tx_keys.tx_pub_key, tx_keys.additional_tx_pub_keys, out_keys, out_indices, inc_kimg);
+}
+
+bool wallet2::block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest& digest, bloom_filter& in_kimg, std::unordered_set<crypto::key_image>& inc_kimg)
+{
+	GULPS_LOG_L2("Scanning tx digest ", txid);
+	for(const crypto::key_image& ki : digest.key_images)
+		in_kimg.add_element(&ki, sizeof(crypto::key_image));
+
+	if(digest.tx_pub_key == crypto::null_pkey)
 	{
 		GULPS_LOG_L0("Public key wasn't found in the transaction extra. Skipping transaction ", txid);
 		return false;
 	}
 
-	const crypto::public_key& tx_pub_key = pub_key_field.pub_key;
-	crypto::key_derivation derivation;
-	bool derivation_res;
-#ifdef HAVE_EC_64
-	derivation_res = crypto::generate_key_derivation_64(tx_pub_key, keys.m_view_secret_key, derivation);
-#else
-	derivation_res = crypto::generate_key_derivation(tx_pub_key, keys.m_view_secret_key, derivation);
-#endif
-
-	if(!derivation_res)
+	std::vector<crypto::public_key> out_keys;
+	std::vector<size_t> out_indices;
+	out_keys.reserve(digest.output_keys.size());
+	out_indices.reserve(digest.output_keys.size());
+	for(size_t out_idx = 0; out_idx < digest.output_keys.size(); out_idx++)
 	{
-		GULPS_WARN("Failed to generate key derivation from tx pubkey, skipping");
-		memcpy(&derivation, rct::identity().bytes, sizeof(derivation));
+		if(digest.output_keys[out_idx] == crypto::null_pkey)
+			continue;
+		out_keys.push_back(digest.output_keys[out_idx]);
+		out_indices.push_back(out_idx);
 	}
 
-	std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(tx);
-	std::vector<crypto::key_derivation> additional_derivations;
-	additional_derivations.resize(additional_tx_pub_keys.size());
+	return block_scan_outputs(ctx, digest.tx_pub_key, digest.additional_tx_pub_keys, out_keys, out_indices, inc_kimg);
+}
 
-	// additional tx pubkeys and derivations for multi-destination transfers involving one or more subaddresses
-	for(size_t i = 0; i < additional_tx_pub_keys.size(); ++i)
-	{
+bool wallet2::block_scan_outputs(const wallet_scan_ctx& ctx, const crypto::public_key& tx_pub_key, const std::vector<crypto::public_key>& additional_tx_pub_keys,
+								 std::vector<crypto::public_key>& out_keys, std::vector<size_t>& out_indices, std::unordered_set<crypto::key_image>& inc_kimg)
+{
+	hw::core::device_default dummy_dev;
+	const cryptonote::account_keys &keys = ctx.account.get_keys();
+
+	// The main tx pubkey goes first, then the additional ones for multi-destination transfers
+	// involving subaddresses, all derived in one batch
+	const size_t additional_cnt = additional_tx_pub_keys.size();
+	std::vector<crypto::public_key> tx_pub_keys;
+	tx_pub_keys.reserve(additional_cnt + 1);
+	tx_pub_keys.push_back(tx_pub_key);
+	tx_pub_keys.insert(tx_pub_keys.end(), additional_tx_pub_keys.begin(), additional_tx_pub_keys.end());
+	std::vector<crypto::secret_key> view_keys(tx_pub_keys.size(), keys.m_view_secret_key);
+	std::vector<crypto::key_derivation> derivations(tx_pub_keys.size());
+	std::unique_ptr<bool[]> derivation_ok(new bool[tx_pub_keys.size()]);
 #ifdef HAVE_EC_64
-		derivation_res = crypto::generate_key_derivation_64(additional_tx_pub_keys[i], keys.m_view_secret_key, additional_derivations[i]);
+	crypto::generate_key_derivations_64(tx_pub_keys.data(), view_keys.data(), tx_pub_keys.size(), derivations.data(), derivation_ok.get());
 #else
-		derivation_res = crypto::generate_key_derivation(additional_tx_pub_keys[i], keys.m_view_secret_key, additional_derivations[i]);
+	crypto::generate_key_derivations(tx_pub_keys.data(), view_keys.data(), tx_pub_keys.size(), derivations.data(), derivation_ok.get());
 #endif
-		if(!derivation_res)
-		{
-			GULPS_WARN("Failed to generate key derivation from extra pubkey ", i, ", skipping");
-			memcpy(&additional_derivations[i], rct::identity().bytes, sizeof(additional_derivations[i]));
-		}
-	}
 
-	bool spend_unknown = keys.m_spend_secret_key == crypto::null_skey || !keys.m_multisig_keys.empty();
-	bool ret = false;
-	for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
+	for(size_t i = 0; i < derivations.size(); ++i)
 	{
-		if(tx.vout[out_idx].target.type() != typeid(cryptonote::txout_to_key))
-		{
-			GULPS_LOG_L0("Wrong type id in transaction out");
+		if(derivation_ok[i])
 			continue;
-		}
+		if(i == 0)
+			GULPS_WARN("Failed to generate key derivation from tx pubkey, skipping");
+		else
+			GULPS_WARN("Failed to generate key derivation from extra pubkey ", i - 1, ", skipping");
+		memcpy(&derivations[i], rct::identity().bytes, sizeof(derivations[i]));
+	}
 
-		// try the shared tx pubkey
-		crypto::public_key subaddress_spendkey;
-		const crypto::public_key& out_pubkey = boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key;
+	bool spend_unknown = keys.m_spend_secret_key == crypto::null_skey || !keys.m_multisig_keys.empty();
+	auto add_found = [&](size_t out_idx, const crypto::public_key& out_pubkey, const crypto::key_derivation& derivation, const cryptonote::subaddress_index& subaddr_index) {
+		if(spend_unknown)
+			return;
+		cryptonote::keypair eph;
+		crypto::key_image ki;
+		bool r = cryptonote::generate_key_image_helper_precomp(keys, out_pubkey, derivation, out_idx, subaddr_index, eph, ki, dummy_dev);
+		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
+		THROW_WALLET_EXCEPTION_IF(eph.pub != out_pubkey,
+							error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
+		THROW_WALLET_EXCEPTION_IF(!inc_kimg.insert(ki).second, error::wallet_internal_error, "Duplicate key image");
+	};
+
+	// try the shared tx pubkey on every output at once
+	std::vector<crypto::key_derivation> out_derivations(out_keys.size(), derivations[0]);
+
+	std::vector<crypto::public_key> subaddress_spendkeys(out_keys.size());
+	std::unique_ptr<bool[]> derive_ok(new bool[out_keys.size()]);
 #ifdef HAVE_EC_64
-		derivation_res = crypto::derive_subaddress_public_key_64(out_pubkey, derivation, out_idx, subaddress_spendkey);
+	crypto::derive_subaddress_public_keys_64(out_keys.data(), out_derivations.data(), out_indices.data(), out_keys.size(), subaddress_spendkeys.data(), derive_ok.get());
 #else
-		derivation_res = crypto::derive_subaddress_public_key(out_pubkey, derivation, out_idx, subaddress_spendkey);
+	crypto::derive_subaddress_public_keys(out_keys.data(), out_derivations.data(), out_indices.data(), out_keys.size(), subaddress_spendkeys.data(), derive_ok.get());
 #endif
 
-		if(!derivation_res)
+	bool ret = false;
+	size_t miss_cnt = 0;
+	for(size_t i = 0; i < out_keys.size(); i++)
+	{
+		if(!derive_ok[i])
 		{
 			GULPS_WARN("Failed to derive main addresses public key, skipping...");
 			continue;
 		}
 
-		auto found = m_subaddresses.find(subaddress_spendkey);
+		auto found = m_subaddresses.find(subaddress_spendkeys[i]);
 		if(found != m_subaddresses.end())
 		{
-			if(!spend_unknown)
-			{
-				cryptonote::keypair eph;
-				crypto::key_image ki;
-				bool r = cryptonote::generate_key_image_helper_precomp(keys, out_pubkey, derivation, out_idx, found->second, eph, ki, dummy_dev);
-				THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
-				THROW_WALLET_EXCEPTION_IF(eph.pub != out_pubkey,
-									error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
-				THROW_WALLET_EXCEPTION_IF(!inc_kimg.insert(ki).second, error::wallet_internal_error, "Duplicate key image");
-			}
+			add_found(out_indices[i], out_keys[i], derivations[0], found->second);
 			ret = true;
 			continue;
 		}
 
-		// try additional tx pubkeys if available
-		if(!additional_derivations.empty())
+		// keep the misses at the front for the additional tx pubkeys
+		out_keys[miss_cnt] = out_keys[i];
+		out_indices[miss_cnt] = out_indices[i];
+		miss_cnt++;
+	}
+
+	// try additional tx pubkeys if available
+	if(additional_cnt == 0 || miss_cnt == 0)
+		return ret;
+
+	out_keys.resize(miss_cnt);
+	out_indices.resize(miss_cnt);
+	out_derivations.resize(miss_cnt);
+	for(size_t i = 0; i < miss_cnt; i++)
+	{
+		if(out_indices[i] >= additional_cnt)
 		{
-			if(out_idx >= additional_derivations.size())
-			{
-				GULPS_LOG_L0("Wrong number of additional derivations");
-				return false;
-			}
+			GULPS_LOG_L0("Wrong number of additional derivations");
+			return false;
+		}
+		out_derivations[i] = derivations[out_indices[i] + 1];
+	}
 
 #ifdef HAVE_EC_64
-			derivation_res = crypto::derive_subaddress_public_key_64(out_pubkey, additional_derivations[out_idx], out_idx, subaddress_spendkey);
+	crypto::derive_subaddress_public_keys_64(out_keys.data(), out_derivations.data(), out_indices.data(), miss_cnt, subaddress_spendkeys.data(), derive_ok.get());
 #else
-			derivation_res = crypto::derive_subaddress_public_key(out_pubkey, additional_derivations[out_idx], out_idx, subaddress_spendkey);
+	crypto::derive_subaddress_public_keys(out_keys.data(), out_derivations.data(), out_indices.data(), miss_cnt, subaddress_spendkeys.data(), derive_ok.get());
 #endif
 
-			if(!derivation_res)
-			{
-				GULPS_WARN("Failed to derive subaddresses public key, skipping...");
-				continue;
-			}
+	for(size_t i = 0; i < miss_cnt; i++)
+	{
+		if(!derive_ok[i])
+		{
+			GULPS_WARN("Failed to derive subaddresses public key, skipping...");
+			continue;
+		}
 
-			found = m_subaddresses.find(subaddress_spendkey);
-			if(found != m_subaddresses.end())
-			{
-				if(!spend_unknown)
-				{
-					cryptonote::keypair eph;
-					crypto::key_image ki;
-					bool r = cryptonote::generate_key_image_helper_precomp(keys, out_pubkey, additional_derivations[out_idx], out_idx, found->second, eph, ki, dummy_dev);
-					THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
-					THROW_WALLET_EXCEPTION_IF(eph.pub != out_pubkey,
-										error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
-					THROW_WALLET_EXCEPTION_IF(!inc_kimg.insert(ki).second, error::wallet_internal_error, "Duplicate key image");
-				}
-				ret = true;
-				continue;
-			}
+		auto found = m_subaddresses.find(subaddress_spendkeys[i]);
+		if(found != m_subaddresses.end())
+		{
+			add_found(out_indices[i], out_keys[i], out_derivations[i], found->second);
+			ret = true;
 		}
 	}
 
@@ -332,6 +672,8 @@ void wallet2::block_scan_thd(const wallet_scan_ctx& ctx)
 			}
 
 			THROW_WALLET_EXCEPTION_IF(pull_res->blocks_bin.size() != pull_res->o_indices.size(), error::wallet_internal_error, "size mismatch");
+			const bool digests = !pull_res->tx_digests.empty();
+			THROW_WALLET_EXCEPTION_IF(digests && pull_res->blocks_bin.size() != pull_res->tx_digests.size(), error::wallet_internal_error, "size mismatch");
 
 			size_t blk_i=0;
 			size_t in_count = 0;
@@ -345,10 +687,11 @@ void wallet2::block_scan_thd(const wallet_scan_ctx& ctx)
 				bool r = cryptonote::parse_and_validate_block_from_blob(bl.block, blke.block);
 				THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl.block);
 				blke.block_hash = get_block_hash(blke.block);
-				THROW_WALLET_EXCEPTION_IF(bl.txs.size() + 1 != blk_o_idx.indices.size(), error::wallet_internal_error,
-					"block transactions=" + std::to_string(bl.txs.size()) + " not match with daemon response size=" +
+				const size_t tx_cnt = digests ? pull_res->tx_digests[blk_i].size() : bl.txs.size();
+				THROW_WALLET_EXCEPTION_IF(tx_cnt + 1 != blk_o_idx.indices.size(), error::wallet_internal_error,
+					"block transactions=" + std::to_string(tx_cnt) + " not match with daemon response size=" +
 					std::to_string(blk_o_idx.indices.size()) + " for block " + std::to_string(blke.block_height));
-				THROW_WALLET_EXCEPTION_IF(bl.txs.size() != blke.block.tx_hashes.size(), error::wallet_internal_error,
+				THROW_WALLET_EXCEPTION_IF(tx_cnt != blke.block.tx_hashes.size(), error::wallet_internal_error,
 										  "Wrong amount of transactions for block");
 
 				blk_i++;
@@ -373,6 +716,8 @@ void wallet2::block_scan_thd(const wallet_scan_ctx& ctx)
 					in_count += tx.vin.size();
 					tx_i++;
 				}
+				for(size_t txi=0; digests && txi < tx_cnt; txi++)
+					in_count += pull_res->tx_digests[blke.block_height - pull_res->blocks_start_height][txi].key_images.size();
 			}
 
 			pull_res->key_images.init(in_count);
@@ -394,6 +739,12 @@ void wallet2::block_scan_thd(const wallet_scan_ctx& ctx)
 					if(block_scan_tx(ctx, blke.block.tx_hashes[txi], blke.txes[txi], pull_res->key_images, pull_res->incoming_kimg))
 						pull_res->indices_found.emplace_back(i, txi+1);
 				}
+
+				for(size_t txi=0; digests && txi < pull_res->tx_digests[i].size(); txi++)
+				{
+					if(block_scan_tx(ctx, blke.block.tx_hashes[txi], pull_res->tx_digests[i][txi], pull_res->key_images, pull_res->incoming_kimg))
+						pull_res->indices_found.emplace_back(i, txi+1);
+				}
 			}
 
 			ctx.refresh_ctx.m_scan_out_queue.push(std::move(pull_res));
@@ -91,6 +91,21 @@ boost::optional<tools::password_container> password_prompter(const char *prompt,
 	}
 	return pwd_container;
 }
+
+// Transfer list cursors are "<height>-<txid>", paging resumes past that position
+std::string transfer_cursor_to_str(const tools::wallet2::transfer_position &pos)
+{
+	return std::to_string(pos.height) + "-" + epee::string_tools::pod_to_hex(pos.txid);
+}
+
+bool transfer_cursor_from_str(const std::string &str, tools::wallet2::transfer_position &pos)
+{
+	const size_t sep = str.find('-');
+	if(sep == std::string::npos || sep == 0)
+		return false;
+	return epee::string_tools::get_xtype_from_string(pos.height, str.substr(0, sep)) &&
+		   epee::string_tools::hex_to_pod(str.substr(sep + 1), pos.txid);
+}
 }
 
 namespace tools
@@ -884,6 +899,76 @@ bool wallet_rpc_server::on_transfer_split(const wallet_rpc::COMMAND_RPC_TRANSFER
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool wallet_rpc_server::on_transfer_batch(const wallet_rpc::COMMAND_RPC_TRANSFER_BATCH::request &req, wallet_rpc::COMMAND_RPC_TRANSFER_BATCH::response &res, epee::json_rpc::error &er)
+{
+	std::vector<std::vector<cryptonote::tx_destination_entry>> dsts;
+
+	if(!m_wallet)
+		return not_open(er);
+	if(m_wallet->restricted())
+	{
+		er.code = WALLET_RPC_ERROR_CODE_DENIED;
+		er.message = "Command unavailable in restricted mode.";
+		return false;
+	}
+
+	// validate every transaction of the batch, they all carry the same payment id
+	crypto::uniform_payment_id pid;
+	for(const auto &tx : req.txes)
+	{
+		std::vector<cryptonote::tx_destination_entry> tx_dsts;
+		crypto::uniform_payment_id tx_pid;
+		if(!validate_transfer(tx.destinations, req.payment_id, tx_dsts, tx_pid, true, er))
+		{
+			return false;
+		}
+		if(!dsts.empty() && (tx_pid.zero != pid.zero || tx_pid.payment_id != pid.payment_id))
+		{
+			er.code = WALLET_RPC_ERROR_CODE_WRONG_PAYMENT_ID;
+			er.message = "A single payment id is allowed per batch";
+			return false;
+		}
+		pid = tx_pid;
+		dsts.push_back(std::move(tx_dsts));
+	}
+
+	if(dsts.empty())
+	{
+		er.code = WALLET_RPC_ERROR_CODE_ZERO_DESTINATION;
+		er.message = "No transactions in this batch";
+		return false;
+	}
+
+	try
+	{
+		uint64_t mixin;
+		if(req.ring_size != 0)
+		{
+			mixin = m_wallet->adjust_mixin(req.ring_size - 1);
+		}
+		else
+		{
+			mixin = m_wallet->adjust_mixin(req.mixin);
+		}
+		uint32_t priority = m_wallet->adjust_priority(req.priority);
+		GULPS_LOG_L2("on_transfer_batch calling create_transactions_batch");
+
+		std::vector<wallet2::pending_tx> ptx_vector =
+			m_wallet->create_transactions_batch(dsts, mixin, req.unlock_time, priority, check_pid(pid), req.account_index, req.subaddr_indices);
+
+		GULPS_LOG_L2("on_transfer_batch called create_transactions_batch");
+
+		return fill_response(ptx_vector, req.get_tx_keys, res.tx_key_list, res.amount_list, res.fee_list, res.multisig_txset, req.do_not_relay,
+							 res.tx_hash_list, req.get_tx_hex, res.tx_blob_list, req.get_tx_metadata, res.tx_metadata_list, er);
+	}
+	catch(const std::exception &e)
+	{
+		handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_GENERIC_TRANSFER_ERROR);
+		return false;
+	}
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
 bool wallet_rpc_server::on_sweep_all(const wallet_rpc::COMMAND_RPC_SWEEP_ALL::request &req, wallet_rpc::COMMAND_RPC_SWEEP_ALL::response &res, epee::json_rpc::error &er)
 {
 	std::vector<cryptonote::tx_destination_entry> dsts;
@@ -1185,58 +1270,84 @@ bool wallet_rpc_server::on_get_payments(const wallet_rpc::COMMAND_RPC_GET_PAYMEN
 bool wallet_rpc_server::on_get_bulk_payments(const wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::request &req, wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::response &res, epee::json_rpc::error &er)
 {
 	res.payments.clear();
+	res.has_more = false;
 	if(!m_wallet)
 		return not_open(er);
 
-	/* If the payment ID list is empty, we get payments to any payment ID (or lack thereof) */
-	if(req.payment_ids.empty())
+	boost::optional<wallet2::transfer_position> after;
+	if(!req.cursor.empty())
 	{
-		std::list<std::pair<crypto::hash, wallet2::payment_details>> payment_list;
-		m_wallet->get_payments(payment_list, req.min_block_height);
-
-		for(auto &payment : payment_list)
+		wallet2::transfer_position pos;
+		if(!transfer_cursor_from_str(req.cursor, pos))
 		{
-			wallet_rpc::payment_details rpc_payment;
-			rpc_payment.payment_id = epee::string_tools::pod_to_hex(payment.first);
-			rpc_payment.tx_hash = epee::string_tools::pod_to_hex(payment.second.m_tx_hash);
-			rpc_payment.amount = payment.second.m_amount;
-			rpc_payment.block_height = payment.second.m_block_height;
-			rpc_payment.unlock_time = payment.second.m_unlock_time;
-			rpc_payment.subaddr_index = payment.second.m_subaddr_index;
-			rpc_payment.address = m_wallet->get_subaddress_as_str(payment.second.m_subaddr_index);
-			res.payments.push_back(std::move(rpc_payment));
+			er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+			er.message = "Invalid cursor: " + req.cursor;
+			return false;
 		}
-
-		return true;
+		after = pos;
 	}
+	res.next_cursor = req.cursor;
 
-	for(auto &payment_id_str : req.payment_ids)
+	std::list<std::pair<std::string, wallet2::payment_details>> payment_list;
+	/* If the payment ID list is empty, we get payments to any payment ID (or lack thereof) */
+	if(req.payment_ids.empty())
+	{
+		std::list<std::pair<crypto::hash, wallet2::payment_details>> payments;
+		res.has_more = m_wallet->get_payments(payments, req.min_block_height, (uint64_t)-1, boost::none, {}, after, req.max_count);
+		for(auto &payment : payments)
+			payment_list.emplace_back(epee::string_tools::pod_to_hex(payment.first), std::move(payment.second));
+	}
+	else
 	{
-		crypto::uniform_payment_id payment_id;
-		if(!wallet2::parse_payment_id(payment_id_str, payment_id))
+		for(auto &payment_id_str : req.payment_ids)
 		{
-			er.code = WALLET_RPC_ERROR_CODE_WRONG_PAYMENT_ID;
-			er.message = "Payment ID has invalid format: " + payment_id_str;
-			return false;
-		}
+			crypto::uniform_payment_id payment_id;
+			if(!wallet2::parse_payment_id(payment_id_str, payment_id))
+			{
+				er.code = WALLET_RPC_ERROR_CODE_WRONG_PAYMENT_ID;
+				er.message = "Payment ID has invalid format: " + payment_id_str;
+				return false;
+			}
 
-		std::list<wallet2::payment_details> payment_list;
-		m_wallet->get_payments(payment_id, payment_list, req.min_block_height);
+			std::list<wallet2::payment_details> payments;
+			m_wallet->get_payments(payment_id, payments, req.min_block_height);
+			for(auto &payment : payments)
+			{
+				if(!after || *after < wallet2::transfer_position{payment.m_block_height, payment.m_tx_hash})
+					payment_list.emplace_back(payment_id_str, std::move(payment));
+			}
+		}
 
-		for(auto &payment : payment_list)
+		// each payment id is looked up on its own, put them in cursor order before cutting the page
+		payment_list.sort([](const std::pair<std::string, wallet2::payment_details> &a, const std::pair<std::string, wallet2::payment_details> &b) {
+			return wallet2::transfer_position{a.second.m_block_height, a.second.m_tx_hash} < wallet2::transfer_position{b.second.m_block_height, b.second.m_tx_hash};
+		});
+		if(req.max_count != 0 && payment_list.size() > req.max_count)
 		{
-			wallet_rpc::payment_details rpc_payment;
-			rpc_payment.payment_id = payment_id_str;
-			rpc_payment.tx_hash = epee::string_tools::pod_to_hex(payment.m_tx_hash);
-			rpc_payment.amount = payment.m_amount;
-			rpc_payment.block_height = payment.m_block_height;
-			rpc_payment.unlock_time = payment.m_unlock_time;
-			rpc_payment.subaddr_index = payment.m_subaddr_index;
-			rpc_payment.address = m_wallet->get_subaddress_as_str(payment.m_subaddr_index);
-			res.payments.push_back(std::move(rpc_payment));
+			auto it = std::next(payment_list.begin(), req.max_count);
+			const crypto::hash &txid = std::prev(it)->second.m_tx_hash;
+			while(it != payment_list.end() && it->second.m_tx_hash == txid)
+				++it;
+			res.has_more = it != payment_list.end();
+			payment_list.erase(it, payment_list.end());
 		}
 	}
 
+	for(auto &payment : payment_list)
+	{
+		wallet_rpc::payment_details rpc_payment;
+		rpc_payment.payment_id = payment.first;
+		rpc_payment.tx_hash = epee::string_tools::pod_to_hex(payment.second.m_tx_hash);
+		rpc_payment.amount = payment.second.m_amount;
+		rpc_payment.block_height = payment.second.m_block_height;
+		rpc_payment.unlock_time = payment.second.m_unlock_time;
+		rpc_payment.subaddr_index = payment.second.m_subaddr_index;
+		rpc_payment.address = m_wallet->get_subaddress_as_str(payment.second.m_subaddr_index);
+		res.payments.push_back(std::move(rpc_payment));
+	}
+	if(!payment_list.empty())
+		res.next_cursor = transfer_cursor_to_str({payment_list.back().second.m_block_height, payment_list.back().second.m_tx_hash});
+
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -1278,13 +1389,12 @@ bool wallet_rpc_server::on_incoming_transfers(const wallet_rpc::COMMAND_RPC_INCO
 			{
 				transfers_found = true;
 			}
-			auto txBlob = t_serializable_object_to_blob(td.m_tx);
 			wallet_rpc::transfer_details rpc_transfers;
 			rpc_transfers.amount = td.amount();
 			rpc_transfers.spent = td.m_spent;
 			rpc_transfers.global_index = td.m_global_output_index;
 			rpc_transfers.tx_hash = epee::string_tools::pod_to_hex(td.m_txid);
-			rpc_transfers.tx_size = txBlob.size();
+			rpc_transfers.tx_size = td.m_tx_size;
 			rpc_transfers.subaddr_index = td.m_subaddr_index.minor;
 			rpc_transfers.key_image = req.verbose && td.m_key_image_known ? epee::string_tools::pod_to_hex(td.m_key_image) : "";
 			res.transfers.push_back(rpc_transfers);
@@ -1812,26 +1922,58 @@ bool wallet_rpc_server::on_get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANS
 		max_height = req.max_height <= max_height ? req.max_height : max_height;
 	}
 
-	if(req.in)
+	boost::optional<wallet2::transfer_position> after;
+	if(!req.cursor.empty())
 	{
-		std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-		m_wallet->get_payments(payments, min_height, max_height, req.account_index, req.subaddr_indices);
-		for(std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i)
+		wallet2::transfer_position pos;
+		if(!transfer_cursor_from_str(req.cursor, pos))
 		{
-			res.in.push_back(wallet_rpc::transfer_entry());
-			fill_transfer_entry(res.in.back(), i->second.m_tx_hash, i->first, i->second);
+			er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+			er.message = "Invalid cursor: " + req.cursor;
+			return false;
 		}
+		after = pos;
 	}
 
+	std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments_in;
+	std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments_out;
+	bool more_in = false, more_out = false;
+	if(req.in)
+		more_in = m_wallet->get_payments(payments_in, min_height, max_height, req.account_index, req.subaddr_indices, after, req.max_count);
 	if(req.out)
+		more_out = m_wallet->get_payments_out(payments_out, min_height, max_height, req.account_index, req.subaddr_indices, after, req.max_count);
+
+	// in and out share one page, it ends with the tx holding the max_count-th entry of both
+	std::vector<wallet2::transfer_position> positions;
+	positions.reserve(payments_in.size() + payments_out.size());
+	for(const auto &p : payments_in)
+		positions.push_back({p.second.m_block_height, p.second.m_tx_hash});
+	for(const auto &p : payments_out)
+		positions.push_back({p.second.m_block_height, p.first});
+	std::sort(positions.begin(), positions.end());
+	res.has_more = more_in || more_out;
+	if(req.max_count != 0 && positions.size() >= req.max_count)
+	{
+		const wallet2::transfer_position last = positions[req.max_count - 1];
+		res.has_more = res.has_more || last < positions.back();
+		payments_in.remove_if([&last](const std::pair<crypto::hash, tools::wallet2::payment_details> &p) { return last < wallet2::transfer_position{p.second.m_block_height, p.second.m_tx_hash}; });
+		payments_out.remove_if([&last](const std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details> &p) { return last < wallet2::transfer_position{p.second.m_block_height, p.first}; });
+		res.next_cursor = transfer_cursor_to_str(last);
+	}
+	else
 	{
-		std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-		m_wallet->get_payments_out(payments, min_height, max_height, req.account_index, req.subaddr_indices);
-		for(std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i)
-		{
-			res.out.push_back(wallet_rpc::transfer_entry());
-			fill_transfer_entry(res.out.back(), i->first, i->second);
-		}
+		res.next_cursor = positions.empty() ? req.cursor : transfer_cursor_to_str(positions.back());
+	}
+
+	for(const auto &p : payments_in)
+	{
+		res.in.push_back(wallet_rpc::transfer_entry());
+		fill_transfer_entry(res.in.back(), p.second.m_tx_hash, p.first, p.second);
+	}
+	for(const auto &p : payments_out)
+	{
+		res.out.push_back(wallet_rpc::transfer_entry());
+		fill_transfer_entry(res.out.back(), p.first, p.second);
 	}
 
 	if(req.pending || req.failed)
@@ -3026,6 +3168,11 @@ bool wallet_rpc_server::on_validate_address(const wallet_rpc::COMMAND_RPC_VALIDA
 	er.message = std::string("Invalid address");
 	return false;
 }
+//------------------------------------------------------------------------------------------------------------------------------
+void wallet_rpc_server::on_get_metrics(std::string &body)
+{
+	epee::net_utils::rpc_metrics::instance().write_prometheus(body, "ryo_wallet_rpc");
+}
 
 }
 
@@ -94,6 +94,7 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
 
 	BEGIN_URI_MAP2()
+	MAP_URI_METRICS2("/metrics", on_get_metrics)
 	BEGIN_JSON_RPC_MAP("/json_rpc")
 	MAP_JON_RPC_WE("get_balance", on_getbalance, wallet_rpc::COMMAND_RPC_GET_BALANCE)
 	MAP_JON_RPC_WE("get_address", on_getaddress, wallet_rpc::COMMAND_RPC_GET_ADDRESS)
@@ -113,6 +114,7 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	MAP_JON_RPC_WE("getheight", on_getheight, wallet_rpc::COMMAND_RPC_GET_HEIGHT)
 	MAP_JON_RPC_WE("transfer", on_transfer, wallet_rpc::COMMAND_RPC_TRANSFER)
 	MAP_JON_RPC_WE("transfer_split", on_transfer_split, wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT)
+	MAP_JON_RPC_WE("transfer_batch", on_transfer_batch, wallet_rpc::COMMAND_RPC_TRANSFER_BATCH)
 	MAP_JON_RPC_WE("sweep_all", on_sweep_all, wallet_rpc::COMMAND_RPC_SWEEP_ALL)
 	MAP_JON_RPC_WE("sweep_single", on_sweep_single, wallet_rpc::COMMAND_RPC_SWEEP_SINGLE)
 	MAP_JON_RPC_WE("relay_tx", on_relay_tx, wallet_rpc::COMMAND_RPC_RELAY_TX)
@@ -187,6 +189,7 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	bool validate_transfer(const std::list<wallet_rpc::transfer_destination> &destinations, const std::string &s_payment_id, std::vector<cryptonote::tx_destination_entry> &dsts, crypto::uniform_payment_id& payment_id, bool at_least_one_destination, epee::json_rpc::error &er);
 	bool on_transfer(const wallet_rpc::COMMAND_RPC_TRANSFER::request &req, wallet_rpc::COMMAND_RPC_TRANSFER::response &res, epee::json_rpc::error &er);
 	bool on_transfer_split(const wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::request &req, wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::response &res, epee::json_rpc::error &er);
+	bool on_transfer_batch(const wallet_rpc::COMMAND_RPC_TRANSFER_BATCH::request &req, wallet_rpc::COMMAND_RPC_TRANSFER_BATCH::response &res, epee::json_rpc::error &er);
 	bool on_sweep_all(const wallet_rpc::COMMAND_RPC_SWEEP_ALL::request &req, wallet_rpc::COMMAND_RPC_SWEEP_ALL::response &res, epee::json_rpc::error &er);
 	bool on_sweep_single(const wallet_rpc::COMMAND_RPC_SWEEP_SINGLE::request &req, wallet_rpc::COMMAND_RPC_SWEEP_SINGLE::response &res, epee::json_rpc::error &er);
 	bool on_relay_tx(const wallet_rpc::COMMAND_RPC_RELAY_TX::request &req, wallet_rpc::COMMAND_RPC_RELAY_TX::response &res, epee::json_rpc::error &er);
@@ -244,6 +247,9 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	//json rpc v2
 	bool on_query_key(const wallet_rpc::COMMAND_RPC_QUERY_KEY::request &req, wallet_rpc::COMMAND_RPC_QUERY_KEY::response &res, epee::json_rpc::error &er);
 
+	//prometheus text
+	void on_get_metrics(std::string &body);
+
 	// helpers
 	void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const crypto::hash &payment_id, const tools::wallet2::payment_details &pd);
 	void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const tools::wallet2::confirmed_transfer_details &pd);
@@ -531,6 +531,71 @@ struct COMMAND_RPC_TRANSFER_SPLIT
 	};
 };
 
+struct COMMAND_RPC_TRANSFER_BATCH
+{
+	struct batch_tx
+	{
+		std::list<transfer_destination> destinations;
+
+		BEGIN_KV_SERIALIZE_MAP(batch_tx)
+		KV_SERIALIZE(destinations)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	// one transaction per entry of txes, with the inputs picked for all of them before any is signed
+	struct request
+	{
+		std::list<batch_tx> txes;
+		uint32_t account_index;
+		std::set<uint32_t> subaddr_indices;
+		uint32_t priority;
+		uint64_t mixin;
+		uint64_t ring_size;
+		uint64_t unlock_time;
+		std::string payment_id;
+		bool get_tx_keys;
+		bool do_not_relay;
+		bool get_tx_hex;
+		bool get_tx_metadata;
+
+		BEGIN_KV_SERIALIZE_MAP(request)
+		KV_SERIALIZE(txes)
+		KV_SERIALIZE(account_index)
+		KV_SERIALIZE(subaddr_indices)
+		KV_SERIALIZE(priority)
+		KV_SERIALIZE_OPT(mixin, (uint64_t)0)
+		KV_SERIALIZE_OPT(ring_size, (uint64_t)0)
+		KV_SERIALIZE(unlock_time)
+		KV_SERIALIZE(payment_id)
+		KV_SERIALIZE(get_tx_keys)
+		KV_SERIALIZE_OPT(do_not_relay, false)
+		KV_SERIALIZE_OPT(get_tx_hex, false)
+		KV_SERIALIZE_OPT(get_tx_metadata, false)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct response
+	{
+		std::list<std::string> tx_hash_list;
+		std::list<std::string> tx_key_list;
+		std::list<uint64_t> amount_list;
+		std::list<uint64_t> fee_list;
+		std::list<std::string> tx_blob_list;
+		std::list<std::string> tx_metadata_list;
+		std::string multisig_txset;
+
+		BEGIN_KV_SERIALIZE_MAP(response)
+		KV_SERIALIZE(tx_hash_list)
+		KV_SERIALIZE(tx_key_list)
+		KV_SERIALIZE(amount_list)
+		KV_SERIALIZE(fee_list)
+		KV_SERIALIZE(tx_blob_list)
+		KV_SERIALIZE(tx_metadata_list)
+		KV_SERIALIZE(multisig_txset)
+		END_KV_SERIALIZE_MAP()
+	};
+};
+
 struct COMMAND_RPC_SWEEP_ALL
 {
 	struct request
@@ -740,19 +805,27 @@ struct COMMAND_RPC_GET_BULK_PAYMENTS
 	{
 		std::vector<std::string> payment_ids;
 		uint64_t min_block_height;
+		uint64_t max_count; // 0 for all of them
+		std::string cursor; // next_cursor of the previous page
 
 		BEGIN_KV_SERIALIZE_MAP(request)
 		KV_SERIALIZE(payment_ids)
 		KV_SERIALIZE(min_block_height)
+		KV_SERIALIZE_OPT(max_count, (uint64_t)0)
+		KV_SERIALIZE_OPT(cursor, std::string())
 		END_KV_SERIALIZE_MAP()
 	};
 
 	struct response
 	{
 		std::list<payment_details> payments;
+		std::string next_cursor;
+		bool has_more; // more entries follow next_cursor
 
 		BEGIN_KV_SERIALIZE_MAP(response)
 		KV_SERIALIZE(payments)
+		KV_SERIALIZE(next_cursor)
+		KV_SERIALIZE(has_more)
 		END_KV_SERIALIZE_MAP()
 	};
 };
@@ -1250,6 +1323,8 @@ struct COMMAND_RPC_GET_TRANSFERS
 		uint64_t max_height;
 		uint32_t account_index;
 		std::set<uint32_t> subaddr_indices;
+		uint64_t max_count; // for in and out together, 0 for all of them
+		std::string cursor; // next_cursor of the previous page
 
 		BEGIN_KV_SERIALIZE_MAP(request)
 		KV_SERIALIZE(in);
@@ -1262,6 +1337,8 @@ struct COMMAND_RPC_GET_TRANSFERS
 		KV_SERIALIZE_OPT(max_height, cryptonote::common_config::CRYPTONOTE_MAX_BLOCK_NUMBER);
 		KV_SERIALIZE(account_index);
 		KV_SERIALIZE(subaddr_indices);
+		KV_SERIALIZE_OPT(max_count, (uint64_t)0);
+		KV_SERIALIZE_OPT(cursor, std::string());
 		END_KV_SERIALIZE_MAP()
 	};
 
@@ -1272,6 +1349,8 @@ struct COMMAND_RPC_GET_TRANSFERS
 		std::list<transfer_entry> pending;
 		std::list<transfer_entry> failed;
 		std::list<transfer_entry> pool;
+		std::string next_cursor; // past the last in or out entry, or the request cursor if there are none
+		bool has_more;			 // more entries follow next_cursor
 
 		BEGIN_KV_SERIALIZE_MAP(response)
 		KV_SERIALIZE(in);
@@ -1279,6 +1358,8 @@ struct COMMAND_RPC_GET_TRANSFERS
 		KV_SERIALIZE(pending);
 		KV_SERIALIZE(failed);
 		KV_SERIALIZE(pool);
+		KV_SERIALIZE(next_cursor);
+		KV_SERIALIZE(has_more);
 		END_KV_SERIALIZE_MAP()
 	};
 };
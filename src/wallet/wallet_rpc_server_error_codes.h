@@ -84,3 +84,4 @@
 #define WALLET_RPC_ERROR_CODE_MULTISIG_SUBMISSION -36
 #define WALLET_RPC_ERROR_CODE_NOT_ENOUGH_UNLOCKED_MONEY -37
 #define WALLET_RPC_ERROR_CODE_NO_DAEMON_CONNECTION -38
+#define WALLET_RPC_ERROR_CODE_WRONG_CURSOR -39
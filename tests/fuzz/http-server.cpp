@@ -0,0 +1,120 @@
+// Copyright (c) 2017-2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "file_io_utils.h"
+#include "fuzzer.h"
+#include "include_base_utils.h"
+#include "net/http_protocol_handler.h"
+#include "net/net_utils_base.h"
+
+namespace
+{
+class dummy_endpoint : public epee::net_utils::i_service_endpoint
+{
+  public:
+	dummy_endpoint(boost::asio::io_service &io_service) : m_io_service(io_service) {}
+
+	virtual bool do_send(const void *ptr, size_t cb) { return true; }
+	virtual bool close() { return true; }
+	virtual bool call_run_once_service_io() { return true; }
+	virtual bool request_callback() { return true; }
+	virtual boost::asio::io_service &get_io_service() { return m_io_service; }
+	virtual bool add_ref() { return true; }
+	virtual bool release() { return true; }
+
+  private:
+	boost::asio::io_service &m_io_service;
+};
+
+class dummy_handler : public epee::net_utils::http::simple_http_connection_handler<epee::net_utils::connection_context_base>
+{
+  public:
+	dummy_handler(epee::net_utils::i_service_endpoint *endpoint, config_type &config) : simple_http_connection_handler(endpoint, config) {}
+
+	virtual bool handle_request(const epee::net_utils::http::http_request_info &query_info, epee::net_utils::http::http_response_info &response)
+	{
+		std::list<epee::net_utils::http::multipart_entry> entries;
+		if(!query_info.m_header_info.m_content_type.empty())
+			epee::net_utils::http::parse_multipart_body(query_info.m_header_info.m_content_type, query_info.m_body, entries);
+		response.m_response_code = 200;
+		response.m_response_comment = "OK";
+		return true;
+	}
+};
+}
+
+class HTTPServerFuzzer : public Fuzzer
+{
+  public:
+	HTTPServerFuzzer() : endpoint(io_service) {}
+	virtual int init();
+	virtual int run(const std::string &filename);
+
+  private:
+	boost::asio::io_service io_service;
+	dummy_endpoint endpoint;
+	epee::net_utils::http::http_server_config config;
+};
+
+int HTTPServerFuzzer::init()
+{
+	return 0;
+}
+
+int HTTPServerFuzzer::run(const std::string &filename)
+{
+	std::string s;
+
+	if(!epee::file_io_utils::load_file_to_string(filename, s))
+	{
+		std::cout << "Error: failed to load file " << filename << std::endl;
+		return 1;
+	}
+	try
+	{
+		// feed the input both in one go and split in two, to exercise partial reads
+		dummy_handler whole(&endpoint, config);
+		whole.handle_recv(s.data(), s.size());
+
+		dummy_handler split(&endpoint, config);
+		const size_t half = s.size() / 2;
+		if(split.handle_recv(s.data(), half))
+			split.handle_recv(s.data() + half, s.size() - half);
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << "Failed to test http server: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	HTTPServerFuzzer fuzzer;
+	return run_fuzzer(argc, argv, fuzzer);
+}
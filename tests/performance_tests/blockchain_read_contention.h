@@ -0,0 +1,152 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "syncobj.h"
+
+// Read latency while a writer keeps adding "blocks". The writer holds a recursive lock
+// standing in for m_blockchain_lock for the whole write, like block verification does.
+// Readers either queue on that lock (the old RPC path) or read from a db snapshot.
+template <bool use_snapshot>
+class test_blockchain_read_contention
+{
+  public:
+	static const size_t loop_count = 1000;
+	static const size_t write_hold_us = 2000;
+	static const size_t write_pause_us = 500;
+
+	test_blockchain_read_contention() : m_stop(false) {}
+
+	~test_blockchain_read_contention()
+	{
+		m_stop = true;
+		if(m_writer.joinable())
+			m_writer.join();
+		if(m_db.is_open())
+			m_db.close();
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(m_dir, ec);
+	}
+
+	bool init()
+	{
+		m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ryo-perf-%%%%-%%%%");
+		boost::filesystem::create_directories(m_dir);
+		m_db.open(m_dir.string());
+
+		// the tx readers look up, never touched by the writer
+		m_db.block_txn_start(false);
+		m_db.add_txpool_tx(make_tx(0), make_meta());
+		m_db.block_txn_stop();
+		m_txid = cryptonote::get_transaction_hash(make_tx(0));
+
+		m_writer = boost::thread([this]() { write_loop(); });
+		return true;
+	}
+
+	bool test()
+	{
+		cryptonote::txpool_tx_meta_t meta;
+		if(use_snapshot)
+		{
+			cryptonote::db_rtxn_guard rtxn_guard(&m_db);
+			return m_db.txpool_has_tx(m_txid) && m_db.get_txpool_tx_meta(m_txid, meta);
+		}
+		else
+		{
+			CRITICAL_REGION_LOCAL(m_lock);
+			return m_db.txpool_has_tx(m_txid) && m_db.get_txpool_tx_meta(m_txid, meta);
+		}
+	}
+
+  private:
+	static cryptonote::transaction make_tx(uint64_t n)
+	{
+		cryptonote::transaction tx;
+		tx.version = 1;
+		tx.unlock_time = n;
+		cryptonote::txin_gen in;
+		in.height = n;
+		tx.vin.push_back(in);
+		return tx;
+	}
+
+	static cryptonote::txpool_tx_meta_t make_meta()
+	{
+		cryptonote::txpool_tx_meta_t meta;
+		memset(&meta, 0, sizeof(meta));
+		meta.relayed = 1;
+		return meta;
+	}
+
+	void write_loop()
+	{
+		for(uint64_t n = 1; !m_stop; ++n)
+		{
+			{
+				CRITICAL_REGION_LOCAL(m_lock);
+				m_db.block_txn_start(false);
+				m_db.add_txpool_tx(make_tx(n), make_meta());
+				if(n > 1)
+					m_db.remove_txpool_tx(cryptonote::get_transaction_hash(make_tx(n - 1)));
+				boost::this_thread::sleep_for(boost::chrono::microseconds(write_hold_us));
+				m_db.block_txn_stop();
+			}
+			boost::this_thread::sleep_for(boost::chrono::microseconds(write_pause_us));
+		}
+	}
+
+	cryptonote::BlockchainLMDB m_db;
+	boost::filesystem::path m_dir;
+	crypto::hash m_txid;
+	epee::critical_section m_lock;
+	boost::thread m_writer;
+	std::atomic<bool> m_stop;
+};
@@ -0,0 +1,109 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "wallet/wallet2.h"
+
+#include "multi_tx_test_base.h"
+
+// Signing a batch of payout transactions that already have their rings, one after another
+// or through wallet2::construct_txes, which spreads them over the threadpool
+template <size_t a_tx_count, bool parallel>
+class test_construct_tx_batch : public multi_tx_test_base<11>
+{
+  public:
+	static const size_t loop_count = 5;
+
+	typedef multi_tx_test_base<11> base_class;
+
+	bool init()
+	{
+		using namespace cryptonote;
+
+		if(!base_class::init())
+			return false;
+
+		account_base alice;
+		alice.generate_new(0);
+		m_destinations.push_back(tx_destination_entry(m_source_amount, alice.get_keys().m_account_address, false));
+		m_subaddresses[m_miners[real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0, 0};
+		m_txes.resize(a_tx_count);
+		return true;
+	}
+
+	bool test()
+	{
+		std::deque<bool> results(a_tx_count, false);
+		if(parallel)
+		{
+			m_wallet.construct_txes(a_tx_count, [&](size_t i) { results[i] = construct(i); });
+		}
+		else
+		{
+			for(size_t i = 0; i < a_tx_count; ++i)
+				results[i] = construct(i);
+		}
+		return std::all_of(results.begin(), results.end(), [](bool r) { return r; });
+	}
+
+  private:
+	bool construct(size_t i)
+	{
+		crypto::secret_key tx_key;
+		std::vector<crypto::secret_key> additional_tx_keys;
+		std::vector<cryptonote::tx_source_entry> sources = m_sources;
+		const cryptonote::account_keys &keys = m_miners[real_source_idx].get_keys();
+		return cryptonote::construct_tx_and_get_tx_key(keys, m_subaddresses, sources, m_destinations, keys.m_account_address, nullptr, m_txes[i], 0, tx_key, additional_tx_keys, true);
+	}
+
+	std::vector<cryptonote::tx_destination_entry> m_destinations;
+	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+	std::vector<cryptonote::transaction> m_txes;
+	tools::wallet2 m_wallet;
+};
@@ -0,0 +1,143 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+// Derivations of one tx pubkey for account_count view keys, then the subaddress spend keys
+// of output_count outputs for each account. Either one call per key or the batched kernel.
+template <size_t account_count, size_t output_count, bool batched>
+class test_derive_subaddress_batch
+{
+  public:
+	static const size_t loop_count = 100;
+
+	bool init()
+	{
+		crypto::secret_key sec;
+		crypto::generate_legacy_keys(m_tx_pub_key, sec);
+		m_view_keys.resize(account_count);
+		for(auto &vk : m_view_keys)
+		{
+			crypto::public_key pub;
+			crypto::generate_legacy_keys(pub, vk);
+		}
+		m_out_keys.resize(output_count);
+		for(auto &ok : m_out_keys)
+			crypto::generate_legacy_keys(ok, sec);
+
+		m_pub_keys.assign(account_count, m_tx_pub_key);
+		m_derivations.resize(account_count);
+		m_valid.reset(new bool[account_count * output_count]);
+		for(size_t o = 0; o < output_count; o++)
+		{
+			for(size_t a = 0; a < account_count; a++)
+			{
+				m_batch_keys.push_back(m_out_keys[o]);
+				m_batch_indices.push_back(o);
+			}
+		}
+		m_batch_derivations.resize(account_count * output_count);
+		m_spend_keys.resize(account_count * output_count);
+		return true;
+	}
+
+	bool test()
+	{
+		if(batched)
+		{
+#ifdef HAVE_EC_64
+			crypto::generate_key_derivations_64(m_pub_keys.data(), m_view_keys.data(), account_count, m_derivations.data(), m_valid.get());
+#else
+			crypto::generate_key_derivations(m_pub_keys.data(), m_view_keys.data(), account_count, m_derivations.data(), m_valid.get());
+#endif
+			for(size_t i = 0; i < m_batch_derivations.size(); i++)
+				m_batch_derivations[i] = m_derivations[i % account_count];
+#ifdef HAVE_EC_64
+			crypto::derive_subaddress_public_keys_64(m_batch_keys.data(), m_batch_derivations.data(), m_batch_indices.data(), m_batch_keys.size(), m_spend_keys.data(), m_valid.get());
+#else
+			crypto::derive_subaddress_public_keys(m_batch_keys.data(), m_batch_derivations.data(), m_batch_indices.data(), m_batch_keys.size(), m_spend_keys.data(), m_valid.get());
+#endif
+			return true;
+		}
+
+		for(size_t a = 0; a < account_count; a++)
+		{
+			crypto::key_derivation derivation;
+#ifdef HAVE_EC_64
+			if(!crypto::generate_key_derivation_64(m_tx_pub_key, m_view_keys[a], derivation))
+				return false;
+#else
+			if(!crypto::generate_key_derivation(m_tx_pub_key, m_view_keys[a], derivation))
+				return false;
+#endif
+			for(size_t o = 0; o < output_count; o++)
+			{
+#ifdef HAVE_EC_64
+				if(!crypto::derive_subaddress_public_key_64(m_out_keys[o], derivation, o, m_spend_keys[o * account_count + a]))
+					return false;
+#else
+				if(!crypto::derive_subaddress_public_key(m_out_keys[o], derivation, o, m_spend_keys[o * account_count + a]))
+					return false;
+#endif
+			}
+		}
+		return true;
+	}
+
+  private:
+	crypto::public_key m_tx_pub_key;
+	std::vector<crypto::secret_key> m_view_keys;
+	std::vector<crypto::public_key> m_out_keys;
+	std::vector<crypto::public_key> m_pub_keys;
+	std::vector<crypto::key_derivation> m_derivations;
+	std::vector<crypto::public_key> m_batch_keys;
+	std::vector<crypto::key_derivation> m_batch_derivations;
+	std::vector<size_t> m_batch_indices;
+	std::vector<crypto::public_key> m_spend_keys;
+	std::unique_ptr<bool[]> m_valid;
+};
@@ -0,0 +1,160 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "net/http_protocol_handler.h"
+#include <boost/regex.hpp>
+
+// Request line and header parsing of the epee http server. The regex variant is the
+// parser the server used before, kept here as the baseline.
+template <bool use_regex>
+class test_http_parse
+{
+  public:
+	static const size_t loop_count = 100000;
+
+	bool init()
+	{
+		m_request = "POST /json_rpc HTTP/1.1\r\n"
+					"Host: 127.0.0.1:12211\r\n"
+					"User-Agent: ryo-wallet\r\n"
+					"Accept: */*\r\n"
+					"Connection: keep-alive\r\n"
+					"Content-Type: application/json\r\n"
+					"Content-Length: 87\r\n"
+					"Authorization: Digest username=\"ryo\", realm=\"ryo-rpc\", nonce=\"4f8e\", uri=\"/json_rpc\"\r\n"
+					"\r\n";
+		return true;
+	}
+
+	bool test()
+	{
+		epee::net_utils::http::http_request_info info;
+		bool r = use_regex ? parse_regex(info) : parse_handwritten(info);
+		return r && info.m_http_method == epee::net_utils::http::http_method_post && info.m_header_info.m_content_length == "87";
+	}
+
+  private:
+	bool parse_handwritten(epee::net_utils::http::http_request_info &info)
+	{
+		using namespace epee::net_utils::http;
+		const char *begin = m_request.data();
+		const char *end = begin + m_request.size();
+		http_request_line rl;
+		if(!parse_request_line(begin, end, rl))
+			return false;
+		info.m_http_method = rl.method;
+		info.m_URI.assign(rl.uri_begin, rl.uri_end);
+		info.m_http_method_str.assign(rl.method_begin, rl.method_end);
+		info.m_full_request_str.assign(rl.line_begin, rl.line_end);
+
+		http_header_info &hi = info.m_header_info;
+		parse_header_fields(rl.line_end, end, [&hi](const char *nb, const char *ne, const char *vb, const char *ve) {
+			if(equal_no_case(nb, ne, "Connection"))
+				hi.m_connection.assign(vb, ve);
+			else if(equal_no_case(nb, ne, "Content-Length"))
+				hi.m_content_length.assign(vb, ve);
+			else if(equal_no_case(nb, ne, "Content-Type"))
+				hi.m_content_type.assign(vb, ve);
+			else if(equal_no_case(nb, ne, "Host"))
+				hi.m_host.assign(vb, ve);
+			else if(equal_no_case(nb, ne, "User-Agent"))
+				hi.m_user_agent.assign(vb, ve);
+			else
+				hi.m_etc_fields.emplace_back(std::string(nb, ne), std::string(vb, ve));
+		});
+
+		size_t len;
+		return parse_content_length(hi.m_content_length, len);
+	}
+
+	bool parse_regex(epee::net_utils::http::http_request_info &info)
+	{
+		using namespace epee::net_utils::http;
+		static const boost::regex rexp_match_command_line("^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+).(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
+		static const boost::regex rexp_mach_field(
+			"\n?((Connection)|(Content-Length)|(Content-Type)|(Host)|(User-Agent)"
+			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",
+			boost::regex::icase | boost::regex::normal);
+		static const boost::regex rexp_digits("\\d+", boost::regex::normal);
+
+		boost::smatch result;
+		if(!(boost::regex_search(m_request, result, rexp_match_command_line, boost::match_default) && result[0].matched))
+			return false;
+		info.m_http_ver_hi = boost::lexical_cast<int>(result[11]);
+		info.m_http_ver_lo = boost::lexical_cast<int>(result[12]);
+		info.m_http_method = result[6].matched ? http_method_post : http_method_etc;
+		info.m_URI = result[10];
+		info.m_http_method_str = result[2];
+		info.m_full_request_str = result[0];
+
+		http_header_info &hi = info.m_header_info;
+		std::string::const_iterator it_current_bound = result[0].second;
+		std::string::const_iterator it_end_bound = m_request.end();
+		while(boost::regex_search(it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched)
+		{
+			const size_t field_val = 9;
+			if(result[2].matched)
+				hi.m_connection = result[field_val];
+			else if(result[3].matched)
+				hi.m_content_length = result[field_val];
+			else if(result[4].matched)
+				hi.m_content_type = result[field_val];
+			else if(result[5].matched)
+				hi.m_host = result[field_val];
+			else if(result[6].matched)
+				hi.m_user_agent = result[field_val];
+			else
+				hi.m_etc_fields.push_back(std::pair<std::string, std::string>(result[7], result[field_val]));
+			it_current_bound = result[(int)result.size() - 1].first;
+		}
+
+		if(!(boost::regex_search(hi.m_content_length, result, rexp_digits, boost::match_default) && result[0].matched))
+			return false;
+		boost::lexical_cast<size_t>(result[0]);
+		return true;
+	}
+
+	std::string m_request;
+};
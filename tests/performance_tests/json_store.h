@@ -0,0 +1,100 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+// JSON serialization of a large get_block_headers_range response. The portable_storage
+// variant builds the whole tree before dumping it, which is what store_t_to_json did before.
+template <bool use_portable_storage>
+class test_json_store
+{
+  public:
+	static const size_t loop_count = 100;
+
+	bool init()
+	{
+		m_res.status = CORE_RPC_STATUS_OK;
+		m_res.untrusted = false;
+		m_res.headers.resize(1000);
+		for(size_t i = 0; i < m_res.headers.size(); ++i)
+		{
+			cryptonote::block_header_response &h = m_res.headers[i];
+			h.major_version = 8;
+			h.minor_version = 8;
+			h.timestamp = 1577836800 + i * 240;
+			h.prev_hash = std::string(64, 'a');
+			h.nonce = i * 7919;
+			h.orphan_status = false;
+			h.height = 300000 + i;
+			h.depth = 1000 - i;
+			h.hash = std::string(64, 'b');
+			h.difficulty = 123456789 + i;
+			h.reward = 1234567890123;
+			h.block_size = 5000 + i;
+			h.num_txes = i % 10;
+		}
+		return true;
+	}
+
+	bool test()
+	{
+		std::string json;
+		if(use_portable_storage)
+		{
+			epee::serialization::portable_storage ps;
+			m_res.store(ps);
+			ps.dump_as_json(json);
+		}
+		else
+		{
+			epee::serialization::store_t_to_json(m_res, json);
+		}
+		return json.size() > m_res.headers.size() * 64;
+	}
+
+  private:
+	cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response m_res;
+};
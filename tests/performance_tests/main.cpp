@@ -37,13 +37,16 @@
 #include "performance_utils.h"
 
 // tests
+#include "blockchain_read_contention.h"
 #include "bulletproof.h"
 #include "check_tx_signature.h"
 #include "cn_fast_hash.h"
 #include "cn_slow_hash.h"
 #include "construct_tx.h"
+#include "construct_tx_batch.h"
 #include "crypto_ops.h"
 #include "derive_public_key.h"
+#include "derive_subaddress_batch.h"
 #include "derive_secret_key.h"
 #include "equality.h"
 #include "ge_frombytes_vartime.h"
@@ -52,15 +55,21 @@
 #include "generate_key_image.h"
 #include "generate_key_image_helper.h"
 #include "generate_keypair.h"
+#include "http_parse.h"
 #include "is_out_to_acc.h"
+#include "json_store.h"
+#include "multi_account_scan.h"
 #include "multiexp.h"
 #include "range_proof.h"
 #include "rct_mlsag.h"
 #include "rct_mlsag.h"
 #include "sc_check.h"
 #include "sc_reduce32.h"
+#include "scan_digest.h"
 #include "signature.h"
 #include "subaddress_expand.h"
+#include "transfer_details_memory.h"
+#include "wallet_recent_transfers.h"
 
 namespace po = boost::program_options;
 
@@ -113,6 +122,9 @@ int main(int argc, char **argv)
 	TEST_PERFORMANCE2(filter, p, test_construct_tx, 100, 2);
 	TEST_PERFORMANCE2(filter, p, test_construct_tx, 100, 10);
 
+	TEST_PERFORMANCE2(filter, p, test_construct_tx_batch, 16, false);
+	TEST_PERFORMANCE2(filter, p, test_construct_tx_batch, 16, true);
+
 	TEST_PERFORMANCE3(filter, p, test_check_tx_signature, 2, 2, false);
 	TEST_PERFORMANCE3(filter, p, test_check_tx_signature, 10, 2, false);
 	TEST_PERFORMANCE3(filter, p, test_check_tx_signature, 100, 2, false);
@@ -140,6 +152,12 @@ int main(int argc, char **argv)
 	TEST_PERFORMANCE0(filter, p, test_generate_key_image);
 	TEST_PERFORMANCE0(filter, p, test_derive_public_key);
 	TEST_PERFORMANCE0(filter, p, test_derive_secret_key);
+	TEST_PERFORMANCE3(filter, p, test_derive_subaddress_batch, 1, 2, false);
+	TEST_PERFORMANCE3(filter, p, test_derive_subaddress_batch, 1, 2, true);
+	TEST_PERFORMANCE3(filter, p, test_derive_subaddress_batch, 1, 16, false);
+	TEST_PERFORMANCE3(filter, p, test_derive_subaddress_batch, 1, 16, true);
+	TEST_PERFORMANCE3(filter, p, test_derive_subaddress_batch, 100, 2, false);
+	TEST_PERFORMANCE3(filter, p, test_derive_subaddress_batch, 100, 2, true);
 	TEST_PERFORMANCE0(filter, p, test_ge_frombytes_vartime);
 	TEST_PERFORMANCE0(filter, p, test_ge_tobytes);
 	TEST_PERFORMANCE0(filter, p, test_generate_keypair);
@@ -149,12 +167,32 @@ int main(int argc, char **argv)
 	TEST_PERFORMANCE1(filter, p, test_signature, true);
 
 	TEST_PERFORMANCE2(filter, p, test_wallet2_expand_subaddresses, 50, 200);
+	TEST_PERFORMANCE2(filter, p, test_transfer_details_memory, 1000000, false);
+	TEST_PERFORMANCE2(filter, p, test_transfer_details_memory, 1000000, true);
+	TEST_PERFORMANCE2(filter, p, test_wallet_recent_transfers, 1000000, false);
+	TEST_PERFORMANCE2(filter, p, test_wallet_recent_transfers, 1000000, true);
+
+	TEST_PERFORMANCE2(filter, p, test_multi_account_scan, 100, false);
+	TEST_PERFORMANCE2(filter, p, test_multi_account_scan, 100, true);
+	TEST_PERFORMANCE2(filter, p, test_multi_account_scan, 1000, false);
+	TEST_PERFORMANCE2(filter, p, test_multi_account_scan, 1000, true);
+	TEST_PERFORMANCE2(filter, p, test_scan_digest, 25, false);
+	TEST_PERFORMANCE2(filter, p, test_scan_digest, 25, true);
 
 	TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, false);
 	TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, true);
 	TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
 	TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
 
+	TEST_PERFORMANCE1(filter, p, test_http_parse, true);
+	TEST_PERFORMANCE1(filter, p, test_http_parse, false);
+
+	TEST_PERFORMANCE1(filter, p, test_json_store, true);
+	TEST_PERFORMANCE1(filter, p, test_json_store, false);
+
+	TEST_PERFORMANCE1(filter, p, test_blockchain_read_contention, false);
+	TEST_PERFORMANCE1(filter, p, test_blockchain_read_contention, true);
+
 	TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 3, false);
 	TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 5, false);
 	TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 10, false);
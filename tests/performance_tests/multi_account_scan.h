@@ -0,0 +1,155 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "wallet/multi_account_scanner.h"
+
+// One block of tx_count miner txs paying accounts spread over account_count view keys.
+// The shared case scans it once with multi_account_scanner, the other does what one
+// wallet2 per account does: parse the block and every tx extra, then derive and look up.
+template <size_t account_count, bool shared>
+class test_multi_account_scan
+{
+  public:
+	static const size_t loop_count = 10;
+	static const size_t tx_count = 10;
+
+	bool init()
+	{
+		using namespace cryptonote;
+
+		m_accounts.resize(account_count);
+		m_subaddresses.resize(account_count);
+		for(size_t i = 0; i < account_count; i++)
+		{
+			m_accounts[i].generate_new(0);
+			m_subaddresses[i][m_accounts[i].get_keys().m_account_address.m_spend_public_key] = {0, 0};
+			m_scanner.add_account(m_accounts[i].get_keys().m_view_secret_key, m_subaddresses[i]);
+		}
+
+		block blk;
+		std::vector<transaction> txs(tx_count);
+		for(size_t i = 0; i < tx_count; i++)
+		{
+			const account_public_address &addr = m_accounts[i * account_count / tx_count].get_keys().m_account_address;
+			if(!construct_miner_tx(MAINNET, 0, 0, 0, 2, 0, addr, i == 0 ? blk.miner_tx : txs[i]))
+				return false;
+			if(i > 0)
+			{
+				blk.tx_hashes.push_back(get_transaction_hash(txs[i]));
+				m_entry.txs.push_back(tx_to_blob(txs[i]));
+			}
+		}
+		m_entry.block = block_to_blob(blk);
+
+		std::vector<tools::multi_account_scanner::matched_output> matches;
+		m_expected = m_scanner.scan_block(1, m_entry, matches);
+		return m_expected >= tx_count;
+	}
+
+	bool test()
+	{
+		if(shared)
+		{
+			std::vector<tools::multi_account_scanner::matched_output> matches;
+			return m_scanner.scan_block(1, m_entry, matches) == m_expected;
+		}
+
+		size_t found = 0;
+		for(size_t i = 0; i < account_count; i++)
+		{
+			cryptonote::block blk;
+			if(!cryptonote::parse_and_validate_block_from_blob(m_entry.block, blk))
+				return false;
+			found += scan_tx(i, blk.miner_tx);
+			for(const cryptonote::blobdata &blob : m_entry.txs)
+			{
+				cryptonote::transaction tx;
+				if(!cryptonote::parse_and_validate_tx_base_from_blob(blob, tx))
+					return false;
+				found += scan_tx(i, tx);
+			}
+		}
+		return found == m_expected;
+	}
+
+  private:
+	size_t scan_tx(size_t account, const cryptonote::transaction &tx)
+	{
+		const crypto::public_key tx_pub_key = cryptonote::get_tx_pub_key_from_extra(tx);
+		const std::vector<crypto::public_key> additional_tx_pub_keys = cryptonote::get_additional_tx_pub_keys_from_extra(tx);
+		crypto::key_derivation derivation;
+#ifdef HAVE_EC_64
+		crypto::generate_key_derivation_64(tx_pub_key, m_accounts[account].get_keys().m_view_secret_key, derivation);
+#else
+		crypto::generate_key_derivation(tx_pub_key, m_accounts[account].get_keys().m_view_secret_key, derivation);
+#endif
+		size_t found = additional_tx_pub_keys.size(); // none in miner txs, keeps the parse alive
+		for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
+		{
+			crypto::public_key subaddress_spendkey;
+			const crypto::public_key &out_key = boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key;
+#ifdef HAVE_EC_64
+			crypto::derive_subaddress_public_key_64(out_key, derivation, out_idx, subaddress_spendkey);
+#else
+			crypto::derive_subaddress_public_key(out_key, derivation, out_idx, subaddress_spendkey);
+#endif
+			found += m_subaddresses[account].count(subaddress_spendkey);
+		}
+		return found;
+	}
+
+	std::vector<cryptonote::account_base> m_accounts;
+	std::vector<std::unordered_map<crypto::public_key, cryptonote::subaddress_index>> m_subaddresses;
+	tools::multi_account_scanner m_scanner;
+	cryptonote::block_complete_entry_v m_entry = {cryptonote::blobdata(), {}};
+	size_t m_expected;
+};
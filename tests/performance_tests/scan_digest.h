@@ -0,0 +1,107 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+#include "multi_tx_test_base.h"
+
+// What a wallet decodes per tx during refresh, a getblocks.bin tx blob against its digest. The
+// digest is filled the same way the daemon does it.
+template <size_t a_ring_size, bool digest>
+class test_scan_digest : public multi_tx_test_base<a_ring_size>
+{
+  public:
+	static const size_t loop_count = 10000;
+
+	typedef multi_tx_test_base<a_ring_size> base_class;
+
+	bool init()
+	{
+		using namespace cryptonote;
+
+		if(!base_class::init())
+			return false;
+
+		account_base alice;
+		alice.generate_new(0);
+		std::vector<tx_destination_entry> destinations;
+		destinations.push_back(tx_destination_entry(this->m_source_amount, alice.get_keys().m_account_address, false));
+
+		transaction tx;
+		crypto::secret_key tx_key;
+		std::vector<crypto::secret_key> additional_tx_keys;
+		std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+		subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0, 0};
+		if(!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, this->m_miners[this->real_source_idx].get_keys().m_account_address, nullptr, tx, 0, tx_key, additional_tx_keys, true))
+			return false;
+		m_tx_blob = tx_to_blob(tx);
+
+		COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest d;
+		d.tx_pub_key = get_tx_pub_key_from_extra(tx);
+		for(const tx_out &out : tx.vout)
+			d.output_keys.push_back(boost::get<txout_to_key>(out.target).key);
+		for(const txin_v &in : tx.vin)
+			d.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+		return epee::serialization::store_t_to_binary(d, m_digest_blob);
+	}
+
+	bool test()
+	{
+		if(digest)
+		{
+			cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_scan_digest d;
+			return epee::serialization::load_t_from_binary(d, m_digest_blob) && !d.output_keys.empty();
+		}
+
+		cryptonote::transaction tx;
+		return cryptonote::parse_and_validate_tx_base_from_blob(m_tx_blob, tx) && !tx.vout.empty();
+	}
+
+  private:
+	cryptonote::blobdata m_tx_blob;
+	std::string m_digest_blob;
+};
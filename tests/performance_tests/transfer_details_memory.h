@@ -0,0 +1,171 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+
+// A synthetic wallet holding output_count outputs, each received in a typical
+// 2-in/2-out ring 11 tx. The legacy case keeps the whole tx prefix per output as
+// transfer_details did up to cache version 9. init() prints the bytes held per
+// output (allocator overhead excluded), test() is one pass over the transfers as
+// done for every balance query.
+template <size_t output_count, bool compact>
+class test_transfer_details_memory
+{
+  public:
+	static const size_t loop_count = 10;
+
+	struct legacy_transfer_details
+	{
+		uint64_t m_block_height;
+		cryptonote::transaction_prefix m_tx;
+		crypto::hash m_txid;
+		size_t m_internal_output_index;
+		uint64_t m_global_output_index;
+		bool m_spent;
+		uint64_t m_spent_height;
+		crypto::key_image m_key_image;
+		rct::key m_mask;
+		uint64_t m_amount;
+		bool m_rct;
+		bool m_key_image_known;
+		size_t m_pk_index;
+		cryptonote::subaddress_index m_subaddr_index;
+		bool m_key_image_partial;
+		std::vector<rct::key> m_multisig_k;
+		std::vector<tools::wallet2::multisig_info> m_multisig_info;
+	};
+
+	bool init()
+	{
+		using namespace cryptonote;
+
+		transaction_prefix tx;
+		tx.version = 2;
+		tx.unlock_time = 0;
+		for(size_t i = 0; i < 2; ++i)
+		{
+			txin_to_key in;
+			in.amount = 0;
+			in.key_offsets.resize(11, 1000);
+			in.k_image = rct::rct2ki(rct::pkGen());
+			tx.vin.push_back(in);
+		}
+		for(size_t i = 0; i < 2; ++i)
+		{
+			tx_out out;
+			out.amount = 0;
+			out.target = txout_to_key(rct::rct2pk(rct::pkGen()));
+			tx.vout.push_back(out);
+		}
+		add_tx_pub_key_to_extra(tx, rct::rct2pk(rct::pkGen()));
+		crypto::hash8 payment_id = crypto::rand<crypto::hash8>();
+		std::string extra_nonce;
+		set_encrypted_payment_id_to_tx_extra_nonce(extra_nonce, payment_id);
+		add_extra_nonce_to_tx_extra(tx.extra, extra_nonce);
+
+		size_t bytes = 0;
+		if(compact)
+		{
+			m_transfers.resize(output_count);
+			for(size_t i = 0; i < output_count; ++i)
+			{
+				tools::wallet2::transfer_details &td = m_transfers[i];
+				td.m_block_height = i;
+				td.m_internal_output_index = i % 2;
+				td.set_tx(tx);
+				td.m_amount = i;
+				td.m_spent = i % 3 == 0;
+				bytes += td.m_input_key_images.capacity() * sizeof(crypto::key_image);
+			}
+			bytes += m_transfers.capacity() * sizeof(tools::wallet2::transfer_details);
+		}
+		else
+		{
+			m_legacy_transfers.resize(output_count);
+			for(size_t i = 0; i < output_count; ++i)
+			{
+				legacy_transfer_details &td = m_legacy_transfers[i];
+				td.m_block_height = i;
+				td.m_internal_output_index = i % 2;
+				td.m_tx = tx;
+				td.m_amount = i;
+				td.m_spent = i % 3 == 0;
+				bytes += td.m_tx.vin.capacity() * sizeof(txin_v) + td.m_tx.vout.capacity() * sizeof(tx_out) + td.m_tx.extra.capacity();
+				for(const txin_v &in : td.m_tx.vin)
+					bytes += boost::get<txin_to_key>(in).key_offsets.capacity() * sizeof(uint64_t);
+			}
+			bytes += m_legacy_transfers.capacity() * sizeof(legacy_transfer_details);
+		}
+		std::cout << "  " << output_count << " outputs: " << bytes / output_count << " bytes/output, " << bytes / (1024 * 1024) << " MB" << std::endl;
+		return true;
+	}
+
+	bool test()
+	{
+		uint64_t unlocked = 0;
+		if(compact)
+		{
+			for(const tools::wallet2::transfer_details &td : m_transfers)
+				if(!td.m_spent && td.m_unlock_time <= td.m_block_height)
+					unlocked += td.amount();
+		}
+		else
+		{
+			for(const legacy_transfer_details &td : m_legacy_transfers)
+				if(!td.m_spent && td.m_tx.unlock_time <= td.m_block_height)
+					unlocked += td.m_amount;
+		}
+		return unlocked != 0;
+	}
+
+  private:
+	std::vector<tools::wallet2::transfer_details> m_transfers;
+	std::vector<legacy_transfer_details> m_legacy_transfers;
+};
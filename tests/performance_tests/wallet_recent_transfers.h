@@ -0,0 +1,99 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <list>
+
+#include "wallet/wallet2.h"
+
+// An exchange polling get_transfers for the last few blocks of a wallet holding payment_count
+// payments, ten per block. The unindexed case filters the whole payment map as was done before
+// the height index.
+template <size_t payment_count, bool indexed>
+class test_wallet_recent_transfers
+{
+  public:
+	static const size_t loop_count = 100;
+	static const uint64_t per_block = 10;
+
+	bool init()
+	{
+		tools::wallet2::payment_container payments;
+		for(uint64_t i = 0; i < payment_count; ++i)
+		{
+			tools::wallet2::payment_details pd = AUTO_VAL_INIT(pd);
+			pd.m_tx_hash = crypto::rand<crypto::hash>();
+			pd.m_amount = i;
+			pd.m_block_height = 1 + i / per_block;
+			payments.emplace(crypto::rand<crypto::hash>(), pd);
+		}
+		m_min_height = payment_count / per_block - 5;
+		if(indexed)
+			m_wallet.import_payments(payments);
+		else
+			m_payments.swap(payments);
+		return true;
+	}
+
+	bool test()
+	{
+		std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
+		if(indexed)
+		{
+			m_wallet.get_payments(payments, m_min_height, (uint64_t)-1, 0);
+		}
+		else
+		{
+			for(const auto &p : m_payments)
+				if(m_min_height < p.second.m_block_height && p.second.m_subaddr_index.major == 0)
+					payments.push_back(p);
+		}
+		return payments.size() == 5 * per_block;
+	}
+
+  private:
+	tools::wallet2 m_wallet;
+	tools::wallet2::payment_container m_payments;
+	uint64_t m_min_height;
+};
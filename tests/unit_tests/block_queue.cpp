@@ -85,3 +85,63 @@ TEST(block_queue, flush_uuid)
 	bq.add_blocks(0, 200, uuid1());
 	ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+static std::list<cryptonote::block_complete_entry> make_entries(size_t n)
+{
+	return std::list<cryptonote::block_complete_entry>(n);
+}
+
+TEST(block_queue, span_size_unmeasured)
+{
+	cryptonote::block_queue bq;
+	ASSERT_EQ(bq.get_span_size(uuid1(), 20, 200, 2.0f, 1000000), 20);
+	ASSERT_EQ(bq.get_span_size(uuid1(), 20, 10, 2.0f, 1000000), 10);
+	ASSERT_LT(bq.get_expected_span_time(uuid1(), 20), 0.0f);
+}
+
+TEST(block_queue, span_size_from_throughput)
+{
+	cryptonote::block_queue bq;
+	// 100 kB/s with 1 kB blocks
+	bq.add_blocks(0, make_entries(10), uuid1(), 100000.0f, 10000);
+	ASSERT_EQ(bq.get_span_size(uuid1(), 20, 1000, 2.0f, 1000000), 200);
+	ASSERT_EQ(bq.get_span_size(uuid1(), 20, 100, 2.0f, 1000000), 100);
+	ASSERT_EQ(bq.get_span_size(uuid1(), 20, 1000, 2.0f, 50000), 50);
+	ASSERT_FLOAT_EQ(bq.get_expected_span_time(uuid1(), 100), 1.0f);
+
+	// 1 kB/s peer gets the minimum
+	bq.add_blocks(10, make_entries(10), uuid2(), 1000.0f, 10000);
+	ASSERT_EQ(bq.get_span_size(uuid2(), 20, 1000, 0.5f, 1000000), 1);
+	ASSERT_FLOAT_EQ(bq.get_speed(uuid2()), 0.01f);
+	ASSERT_FLOAT_EQ(bq.get_speed(uuid1()), 1.0f);
+
+	// measurements outlive the spans
+	bq.remove_spans(uuid1(), 0);
+	ASSERT_FLOAT_EQ(bq.get_speed(uuid2()), 0.01f);
+	bq.forget_peer(uuid1());
+	ASSERT_FLOAT_EQ(bq.get_speed(uuid2()), 1.0f);
+	ASSERT_EQ(bq.get_span_size(uuid1(), 20, 1000, 2.0f, 1000000), 20);
+}
+
+TEST(block_queue, scheduled_size)
+{
+	cryptonote::block_queue bq;
+	bq.add_blocks(0, 10, uuid1());
+	bq.add_blocks(10, make_entries(10), uuid2(), 1000.0f, 20000);
+	ASSERT_EQ(bq.get_scheduled_size(100000), 20000);
+	bq.add_blocks(20, 5, uuid2());
+	ASSERT_EQ(bq.get_scheduled_size(100000), 30000);
+	ASSERT_EQ(bq.get_data_size(), 20000);
+}
+
+TEST(block_queue, scheduled_size_unmeasured)
+{
+	cryptonote::block_queue bq;
+	ASSERT_EQ(bq.get_scheduled_size(100000), 0);
+	bq.add_blocks(0, 10, uuid1());
+	ASSERT_EQ(bq.get_scheduled_size(100000), 1000000);
+	bq.add_blocks(10, 5, uuid2());
+	ASSERT_EQ(bq.get_scheduled_size(100000), 1500000);
+	bq.flush_spans(uuid1());
+	ASSERT_EQ(bq.get_scheduled_size(100000), 500000);
+}
@@ -31,6 +31,7 @@
 #include <chrono>
 #include <cstdio>
 #include <iostream>
+#include <memory>
 #include <thread>
 
 #include "gtest/gtest.h"
@@ -448,4 +449,227 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
 	ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, OutputDistribution)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+	std::vector<uint64_t> distribution;
+	uint64_t base = 0;
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+	ASSERT_EQ(2, distribution.size());
+	ASSERT_EQ(0, base);
+	ASSERT_EQ(this->m_db->get_num_outputs(0), distribution[0] + distribution[1]);
+	const uint64_t first = distribution[0];
+
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 1, 0, distribution, base));
+	ASSERT_EQ(1, distribution.size());
+	ASSERT_EQ(first, base);
+
+	ASSERT_FALSE(this->m_db->get_output_distribution(0, 2, 0, distribution, base));
+
+	block blk;
+	std::vector<transaction> txs;
+	ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+	base = 0;
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+	ASSERT_EQ(1, distribution.size());
+	ASSERT_EQ(first, distribution[0]);
+	ASSERT_EQ(this->m_db->get_num_outputs(0), distribution[0]);
+}
+
+TYPED_TEST(BlockchainDBTest, ReadSnapshot)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+
+	// a reader pinned to a snapshot keeps seeing it while another thread adds a block
+	{
+		db_rtxn_guard rtxn_guard(this->m_db);
+		ASSERT_EQ(1, this->m_db->height());
+
+		bool added = false;
+		std::thread writer([this, &added]() {
+			this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]);
+			added = true;
+		});
+		writer.join();
+		ASSERT_TRUE(added);
+
+		ASSERT_EQ(1, this->m_db->height());
+		ASSERT_FALSE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+
+		// nested guards share the outer snapshot
+		db_rtxn_guard inner_guard(this->m_db);
+		ASSERT_EQ(1, this->m_db->height());
+	}
+
+	ASSERT_EQ(2, this->m_db->height());
+	ASSERT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+}
+
+TYPED_TEST(BlockchainDBTest, BatchedLookups)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+	// request order is deliberately not db order, with a duplicate and unknown entries
+	std::vector<crypto::hash> hashes;
+	std::vector<crypto::key_image> key_images;
+	for(size_t i = 0; i < 2; ++i)
+	{
+		for(const transaction &tx : this->m_txs[i])
+		{
+			hashes.push_back(get_transaction_hash(tx));
+			for(const txin_v &in : tx.vin)
+				if(in.type() == typeid(txin_to_key))
+					key_images.push_back(boost::get<txin_to_key>(in).k_image);
+		}
+	}
+	ASSERT_FALSE(hashes.empty());
+	ASSERT_FALSE(key_images.empty());
+	std::reverse(hashes.begin(), hashes.end());
+	hashes.insert(hashes.begin() + 1, crypto::rand<crypto::hash>());
+	hashes.push_back(hashes.front());
+	std::reverse(key_images.begin(), key_images.end());
+	key_images.insert(key_images.begin() + 1, crypto::rand<crypto::key_image>());
+	key_images.push_back(key_images.front());
+
+	std::vector<blobdata> blobs;
+	std::vector<uint64_t> heights;
+	ASSERT_EQ(hashes.size() - 1, this->m_db->get_tx_blobs(hashes, blobs, heights));
+	ASSERT_EQ(hashes.size(), blobs.size());
+	ASSERT_EQ(hashes.size(), heights.size());
+	for(size_t i = 0; i < hashes.size(); ++i)
+	{
+		blobdata blob;
+		if(this->m_db->get_tx_blob(hashes[i], blob))
+		{
+			ASSERT_EQ(blob, blobs[i]);
+			ASSERT_EQ(this->m_db->get_tx_block_height(hashes[i]), heights[i]);
+		}
+		else
+		{
+			ASSERT_TRUE(blobs[i].empty());
+			ASSERT_EQ(std::numeric_limits<uint64_t>::max(), heights[i]);
+		}
+	}
+
+	std::vector<bool> spent;
+	this->m_db->has_key_images(key_images, spent);
+	ASSERT_EQ(key_images.size(), spent.size());
+	for(size_t i = 0; i < key_images.size(); ++i)
+		ASSERT_EQ(this->m_db->has_key_image(key_images[i]), spent[i]);
+	ASSERT_FALSE(spent[1]);
+	ASSERT_TRUE(spent[0]);
+}
+
+TYPED_TEST(BlockchainDBTest, ReadOnlyReader)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+	// a second handle on the same files, the way a wallet reads a running daemon's chain
+	std::unique_ptr<BlockchainDB> reader(new TypeParam());
+	ASSERT_NO_THROW(reader->open(dirPath, DBF_RDONLY));
+	{
+		db_rtxn_guard rtxn_guard(reader.get());
+		ASSERT_EQ(2, reader->height());
+		ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), reader->get_block_hash_from_height(1));
+		for(const transaction &tx : this->m_txs[1])
+		{
+			blobdata blob;
+			std::vector<uint64_t> indices;
+			ASSERT_TRUE(reader->get_tx_blob_indexed(get_transaction_hash(tx), blob, indices));
+			ASSERT_EQ(tx_to_blob(tx), blob);
+			ASSERT_EQ(tx.vout.size(), indices.size());
+		}
+	}
+	ASSERT_NO_THROW(reader->close());
+}
+
+TYPED_TEST(BlockchainDBTest, ReadOnlyReaderNeedsMigration)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	ASSERT_NO_THROW(this->m_db->close());
+
+	// turn the files back into a version 1 DB, which had no RingCT distribution
+	MDB_env *env;
+	MDB_txn *txn;
+	MDB_dbi dbi;
+	uint32_t version = 1;
+	MDB_val k = {strlen("version") + 1, (void *)"version"};
+	MDB_val v = {sizeof(version), &version};
+	ASSERT_EQ(0, mdb_env_create(&env));
+	ASSERT_EQ(0, mdb_env_set_maxdbs(env, 32));
+	ASSERT_EQ(0, mdb_env_open(env, dirPath.c_str(), 0, 0644));
+	ASSERT_EQ(0, mdb_txn_begin(env, NULL, 0, &txn));
+	ASSERT_EQ(0, mdb_dbi_open(txn, "rct_distribution", 0, &dbi));
+	ASSERT_EQ(0, mdb_drop(txn, dbi, 1));
+	ASSERT_EQ(0, mdb_dbi_open(txn, "properties", 0, &dbi));
+	ASSERT_EQ(0, mdb_put(txn, dbi, &k, &v, 0));
+	ASSERT_EQ(0, mdb_txn_commit(txn));
+	mdb_env_close(env);
+
+	// a reader can't migrate, and must leave the DB as it found it
+	std::unique_ptr<BlockchainDB> reader(new TypeParam());
+	ASSERT_THROW(reader->open(dirPath, DBF_RDONLY), DB_NEEDS_MIGRATION);
+	ASSERT_FALSE(reader->is_open());
+
+	ASSERT_EQ(0, mdb_env_create(&env));
+	ASSERT_EQ(0, mdb_env_set_maxdbs(env, 32));
+	ASSERT_EQ(0, mdb_env_open(env, dirPath.c_str(), MDB_RDONLY, 0644));
+	ASSERT_EQ(0, mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+	ASSERT_EQ(MDB_NOTFOUND, mdb_dbi_open(txn, "rct_distribution", 0, &dbi));
+	ASSERT_EQ(0, mdb_dbi_open(txn, "properties", 0, &dbi));
+	ASSERT_EQ(0, mdb_get(txn, dbi, &k, &v));
+	ASSERT_EQ(1, *(const uint32_t *)v.mv_data);
+	mdb_txn_abort(txn);
+	mdb_env_close(env);
+}
+
 } // anonymous namespace
@@ -0,0 +1,132 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "common/bloom_filter.hpp"
+
+static crypto::hash make_hash(uint64_t n)
+{
+	return crypto::cn_fast_hash(&n, sizeof(n));
+}
+
+TEST(bloom_filter, added_elements_are_present)
+{
+	bloom_filter filter;
+	filter.init(1000);
+	for(uint64_t i = 0; i < 1000; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		filter.add_element(&h, sizeof(h));
+	}
+	for(uint64_t i = 0; i < 1000; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		ASSERT_FALSE(filter.not_present(&h, sizeof(h)));
+	}
+}
+
+TEST(bloom_filter, large_filter_uses_all_bits)
+{
+	// over 4096 elements the bit positions no longer fit 16 bits
+	bloom_filter filter;
+	filter.init(20000);
+	for(uint64_t i = 0; i < 20000; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		filter.add_element(&h, sizeof(h));
+	}
+	size_t false_positives = 0;
+	for(uint64_t i = 20000; i < 40000; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		if(!filter.not_present(&h, sizeof(h)))
+			++false_positives;
+	}
+	ASSERT_LT(false_positives, 20);
+}
+
+TEST(bloom_filter, clear)
+{
+	bloom_filter filter;
+	filter.init(100);
+	const crypto::hash h = make_hash(1);
+	filter.add_element(&h, sizeof(h));
+	filter.clear();
+	ASSERT_TRUE(filter.not_present(&h, sizeof(h)));
+}
+
+TEST(rolling_bloom_filter, remembers_last_generation)
+{
+	rolling_bloom_filter filter;
+	filter.init(100);
+	for(uint64_t i = 0; i < 150; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		filter.add_element(&h, sizeof(h));
+	}
+	// at least the last 100 elements are always remembered
+	for(uint64_t i = 50; i < 150; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		ASSERT_FALSE(filter.not_present(&h, sizeof(h)));
+	}
+}
+
+TEST(rolling_bloom_filter, forgets_old_generations)
+{
+	rolling_bloom_filter filter;
+	filter.init(100);
+	for(uint64_t i = 0; i < 300; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		filter.add_element(&h, sizeof(h));
+	}
+	size_t forgotten = 0;
+	for(uint64_t i = 0; i < 100; ++i)
+	{
+		const crypto::hash h = make_hash(i);
+		if(filter.not_present(&h, sizeof(h)))
+			++forgotten;
+	}
+	ASSERT_GT(forgotten, 90);
+}
@@ -30,9 +30,17 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "crypto/crypto.h"
 
+extern "C" {
+#include "crypto/crypto-ops.h"
+}
+#ifdef HAVE_EC_64
+#include "crypto/ecops64/ecops64.h"
+#endif
+
 namespace
 {
 
@@ -110,6 +118,55 @@ TEST(Crypto, derive_subaddress_public_key_64)
 }
 #endif
 
+namespace
+{
+// Runs of 9 equal entries per test vector, so keys get shared and the 72 entries span two inversion batches.
+// The last entry holds a key that does not decompress.
+template <typename F>
+void check_subaddress_public_keys(F derive)
+{
+	using namespace crypto;
+	std::vector<public_key> pks;
+	std::vector<key_derivation> dks;
+	for(int i = 0; i < 8 * 9; ++i)
+	{
+		pks.emplace_back();
+		memcpy(pks.back().data, out_key[i / 9], 32u);
+		dks.emplace_back();
+		memcpy(dks.back().data, derivation[i / 9], 32u);
+	}
+	pks.emplace_back();
+	memset(pks.back().data, 0, 32u);
+	pks.back().data[0] = 2;
+	dks.push_back(dks.front());
+
+	std::vector<size_t> indices(pks.size(), 0);
+	std::vector<public_key> results(pks.size());
+	std::unique_ptr<bool[]> valid(new bool[pks.size()]);
+	derive(pks.data(), dks.data(), indices.data(), pks.size(), results.data(), valid.get());
+
+	for(int i = 0; i < 8 * 9; ++i)
+	{
+		ASSERT_TRUE(valid[i]);
+		ASSERT_EQ(memcmp(derived_key[i / 9], results[i].data, 32), 0);
+	}
+	ASSERT_FALSE(valid[pks.size() - 1]);
+	ASSERT_EQ(results.back(), null_pkey);
+}
+} // namespace anonymous
+
+TEST(Crypto, derive_subaddress_public_keys)
+{
+	check_subaddress_public_keys(&crypto::derive_subaddress_public_keys);
+}
+
+#ifdef HAVE_EC_64
+TEST(Crypto, derive_subaddress_public_keys_64)
+{
+	check_subaddress_public_keys(&crypto::derive_subaddress_public_keys_64);
+}
+#endif
+
 namespace
 {
 
@@ -179,3 +236,172 @@ TEST(Crypto, generate_key_derivation_64)
 	}
 }
 #endif
+
+namespace
+{
+template <typename F>
+void check_key_derivations(F derive)
+{
+	using namespace crypto;
+	std::vector<public_key> pks;
+	std::vector<secret_key> sks;
+	for(int i = 0; i < 5 * 15; ++i)
+	{
+		pks.emplace_back();
+		memcpy(pks.back().data, pub_key[i / 15], 32u);
+		sks.emplace_back();
+		memcpy(sks.back().data, sec_key[i / 15], 32u);
+	}
+
+	std::vector<key_derivation> results(pks.size());
+	std::unique_ptr<bool[]> valid(new bool[pks.size()]);
+	derive(pks.data(), sks.data(), pks.size(), results.data(), valid.get());
+
+	for(int i = 0; i < 5 * 15; ++i)
+	{
+		ASSERT_TRUE(valid[i]);
+		ASSERT_EQ(memcmp(res_derived_key[i / 15], results[i].data, 32), 0);
+	}
+}
+} // namespace anonymous
+
+TEST(Crypto, generate_key_derivations)
+{
+	check_key_derivations(&crypto::generate_key_derivations);
+}
+
+#ifdef HAVE_EC_64
+TEST(Crypto, generate_key_derivations_64)
+{
+	check_key_derivations(&crypto::generate_key_derivations_64);
+}
+#endif
+
+#ifdef HAVE_EC_64
+namespace
+{
+// Random keys in runs of 1 to 7 equal entries, about a third of them not on the curve,
+// over enough entries for two full inversion batches and a partial one
+struct random_batch
+{
+	random_batch(size_t count)
+	{
+		crypto::public_key key;
+		crypto::secret_key sec;
+		while(keys.size() < count)
+		{
+			const size_t run = 1 + crypto::rand<uint8_t>() % 7;
+			crypto::random_scalar((unsigned char *)sec.data);
+			if(crypto::rand<uint8_t>() % 3 == 0)
+				key = crypto::rand<crypto::public_key>();
+			else
+				crypto::secret_key_to_public_key(sec, key);
+			for(size_t i = 0; i < run && keys.size() < count; ++i)
+			{
+				keys.push_back(key);
+				crypto::random_scalar((unsigned char *)sec.data);
+				secrets.push_back(sec);
+				indices.push_back(crypto::rand<uint8_t>());
+			}
+		}
+	}
+
+	std::vector<crypto::public_key> keys;
+	std::vector<crypto::secret_key> secrets;
+	std::vector<size_t> indices;
+};
+} // namespace anonymous
+
+TEST(Crypto, key_derivations_64_match_portable)
+{
+	using namespace crypto;
+	const random_batch batch(150);
+	const size_t count = batch.keys.size();
+
+	std::vector<key_derivation> derivations(count), derivations64(count);
+	std::unique_ptr<bool[]> valid(new bool[count]), valid64(new bool[count]);
+	generate_key_derivations(batch.keys.data(), batch.secrets.data(), count, derivations.data(), valid.get());
+	generate_key_derivations_64(batch.keys.data(), batch.secrets.data(), count, derivations64.data(), valid64.get());
+
+	size_t invalid = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		key_derivation single;
+		ASSERT_EQ(generate_key_derivation(batch.keys[i], batch.secrets[i], single), valid[i]);
+		ASSERT_EQ(valid[i], valid64[i]);
+		ASSERT_EQ(memcmp(&derivations[i], &derivations64[i], 32), 0);
+		if(valid[i])
+			ASSERT_EQ(memcmp(&single, &derivations64[i], 32), 0);
+		invalid += !valid[i];
+	}
+	ASSERT_LT(0u, invalid);
+}
+
+TEST(Crypto, subaddress_public_keys_64_match_portable)
+{
+	using namespace crypto;
+	const random_batch batch(150);
+	const size_t count = batch.keys.size();
+
+	// the derivations only feed a hash, any 32 bytes do
+	std::vector<key_derivation> derivations(count);
+	for(key_derivation &d : derivations)
+		d = rand<key_derivation>();
+
+	std::vector<public_key> results(count), results64(count);
+	std::unique_ptr<bool[]> valid(new bool[count]), valid64(new bool[count]);
+	derive_subaddress_public_keys(batch.keys.data(), derivations.data(), batch.indices.data(), count, results.data(), valid.get());
+	derive_subaddress_public_keys_64(batch.keys.data(), derivations.data(), batch.indices.data(), count, results64.data(), valid64.get());
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		public_key single;
+		ASSERT_EQ(derive_subaddress_public_key(batch.keys[i], derivations[i], batch.indices[i], single), valid[i]);
+		ASSERT_EQ(valid[i], valid64[i]);
+		ASSERT_EQ(results[i], results64[i]);
+		if(valid[i])
+			ASSERT_EQ(single, results64[i]);
+	}
+}
+
+TEST(Crypto, ge64_tobytes_batch)
+{
+	using namespace crypto;
+	// scalar multiples of a random point, so every Z differs, compared with one inversion each
+	// and with the portable public key of the same scalar times the base point
+	for(size_t count : {1, 63, 64, 65, 150})
+	{
+		std::vector<ge64_p2> points(count);
+		std::vector<public_key> expected(count), batched(count);
+		for(size_t i = 0; i < count; ++i)
+		{
+			secret_key sec;
+			random_scalar((unsigned char *)sec.data);
+			ge64_p3 point;
+			ge64_scalarmult_base(&point, (const unsigned char *)sec.data);
+			if(i % 2)
+			{
+				ge64_p2 point2;
+				ge64_p1p1 point3;
+				ge64_p3_to_p2(&point2, &point);
+				ge64_p2_dbl(&point3, &point2);
+				ge64_p1p1_to_p2(&points[i], &point3);
+				sc_add((unsigned char *)sec.data, (const unsigned char *)sec.data, (const unsigned char *)sec.data);
+			}
+			else
+			{
+				ge64_p3_to_p2(&points[i], &point);
+			}
+			secret_key_to_public_key(sec, expected[i]);
+
+			public_key single;
+			ge64_tobytes((unsigned char *)single.data, &points[i]);
+			ASSERT_EQ(expected[i], single);
+		}
+
+		ge64_tobytes_batch((unsigned char *)batched.data(), points.data(), count);
+		for(size_t i = 0; i < count; ++i)
+			ASSERT_EQ(expected[i], batched[i]) << count << " points, entry " << i;
+	}
+}
+#endif
@@ -30,6 +30,7 @@
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/uuid/random_generator.hpp>
 
 #include "gtest/gtest.h"
 
@@ -433,6 +434,42 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
 	ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_sends_shared_notify_buffer)
+{
+	// Setup
+	const int expected_command = 5127460;
+
+	test_connection_ptr conn_a = create_connection(false);
+	test_connection_ptr conn_b = create_connection(false);
+	static_cast<epee::net_utils::connection_context_base &>(conn_a->m_protocol_handler.get_context_ref()) =
+		epee::net_utils::connection_context_base(boost::uuids::random_generator()(), epee::net_utils::ipv4_network_address{0, 0}, false);
+	static_cast<epee::net_utils::connection_context_base &>(conn_b->m_protocol_handler.get_context_ref()) =
+		epee::net_utils::connection_context_base(boost::uuids::random_generator()(), epee::net_utils::ipv4_network_address{0, 0}, false);
+	conn_a->start();
+	conn_b->start();
+
+	std::string in_data(256, 'r');
+	epee::net_utils::shared_buffer packet = epee::levin::make_notify_buffer(expected_command, in_data);
+
+	// Test
+	ASSERT_EQ(1, m_handler_config.notify(packet, conn_a->m_protocol_handler.get_connection_id()));
+	ASSERT_EQ(1, m_handler_config.notify(packet, conn_b->m_protocol_handler.get_connection_id()));
+
+	// Check both connections sent the same header and payload
+	ASSERT_EQ(*packet, conn_a->last_send_data());
+	ASSERT_EQ(*packet, conn_b->last_send_data());
+
+	epee::levin::bucket_head2 head = *reinterpret_cast<const epee::levin::bucket_head2 *>(packet->data());
+	ASSERT_EQ(sizeof(head) + in_data.size(), packet->size());
+	ASSERT_EQ(in_data, packet->substr(sizeof(head)));
+	ASSERT_EQ(LEVIN_SIGNATURE, head.m_signature);
+	ASSERT_EQ(expected_command, head.m_command);
+	ASSERT_EQ(in_data.size(), head.m_cb);
+	ASSERT_FALSE(head.m_have_to_return_data);
+	ASSERT_EQ(LEVIN_PROTOCOL_VER_1, head.m_protocol_version);
+	ASSERT_EQ(LEVIN_PACKET_REQUEST, head.m_flags);
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
 	test_connection_ptr conn = create_connection();
@@ -536,6 +573,23 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_chunke
 	ASSERT_EQ(1, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, reports_pending_body_size)
+{
+	prepare_buf();
+	ASSERT_EQ(0, m_conn->m_protocol_handler.get_recv_size_hint());
+
+	size_t buf1_size = sizeof(m_req_head) + 100;
+	std::string buf1 = m_buf.substr(0, buf1_size);
+	std::string buf2 = m_buf.substr(buf1_size);
+
+	ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(buf1.data(), buf1.size()));
+	ASSERT_EQ(m_in_data.size() - 100, m_conn->m_protocol_handler.get_recv_size_hint());
+
+	ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(buf2.data(), buf2.size()));
+	ASSERT_EQ(1, m_commands_handler.invoke_counter());
+	ASSERT_EQ(0, m_conn->m_protocol_handler.get_recv_size_hint());
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_requests_at_once)
 {
 	prepare_buf();
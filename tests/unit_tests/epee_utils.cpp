@@ -27,14 +27,18 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <array>
+#include <atomic>
 #include <boost/endian/conversion.hpp>
 #include <boost/range/algorithm/equal.hpp>
 #include <boost/range/algorithm_ext/iota.hpp>
+#include <chrono>
 #include <cstdint>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #ifndef _WIN32
@@ -44,11 +48,17 @@
 #include "boost/archive/portable_binary_iarchive.hpp"
 #include "boost/archive/portable_binary_oarchive.hpp"
 #include "hex.h"
+#include "latency_histogram.h"
 #include "net/local_ip.h"
 #include "net/net_utils_base.h"
+#include "net/rpc_admission.h"
+#include "net/rpc_metrics.h"
 #include "p2p/net_peerlist_boost_serialization.h"
+#include "serialization/keyvalue_serialization.h"
 #include "span.h"
+#include "storages/portable_storage_template_helper.h"
 #include "string_tools.h"
+#include "syncobj.h"
 
 GULPS_CAT_MAJOR("test");
 
@@ -667,3 +677,336 @@ TEST(NetUtils, PrivateRanges)
 	ASSERT_EQ(is_local("0.0.30.172"), false);
 	ASSERT_EQ(is_local("0.0.30.127"), false);
 }
+
+namespace
+{
+// fields are declared in name order, portable_storage dumps them sorted
+struct json_writer_inner
+{
+	std::string a_text;
+	uint64_t b_number;
+	std::vector<uint64_t> c_numbers;
+
+	BEGIN_KV_SERIALIZE_MAP(json_writer_inner)
+	KV_SERIALIZE(a_text)
+	KV_SERIALIZE(b_number)
+	KV_SERIALIZE(c_numbers)
+	END_KV_SERIALIZE_MAP()
+};
+
+struct json_writer_outer
+{
+	bool a_flag;
+	double b_real;
+	int8_t c_small;
+	std::vector<json_writer_inner> d_items;
+	std::vector<json_writer_inner> e_empty_items;
+	json_writer_inner f_inner;
+	std::list<std::string> g_strings;
+	epee::serialization::storage_entry h_entry;
+	uint32_t i_last;
+
+	BEGIN_KV_SERIALIZE_MAP(json_writer_outer)
+	KV_SERIALIZE(a_flag)
+	KV_SERIALIZE(b_real)
+	KV_SERIALIZE(c_small)
+	KV_SERIALIZE(d_items)
+	KV_SERIALIZE(e_empty_items)
+	KV_SERIALIZE(f_inner)
+	KV_SERIALIZE(g_strings)
+	KV_SERIALIZE(h_entry)
+	KV_SERIALIZE(i_last)
+	END_KV_SERIALIZE_MAP()
+};
+
+json_writer_outer make_json_writer_outer()
+{
+	json_writer_outer o;
+	o.a_flag = true;
+	o.b_real = 0.125;
+	o.c_small = -3;
+	for(uint64_t i = 0; i < 3; ++i)
+	{
+		json_writer_inner in;
+		in.a_text = "item \"" + std::to_string(i) + "\"\n/";
+		in.b_number = i * 1000000007;
+		for(uint64_t j = 0; j < i; ++j)
+			in.c_numbers.push_back(j);
+		o.d_items.push_back(in);
+	}
+	o.f_inner.a_text = "inner";
+	o.f_inner.b_number = 18446744073709551615ull;
+	o.g_strings = {"x", "", "\t"};
+	o.h_entry = std::string("entry");
+	o.i_last = 7;
+	return o;
+}
+}
+
+TEST(KVJsonWriter, MatchesPortableStorage)
+{
+	json_writer_outer o = make_json_writer_outer();
+	for(bool newlines : {true, false})
+	{
+		for(size_t indent : {0, 2})
+		{
+			epee::serialization::portable_storage ps;
+			o.store(ps);
+			std::string expected;
+			ps.dump_as_json(expected, indent, newlines);
+
+			std::string json;
+			ASSERT_TRUE(epee::serialization::store_t_to_json(o, json, indent, newlines));
+			ASSERT_EQ(expected, json);
+		}
+	}
+}
+
+TEST(KVJsonWriter, RoundTrip)
+{
+	json_writer_outer o = make_json_writer_outer();
+	std::string json;
+	ASSERT_TRUE(epee::serialization::store_t_to_json(o, json));
+
+	json_writer_outer l;
+	ASSERT_TRUE(epee::serialization::load_t_from_json(l, json));
+	ASSERT_EQ(o.a_flag, l.a_flag);
+	ASSERT_EQ(o.b_real, l.b_real);
+	ASSERT_EQ(o.c_small, l.c_small);
+	ASSERT_EQ(o.d_items.size(), l.d_items.size());
+	for(size_t i = 0; i < o.d_items.size(); ++i)
+	{
+		ASSERT_EQ(o.d_items[i].a_text, l.d_items[i].a_text);
+		ASSERT_EQ(o.d_items[i].b_number, l.d_items[i].b_number);
+		ASSERT_EQ(o.d_items[i].c_numbers, l.d_items[i].c_numbers);
+	}
+	ASSERT_TRUE(l.e_empty_items.empty());
+	ASSERT_EQ(o.f_inner.b_number, l.f_inner.b_number);
+	ASSERT_EQ(o.g_strings, l.g_strings);
+	ASSERT_EQ(o.i_last, l.i_last);
+}
+
+TEST(KVJsonWriter, EmptyStruct)
+{
+	json_writer_inner in;
+	in.b_number = 0;
+	std::string json = "stale";
+	ASSERT_TRUE(epee::serialization::store_t_to_json(in, json, 0, false));
+	ASSERT_EQ("{  \"a_text\": \"\",  \"b_number\": 0}", json);
+}
+
+TEST(LatencyHistogram, BucketBounds)
+{
+	for(uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull, 100ull, 1000ull, 123456ull, 999999999ull})
+	{
+		const size_t idx = epee::latency_histogram::bucket_index(v);
+		ASSERT_LT(idx, size_t(epee::latency_histogram::bucket_count));
+		EXPECT_LT(v, epee::latency_histogram::bucket_upper_bound(idx));
+		if(idx > 0)
+		{
+			EXPECT_GE(v, epee::latency_histogram::bucket_upper_bound(idx - 1));
+		}
+		// log-linear: bucket width is at most 1/8 of its lower bound
+		if(v >= epee::latency_histogram::sub_count)
+		{
+			EXPECT_LE(epee::latency_histogram::bucket_upper_bound(idx) - epee::latency_histogram::bucket_upper_bound(idx - 1), v / 8 + 1);
+		}
+	}
+	EXPECT_EQ(epee::latency_histogram::bucket_count - 1, epee::latency_histogram::bucket_index(std::numeric_limits<uint64_t>::max()));
+}
+
+TEST(LatencyHistogram, Percentiles)
+{
+	epee::latency_histogram h;
+	epee::latency_histogram::snapshot empty = h.get_snapshot();
+	EXPECT_EQ(0, empty.percentile(0.5));
+
+	for(uint64_t v = 1; v <= 1000; ++v)
+		h.record(v);
+	const epee::latency_histogram::snapshot s = h.get_snapshot();
+	EXPECT_EQ(1000, s.count);
+	EXPECT_EQ(500500, s.sum);
+	EXPECT_EQ(1000, s.max);
+	EXPECT_NEAR(500, s.percentile(0.5), 500 / 8);
+	EXPECT_NEAR(990, s.percentile(0.99), 990 / 8);
+	EXPECT_EQ(1000, s.percentile(1.0));
+	EXPECT_EQ(95, s.count_below(96));
+	// [96, 104) straddles 100 so it is left out
+	EXPECT_EQ(95, s.count_below(100));
+	EXPECT_EQ(1000, s.count_below(2000));
+}
+
+TEST(RpcMetrics, CallScope)
+{
+	epee::net_utils::rpc_method_metrics &m = epee::net_utils::rpc_metrics::instance().get("unit_test_call_scope");
+	ASSERT_EQ(&m, &epee::net_utils::rpc_metrics::instance().get("unit_test_call_scope"));
+	std::string response;
+	{
+		epee::net_utils::rpc_call_scope scope(m, 10, response);
+		EXPECT_EQ(1, m.in_flight.load());
+		response = "12345";
+		scope.success();
+	}
+	{
+		epee::net_utils::rpc_call_scope scope(m, 3, response);
+	}
+	EXPECT_EQ(2, m.calls.load());
+	EXPECT_EQ(1, m.errors.load());
+	EXPECT_EQ(0, m.in_flight.load());
+	EXPECT_EQ(13, m.request_bytes.load());
+	EXPECT_EQ(10, m.response_bytes.load());
+	EXPECT_EQ(2, m.latency.count());
+}
+
+TEST(RpcMetrics, Prometheus)
+{
+	epee::net_utils::rpc_method_metrics &m = epee::net_utils::rpc_metrics::instance().get("/unit_test_prometheus");
+	m.latency.record(50);
+	m.latency.record(2000000);
+
+	std::string out;
+	epee::net_utils::rpc_metrics::instance().write_prometheus(out, "test");
+	EXPECT_NE(std::string::npos, out.find("# TYPE test_rpc_requests_total counter\n"));
+	EXPECT_NE(std::string::npos, out.find("# TYPE test_rpc_request_duration_seconds histogram\n"));
+	EXPECT_NE(std::string::npos, out.find("test_rpc_request_duration_seconds_bucket{method=\"/unit_test_prometheus\",le=\"0.0001\"} 1\n"));
+	EXPECT_NE(std::string::npos, out.find("test_rpc_request_duration_seconds_bucket{method=\"/unit_test_prometheus\",le=\"1\"} 1\n"));
+	EXPECT_NE(std::string::npos, out.find("test_rpc_request_duration_seconds_bucket{method=\"/unit_test_prometheus\",le=\"2.5\"} 2\n"));
+	EXPECT_NE(std::string::npos, out.find("test_rpc_request_duration_seconds_bucket{method=\"/unit_test_prometheus\",le=\"+Inf\"} 2\n"));
+	EXPECT_NE(std::string::npos, out.find("test_rpc_request_duration_seconds_sum{method=\"/unit_test_prometheus\"} 2.000050\n"));
+	EXPECT_NE(std::string::npos, out.find("test_rpc_request_duration_seconds_count{method=\"/unit_test_prometheus\"} 2\n"));
+
+	out.clear();
+	epee::net_utils::rpc_metrics::write_prometheus_histogram(out, "lock", "help", {{"", m.latency.get_snapshot()}});
+	EXPECT_NE(std::string::npos, out.find("lock_bucket{le=\"+Inf\"} 2\n"));
+	EXPECT_NE(std::string::npos, out.find("lock_count 2\n"));
+}
+
+TEST(TimedCriticalSection, RecordsWaits)
+{
+	epee::timed_critical_section cs;
+	{
+		CRITICAL_REGION_LOCAL(cs);
+	}
+	ASSERT_EQ(1, cs.wait_histogram().count());
+	EXPECT_EQ(0, cs.wait_histogram().sum());
+
+	std::atomic<bool> held(false);
+	std::thread holder([&] {
+		CRITICAL_REGION_LOCAL(cs);
+		held = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	});
+	while(!held)
+		std::this_thread::yield();
+	{
+		CRITICAL_REGION_LOCAL(cs);
+	}
+	holder.join();
+	ASSERT_EQ(3, cs.wait_histogram().count());
+	EXPECT_GT(cs.wait_histogram().sum(), 1000);
+}
+
+TEST(RpcAdmission, UnlimitedByDefault)
+{
+	epee::net_utils::rpc_admission admission;
+	admission.set_cost("heavy_call", epee::net_utils::rpc_admission::cost_heavy);
+	std::vector<epee::net_utils::rpc_admission::ticket> tickets;
+	for(int i = 0; i < 16; ++i)
+	{
+		tickets.push_back(admission.admit("heavy_call"));
+		ASSERT_TRUE(bool(tickets.back()));
+	}
+}
+
+TEST(RpcAdmission, LimitsAndSheds)
+{
+	using adm = epee::net_utils::rpc_admission;
+	adm admission;
+	admission.set_cost("heavy_call", adm::cost_heavy);
+	admission.set_limit(adm::cost_heavy, 2);
+	admission.set_queue_budget(std::chrono::milliseconds(10));
+
+	{
+		adm::ticket a = admission.admit("heavy_call");
+		adm::ticket b = admission.admit("heavy_call");
+		ASSERT_TRUE(bool(a));
+		ASSERT_TRUE(bool(b));
+		EXPECT_EQ(2, admission.get_stats(adm::cost_heavy).active);
+
+		// light calls are never held back by heavy ones
+		adm::ticket light = admission.admit("get_info");
+		EXPECT_TRUE(bool(light));
+
+		// the class is full and nothing frees up within the budget
+		adm::ticket c = admission.admit("heavy_call");
+		EXPECT_FALSE(bool(c));
+		EXPECT_EQ(1, admission.get_stats(adm::cost_heavy).shed);
+	}
+	EXPECT_EQ(0, admission.get_stats(adm::cost_heavy).active);
+	EXPECT_EQ(2, admission.get_stats(adm::cost_heavy).admitted);
+}
+
+TEST(RpcAdmission, WaitsForSlot)
+{
+	using adm = epee::net_utils::rpc_admission;
+	adm admission;
+	admission.set_cost("heavy_call", adm::cost_heavy);
+	admission.set_limit(adm::cost_heavy, 1);
+	admission.set_queue_budget(std::chrono::milliseconds(5000));
+
+	std::atomic<bool> holding(false);
+	std::thread holder([&] {
+		adm::ticket t = admission.admit("heavy_call");
+		holding = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	});
+	while(!holding)
+		std::this_thread::yield();
+	adm::ticket t = admission.admit("heavy_call");
+	EXPECT_TRUE(bool(t));
+	holder.join();
+	EXPECT_EQ(0, admission.get_stats(adm::cost_heavy).shed);
+}
+
+TEST(RpcAdmission, KeepsWorkerForLightCalls)
+{
+	using adm = epee::net_utils::rpc_admission;
+	adm admission;
+	admission.set_cost("heavy_call", adm::cost_heavy);
+	admission.set_cost("medium_call", adm::cost_medium);
+	admission.set_limit(adm::cost_heavy, 1);
+	admission.set_limit(adm::cost_medium, 3);
+	admission.set_worker_threads(3);
+	admission.set_queue_budget(std::chrono::milliseconds(5000));
+
+	adm::ticket heavy = admission.admit("heavy_call");
+	ASSERT_TRUE(bool(heavy));
+	{
+		adm::ticket medium = admission.admit("medium_call");
+		ASSERT_TRUE(bool(medium));
+
+		// two of the three workers are taken, waiting for the heavy slot would block the last one
+		const auto start = std::chrono::steady_clock::now();
+		adm::ticket waiting_heavy = admission.admit("heavy_call");
+		adm::ticket more_medium = admission.admit("medium_call");
+		EXPECT_FALSE(bool(waiting_heavy));
+		EXPECT_FALSE(bool(more_medium));
+		EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+		EXPECT_EQ(0, admission.get_stats(adm::cost_heavy).waiting);
+
+		adm::ticket light = admission.admit("get_info");
+		EXPECT_TRUE(bool(light));
+	}
+
+	// a finished call gives its worker back
+	adm::ticket medium = admission.admit("medium_call");
+	EXPECT_TRUE(bool(medium));
+}
+
+TEST(RpcAdmission, ParseClass)
+{
+	epee::net_utils::rpc_admission::cost_class cls;
+	ASSERT_TRUE(epee::net_utils::rpc_admission::parse_class("heavy", cls));
+	EXPECT_EQ(epee::net_utils::rpc_admission::cost_heavy, cls);
+	EXPECT_FALSE(epee::net_utils::rpc_admission::parse_class("huge", cls));
+}
@@ -27,7 +27,11 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "net/http_auth.h"
+#include "net/http_protocol_handler.h"
 #include "gtest/gtest.h"
+#ifdef HTTP_ENABLE_GZIP
+#include "gzip_encoding.h"
+#endif
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -707,3 +711,244 @@ TEST(HTTP, Add_Field)
 
 	EXPECT_STREQ("leading textfoo: bar\r\nbar: foo\r\nmoarbars: moarfoo\r\n", str.c_str());
 }
+
+TEST(HTTP_Server_Parse, RequestLine)
+{
+	const std::string req = "\r\nget /json_rpc?a=1 HTTP/1.1\r\nHost: x\r\n\r\n";
+	http::http_request_line rl;
+	ASSERT_TRUE(http::parse_request_line(req.data(), req.data() + req.size(), rl));
+	EXPECT_EQ(http::http_method_get, rl.method);
+	EXPECT_EQ("get", std::string(rl.method_begin, rl.method_end));
+	EXPECT_EQ("/json_rpc?a=1", std::string(rl.uri_begin, rl.uri_end));
+	EXPECT_EQ("get /json_rpc?a=1 HTTP/1.1\r\n", std::string(rl.line_begin, rl.line_end));
+	EXPECT_EQ(1, rl.ver_hi);
+	EXPECT_EQ(1, rl.ver_lo);
+
+	const std::string bad[] = {"GET  / HTTP/1.1\r\n", "GET / HTTP/1.1", "FOO / HTTP/1.1\r\n", "GET / HTTP/1\r\n", "GET / HTTP/99999999999999999999.1\r\n"};
+	for(const std::string &s : bad)
+		EXPECT_FALSE(http::parse_request_line(s.data(), s.data() + s.size(), rl)) << s;
+}
+
+TEST(HTTP_Server_Parse, HeaderFields)
+{
+	const std::string head = "Host: example\r\nX-Folded: a\r\n\tb\r\nContent-Length : 12\r\nnocolon\r\nempty:\r\n\r\n";
+	std::vector<std::pair<std::string, std::string>> fields;
+	http::parse_header_fields(head.data(), head.data() + head.size(), [&fields](const char *nb, const char *ne, const char *vb, const char *ve) {
+		fields.emplace_back(std::string(nb, ne), std::string(vb, ve));
+	});
+
+	ASSERT_EQ(4u, fields.size());
+	EXPECT_EQ(std::make_pair(std::string("Host"), std::string("example")), fields[0]);
+	EXPECT_EQ(std::make_pair(std::string("X-Folded"), std::string("a\r\n\tb")), fields[1]);
+	EXPECT_EQ(std::make_pair(std::string("Content-Length"), std::string("12")), fields[2]);
+	EXPECT_EQ(std::make_pair(std::string("empty"), std::string()), fields[3]);
+
+	size_t len = 0;
+	EXPECT_TRUE(http::parse_content_length(" 12 bytes", len));
+	EXPECT_EQ(12u, len);
+	EXPECT_FALSE(http::parse_content_length("none", len));
+	EXPECT_FALSE(http::parse_content_length("99999999999999999999999", len));
+}
+
+TEST(HTTP_Server_Parse, Multipart)
+{
+	std::string boundary;
+	ASSERT_TRUE(http::match_boundary("multipart/form-data; BOUNDARY=xyz; charset=utf-8", boundary));
+	EXPECT_EQ("xyz", boundary);
+	ASSERT_TRUE(http::match_boundary("multipart/form-data; boundary=abc", boundary));
+	EXPECT_EQ("abc", boundary);
+	EXPECT_FALSE(http::match_boundary("multipart/form-data", boundary));
+
+	const std::string body = "--abc\r\n"
+							 "Content-Disposition: form-data; name=\"f\"\r\n"
+							 "Content-Type: text/plain\r\n"
+							 "X-Extra: 1\r\n"
+							 "\r\n"
+							 "hello\r\n"
+							 "--abc--";
+	std::list<http::multipart_entry> entries;
+	ASSERT_TRUE(http::parse_multipart_body("multipart/form-data; boundary=abc", body, entries));
+	ASSERT_EQ(1u, entries.size());
+	EXPECT_EQ("form-data; name=\"f\"", entries.front().m_content_disposition);
+	EXPECT_EQ("text/plain", entries.front().m_content_type);
+	ASSERT_EQ(1u, entries.front().m_etc_header_fields.size());
+	EXPECT_EQ("X-Extra", entries.front().m_etc_header_fields.front().first);
+	EXPECT_EQ("hello", entries.front().m_body);
+}
+
+namespace
+{
+class test_http_endpoint : public epee::net_utils::i_service_endpoint
+{
+  public:
+	virtual bool do_send(const void *ptr, size_t cb)
+	{
+		sent.append(static_cast<const char *>(ptr), cb);
+		return true;
+	}
+	virtual bool close() { return true; }
+	virtual bool call_run_once_service_io() { return true; }
+	virtual bool request_callback() { return true; }
+	virtual boost::asio::io_service &get_io_service() { return io_service; }
+	virtual bool add_ref() { return true; }
+	virtual bool release() { return true; }
+
+	size_t responses() const
+	{
+		size_t n = 0;
+		for(size_t pos = sent.find("HTTP/1.1 200"); pos != std::string::npos; pos = sent.find("HTTP/1.1 200", pos + 1))
+			++n;
+		return n;
+	}
+
+	boost::asio::io_service io_service;
+	std::string sent;
+};
+
+class test_http_handler : public http::simple_http_connection_handler<epee::net_utils::connection_context_base>
+{
+  public:
+	test_http_handler(test_http_endpoint &endpoint, config_type &config) : simple_http_connection_handler(&endpoint, config) {}
+
+	virtual bool handle_request(const http::http_request_info &query_info, http::http_response_info &response)
+	{
+		response.m_body.assign(query_info.m_URI == "/big" ? 4096 : 16, 'a');
+		response.m_response_code = 200;
+		response.m_response_comment = "OK";
+		return true;
+	}
+};
+}
+
+TEST(HTTP_Server, Pipelined_Requests)
+{
+	http::http_server_config config;
+	test_http_endpoint endpoint;
+	test_http_handler handler(endpoint, config);
+
+	const std::string requests = "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+								 "POST /b HTTP/1.1\r\nContent-Length: 2\r\n\r\nde"
+								 "GET /c HTTP/1.1\r\n\r\n";
+	EXPECT_TRUE(handler.handle_recv(requests.data(), requests.size()));
+	EXPECT_EQ(3u, endpoint.responses());
+	EXPECT_EQ(std::string::npos, endpoint.sent.find("Connection: close"));
+}
+
+TEST(HTTP_Server, Keep_Alive)
+{
+	http::http_server_config config;
+	{
+		test_http_endpoint endpoint;
+		test_http_handler handler(endpoint, config);
+		const std::string request = "GET / HTTP/1.0\r\n\r\nGET / HTTP/1.0\r\n\r\n";
+		EXPECT_FALSE(handler.handle_recv(request.data(), request.size()));
+		EXPECT_EQ(1u, endpoint.responses());
+		EXPECT_NE(std::string::npos, endpoint.sent.find("Connection: close\r\n"));
+	}
+	{
+		test_http_endpoint endpoint;
+		test_http_handler handler(endpoint, config);
+		const std::string request = "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n";
+		EXPECT_TRUE(handler.handle_recv(request.data(), request.size()));
+		EXPECT_NE(std::string::npos, endpoint.sent.find("Connection: keep-alive\r\n"));
+	}
+	{
+		test_http_endpoint endpoint;
+		test_http_handler handler(endpoint, config);
+		const std::string request = "GET / HTTP/1.1\r\nConnection: close\r\n\r\nGET / HTTP/1.1\r\n\r\n";
+		EXPECT_FALSE(handler.handle_recv(request.data(), request.size()));
+		EXPECT_EQ(1u, endpoint.responses());
+	}
+}
+
+TEST(HTTP_Server, Content_Coding)
+{
+	EXPECT_EQ(http::http_coding_gzip, http::select_content_coding("deflate, gzip;q=0.5"));
+	EXPECT_EQ(http::http_coding_deflate, http::select_content_coding("gzip;q=0, deflate"));
+	EXPECT_EQ(http::http_coding_identity, http::select_content_coding("br, identity"));
+	EXPECT_EQ(http::http_coding_identity, http::select_content_coding(""));
+
+#ifdef HTTP_ENABLE_GZIP
+	http::http_server_config config;
+	test_http_endpoint endpoint;
+	test_http_handler handler(endpoint, config);
+	const std::string requests = "GET /small HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n"
+								 "GET /big HTTP/1.1\r\nAccept-Encoding: gzip, deflate\r\n\r\n";
+	EXPECT_TRUE(handler.handle_recv(requests.data(), requests.size()));
+	EXPECT_EQ(2u, endpoint.responses());
+	const size_t second = endpoint.sent.rfind("HTTP/1.1 200");
+	EXPECT_EQ(std::string::npos, endpoint.sent.substr(0, second).find("Content-Encoding"));
+	EXPECT_NE(std::string::npos, endpoint.sent.find("Content-Encoding:gzip\r\n", second));
+	EXPECT_EQ(std::string::npos, endpoint.sent.find("Content-Length: 4096", second));
+#endif
+}
+
+#ifdef HTTP_ENABLE_GZIP
+namespace
+{
+struct test_target_handler : public epee::net_utils::i_target_handler
+{
+	virtual bool handle_target_data(std::string &piece_of_transfer)
+	{
+		data += piece_of_transfer;
+		piece_of_transfer.clear();
+		return true;
+	}
+
+	std::string data;
+};
+
+bool decode_in_pieces(const std::string &packed, bool deflate, size_t piece_size, size_t max_inflated_size, std::string &out)
+{
+	test_target_handler target;
+	epee::net_utils::content_encoding_gzip decoder(&target, deflate, max_inflated_size);
+	for(size_t pos = 0; pos < packed.size(); pos += piece_size)
+	{
+		std::string piece = packed.substr(pos, piece_size);
+		if(!decoder.update_in(piece))
+		{
+			out = std::move(target.data);
+			return false;
+		}
+	}
+	out = std::move(target.data);
+	return true;
+}
+}
+
+TEST(HTTP_Client, Content_Decoding)
+{
+	std::string body;
+	for(size_t i = 0; i < 300000; ++i)
+		body += std::to_string(i * 7919 % 10007);
+
+	for(const http::http_content_coding coding : {http::http_coding_gzip, http::http_coding_deflate})
+	{
+		std::string packed, unpacked;
+		ASSERT_TRUE(http::compress_http_body(body, packed, coding));
+		ASSERT_LT(packed.size(), body.size());
+		for(const size_t piece_size : {size_t(1), size_t(1000), packed.size()})
+		{
+			EXPECT_TRUE(decode_in_pieces(packed, coding == http::http_coding_deflate, piece_size, GZIP_MAX_INFLATED_SIZE, unpacked));
+			EXPECT_EQ(body, unpacked);
+		}
+	}
+}
+
+TEST(HTTP_Client, Content_Decoding_Bomb)
+{
+	// 64 MB of zeros pack to about 64 kB
+	const std::string body(64 * 1024 * 1024, 0);
+	std::string packed, unpacked;
+	ASSERT_TRUE(http::compress_http_body(body, packed, http::http_coding_gzip));
+	ASSERT_LT(packed.size(), 100u * 1024);
+
+	EXPECT_FALSE(decode_in_pieces(packed, false, packed.size(), 1024 * 1024, unpacked));
+	EXPECT_LE(unpacked.size(), 1024u * 1024);
+	EXPECT_FALSE(decode_in_pieces(packed, false, 4096, 1024 * 1024, unpacked));
+	EXPECT_LE(unpacked.size(), 1024u * 1024);
+
+	EXPECT_TRUE(decode_in_pieces(packed, false, packed.size(), body.size(), unpacked));
+	EXPECT_EQ(body.size(), unpacked.size());
+}
+#endif
@@ -0,0 +1,127 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/indexed_blocks_cache.h"
+
+using namespace cryptonote;
+
+namespace
+{
+indexed_blocks_chunk make_chunk(uint64_t start_height, size_t size)
+{
+	indexed_blocks_chunk chunk;
+	chunk.blocks.resize(1);
+	chunk.blocks[0].block = std::to_string(start_height);
+	chunk.size = size;
+	return chunk;
+}
+}
+
+TEST(indexed_blocks_cache, hit)
+{
+	indexed_blocks_cache cache(100, 1000);
+	ASSERT_EQ(nullptr, cache.find(0));
+
+	cache.insert(0, make_chunk(0, 10));
+	cache.insert(100, make_chunk(100, 20));
+	const indexed_blocks_chunk *chunk = cache.find(100);
+	ASSERT_NE(nullptr, chunk);
+	EXPECT_EQ("100", chunk->blocks[0].block);
+	EXPECT_EQ(nullptr, cache.find(200));
+	EXPECT_EQ(2u, cache.count());
+	EXPECT_EQ(30u, cache.size());
+
+	// replacing a chunk doesn't count it twice
+	cache.insert(100, make_chunk(100, 25));
+	EXPECT_EQ(2u, cache.count());
+	EXPECT_EQ(35u, cache.size());
+}
+
+TEST(indexed_blocks_cache, invalidate_on_reorg)
+{
+	indexed_blocks_cache cache(100, 1000);
+	for(uint64_t h = 0; h < 500; h += 100)
+		cache.insert(h, make_chunk(h, 10));
+
+	// popping back to 250 removes the block at 250, so the chunk starting at 200 is stale too
+	cache.invalidate(250);
+	EXPECT_NE(nullptr, cache.find(0));
+	EXPECT_NE(nullptr, cache.find(100));
+	EXPECT_EQ(nullptr, cache.find(200));
+	EXPECT_EQ(nullptr, cache.find(300));
+	EXPECT_EQ(nullptr, cache.find(400));
+	EXPECT_EQ(20u, cache.size());
+
+	// popping back to the start of a chunk keeps the chunk before it
+	cache.invalidate(100);
+	EXPECT_NE(nullptr, cache.find(0));
+	EXPECT_EQ(nullptr, cache.find(100));
+
+	cache.invalidate(0);
+	EXPECT_EQ(0u, cache.count());
+	EXPECT_EQ(0u, cache.size());
+}
+
+TEST(indexed_blocks_cache, evict_least_recently_used)
+{
+	indexed_blocks_cache cache(100, 30);
+	cache.insert(0, make_chunk(0, 10));
+	cache.insert(100, make_chunk(100, 10));
+	cache.insert(200, make_chunk(200, 10));
+
+	// 0 becomes the most recently used, so 100 goes first
+	ASSERT_NE(nullptr, cache.find(0));
+	cache.insert(300, make_chunk(300, 10));
+	EXPECT_EQ(nullptr, cache.find(100));
+	EXPECT_NE(nullptr, cache.find(0));
+	EXPECT_NE(nullptr, cache.find(200));
+	EXPECT_NE(nullptr, cache.find(300));
+	EXPECT_EQ(30u, cache.size());
+
+	// a big chunk makes room for itself
+	cache.insert(400, make_chunk(400, 25));
+	EXPECT_EQ(nullptr, cache.find(0));
+	EXPECT_EQ(nullptr, cache.find(200));
+	EXPECT_EQ(nullptr, cache.find(300));
+	EXPECT_NE(nullptr, cache.find(400));
+	EXPECT_EQ(25u, cache.size());
+}
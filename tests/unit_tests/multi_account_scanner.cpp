@@ -0,0 +1,218 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "ringct/rctOps.h"
+#include "wallet/multi_account_scanner.h"
+#include "wallet/wallet2.h"
+
+namespace
+{
+struct destination
+{
+	cryptonote::account_public_address addr;
+	bool is_subaddress;
+};
+
+// Outputs and tx pubkeys as construct_tx_with_tx_key makes them, nothing else is needed to scan
+cryptonote::transaction make_tx(const std::vector<destination> &dsts)
+{
+	hw::device &hwdev = hw::get_device("default");
+	const cryptonote::keypair tx_key = cryptonote::keypair::generate(hwdev);
+
+	size_t num_subaddresses = 0;
+	for(const destination &dst : dsts)
+		num_subaddresses += dst.is_subaddress;
+	const bool need_additional_txkeys = num_subaddresses > 0 && dsts.size() > 1;
+
+	cryptonote::transaction tx;
+	tx.version = 2;
+	if(num_subaddresses == 1 && dsts.size() == 1)
+		cryptonote::add_tx_pub_key_to_extra(tx, rct::rct2pk(rct::scalarmultKey(rct::pk2rct(dsts[0].addr.m_spend_public_key), rct::sk2rct(tx_key.sec))));
+	else
+		cryptonote::add_tx_pub_key_to_extra(tx, tx_key.pub);
+
+	std::vector<crypto::public_key> additional_tx_pub_keys;
+	for(size_t i = 0; i < dsts.size(); ++i)
+	{
+		crypto::secret_key derivation_key = tx_key.sec;
+		if(need_additional_txkeys)
+		{
+			const cryptonote::keypair additional_key = cryptonote::keypair::generate(hwdev);
+			if(dsts[i].is_subaddress)
+			{
+				additional_tx_pub_keys.push_back(rct::rct2pk(rct::scalarmultKey(rct::pk2rct(dsts[i].addr.m_spend_public_key), rct::sk2rct(additional_key.sec))));
+				derivation_key = additional_key.sec;
+			}
+			else
+			{
+				additional_tx_pub_keys.push_back(additional_key.pub);
+			}
+		}
+
+		crypto::key_derivation derivation;
+		crypto::public_key out_key;
+		EXPECT_TRUE(crypto::generate_key_derivation(dsts[i].addr.m_view_public_key, derivation_key, derivation));
+		EXPECT_TRUE(crypto::derive_public_key(derivation, i, dsts[i].addr.m_spend_public_key, out_key));
+		tx.vout.push_back({0, cryptonote::txout_to_key(out_key)});
+	}
+	if(need_additional_txkeys)
+		cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional_tx_pub_keys);
+	return tx;
+}
+
+typedef std::tuple<size_t, size_t, size_t, uint32_t, uint32_t> match_key; // account, tx, output, subaddress major, minor
+}
+
+class multi_account_scanner_wallet : public ::testing::Test
+{
+  protected:
+	multi_account_scanner_wallet()
+	{
+		for(size_t i = 0; i < 2; ++i)
+		{
+			cryptonote::account_base acc;
+			acc.generate_new(0);
+			const cryptonote::account_keys &keys = acc.get_keys();
+			wallets[i].reset(new tools::wallet2(cryptonote::TESTNET));
+			wallets[i]->generate("", "", keys.m_account_address, keys.m_spend_secret_key, keys.m_view_secret_key);
+			wallets[i]->expand_subaddresses({1, 3});
+			EXPECT_EQ(i, scanner.add_account(keys.m_view_secret_key, wallets[i]->m_subaddresses));
+		}
+		outsider.generate_new(0);
+	}
+
+	destination address(size_t wallet, uint32_t major, uint32_t minor)
+	{
+		return {wallets[wallet]->get_subaddress({major, minor}), major != 0 || minor != 0};
+	}
+
+	// key images of the outputs wallet2 finds in tx, for a wallet that holds its spend key
+	std::unordered_set<crypto::key_image> wallet_scan(size_t wallet, const crypto::hash &txid, const cryptonote::transaction &tx, bool &found)
+	{
+		tools::wallet2::wallet_refresh_ctx refresh_ctx;
+		tools::wallet2::wallet_scan_ctx scan_ctx(*wallets[wallet], refresh_ctx);
+		bloom_filter in_kimg;
+		in_kimg.init(16);
+		std::unordered_set<crypto::key_image> inc_kimg;
+		found = wallets[wallet]->block_scan_tx(scan_ctx, txid, tx, in_kimg, inc_kimg);
+		return inc_kimg;
+	}
+
+	crypto::key_image key_image(const tools::multi_account_scanner::matched_output &m)
+	{
+		cryptonote::keypair eph;
+		crypto::key_image ki;
+		EXPECT_TRUE(cryptonote::generate_key_image_helper_precomp(wallets[m.account_idx]->get_account().get_keys(), m.out_key, m.derivation,
+																  m.out_idx, m.subaddr_index, eph, ki, hw::get_device("default")));
+		EXPECT_EQ(m.out_key, eph.pub);
+		return ki;
+	}
+
+	std::unique_ptr<tools::wallet2> wallets[2];
+	cryptonote::account_base outsider;
+	tools::multi_account_scanner scanner;
+};
+
+TEST_F(multi_account_scanner_wallet, matches_wallet2_scan)
+{
+	const destination outsider_addr = {outsider.get_keys().m_account_address, false};
+
+	cryptonote::block blk;
+	std::vector<cryptonote::transaction> txs;
+	std::set<match_key> expected;
+
+	// miner tx to the first main address
+	blk.miner_tx = make_tx({address(0, 0, 0)});
+	expected.insert(match_key(0, 0, 0, 0, 0));
+	// subaddresses of both wallets and a stranger, with additional pubkeys
+	txs.push_back(make_tx({address(0, 0, 1), outsider_addr, address(1, 1, 2)}));
+	expected.insert(match_key(0, 1, 0, 0, 1));
+	expected.insert(match_key(1, 1, 2, 1, 2));
+	// a single subaddress destination, the tx pubkey is built on its spend key
+	txs.push_back(make_tx({address(1, 0, 3)}));
+	expected.insert(match_key(1, 2, 0, 0, 3));
+	// main address and subaddress of the same wallet, plus change to it in another account
+	txs.push_back(make_tx({address(0, 0, 0), address(0, 1, 1), address(0, 1, 3)}));
+	expected.insert(match_key(0, 3, 0, 0, 0));
+	expected.insert(match_key(0, 3, 1, 1, 1));
+	expected.insert(match_key(0, 3, 2, 1, 3));
+	// nothing for us
+	txs.push_back(make_tx({outsider_addr, outsider_addr}));
+	for(const cryptonote::transaction &tx : txs)
+		blk.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+
+	std::vector<tools::multi_account_scanner::matched_output> matches;
+	EXPECT_EQ(expected.size(), scanner.scan_block(10, blk, txs, matches));
+
+	std::set<match_key> found;
+	for(const tools::multi_account_scanner::matched_output &m : matches)
+	{
+		EXPECT_EQ(10, m.block_height);
+		EXPECT_EQ(m.tx_idx == 0 ? cryptonote::get_transaction_hash(blk.miner_tx) : blk.tx_hashes[m.tx_idx - 1], m.txid);
+		const cryptonote::transaction &tx = m.tx_idx == 0 ? blk.miner_tx : txs[m.tx_idx - 1];
+		EXPECT_EQ(boost::get<cryptonote::txout_to_key>(tx.vout[m.out_idx].target).key, m.out_key);
+		found.insert(match_key(m.account_idx, m.tx_idx, m.out_idx, m.subaddr_index.major, m.subaddr_index.minor));
+	}
+	EXPECT_EQ(expected, found);
+
+	// wallet2 finds the same outputs in every tx, with the same derivation and subaddress
+	for(size_t w = 0; w < 2; ++w)
+	{
+		for(size_t tx_idx = 0; tx_idx <= txs.size(); ++tx_idx)
+		{
+			const cryptonote::transaction &tx = tx_idx == 0 ? blk.miner_tx : txs[tx_idx - 1];
+			const crypto::hash txid = tx_idx == 0 ? cryptonote::get_transaction_hash(blk.miner_tx) : blk.tx_hashes[tx_idx - 1];
+			bool wallet_found;
+			const std::unordered_set<crypto::key_image> wallet_kis = wallet_scan(w, txid, tx, wallet_found);
+
+			std::unordered_set<crypto::key_image> scanner_kis;
+			for(const tools::multi_account_scanner::matched_output &m : matches)
+				if(m.account_idx == w && m.tx_idx == tx_idx)
+					scanner_kis.insert(key_image(m));
+
+			EXPECT_EQ(!scanner_kis.empty(), wallet_found) << "wallet " << w << ", tx " << tx_idx;
+			EXPECT_EQ(scanner_kis, wallet_kis) << "wallet " << w << ", tx " << tx_idx;
+		}
+	}
+}
@@ -869,8 +869,10 @@ TEST(Serialization, portability_outputs)
 	/*
   fields of tools::wallet2::transfer_details to be checked: 
     uint64_t                        m_block_height
-    cryptonote::transaction_prefix  m_tx                        // TODO
     crypto::hash                    m_txid
+    uint64_t                        m_unlock_time               // TODO
+    crypto::public_key              m_out_key                   // TODO
+    crypto::public_key              m_tx_pub_key
     size_t                          m_internal_output_index
     uint64_t                        m_global_output_index
     bool                            m_spent
@@ -880,7 +882,6 @@ TEST(Serialization, portability_outputs)
     uint64_t                        m_amount
     bool                            m_rct
     bool                            m_key_image_known
-    size_t                          m_pk_index
   */
 	ASSERT_TRUE(outputs.size() == 3);
 	auto &td0 = outputs[0];
@@ -919,9 +920,9 @@ TEST(Serialization, portability_outputs)
 	ASSERT_TRUE(td0.m_key_image_known);
 	ASSERT_TRUE(td1.m_key_image_known);
 	ASSERT_TRUE(td2.m_key_image_known);
-	ASSERT_TRUE(td0.m_pk_index == 0);
-	ASSERT_TRUE(td1.m_pk_index == 0);
-	ASSERT_TRUE(td2.m_pk_index == 0);
+	ASSERT_TRUE(td0.m_tx_pub_key != crypto::null_pkey);
+	ASSERT_TRUE(td1.m_tx_pub_key != crypto::null_pkey);
+	ASSERT_TRUE(td2.m_tx_pub_key != crypto::null_pkey);
 }
 
 #define UNSIGNED_TX_PREFIX "Ryo unsigned tx set\003"
@@ -1068,9 +1069,9 @@ TEST(Serialization, portability_unsigned_tx)
 	ASSERT_TRUE(td0.m_key_image_known);
 	ASSERT_TRUE(td1.m_key_image_known);
 	ASSERT_TRUE(td2.m_key_image_known);
-	ASSERT_TRUE(td0.m_pk_index == 0);
-	ASSERT_TRUE(td1.m_pk_index == 0);
-	ASSERT_TRUE(td2.m_pk_index == 0);
+	ASSERT_TRUE(td0.m_tx_pub_key != crypto::null_pkey);
+	ASSERT_TRUE(td1.m_tx_pub_key != crypto::null_pkey);
+	ASSERT_TRUE(td2.m_tx_pub_key != crypto::null_pkey);
 }
 
 #define SIGNED_TX_PREFIX "Ryo signed tx set\003"
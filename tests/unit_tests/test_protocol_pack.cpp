@@ -53,3 +53,42 @@ TEST(protocol_pack, protocol_pack_command)
 		ASSERT_TRUE(r.total_height == 3);
 	}
 }
+
+TEST(protocol_pack, protocol_pack_objects_moves_blobs)
+{
+	cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+	r.current_blockchain_height = 42;
+	for(size_t i = 0; i < 3; ++i)
+	{
+		cryptonote::block_complete_entry bce;
+		bce.block = std::string(1000 + i, 'b');
+		bce.txs.push_back(std::string(500 + i, 't'));
+		r.blocks.push_back(bce);
+		r.txs.push_back(std::string(200 + i, 'x'));
+	}
+	std::string buff;
+	ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+
+	cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r2;
+	ASSERT_TRUE(epee::serialization::load_t_from_binary(r2, buff));
+	ASSERT_EQ(42, r2.current_blockchain_height);
+	ASSERT_EQ(r.txs, r2.txs);
+	ASSERT_EQ(r.blocks.size(), r2.blocks.size());
+	for(auto i = r.blocks.begin(), j = r2.blocks.begin(); i != r.blocks.end(); ++i, ++j)
+	{
+		ASSERT_EQ(i->block, j->block);
+		ASSERT_EQ(i->txs, j->txs);
+	}
+
+	// a storage in move mode hands its strings over, so a second read comes back empty
+	epee::serialization::portable_storage ps;
+	ASSERT_TRUE(ps.load_from_binary(buff));
+	ps.set_move_values(true);
+	cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r3, r4;
+	ASSERT_TRUE(r3.load(ps));
+	ASSERT_EQ(r.txs, r3.txs);
+	ASSERT_EQ(r.blocks.front().block, r3.blocks.front().block);
+	r4.load(ps);
+	ASSERT_TRUE(r4.blocks.front().block.empty());
+	ASSERT_TRUE(r4.txs.front().empty());
+}
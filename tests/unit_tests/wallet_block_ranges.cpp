@@ -0,0 +1,223 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+
+class wallet_block_ranges : public ::testing::Test
+{
+  protected:
+	typedef tools::wallet2::wallet_rpc_scan_data scan_data;
+	typedef std::unique_ptr<scan_data> scan_data_ptr;
+
+	wallet_block_ranges() : w(cryptonote::TESTNET), dl_ctx(refresh_ctx)
+	{
+		main_chain = make_chain(1000, 1000, crypto::null_hash);
+		dl_ctx.scan_thd_cnt = 1000; // never wait for a scanner
+		dl_ctx.dl_order = 0;
+		dl_ctx.top_height = 0;
+		dl_ctx.daemon_height = main_chain.size();
+		dl_ctx.last_range_size = 0;
+	}
+
+	// Blocks that only need to parse and link up by prev_id, the ones at fork_height and above get other hashes
+	static std::vector<cryptonote::blobdata> make_chain(size_t count, uint64_t fork_height, crypto::hash prev)
+	{
+		std::vector<cryptonote::blobdata> chain;
+		for(uint64_t h = 0; h < count; ++h)
+		{
+			cryptonote::block b = AUTO_VAL_INIT(b);
+			b.major_version = 1;
+			b.timestamp = h;
+			b.nonce = h < fork_height ? h : h + 1000000;
+			b.prev_id = prev;
+			b.miner_tx.version = 2;
+			b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+			chain.push_back(cryptonote::block_to_blob(b));
+			prev = cryptonote::get_block_hash(b);
+		}
+		return chain;
+	}
+
+	scan_data_ptr range(uint64_t start, size_t count, const std::vector<cryptonote::blobdata> &chain)
+	{
+		scan_data_ptr r(new scan_data);
+		r->blocks_start_height = start;
+		r->current_height = chain.size();
+		for(uint64_t h = start; h < start + count && h < chain.size(); ++h)
+		{
+			r->blocks_bin.emplace_back(chain[h], std::vector<cryptonote::blobdata>());
+			r->o_indices.emplace_back();
+		}
+		return r;
+	}
+
+	scan_data_ptr range(uint64_t start, size_t count) { return range(start, count, main_chain); }
+
+	void push(scan_data_ptr r) { w.push_block_range(dl_ctx, r); }
+	bool link(scan_data_ptr r) { return w.link_block_range(dl_ctx, r); }
+
+	bool link_ranges(uint64_t base_height, uint64_t stride, std::vector<scan_data_ptr> &ranges, size_t gap_size = 101)
+	{
+		return w.link_block_ranges(dl_ctx, base_height, stride, ranges, [&](uint64_t height) {
+			pulls.push_back(height);
+			return range(height, gap_size);
+		});
+	}
+
+	bool parallel_download() { return w.parallel_block_download(dl_ctx); }
+
+	uint64_t top_height() const { return dl_ctx.top_height; }
+
+	// first and last height of every range pushed to the scanners, each checked to start on the block before
+	std::vector<std::pair<uint64_t, uint64_t>> pushed()
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> res;
+		refresh_ctx.m_scan_in_queue.set_finish_flag();
+		scan_data_ptr r;
+		while(refresh_ctx.m_scan_in_queue.pop(r))
+		{
+			EXPECT_EQ(res.size(), r->dl_order);
+			if(!res.empty())
+				EXPECT_EQ(res.back().second, r->blocks_start_height);
+			for(size_t i = 0; i < r->blocks_bin.size(); ++i)
+				EXPECT_EQ(main_chain[r->blocks_start_height + i], r->blocks_bin[i].block);
+			EXPECT_EQ(r->blocks_bin.size(), r->o_indices.size());
+			res.emplace_back(r->blocks_start_height, r->blocks_start_height + r->blocks_bin.size() - 1);
+		}
+		return res;
+	}
+
+	tools::wallet2 w;
+	tools::wallet2::wallet_refresh_ctx refresh_ctx;
+	tools::wallet2::wallet_block_dl_ctx dl_ctx;
+	std::vector<cryptonote::blobdata> main_chain;
+	std::vector<uint64_t> pulls;
+};
+
+typedef std::vector<std::pair<uint64_t, uint64_t>> heights;
+
+TEST_F(wallet_block_ranges, links_in_order)
+{
+	push(range(0, 101));
+	std::vector<scan_data_ptr> ranges;
+	ranges.push_back(range(100, 101));
+	ranges.push_back(range(200, 101));
+	ranges.push_back(range(300, 101));
+	ASSERT_TRUE(link_ranges(100, 100, ranges));
+
+	EXPECT_TRUE(pulls.empty());
+	EXPECT_EQ(400, top_height());
+	EXPECT_EQ(heights({{0, 100}, {100, 200}, {200, 300}, {300, 400}}), pushed());
+}
+
+TEST_F(wallet_block_ranges, overlap_mismatch)
+{
+	push(range(0, 101));
+	const std::vector<cryptonote::blobdata> fork = make_chain(1000, 150, crypto::null_hash);
+	std::vector<scan_data_ptr> ranges;
+	ranges.push_back(range(100, 101));
+	ranges.push_back(range(200, 101, fork));
+	ranges.push_back(range(300, 101));
+	EXPECT_FALSE(link_ranges(100, 100, ranges));
+
+	// nothing past the block that doesn't link up is pushed, the sequential pull goes on from there
+	EXPECT_TRUE(pulls.empty());
+	EXPECT_EQ(200, top_height());
+	EXPECT_EQ(heights({{0, 100}, {100, 200}}), pushed());
+}
+
+TEST_F(wallet_block_ranges, fills_gap_after_short_range)
+{
+	push(range(0, 101));
+	std::vector<scan_data_ptr> ranges;
+	ranges.push_back(range(100, 51));
+	ranges.push_back(range(200, 101));
+	ASSERT_TRUE(link_ranges(100, 100, ranges, 30));
+
+	// 150 - 179 and 179 - 208 fill the gap, the second range only adds what is left
+	EXPECT_EQ(std::vector<uint64_t>({150, 179}), pulls);
+	EXPECT_EQ(300, top_height());
+	EXPECT_EQ(heights({{0, 100}, {100, 150}, {150, 179}, {179, 208}, {208, 300}}), pushed());
+}
+
+TEST_F(wallet_block_ranges, pulls_failed_range_again)
+{
+	push(range(0, 101));
+	std::vector<scan_data_ptr> ranges;
+	ranges.push_back(range(100, 101));
+	ranges.push_back(nullptr);
+	ranges.push_back(range(300, 101));
+	ASSERT_TRUE(link_ranges(100, 100, ranges));
+
+	EXPECT_EQ(std::vector<uint64_t>({200}), pulls);
+	EXPECT_EQ(heights({{0, 100}, {100, 200}, {200, 300}, {300, 400}}), pushed());
+}
+
+TEST_F(wallet_block_ranges, gap_without_progress)
+{
+	push(range(0, 101));
+	std::vector<scan_data_ptr> ranges;
+	ranges.push_back(range(100, 51));
+	ranges.push_back(range(200, 101));
+	// the daemon keeps answering with nothing new
+	EXPECT_FALSE(link_ranges(100, 100, ranges, 1));
+	EXPECT_EQ(std::vector<uint64_t>({150}), pulls);
+	EXPECT_EQ(heights({{0, 100}, {100, 150}}), pushed());
+}
+
+TEST_F(wallet_block_ranges, short_range_at_tip)
+{
+	push(range(0, 901));
+
+	// a range ending at or before the top adds nothing
+	EXPECT_TRUE(link(range(850, 51)));
+	EXPECT_TRUE(link(range(900, 1)));
+	// the tip is within reach of a single request, nothing is pulled in parallel
+	EXPECT_TRUE(parallel_download());
+	EXPECT_TRUE(dl_ctx.dl_clients.empty());
+
+	// the last blocks before the tip link up as a short range
+	EXPECT_TRUE(link(range(900, 100)));
+	EXPECT_EQ(999, top_height());
+	EXPECT_EQ(heights({{0, 900}, {900, 999}}), pushed());
+}
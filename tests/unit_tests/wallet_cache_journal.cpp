@@ -0,0 +1,154 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include <boost/filesystem.hpp>
+
+#include "crypto/crypto.h"
+#include "wallet/wallet2.h"
+
+namespace
+{
+crypto::hash make_hash(uint64_t n)
+{
+	crypto::hash h = crypto::null_hash;
+	memcpy(h.data, &n, sizeof(n));
+	h.data[31] = 0x5a;
+	return h;
+}
+
+tools::wallet2::transfer_details make_transfer(uint64_t height, crypto::public_key &pub, crypto::key_image &ki)
+{
+	crypto::secret_key sec;
+	crypto::generate_legacy_keys(pub, sec);
+	crypto::generate_key_image(pub, sec, ki);
+
+	tools::wallet2::transfer_details td = boost::value_initialized<tools::wallet2::transfer_details>();
+	td.m_block_height = height;
+	td.m_out_key = pub;
+	td.m_txid = make_hash(height + 1000);
+	td.m_key_image = ki;
+	td.m_key_image_known = true;
+	td.m_amount = 1000000;
+	return td;
+}
+}
+
+TEST(wallet_cache_journal, store_and_load)
+{
+	const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	ASSERT_TRUE(boost::filesystem::create_directories(dir));
+	const std::string file = (dir / "wallet").string();
+	const std::string journal = file + ".journal";
+	const epee::wipeable_string password("journal");
+
+	tools::wallet2 w(cryptonote::TESTNET);
+	w.generate_legacy(file, password, crypto::secret_key(), false);
+	ASSERT_FALSE(boost::filesystem::exists(journal));
+	const uint64_t cache_size = boost::filesystem::file_size(file);
+
+	// what a refresh would add: blocks, a received output and an incoming payment
+	for(uint64_t h = 1; h < 20; ++h)
+		w.m_blockchain.push_back(make_hash(h));
+	crypto::public_key pub;
+	crypto::key_image ki;
+	w.m_transfers.push_back(make_transfer(5, pub, ki));
+	w.m_key_images[ki] = 0;
+	w.m_pub_keys[pub] = 0;
+	tools::wallet2::payment_details pd = {w.m_transfers[0].m_txid, 1000000, 0, 5, 0, 0, {0, 0}};
+	w.m_payments.emplace(crypto::null_hash, pd);
+	w.set_attribute("journal", "appended");
+	w.store();
+
+	ASSERT_TRUE(boost::filesystem::exists(journal));
+	ASSERT_EQ(cache_size, boost::filesystem::file_size(file));
+
+	// the output gets spent a few blocks later, the record has to rewrite it
+	for(uint64_t h = 20; h < 25; ++h)
+		w.m_blockchain.push_back(make_hash(h));
+	w.m_transfers[0].m_spent = true;
+	w.m_transfers[0].m_spent_height = 22;
+	w.store();
+	ASSERT_EQ(cache_size, boost::filesystem::file_size(file));
+
+	{
+		tools::wallet2 w2(cryptonote::TESTNET);
+		w2.load(file, password);
+		ASSERT_EQ(25, w2.m_blockchain.size());
+		EXPECT_EQ(make_hash(24), w2.m_blockchain[24]);
+		ASSERT_EQ(1, w2.m_transfers.size());
+		EXPECT_TRUE(w2.m_transfers[0].m_spent);
+		EXPECT_EQ(22, w2.m_transfers[0].m_spent_height);
+		EXPECT_EQ(0, w2.m_key_images.at(ki));
+		EXPECT_EQ(0, w2.m_pub_keys.at(pub));
+		ASSERT_EQ(1, w2.m_payments.size());
+		EXPECT_EQ(pd.m_tx_hash, w2.m_payments.begin()->second.m_tx_hash);
+		EXPECT_EQ("appended", w2.get_attribute("journal"));
+	}
+
+	// a reorg below stored blocks rewrites the cache and drops the journal
+	w.detach_blockchain(21);
+	w.store();
+	ASSERT_FALSE(boost::filesystem::exists(journal));
+
+	{
+		tools::wallet2 w2(cryptonote::TESTNET);
+		w2.load(file, password);
+		ASSERT_EQ(21, w2.m_blockchain.size());
+		ASSERT_EQ(1, w2.m_transfers.size());
+		EXPECT_FALSE(w2.m_transfers[0].m_spent);
+		EXPECT_EQ("appended", w2.get_attribute("journal"));
+	}
+
+	// a torn record at the end is ignored and the next store rewrites the cache
+	w.m_blockchain.push_back(make_hash(21));
+	w.store();
+	ASSERT_TRUE(boost::filesystem::exists(journal));
+	ASSERT_TRUE(epee::file_io_utils::append_string_to_file(journal, std::string(7, '\x01')));
+	{
+		tools::wallet2 w2(cryptonote::TESTNET);
+		w2.load(file, password);
+		ASSERT_EQ(22, w2.m_blockchain.size());
+		w2.store();
+		ASSERT_FALSE(boost::filesystem::exists(journal));
+	}
+
+	boost::filesystem::remove_all(dir);
+}
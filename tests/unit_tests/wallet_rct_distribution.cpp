@@ -0,0 +1,179 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include <functional>
+
+#include "gtest/gtest.h"
+
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/hardfork.h"
+#include "wallet/wallet2.h"
+
+class wallet_rct_distribution : public ::testing::Test
+{
+  protected:
+	static constexpr uint64_t first_timestamp = 1500000000;
+	static constexpr uint64_t target = cryptonote::common_config::DIFFICULTY_TARGET;
+
+	wallet_rct_distribution() : w(cryptonote::TESTNET), hf(db, 1, 0)
+	{
+		db_path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		boost::filesystem::create_directories(db_path);
+		db.open(db_path.string(), MDB_NOSYNC);
+		hf.init();
+		db.set_hard_fork(&hf);
+	}
+
+	~wallet_rct_distribution()
+	{
+		db.close();
+		boost::filesystem::remove_all(db_path);
+	}
+
+	// Coinbase only blocks with one to three RingCT outputs each, interval gives the seconds since the previous block
+	void add_blocks(uint64_t count, const std::function<int64_t(uint64_t)> &interval)
+	{
+		for(uint64_t i = 0; i < count; ++i)
+		{
+			const uint64_t h = db.height();
+			cryptonote::block b = AUTO_VAL_INIT(b);
+			b.major_version = 1;
+			b.timestamp = h > 0 ? db.get_top_block_timestamp() + interval(h) : first_timestamp;
+			b.prev_id = h > 0 ? db.top_block_hash() : crypto::null_hash;
+			b.miner_tx.version = 2;
+			b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+			for(uint64_t o = 0; o < 1 + h % 3; ++o)
+				b.miner_tx.vout.push_back({1000, cryptonote::txout_to_key(crypto::rand<crypto::public_key>())});
+			b.miner_tx.rct_signatures.type = rct::RCTTypeNull;
+			db.add_block(b, 100, h + 1, 1000 * (h + 1), std::vector<cryptonote::transaction>());
+		}
+	}
+
+	// What the wallet caches from a cumulative get_output_distribution call and the block headers from timestamps_start
+	void load_distribution(uint64_t timestamps_start = 0)
+	{
+		uint64_t base;
+		std::vector<uint64_t> distribution;
+		ASSERT_TRUE(db.get_output_distribution(0, 0, 0, distribution, base));
+		distribution[0] += base;
+		for(size_t n = 1; n < distribution.size(); ++n)
+			distribution[n] += distribution[n - 1];
+		w.m_rct_distribution_start = 0;
+		w.m_rct_distribution = std::move(distribution);
+		w.m_rct_timestamps_start = timestamps_start;
+		w.m_rct_timestamps.clear();
+		for(uint64_t h = timestamps_start; h < db.height(); ++h)
+			w.m_rct_timestamps.push_back(db.get_block_timestamp(h));
+	}
+
+	// Compares the wallet's entry with the daemon's for cutoffs from just before the top block to before the chain
+	void check_histogram()
+	{
+		load_distribution();
+		const uint64_t height = db.height();
+		const uint64_t top_timestamp = db.get_top_block_timestamp();
+		for(uint64_t age : {(uint64_t)1, 50 * target, tools::wallet2::rct_recent_blocks * target, 3 * tools::wallet2::rct_recent_blocks * target})
+		{
+			const uint64_t cutoff = top_timestamp - age;
+			uint64_t unlocked, recent;
+			ASSERT_TRUE(w.get_rct_histogram_entry(cutoff, unlocked, recent));
+			const auto histogram = db.get_output_histogram({0}, true, cutoff, 0);
+			ASSERT_EQ(histogram.size(), 1);
+			EXPECT_EQ(unlocked, std::get<1>(histogram.at(0))) << "height " << height << ", cutoff " << cutoff;
+			EXPECT_EQ(recent, std::get<2>(histogram.at(0))) << "height " << height << ", cutoff " << cutoff;
+		}
+	}
+
+	bool get_rct_histogram_entry(uint64_t cutoff, uint64_t &unlocked, uint64_t &recent, uint64_t *stop_height)
+	{
+		return w.get_rct_histogram_entry(cutoff, unlocked, recent, stop_height);
+	}
+
+	void check_heights(const std::function<int64_t(uint64_t)> &interval)
+	{
+		const uint64_t recent_blocks = tools::wallet2::rct_recent_blocks;
+		const std::vector<uint64_t> heights = {1, CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE + 1, 100,
+			recent_blocks, recent_blocks + 1, recent_blocks + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE + 1, recent_blocks + 50, 3 * recent_blocks};
+		for(uint64_t height : heights)
+		{
+			add_blocks(height - db.height(), interval);
+			check_histogram();
+		}
+	}
+
+	tools::wallet2 w;
+	cryptonote::BlockchainLMDB db;
+	cryptonote::HardFork hf;
+	boost::filesystem::path db_path;
+};
+
+TEST_F(wallet_rct_distribution, histogram_matches_daemon)
+{
+	check_heights([](uint64_t) { return target; });
+}
+
+TEST_F(wallet_rct_distribution, histogram_matches_daemon_with_uneven_blocks)
+{
+	// stretches of slow and fast blocks, and every seventh block timestamped before its parent
+	check_heights([](uint64_t h) -> int64_t {
+		if(h % 7 == 0)
+			return -(int64_t)target / 2;
+		return (h / 100) % 2 ? target * 3 : target / 4;
+	});
+}
+
+TEST_F(wallet_rct_distribution, needs_older_timestamps)
+{
+	add_blocks(3 * tools::wallet2::rct_recent_blocks, [](uint64_t) { return target; });
+	const uint64_t cutoff = db.get_top_block_timestamp() - tools::wallet2::rct_recent_blocks * target;
+	const uint64_t cutoff_height = db.height() - 1 - tools::wallet2::rct_recent_blocks;
+
+	// the cached timestamps start above the block that ends the count
+	load_distribution(cutoff_height + 1);
+	uint64_t unlocked, recent, stop_height;
+	EXPECT_FALSE(get_rct_histogram_entry(cutoff, unlocked, recent, &stop_height));
+
+	load_distribution(cutoff_height - 1);
+	ASSERT_TRUE(get_rct_histogram_entry(cutoff, unlocked, recent, &stop_height));
+	EXPECT_EQ(stop_height, cutoff_height - 1);
+	EXPECT_EQ(recent, std::get<2>(db.get_output_histogram({0}, true, cutoff, 0).at(0)));
+}
@@ -0,0 +1,275 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "ringct/rctOps.h"
+#include "rpc/core_rpc_server.h"
+#include "wallet/wallet2.h"
+
+class wallet_scan_digest : public ::testing::Test
+{
+  protected:
+	typedef tools::wallet2::wallet_rpc_scan_data scan_data;
+	typedef std::unique_ptr<scan_data> scan_data_ptr;
+
+	struct block_counter : public tools::i_wallet2_callback
+	{
+		void on_new_block(uint64_t height, const cryptonote::block &block) { ++blocks; }
+		size_t blocks = 0;
+	};
+
+	wallet_scan_digest() : w(cryptonote::TESTNET)
+	{
+		cryptonote::account_base acc;
+		acc.generate_new(0);
+		const cryptonote::account_keys &keys = acc.get_keys();
+		w.generate("", "", keys.m_account_address, keys.m_spend_secret_key, keys.m_view_secret_key);
+		w.expand_subaddresses({0, 3});
+		w.m_explicit_refresh_from_block_height = true;
+		w.m_refresh_from_block_height = 0;
+		w.callback(&counter);
+		outsider.generate_new(0);
+		spent_ki = crypto::rand<crypto::key_image>();
+		make_chain();
+
+		w.m_blockchain.clear();
+		w.m_blockchain.push_back(cryptonote::get_block_hash(blocks[0]));
+		w.m_local_bc_height = 1;
+	}
+
+	cryptonote::transaction make_tx(const std::vector<std::pair<cryptonote::account_public_address, bool>> &dsts, const std::vector<crypto::key_image> &spends)
+	{
+		hw::device &hwdev = hw::get_device("default");
+		const cryptonote::keypair tx_key = cryptonote::keypair::generate(hwdev);
+		const bool need_additional_txkeys = dsts.size() > 1;
+
+		cryptonote::transaction tx;
+		tx.version = 2;
+		tx.rct_signatures.type = spends.empty() ? rct::RCTTypeNull : rct::RCTTypeBulletproof;
+		for(const crypto::key_image &ki : spends)
+			tx.vin.push_back(cryptonote::txin_to_key{0, {1, 2, 3}, ki});
+		cryptonote::add_tx_pub_key_to_extra(tx, tx_key.pub);
+
+		std::vector<crypto::public_key> additional_tx_pub_keys;
+		for(size_t i = 0; i < dsts.size(); ++i)
+		{
+			crypto::secret_key derivation_key = tx_key.sec;
+			if(need_additional_txkeys)
+			{
+				const cryptonote::keypair additional_key = cryptonote::keypair::generate(hwdev);
+				if(dsts[i].second)
+				{
+					additional_tx_pub_keys.push_back(rct::rct2pk(rct::scalarmultKey(rct::pk2rct(dsts[i].first.m_spend_public_key), rct::sk2rct(additional_key.sec))));
+					derivation_key = additional_key.sec;
+				}
+				else
+				{
+					additional_tx_pub_keys.push_back(additional_key.pub);
+				}
+			}
+
+			crypto::key_derivation derivation;
+			crypto::public_key out_key;
+			EXPECT_TRUE(crypto::generate_key_derivation(dsts[i].first.m_view_public_key, derivation_key, derivation));
+			EXPECT_TRUE(crypto::derive_public_key(derivation, i, dsts[i].first.m_spend_public_key, out_key));
+			tx.vout.push_back({0, cryptonote::txout_to_key(out_key)});
+		}
+		if(need_additional_txkeys)
+			cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional_tx_pub_keys);
+		if(!spends.empty())
+		{
+			tx.rct_signatures.ecdhInfo.resize(tx.vout.size());
+			tx.rct_signatures.outPk.resize(tx.vout.size());
+		}
+		return tx;
+	}
+
+	// Block 0 has nothing for us, the others carry a mix of txs that pay us, pay a subaddress
+	// next to a stranger, spend spent_ki and have nothing to do with us. The txs are kept
+	// pruned, the way getblocks.bin sends them, and the fake signatures leave them without a real hash.
+	void make_chain()
+	{
+		const std::pair<cryptonote::account_public_address, bool> ours = {w.get_address(), false};
+		const std::pair<cryptonote::account_public_address, bool> sub = {w.get_subaddress({0, 2}), true};
+		const std::pair<cryptonote::account_public_address, bool> other = {outsider.get_keys().m_account_address, false};
+
+		crypto::hash prev = crypto::null_hash;
+		for(uint64_t h = 0; h < 6; ++h)
+		{
+			std::vector<cryptonote::transaction> txs;
+			std::vector<cryptonote::blobdata> tx_blobs;
+			cryptonote::block b = AUTO_VAL_INIT(b);
+			b.major_version = 1;
+			b.timestamp = h;
+			b.prev_id = prev;
+			b.miner_tx = make_tx({h == 3 ? ours : other}, {});
+			b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+			if(h == 1)
+				txs.push_back(make_tx({other, ours}, {crypto::rand<crypto::key_image>()}));
+			if(h == 2)
+			{
+				txs.push_back(make_tx({other}, {crypto::rand<crypto::key_image>()}));
+				txs.push_back(make_tx({other, sub, other}, {crypto::rand<crypto::key_image>()}));
+			}
+			if(h == 4)
+				txs.push_back(make_tx({other, other}, {spent_ki}));
+			if(h == 5)
+				txs.push_back(make_tx({ours, sub}, {crypto::rand<crypto::key_image>()}));
+			for(cryptonote::transaction &tx : txs)
+			{
+				tx_blobs.push_back(cryptonote::get_pruned_tx_blob(tx));
+				b.tx_hashes.push_back(crypto::cn_fast_hash(tx_blobs.back().data(), tx_blobs.back().size()));
+			}
+			prev = cryptonote::get_block_hash(b);
+			blocks.push_back(b);
+			block_txs.push_back(std::move(tx_blobs));
+		}
+	}
+
+	// What getblocks.bin sends from the start of the chain, with or without digests
+	scan_data_ptr range(bool digests)
+	{
+		scan_data_ptr r(new scan_data);
+		r->dl_order = 0;
+		r->blocks_start_height = 0;
+		r->current_height = blocks.size();
+		for(size_t i = 0; i < blocks.size(); ++i)
+		{
+			std::vector<cryptonote::blobdata> txs(block_txs[i]);
+
+			r->o_indices.emplace_back();
+			r->o_indices.back().indices.resize(txs.size() + 1);
+			if(digests)
+			{
+				r->tx_digests.emplace_back(txs.size());
+				for(size_t j = 0; j < txs.size(); ++j)
+					EXPECT_TRUE(cryptonote::core_rpc_server::make_tx_scan_digest(txs[j], r->tx_digests.back()[j]));
+				txs.clear();
+			}
+			r->blocks_bin.emplace_back(cryptonote::block_to_blob(blocks[i]), std::move(txs));
+		}
+		return r;
+	}
+
+	scan_data_ptr scan(scan_data_ptr r)
+	{
+		tools::wallet2::wallet_refresh_ctx refresh_ctx;
+		tools::wallet2::wallet_scan_ctx scan_ctx(w, refresh_ctx);
+		refresh_ctx.m_running_scan_thd_cnt = 1;
+		refresh_ctx.m_scan_in_queue.push(std::move(r));
+		refresh_ctx.m_scan_in_queue.set_finish_flag();
+		w.block_scan_thd(scan_ctx);
+		EXPECT_FALSE(refresh_ctx.m_scan_error);
+		EXPECT_TRUE(refresh_ctx.m_scan_out_queue.pop(r));
+		return r;
+	}
+
+	void integrate(scan_data_ptr &r) { w.integrate_scanned_result(r); }
+
+	// as if an earlier refresh had integrated the whole chain
+	void add_known_blocks()
+	{
+		for(size_t i = w.m_blockchain.size(); i < blocks.size(); ++i)
+			w.m_blockchain.push_back(cryptonote::get_block_hash(blocks[i]));
+		w.m_local_bc_height = blocks.size();
+	}
+
+	size_t blockchain_size() const { return w.m_blockchain.size(); }
+	uint64_t local_height() const { return w.m_local_bc_height; }
+	size_t transfer_count() const { return w.m_transfers.size(); }
+
+	static std::vector<std::pair<size_t, size_t>> found(const scan_data &r)
+	{
+		std::vector<std::pair<size_t, size_t>> res;
+		for(const auto &i : r.indices_found)
+			res.emplace_back(i.block_idx, i.tx_idx);
+		return res;
+	}
+
+	tools::wallet2 w;
+	block_counter counter;
+	cryptonote::account_base outsider;
+	crypto::key_image spent_ki;
+	std::vector<cryptonote::block> blocks;
+	std::vector<std::vector<cryptonote::blobdata>> block_txs;
+};
+
+TEST_F(wallet_scan_digest, finds_what_full_txs_find)
+{
+	const scan_data_ptr full = scan(range(false));
+	const scan_data_ptr digest = scan(range(true));
+
+	const std::vector<std::pair<size_t, size_t>> expected = {{1, 1}, {2, 2}, {3, 0}, {5, 1}};
+	EXPECT_EQ(expected, found(*full));
+	EXPECT_EQ(expected, found(*digest));
+	EXPECT_EQ(5, full->incoming_kimg.size());
+	EXPECT_EQ(full->incoming_kimg, digest->incoming_kimg);
+	EXPECT_FALSE(full->key_images.not_present(&spent_ki, sizeof(spent_ki)));
+	EXPECT_FALSE(digest->key_images.not_present(&spent_ki, sizeof(spent_ki)));
+}
+
+TEST_F(wallet_scan_digest, failed_fetch_commits_nothing)
+{
+	// nothing listens there, so the matched blocks can't be downloaded
+	ASSERT_TRUE(w.init("http://127.0.0.1:1"));
+	scan_data_ptr digest = scan(range(true));
+	ASSERT_FALSE(digest->indices_found.empty());
+
+	EXPECT_THROW(integrate(digest), tools::error::no_connection_to_daemon);
+	EXPECT_EQ(1, blockchain_size());
+	EXPECT_EQ(1, local_height());
+	EXPECT_EQ(0, counter.blocks);
+	EXPECT_EQ(0, transfer_count());
+}
+
+TEST_F(wallet_scan_digest, known_blocks_are_not_fetched)
+{
+	ASSERT_TRUE(w.init("http://127.0.0.1:1"));
+	add_known_blocks();
+
+	// every match is in a block the wallet has, so the daemon is never asked
+	scan_data_ptr digest = scan(range(true));
+	integrate(digest);
+	EXPECT_EQ(blocks.size(), blockchain_size());
+	EXPECT_EQ(0, counter.blocks);
+}
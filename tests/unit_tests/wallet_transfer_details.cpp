@@ -0,0 +1,242 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include <sstream>
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+
+namespace
+{
+// transfer_details as it was stored up to version 9, with the whole tx prefix
+struct legacy_transfer_details
+{
+	uint64_t m_block_height;
+	cryptonote::transaction_prefix m_tx;
+	crypto::hash m_txid;
+	size_t m_internal_output_index;
+	uint64_t m_global_output_index;
+	bool m_spent;
+	uint64_t m_spent_height;
+	crypto::key_image m_key_image;
+	rct::key m_mask;
+	uint64_t m_amount;
+	bool m_rct;
+	bool m_key_image_known;
+	size_t m_pk_index;
+	cryptonote::subaddress_index m_subaddr_index;
+	bool m_key_image_partial;
+	std::vector<rct::key> m_multisig_k;
+	std::vector<tools::wallet2::multisig_info> m_multisig_info;
+};
+
+crypto::public_key make_pub_key()
+{
+	crypto::public_key pub;
+	crypto::secret_key sec;
+	crypto::generate_legacy_keys(pub, sec);
+	return pub;
+}
+
+crypto::key_image make_key_image()
+{
+	crypto::key_image ki;
+	crypto::secret_key sec;
+	crypto::generate_key_image(make_pub_key(), sec, ki);
+	return ki;
+}
+
+legacy_transfer_details make_legacy_transfer(size_t out_index, bool additional_keys)
+{
+	legacy_transfer_details td = boost::value_initialized<legacy_transfer_details>();
+	td.m_block_height = 1234;
+	td.m_tx.version = 2;
+	td.m_tx.unlock_time = 1300;
+	for(size_t i = 0; i < 2; ++i)
+	{
+		cryptonote::txin_to_key in;
+		in.amount = 0;
+		in.key_offsets = {10, 20, 30};
+		in.k_image = make_key_image();
+		td.m_tx.vin.push_back(in);
+	}
+	std::vector<crypto::public_key> additional_tx_pub_keys;
+	for(size_t i = 0; i < 3; ++i)
+	{
+		cryptonote::tx_out out;
+		out.amount = 0;
+		out.target = cryptonote::txout_to_key(make_pub_key());
+		td.m_tx.vout.push_back(out);
+		additional_tx_pub_keys.push_back(make_pub_key());
+	}
+	cryptonote::add_tx_pub_key_to_extra(td.m_tx, make_pub_key());
+	if(additional_keys)
+		cryptonote::add_additional_tx_pub_keys_to_extra(td.m_tx.extra, additional_tx_pub_keys);
+	td.m_txid = crypto::cn_fast_hash(td.m_tx.extra.data(), td.m_tx.extra.size());
+	td.m_internal_output_index = out_index;
+	td.m_global_output_index = 98765;
+	td.m_spent = true;
+	td.m_spent_height = 1300;
+	td.m_key_image = make_key_image();
+	td.m_mask = rct::skGen();
+	td.m_amount = 4000000000;
+	td.m_rct = true;
+	td.m_key_image_known = true;
+	td.m_subaddr_index = {1, 2};
+	return td;
+}
+}
+
+BOOST_CLASS_VERSION(legacy_transfer_details, 9)
+
+namespace boost
+{
+namespace serialization
+{
+template <class Archive>
+inline void serialize(Archive &a, legacy_transfer_details &x, const boost::serialization::version_type ver)
+{
+	a &x.m_block_height;
+	a &x.m_global_output_index;
+	a &x.m_internal_output_index;
+	a &x.m_tx;
+	a &x.m_spent;
+	a &x.m_key_image;
+	a &x.m_mask;
+	a &x.m_amount;
+	a &x.m_spent_height;
+	a &x.m_txid;
+	a &x.m_rct;
+	a &x.m_key_image_known;
+	a &x.m_pk_index;
+	a &x.m_subaddr_index;
+	a &x.m_multisig_info;
+	a &x.m_multisig_k;
+	a &x.m_key_image_partial;
+}
+}
+}
+
+TEST(wallet_transfer_details, load_legacy)
+{
+	std::vector<legacy_transfer_details> legacy;
+	legacy.push_back(make_legacy_transfer(0, false));
+	legacy.push_back(make_legacy_transfer(2, true));
+
+	std::stringstream ss;
+	{
+		boost::archive::portable_binary_oarchive ar(ss);
+		ar << legacy;
+	}
+	std::vector<tools::wallet2::transfer_details> transfers;
+	{
+		boost::archive::portable_binary_iarchive ar(ss);
+		ar >> transfers;
+	}
+
+	ASSERT_EQ(legacy.size(), transfers.size());
+	for(size_t i = 0; i < legacy.size(); ++i)
+	{
+		const legacy_transfer_details &l = legacy[i];
+		const tools::wallet2::transfer_details &td = transfers[i];
+		ASSERT_EQ(l.m_block_height, td.m_block_height);
+		ASSERT_EQ(l.m_txid, td.m_txid);
+		ASSERT_EQ(l.m_tx.unlock_time, td.m_unlock_time);
+		ASSERT_EQ(boost::get<cryptonote::txout_to_key>(l.m_tx.vout[l.m_internal_output_index].target).key, td.get_public_key());
+		ASSERT_EQ(cryptonote::get_tx_pub_key_from_extra(l.m_tx), td.m_tx_pub_key);
+		ASSERT_EQ(2, td.m_input_key_images.size());
+		ASSERT_EQ(boost::get<cryptonote::txin_to_key>(l.m_tx.vin[0]).k_image, td.m_input_key_images[0]);
+		ASSERT_EQ(boost::get<cryptonote::txin_to_key>(l.m_tx.vin[1]).k_image, td.m_input_key_images[1]);
+		ASSERT_EQ(cryptonote::get_object_blobsize(l.m_tx), td.m_tx_size);
+		ASSERT_EQ(l.m_internal_output_index, td.m_internal_output_index);
+		ASSERT_EQ(l.m_global_output_index, td.m_global_output_index);
+		ASSERT_EQ(l.m_spent, td.m_spent);
+		ASSERT_EQ(l.m_spent_height, td.m_spent_height);
+		ASSERT_EQ(l.m_key_image, td.m_key_image);
+		ASSERT_EQ(l.m_mask, td.m_mask);
+		ASSERT_EQ(l.m_amount, td.m_amount);
+		ASSERT_EQ(l.m_rct, td.m_rct);
+		ASSERT_EQ(l.m_key_image_known, td.m_key_image_known);
+		ASSERT_EQ(l.m_subaddr_index, td.m_subaddr_index);
+	}
+
+	ASSERT_TRUE(transfers[0].get_additional_tx_pub_keys().empty());
+	const std::vector<crypto::public_key> legacy_additional = cryptonote::get_additional_tx_pub_keys_from_extra(legacy[1].m_tx);
+	const std::vector<crypto::public_key> additional = transfers[1].get_additional_tx_pub_keys();
+	ASSERT_EQ(3, additional.size());
+	ASSERT_EQ(legacy_additional[2], additional[2]);
+}
+
+TEST(wallet_transfer_details, round_trip)
+{
+	const legacy_transfer_details l = make_legacy_transfer(1, true);
+	tools::wallet2::transfer_details td = boost::value_initialized<tools::wallet2::transfer_details>();
+	td.m_block_height = l.m_block_height;
+	td.m_txid = l.m_txid;
+	td.m_internal_output_index = l.m_internal_output_index;
+	td.set_tx(l.m_tx);
+	td.m_amount = l.m_amount;
+	td.m_mask = l.m_mask;
+	td.m_multisig_k.push_back(rct::skGen());
+
+	std::stringstream ss;
+	{
+		boost::archive::portable_binary_oarchive ar(ss);
+		ar << td;
+	}
+	tools::wallet2::transfer_details loaded;
+	{
+		boost::archive::portable_binary_iarchive ar(ss);
+		ar >> loaded;
+	}
+
+	ASSERT_EQ(td.m_txid, loaded.m_txid);
+	ASSERT_EQ(td.m_unlock_time, loaded.m_unlock_time);
+	ASSERT_EQ(td.get_public_key(), loaded.get_public_key());
+	ASSERT_EQ(td.m_tx_pub_key, loaded.m_tx_pub_key);
+	ASSERT_EQ(td.m_additional_tx_pub_key, loaded.m_additional_tx_pub_key);
+	ASSERT_TRUE(td.m_input_key_images == loaded.m_input_key_images);
+	ASSERT_EQ(td.m_tx_size, loaded.m_tx_size);
+	ASSERT_EQ(td.m_amount, loaded.m_amount);
+	ASSERT_EQ(td.m_mask, loaded.m_mask);
+	ASSERT_EQ(1, loaded.m_multisig_k.size());
+	ASSERT_EQ(td.m_multisig_k[0], loaded.m_multisig_k[0]);
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+
+namespace
+{
+crypto::hash make_txid(uint64_t n)
+{
+	crypto::hash h = crypto::null_hash;
+	memcpy(h.data, &n, sizeof(n));
+	return h;
+}
+
+// Two payments per block from 101 to 200, the odd one to account 1
+tools::wallet2::payment_container make_payments()
+{
+	tools::wallet2::payment_container payments;
+	for(uint64_t height = 101; height <= 200; ++height)
+	{
+		for(uint32_t i = 0; i < 2; ++i)
+		{
+			tools::wallet2::payment_details pd = AUTO_VAL_INIT(pd);
+			pd.m_tx_hash = make_txid(height * 2 + i);
+			pd.m_amount = height;
+			pd.m_block_height = height;
+			pd.m_subaddr_index = {i, i + 1};
+			payments.emplace(make_txid(i), pd);
+		}
+	}
+	return payments;
+}
+}
+
+TEST(wallet_transfer_index, payments_by_height)
+{
+	tools::wallet2 w;
+	w.import_payments(make_payments());
+
+	std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
+	w.get_payments(payments, 190);
+	ASSERT_EQ(20, payments.size());
+	uint64_t height = 191;
+	for(auto it = payments.begin(); it != payments.end(); ++it, ++height)
+	{
+		ASSERT_EQ(height, it->second.m_block_height);
+		ASSERT_EQ(height, (++it)->second.m_block_height);
+	}
+
+	payments.clear();
+	w.get_payments(payments, 150, 160, 1);
+	ASSERT_EQ(10, payments.size());
+	for(const auto &p : payments)
+		ASSERT_EQ(1, p.second.m_subaddr_index.major);
+
+	payments.clear();
+	w.get_payments(payments, 0, (uint64_t)-1, 0, {2});
+	ASSERT_TRUE(payments.empty());
+	w.get_payments(payments, 0, (uint64_t)-1, 5);
+	ASSERT_TRUE(payments.empty());
+}
+
+TEST(wallet_transfer_index, payments_paging)
+{
+	tools::wallet2 w;
+	w.import_payments(make_payments());
+
+	std::vector<tools::wallet2::payment_details> all;
+	boost::optional<tools::wallet2::transfer_position> cursor;
+	for(size_t pages = 0;; ++pages)
+	{
+		ASSERT_LT(pages, 100);
+		std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
+		w.get_payments(payments, 120, 180, boost::none, {}, cursor, 7);
+		if(payments.empty())
+			break;
+		ASSERT_LE(payments.size(), 7);
+		for(const auto &p : payments)
+			all.push_back(p.second);
+		cursor = tools::wallet2::transfer_position{all.back().m_block_height, all.back().m_tx_hash};
+	}
+
+	ASSERT_EQ(120, all.size());
+	for(size_t i = 1; i < all.size(); ++i)
+	{
+		const tools::wallet2::transfer_position a = {all[i - 1].m_block_height, all[i - 1].m_tx_hash};
+		const tools::wallet2::transfer_position b = {all[i].m_block_height, all[i].m_tx_hash};
+		ASSERT_TRUE(a < b);
+	}
+	ASSERT_EQ(121, all.front().m_block_height);
+	ASSERT_EQ(180, all.back().m_block_height);
+}
+
+TEST(wallet_transfer_index, payments_has_more)
+{
+	tools::wallet2 w;
+	w.import_payments(make_payments());
+
+	// 120 payments in pages of 10, the last page is exactly full
+	boost::optional<tools::wallet2::transfer_position> cursor;
+	for(size_t page = 0; page < 12; ++page)
+	{
+		std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
+		ASSERT_EQ(page < 11, w.get_payments(payments, 120, 180, boost::none, {}, cursor, 10));
+		ASSERT_EQ(10, payments.size());
+		cursor = tools::wallet2::transfer_position{payments.back().second.m_block_height, payments.back().second.m_tx_hash};
+	}
+
+	// payments past the page that the filter drops are not more
+	std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
+	ASSERT_FALSE(w.get_payments(payments, 0, (uint64_t)-1, boost::none, {1}, boost::none, 100));
+	ASSERT_EQ(100, payments.size());
+	payments.clear();
+	ASSERT_TRUE(w.get_payments(payments, 0, (uint64_t)-1, boost::none, {1}, boost::none, 99));
+	ASSERT_FALSE(w.get_payments(payments, 0, (uint64_t)-1, boost::none, {1}));
+}
+
+TEST(wallet_transfer_index, payments_out)
+{
+	tools::wallet2 w;
+	std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> confirmed;
+	for(uint64_t height = 1; height <= 50; ++height)
+	{
+		tools::wallet2::confirmed_transfer_details ctd;
+		ctd.m_block_height = height;
+		ctd.m_subaddr_account = height % 2;
+		ctd.m_subaddr_indices = {(uint32_t)height % 3};
+		confirmed.emplace_back(make_txid(height), ctd);
+	}
+	w.import_payments_out(confirmed);
+
+	std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> out;
+	w.get_payments_out(out, 40, 45);
+	ASSERT_EQ(5, out.size());
+	ASSERT_EQ(41, out.front().second.m_block_height);
+	ASSERT_EQ(45, out.back().second.m_block_height);
+
+	out.clear();
+	w.get_payments_out(out, 0, (uint64_t)-1, 1, {0});
+	for(const auto &o : out)
+	{
+		ASSERT_EQ(1, o.second.m_subaddr_account);
+		ASSERT_EQ(0, o.second.m_block_height % 3);
+	}
+	ASSERT_EQ(8, out.size());
+
+	out.clear();
+	ASSERT_TRUE(w.get_payments_out(out, 0, (uint64_t)-1, boost::none, {}, tools::wallet2::transfer_position{48, make_txid(48)}, 1));
+	ASSERT_EQ(1, out.size());
+	ASSERT_EQ(make_txid(49), out.front().first);
+	out.clear();
+	ASSERT_FALSE(w.get_payments_out(out, 0, (uint64_t)-1, boost::none, {}, tools::wallet2::transfer_position{48, make_txid(48)}, 2));
+	ASSERT_EQ(2, out.size());
+}
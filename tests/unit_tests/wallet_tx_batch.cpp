@@ -0,0 +1,336 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "net/http_server_impl_base.h"
+#include "ringct/rctOps.h"
+#include "ringct/rctSigs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "wallet/wallet2.h"
+
+// the epee handler map macros expect it
+using namespace epee;
+
+namespace
+{
+// Serves what the wallet asks a daemon for while it builds transactions, from a chain of
+// two RingCT outputs per block where every fork is already active
+class mock_daemon : public epee::http_server_impl_base<mock_daemon>
+{
+  public:
+	typedef epee::net_utils::connection_context_base connection_context;
+
+	static constexpr uint64_t height = 1000;
+
+	mock_daemon()
+	{
+		for(uint64_t i = 0; i < height * 2; ++i)
+			outputs.emplace_back(rct::rct2pk(rct::pkGen()), rct::commit(crypto::rand<uint32_t>(), rct::skGen()), true, i / 2, crypto::rand<crypto::hash>());
+	}
+
+	CHAIN_HTTP_TO_MAP2(connection_context);
+
+	BEGIN_URI_MAP2()
+	MAP_URI_AUTO_JON2("/getheight", on_get_height, cryptonote::COMMAND_RPC_GET_HEIGHT)
+	MAP_URI_AUTO_BIN2("/get_outs.bin", on_get_outs_bin, cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN)
+	BEGIN_JSON_RPC_MAP("/json_rpc")
+	MAP_JON_RPC_WE("hard_fork_info", on_hard_fork_info, cryptonote::COMMAND_RPC_HARD_FORK_INFO)
+	MAP_JON_RPC_WE("get_version", on_get_version, cryptonote::COMMAND_RPC_GET_VERSION)
+	MAP_JON_RPC_WE("get_output_distribution", on_get_output_distribution, cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
+	MAP_JON_RPC_WE("getblockheadersrange", on_get_block_headers_range, cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE)
+	END_JSON_RPC_MAP()
+	END_URI_MAP2()
+
+	bool on_get_height(const cryptonote::COMMAND_RPC_GET_HEIGHT::request &req, cryptonote::COMMAND_RPC_GET_HEIGHT::response &res)
+	{
+		res.height = height;
+		res.status = CORE_RPC_STATUS_OK;
+		return true;
+	}
+
+	bool on_get_outs_bin(const cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request &req, cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::response &res)
+	{
+		for(const cryptonote::get_outputs_out &o : req.outputs)
+		{
+			if(o.amount != 0 || o.index >= outputs.size())
+				return false;
+			res.outs.push_back(outputs[o.index]);
+			res.outs.back().unlocked = res.outs.back().height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= height;
+		}
+		res.status = CORE_RPC_STATUS_OK;
+		return true;
+	}
+
+	bool on_hard_fork_info(const cryptonote::COMMAND_RPC_HARD_FORK_INFO::request &req, cryptonote::COMMAND_RPC_HARD_FORK_INFO::response &res, epee::json_rpc::error &er)
+	{
+		res.version = req.version;
+		res.enabled = true;
+		res.earliest_height = 100;
+		res.status = CORE_RPC_STATUS_OK;
+		return true;
+	}
+
+	bool on_get_version(const cryptonote::COMMAND_RPC_GET_VERSION::request &req, cryptonote::COMMAND_RPC_GET_VERSION::response &res, epee::json_rpc::error &er)
+	{
+		res.version = CORE_RPC_VERSION;
+		res.status = CORE_RPC_STATUS_OK;
+		return true;
+	}
+
+	bool on_get_output_distribution(const cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request &req, cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response &res, epee::json_rpc::error &er)
+	{
+		if(req.amounts.size() != 1 || req.amounts[0] != 0 || !req.cumulative || req.from_height >= height)
+			return false;
+		res.distributions.push_back({0, req.from_height, {}, req.from_height * 2});
+		for(uint64_t h = req.from_height; h < height; ++h)
+			res.distributions.back().distribution.push_back((h + 1) * 2);
+		res.status = CORE_RPC_STATUS_OK;
+		return true;
+	}
+
+	// blocks came at the target interval, the last one just now
+	bool on_get_block_headers_range(const cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request &req, cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response &res, epee::json_rpc::error &er)
+	{
+		if(req.start_height > req.end_height || req.end_height >= height)
+			return false;
+		const uint64_t now = time(NULL);
+		for(uint64_t h = req.start_height; h <= req.end_height; ++h)
+		{
+			res.headers.push_back(AUTO_VAL_INIT(cryptonote::block_header_response()));
+			res.headers.back().height = h;
+			res.headers.back().timestamp = now - (height - 1 - h) * cryptonote::common_config::DIFFICULTY_TARGET;
+		}
+		res.status = CORE_RPC_STATUS_OK;
+		return true;
+	}
+
+	std::vector<cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey> outputs;
+};
+}
+
+class wallet_tx_batch : public ::testing::Test
+{
+  protected:
+	wallet_tx_batch() : w(cryptonote::TESTNET)
+	{
+		cryptonote::account_base acc;
+		acc.generate_new(0);
+		const cryptonote::account_keys &keys = acc.get_keys();
+		w.generate("", "", keys.m_account_address, keys.m_spend_secret_key, keys.m_view_secret_key);
+		EXPECT_TRUE(daemon.init([](size_t len, uint8_t *ptr) { crypto::rand(len, ptr); }, "0", "127.0.0.1"));
+		EXPECT_TRUE(daemon.run(1, false));
+		w.init("http://127.0.0.1:" + std::to_string(daemon.get_binded_port()));
+		w.m_local_bc_height = mock_daemon::height;
+	}
+
+	~wallet_tx_batch()
+	{
+		daemon.send_stop_signal();
+		daemon.timed_wait_server_stop(5000);
+		daemon.deinit();
+	}
+
+	// An output of ours at a global index of the daemon's chain, received on a subaddress of the first account
+	void add_output(uint64_t global_index, uint64_t amount, uint32_t minor = 0)
+	{
+		hw::device &hwdev = hw::get_device("default");
+		const cryptonote::account_keys &keys = w.get_account().get_keys();
+		const cryptonote::subaddress_index subaddr_index = {0, minor};
+		const crypto::public_key spend_public_key = w.get_subaddress(subaddr_index).m_spend_public_key;
+		const cryptonote::keypair tx_key = cryptonote::keypair::generate(hwdev);
+		crypto::key_derivation derivation;
+		ASSERT_TRUE(crypto::generate_key_derivation(keys.m_account_address.m_view_public_key, tx_key.sec, derivation));
+
+		tools::wallet2::transfer_details td = AUTO_VAL_INIT(td);
+		td.m_block_height = global_index / 2;
+		td.m_txid = crypto::rand<crypto::hash>();
+		td.m_tx_pub_key = tx_key.pub;
+		td.m_additional_tx_pub_key = crypto::null_pkey;
+		td.m_internal_output_index = 0;
+		td.m_global_output_index = global_index;
+		ASSERT_TRUE(crypto::derive_public_key(derivation, 0, spend_public_key, td.m_out_key));
+		td.m_mask = rct::skGen();
+		td.m_amount = amount;
+		td.m_subaddr_index = subaddr_index;
+		td.m_rct = true;
+		td.m_key_image_known = true;
+		cryptonote::keypair in_ephemeral;
+		ASSERT_TRUE(cryptonote::generate_key_image_helper(keys, {{spend_public_key, subaddr_index}}, td.m_out_key, td.m_tx_pub_key, {}, 0, in_ephemeral, td.m_key_image, hwdev));
+		w.m_transfers.push_back(td);
+
+		daemon.outputs[global_index].key = td.m_out_key;
+		daemon.outputs[global_index].mask = rct::commit(amount, td.m_mask);
+	}
+
+	// What the daemon checks before it takes a transaction: every ring signature and range proof against
+	// the ring members it knows, and that the key images are those of the inputs the wallet says it spent
+	void validate(const tools::wallet2::pending_tx &ptx, size_t n)
+	{
+		SCOPED_TRACE("transaction " + std::to_string(n));
+		cryptonote::transaction tx;
+		ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(cryptonote::tx_to_blob(ptx.tx), tx));
+		ASSERT_EQ(tx.vin.size(), ptx.selected_transfers.size());
+
+		rct::rctSig &rv = tx.rct_signatures;
+		ASSERT_EQ(rv.type, rct::RCTTypeBulletproof);
+		ASSERT_EQ(rv.p.MGs.size(), tx.vin.size());
+		rv.message = rct::hash2rct(cryptonote::get_transaction_prefix_hash(tx));
+		rv.mixRing.resize(tx.vin.size());
+		for(size_t i = 0; i < tx.vin.size(); ++i)
+		{
+			const cryptonote::txin_to_key &in = boost::get<cryptonote::txin_to_key>(tx.vin[i]);
+			EXPECT_EQ(in.k_image, w.m_transfers[ptx.selected_transfers[i]].m_key_image);
+			EXPECT_TRUE(key_images.insert(in.k_image).second);
+			rv.p.MGs[i].II.resize(1);
+			rv.p.MGs[i].II[0] = rct::ki2rct(in.k_image);
+			for(uint64_t idx : cryptonote::relative_output_offsets_to_absolute(in.key_offsets))
+			{
+				ASSERT_LT(idx, daemon.outputs.size());
+				rv.mixRing[i].push_back({rct::pk2rct(daemon.outputs[idx].key), daemon.outputs[idx].mask});
+			}
+			EXPECT_EQ(rv.mixRing[i].size(), ring_size);
+		}
+		for(size_t i = 0; i < tx.vout.size(); ++i)
+			rv.outPk[i].dest = rct::pk2rct(boost::get<cryptonote::txout_to_key>(tx.vout[i].target).key);
+		EXPECT_TRUE(rct::verRctSemanticsSimple(rv));
+		EXPECT_TRUE(rct::verRctNonSemanticsSimple(rv));
+
+		EXPECT_EQ(rv.txnFee, ptx.fee);
+		EXPECT_GE(ptx.fee, w.calculate_fee(ring_size, cryptonote::get_object_blobsize(tx), w.get_fee_multiplier(1)));
+	}
+
+	static constexpr size_t ring_size = cryptonote::common_config::MIN_MIXIN_V2 + 1;
+
+	mock_daemon daemon;
+	tools::wallet2 w;
+	std::unordered_set<crypto::key_image> key_images;
+};
+
+constexpr size_t wallet_tx_batch::ring_size;
+
+TEST_F(wallet_tx_batch, every_tx_validates)
+{
+	for(uint64_t i = 0; i < 12; ++i)
+		add_output(100 + i * 150, cryptonote::MK_COINS(10));
+
+	std::vector<std::vector<cryptonote::tx_destination_entry>> dsts;
+	for(size_t n = 0; n < 5; ++n)
+	{
+		dsts.emplace_back();
+		for(size_t d = 0; d <= n % 3; ++d)
+		{
+			cryptonote::account_base payee;
+			payee.generate_new(0);
+			// the last one needs several inputs
+			dsts.back().emplace_back(n == 4 ? cryptonote::MK_COINS(15) : cryptonote::MK_COINS(n + d + 1), payee.get_keys().m_account_address, false);
+		}
+	}
+
+	std::vector<tools::wallet2::pending_tx> ptxs = w.create_transactions_batch(dsts, ring_size - 1, 0, 1, nullptr, 0, {});
+	ASSERT_EQ(ptxs.size(), dsts.size());
+	for(size_t n = 0; n < ptxs.size(); ++n)
+	{
+		validate(ptxs[n], n);
+		ASSERT_EQ(ptxs[n].dests.size(), dsts[n].size());
+		for(size_t d = 0; d < dsts[n].size(); ++d)
+			EXPECT_EQ(ptxs[n].dests[d].amount, dsts[n][d].amount);
+	}
+	EXPECT_GT(ptxs[4].selected_transfers.size(), 1);
+}
+
+TEST_F(wallet_tx_batch, not_enough_money)
+{
+	for(uint64_t i = 0; i < 3; ++i)
+		add_output(100 + i * 150, cryptonote::MK_COINS(10));
+
+	cryptonote::account_base payee;
+	payee.generate_new(0);
+	const std::vector<cryptonote::tx_destination_entry> dst = {cryptonote::tx_destination_entry(cryptonote::MK_COINS(10), payee.get_keys().m_account_address, false)};
+	const std::vector<std::vector<cryptonote::tx_destination_entry>> dsts(3, dst);
+	EXPECT_THROW(w.create_transactions_batch(dsts, ring_size - 1, 0, 1, nullptr, 0, {}), tools::error::tx_not_possible);
+}
+
+TEST_F(wallet_tx_batch, spends_from_one_subaddress)
+{
+	// the richer subaddress pays for the first transaction and has too little left for the second,
+	// which the other one can pay for on its own
+	for(uint64_t i = 0; i < 4; ++i)
+		add_output(100 + i * 150, cryptonote::MK_COINS(10), 0);
+	for(uint64_t i = 0; i < 3; ++i)
+		add_output(1100 + i * 150, cryptonote::MK_COINS(10), 1);
+
+	std::vector<std::vector<cryptonote::tx_destination_entry>> dsts;
+	for(size_t n = 0; n < 2; ++n)
+	{
+		cryptonote::account_base payee;
+		payee.generate_new(0);
+		dsts.push_back({cryptonote::tx_destination_entry(cryptonote::MK_COINS(25), payee.get_keys().m_account_address, false)});
+	}
+
+	std::vector<tools::wallet2::pending_tx> ptxs = w.create_transactions_batch(dsts, ring_size - 1, 0, 1, nullptr, 0, {});
+	ASSERT_EQ(ptxs.size(), dsts.size());
+	for(size_t n = 0; n < ptxs.size(); ++n)
+	{
+		validate(ptxs[n], n);
+		const cryptonote::subaddress_index &first = w.get_transfer_details(ptxs[n].selected_transfers.front()).m_subaddr_index;
+		for(size_t idx : ptxs[n].selected_transfers)
+			EXPECT_EQ(w.get_transfer_details(idx).m_subaddr_index, first) << "transaction " << n;
+	}
+}
+
+TEST_F(wallet_tx_batch, spends_from_several_subaddresses_if_needed)
+{
+	for(uint64_t i = 0; i < 3; ++i)
+	{
+		add_output(100 + i * 150, cryptonote::MK_COINS(10), 0);
+		add_output(1100 + i * 150, cryptonote::MK_COINS(10), 1);
+	}
+
+	cryptonote::account_base payee;
+	payee.generate_new(0);
+	const std::vector<std::vector<cryptonote::tx_destination_entry>> dsts = {{cryptonote::tx_destination_entry(cryptonote::MK_COINS(45), payee.get_keys().m_account_address, false)}};
+	std::vector<tools::wallet2::pending_tx> ptxs = w.create_transactions_batch(dsts, ring_size - 1, 0, 1, nullptr, 0, {});
+	ASSERT_EQ(ptxs.size(), 1);
+	validate(ptxs[0], 0);
+	EXPECT_EQ(ptxs[0].selected_transfers.size(), 5);
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "rpc/zmq_pub.h"
+#include "string_tools.h"
+
+namespace
+{
+class test_publisher : public cryptonote::rpc::ZmqPublisher
+{
+  public:
+	test_publisher() : ZmqPublisher(), caller(boost::this_thread::get_id()), on_caller_thread(false) {}
+	// the publisher thread calls send() until it is stopped
+	~test_publisher() { stop(); }
+
+	bool wait_for(size_t count)
+	{
+		boost::unique_lock<boost::mutex> lock(sent_lock);
+		return sent_cond.wait_for(lock, boost::chrono::seconds(10), [&] { return sent.size() >= count; });
+	}
+
+	std::vector<std::pair<std::string, std::string>> sent;
+	boost::thread::id caller;
+	bool on_caller_thread;
+
+  private:
+	void send(const std::string &topic, const std::string &body) override
+	{
+		boost::unique_lock<boost::mutex> lock(sent_lock);
+		on_caller_thread |= boost::this_thread::get_id() == caller;
+		sent.emplace_back(topic, body);
+		sent_cond.notify_all();
+	}
+
+	boost::mutex sent_lock;
+	boost::condition_variable sent_cond;
+};
+
+crypto::hash make_hash(char c)
+{
+	crypto::hash h;
+	memset(&h, c, sizeof(h));
+	return h;
+}
+}
+
+TEST(zmq_pub, publishes_events_in_order)
+{
+	const crypto::hash block = make_hash(1), tx1 = make_hash(2), tx2 = make_hash(3);
+	const std::string block_hex = epee::string_tools::pod_to_hex(block);
+	const std::string tx1_hex = epee::string_tools::pod_to_hex(tx1);
+	const std::string tx2_hex = epee::string_tools::pod_to_hex(tx2);
+
+	test_publisher publisher;
+	publisher.run();
+	publisher.on_txpool_tx_added(tx1);
+	publisher.on_block_added(10, block, {tx1, tx2});
+	publisher.on_block_removed(10, block, {});
+	publisher.on_txpool_tx_removed(tx2);
+	ASSERT_TRUE(publisher.wait_for(4));
+	publisher.stop();
+
+	ASSERT_EQ(4u, publisher.sent.size());
+	EXPECT_EQ("txpool_add", publisher.sent[0].first);
+	EXPECT_EQ("{\"tx_hash\":\"" + tx1_hex + "\"}", publisher.sent[0].second);
+	EXPECT_EQ("block_added", publisher.sent[1].first);
+	EXPECT_EQ("{\"height\":10,\"hash\":\"" + block_hex + "\",\"tx_hashes\":[\"" + tx1_hex + "\",\"" + tx2_hex + "\"]}", publisher.sent[1].second);
+	EXPECT_EQ("block_removed", publisher.sent[2].first);
+	EXPECT_EQ("{\"height\":10,\"hash\":\"" + block_hex + "\",\"tx_hashes\":[]}", publisher.sent[2].second);
+	EXPECT_EQ("txpool_remove", publisher.sent[3].first);
+	EXPECT_EQ("{\"tx_hash\":\"" + tx2_hex + "\"}", publisher.sent[3].second);
+
+	// the callbacks only queue, sending happens on the publisher thread
+	EXPECT_FALSE(publisher.on_caller_thread);
+}
+
+TEST(zmq_pub, ignores_events_when_not_running)
+{
+	test_publisher publisher;
+	publisher.on_txpool_tx_added(make_hash(1));
+	publisher.run();
+	publisher.on_txpool_tx_added(make_hash(2));
+	ASSERT_TRUE(publisher.wait_for(1));
+	publisher.stop();
+	publisher.on_txpool_tx_added(make_hash(3));
+
+	ASSERT_EQ(1u, publisher.sent.size());
+	EXPECT_EQ("{\"tx_hash\":\"" + epee::string_tools::pod_to_hex(make_hash(2)) + "\"}", publisher.sent[0].second);
+}